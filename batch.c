@@ -0,0 +1,651 @@
+/**
+ * pluto-gps-batch renders a list of scenarios from a scenario file into I/Q
+ * files. The file is parsed and validated completely before the first sample
+ * is generated, ephemeris and motion files are read once however many
+ * scenarios use them, and the worker threads keep their engine context and
+ * filters from one scenario to the next.
+ *
+ * This file is part of the pluto-gps-sim project at
+ * https://github.com/mictronics/pluto-gps-sim.git
+ *
+ * Copyright © 2019 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "gpssim_int.h"
+
+/*! \brief Maximum number of scenarios in one file */
+#define BATCH_MAX_SCENARIOS (4096)
+
+/*! \brief Maximum number of ephemeris files in one file */
+#define BATCH_MAX_EPHEMERIS (64)
+
+/*! \brief Maximum number of cores in the affinity list */
+#define BATCH_MAX_CORES (256)
+
+/*! \brief One ephemeris file, loaded once into a context of its own */
+struct batch_ephemeris {
+    char file[MAX_CHAR];
+    int rinex3;
+    gpssim_t *holder;
+};
+
+/*! \brief One receiver motion file, loaded once */
+struct batch_motion {
+    char file[MAX_CHAR];
+    double (*xyz)[3];
+    int numd;
+};
+
+/*! \brief One scenario of the file, defaults and derived data included */
+struct scenario {
+    char name[MAX_CHAR];
+    int line; // Line of the section header
+    gpssim_config_t cfg;
+    char ephfile[MAX_CHAR];
+    int rinex3;
+    gpstime_t g0; // Start, week < 0 = first ephemeris set
+    double xyz[3]; // Static position
+    char motion[MAX_CHAR]; // Motion file, empty = static position
+    double duration; // Seconds
+    double power[MAX_SAT]; // Power offset per PRN in dB
+    char output[MAX_CHAR];
+    int iq_bits;
+    // Derived during validation
+    long long nsamp;
+    const struct batch_ephemeris *eph;
+    const struct batch_motion *mot;
+    // Result
+    int status;
+    double secs;
+};
+
+/*! \brief Scenario list and the settings of the whole run */
+struct batch {
+    struct scenario *scen;
+    int nscen;
+    struct batch_ephemeris eph[BATCH_MAX_EPHEMERIS];
+    int neph;
+    struct batch_motion *mot;
+    int nmot;
+    int nthreads; // 0 = all cores
+    int cores[BATCH_MAX_CORES];
+    int ncores;
+    atomic_int next; // Next scenario to render
+};
+
+/*! \brief Worker thread, keeps its engine context from scenario to scenario */
+struct batch_worker {
+    struct batch *b;
+    int core; // < 0 = no affinity
+    gpssim_t *sim;
+    gpssim_config_t cfg; // Configuration of sim
+    const struct batch_ephemeris *eph; // Ephemeris loaded into sim
+    short *iq;
+    unsigned char *pack;
+    int block;
+};
+
+static void batchUsage(void) {
+    fprintf(stderr, "Usage: pluto-gps-batch [options] <scenario file>\n"
+            "Options:\n"
+            "  -n               Validate the scenario file only, render nothing\n"
+            "  -j <threads>     Worker threads, overrides the file, 0 = all cores\n");
+
+    return;
+}
+
+/*! \brief Report an error at a line of the scenario file and exit */
+static void batchError(const char *file, int line, const char *msg, const char *arg) {
+    fprintf(stderr, "ERROR: %s:%d: %s%s%s\n", file, line, msg, (arg != NULL) ? ": " : "", (arg != NULL) ? arg : "");
+    exit(1);
+}
+
+/*! \brief Remove leading and trailing white space in place */
+static char *trim(char *s) {
+    char *e;
+
+    while (*s == ' ' || *s == '\t')
+        s++;
+    e = s + strlen(s);
+    while (e > s && (e[-1] == ' ' || e[-1] == '\t' || e[-1] == '\r' || e[-1] == '\n'))
+        e--;
+    *e = '\0';
+
+    return (s);
+}
+
+/*! \brief Parse a whole decimal value, nothing may follow */
+static int parseLong(const char *v, long long *out) {
+    char *end;
+
+    *out = strtoll(v, &end, 10);
+
+    return ((end != v && *end == '\0') ? 0 : -1);
+}
+
+/*! \brief Parse a whole floating point value, nothing may follow */
+static int parseDouble(const char *v, double *out) {
+    char *end;
+
+    *out = strtod(v, &end);
+
+    return ((end != v && *end == '\0') ? 0 : -1);
+}
+
+/*! \brief Parse a comma separated list of core numbers
+ *  \returns Number of cores, -1 on syntax error
+ */
+static int parseCores(const char *v, int *cores, int max) {
+    const char *p = v;
+    char *end;
+    long c;
+    int n = 0;
+
+    while (*p != '\0') {
+        c = strtol(p, &end, 10);
+        if (end == p || c < 0 || n == max)
+            return (-1);
+        cores[n++] = (int) c;
+        p = end;
+        if (*p == ',')
+            p++;
+        else if (*p != '\0')
+            return (-1);
+    }
+
+    return (n);
+}
+
+/*! \brief Set a run wide key, only allowed before the first section
+ *  \returns 0 on success, 1 if the key is not a run wide key, -1 on invalid value
+ */
+static int setGlobalKey(struct batch *b, const char *key, const char *v) {
+    long long n;
+
+    if (strcmp(key, "threads") == 0) {
+        if (parseLong(v, &n) != 0 || n < 0 || n > BATCH_MAX_CORES)
+            return (-1);
+        b->nthreads = (int) n;
+    } else if (strcmp(key, "affinity") == 0) {
+        b->ncores = parseCores(v, b->cores, BATCH_MAX_CORES);
+        if (b->ncores < 1)
+            return (-1);
+    } else {
+        return (1);
+    }
+
+    return (0);
+}
+
+/*! \brief Set a scenario key
+ *  \returns 0 on success, 1 on unknown key, -1 on invalid value
+ */
+static int setScenarioKey(struct scenario *s, const char *key, const char *v) {
+    gpssim_config_t *cfg = &s->cfg;
+    datetime_t t0;
+    double d;
+    long long n;
+
+    if (strcmp(key, "ephemeris") == 0) {
+        snprintf(s->ephfile, MAX_CHAR, "%s", v);
+    } else if (strcmp(key, "rinex3") == 0) {
+        if (parseLong(v, &n) != 0 || n < 0 || n > 1)
+            return (-1);
+        s->rinex3 = (int) n;
+    } else if (strcmp(key, "start") == 0) {
+        if (sscanf(v, "%d/%d/%d,%d:%d:%lf", &t0.y, &t0.m, &t0.d, &t0.hh, &t0.mm, &t0.sec) != 6
+                || t0.y <= 1980 || t0.m < 1 || t0.m > 12 || t0.d < 1 || t0.d > 31
+                || t0.hh < 0 || t0.hh > 23 || t0.mm < 0 || t0.mm > 59 || t0.sec < 0.0 || t0.sec >= 60.0)
+            return (-1);
+        t0.sec = floor(t0.sec);
+        date2gps(&t0, &s->g0);
+    } else if (strcmp(key, "llh") == 0) {
+        double llh[3];
+
+        if (sscanf(v, "%lf,%lf,%lf", &llh[0], &llh[1], &llh[2]) != 3 || fabs(llh[0]) > 90.0 || fabs(llh[1]) > 180.0)
+            return (-1);
+        gpssim_llh_to_xyz(llh, s->xyz);
+        s->motion[0] = '\0';
+    } else if (strcmp(key, "xyz") == 0) {
+        if (sscanf(v, "%lf,%lf,%lf", &s->xyz[0], &s->xyz[1], &s->xyz[2]) != 3)
+            return (-1);
+        s->motion[0] = '\0';
+    } else if (strcmp(key, "motion") == 0) {
+        snprintf(s->motion, MAX_CHAR, "%s", v);
+    } else if (strcmp(key, "duration") == 0) {
+        if (parseDouble(v, &d) != 0 || d <= 0.0)
+            return (-1);
+        s->duration = d;
+    } else if (strcmp(key, "sample_rate") == 0) {
+        if (parseLong(v, &n) != 0)
+            return (-1);
+        cfg->fs_hz = n;
+    } else if (strcmp(key, "generation_rate") == 0) {
+        if (parseLong(v, &n) != 0 || n < 0)
+            return (-1);
+        cfg->gen_hz = n;
+    } else if (strcmp(key, "channels") == 0) {
+        if (parseLong(v, &n) != 0 || n < 1 || n > MAX_CHAN)
+            return (-1);
+        cfg->nchan = (int) n;
+    } else if (strcmp(key, "fir_taps") == 0) {
+        if (parseLong(v, &n) != 0 || (n != 0 && (n < MIN_FIR_TAPS || n > MAX_FIR_TAPS || n % 4 != 0)))
+            return (-1);
+        cfg->fir_taps = (int) n;
+    } else if (strcmp(key, "bandwidth") == 0) {
+        if (parseDouble(v, &d) != 0 || d <= 0.0)
+            return (-1);
+        cfg->bw_hz = MHZ(d);
+    } else if (strcmp(key, "noise") == 0) {
+        if (strcmp(v, "off") == 0) {
+            cfg->noise_cn0 = -1.0;
+        } else {
+            if (parseDouble(v, &d) != 0 || d < MIN_NOISE_CN0 || d > MAX_NOISE_CN0)
+                return (-1);
+            cfg->noise_cn0 = d;
+        }
+    } else if (strcmp(key, "seed") == 0) {
+        if (parseLong(v, &n) != 0)
+            return (-1);
+        cfg->noise_seed = (uint64_t) n;
+    } else if (strcmp(key, "power") == 0) {
+        // Replaces the whole list, PRNs not listed are at 0dB
+        for (n = 0; n < MAX_SAT; n++)
+            s->power[n] = 0.0;
+        if (parsePrnLevels(v, s->power, -MAX_POWER_OFFSET, MAX_POWER_OFFSET) != 0)
+            return (-1);
+    } else if (strcmp(key, "iono") == 0) {
+        if (parseLong(v, &n) != 0 || n < 0 || n > 1)
+            return (-1);
+        cfg->iono = (int) n;
+    } else if (strcmp(key, "autoscale") == 0) {
+        if (parseLong(v, &n) != 0 || n < 0 || n > 1)
+            return (-1);
+        cfg->autoscale = (int) n;
+    } else if (strcmp(key, "output") == 0) {
+        snprintf(s->output, MAX_CHAR, "%s", v);
+    } else if (strcmp(key, "format") == 0) {
+        if (parseLong(v, &n) != 0 || (n != IQ_FMT_SC16 && n != IQ_FMT_SC8 && n != IQ_FMT_SC4))
+            return (-1);
+        s->iq_bits = (int) n;
+    } else {
+        return (1);
+    }
+
+    return (0);
+}
+
+/*! \brief Parse a scenario file into \a b, exits on the first error
+ *
+ * Lines are key = value pairs, # starts a comment. A [name] line starts a
+ * scenario, it takes all keys set before the first section as defaults.
+ */
+static void readScenarioFile(struct batch *b, const char *file) {
+    struct scenario def;
+    struct scenario *s = &def;
+    char str[MAX_CHAR * 2];
+    char *line, *key, *v, *p;
+    int lineno = 0, rc;
+    FILE *fp;
+
+    memset(&def, 0, sizeof (def));
+    gpssim_config_default(&def.cfg);
+    def.g0.week = -1;
+    def.duration = 300.0;
+    def.iq_bits = IQ_FMT_SC16;
+
+    fp = fopen(file, "rt");
+    if (fp == NULL) {
+        fprintf(stderr, "ERROR: Failed to open scenario file %s.\n", file);
+        exit(1);
+    }
+
+    while (fgets(str, sizeof (str), fp) != NULL) {
+        lineno++;
+        if (strchr(str, '\n') == NULL && !feof(fp))
+            batchError(file, lineno, "Line too long", NULL);
+        p = strchr(str, '#');
+        if (p != NULL)
+            *p = '\0';
+        line = trim(str);
+        if (*line == '\0')
+            continue;
+
+        if (*line == '[') {
+            p = strchr(line, ']');
+            if (p == NULL || p[1] != '\0' || p == line + 1)
+                batchError(file, lineno, "Invalid section", line);
+            if (b->nscen == BATCH_MAX_SCENARIOS)
+                batchError(file, lineno, "Too many scenarios", NULL);
+            *p = '\0';
+            s = &b->scen[b->nscen++];
+            *s = def;
+            snprintf(s->name, MAX_CHAR, "%s", line + 1);
+            s->line = lineno;
+            continue;
+        }
+
+        v = strchr(line, '=');
+        if (v == NULL)
+            batchError(file, lineno, "Expected key = value", line);
+        *v++ = '\0';
+        key = trim(line);
+        v = trim(v);
+        if (*v == '\0')
+            batchError(file, lineno, "Missing value", key);
+
+        rc = setGlobalKey(b, key, v);
+        if (rc == 0 && s != &def)
+            batchError(file, lineno, "Key only allowed before the first scenario", key);
+        if (rc == 1)
+            rc = setScenarioKey(s, key, v);
+        if (rc == 1)
+            batchError(file, lineno, "Unknown key", key);
+        if (rc != 0)
+            batchError(file, lineno, "Invalid value", v);
+    }
+
+    fclose(fp);
+
+    if (b->nscen == 0) {
+        fprintf(stderr, "ERROR: %s has no scenario.\n", file);
+        exit(1);
+    }
+
+    return;
+}
+
+/*! \brief Check every scenario and load its ephemeris and motion, exits on the first error */
+static void validateScenarios(struct batch *b, const char *file) {
+    struct scenario *s;
+    gpssim_config_t cfg;
+    gpssim_t *sim;
+    int i, j;
+
+    for (i = 0; i < b->nscen; i++) {
+        s = &b->scen[i];
+
+        if (s->ephfile[0] == '\0')
+            batchError(file, s->line, "No ephemeris file", s->name);
+        if (s->output[0] == '\0')
+            batchError(file, s->line, "No output file", s->name);
+        for (j = 0; j < i; j++) {
+            if (strcmp(b->scen[j].output, s->output) == 0)
+                batchError(file, s->line, "Output file already used by scenario", b->scen[j].name);
+        }
+
+        // Compact formats quantize the 12-bit DAC range
+        if (s->iq_bits != IQ_FMT_SC16)
+            s->cfg.autoscale = 1;
+
+        // A context of the configuration is the check, it is released right away
+        sim = gpssim_create(&s->cfg);
+        if (sim == NULL)
+            batchError(file, s->line, "Invalid sample rate, generation rate, channels, FIR or noise", s->name);
+
+        s->nsamp = llround(s->duration * (double) s->cfg.fs_hz);
+        if (s->iq_bits == IQ_FMT_SC4 && ((s->cfg.fs_hz / 10) % 2 != 0 || s->nsamp % 2 != 0))
+            batchError(file, s->line, "sc4 needs an even number of samples per block and in total", s->name);
+
+        // Each ephemeris file is read once, into a context that only holds it
+        for (j = 0; j < b->neph; j++) {
+            if (strcmp(b->eph[j].file, s->ephfile) == 0 && b->eph[j].rinex3 == s->rinex3)
+                break;
+        }
+        if (j == b->neph) {
+            if (b->neph == BATCH_MAX_EPHEMERIS)
+                batchError(file, s->line, "Too many ephemeris files", NULL);
+            gpssim_config_default(&cfg);
+            snprintf(b->eph[j].file, MAX_CHAR, "%s", s->ephfile);
+            b->eph[j].rinex3 = s->rinex3;
+            b->eph[j].holder = gpssim_create(&cfg);
+            if (b->eph[j].holder == NULL || gpssim_load_ephemeris(b->eph[j].holder, s->ephfile, s->rinex3) <= 0)
+                batchError(file, s->line, "Failed to read ephemeris", s->ephfile);
+            b->neph++;
+        }
+        s->eph = &b->eph[j];
+
+        gpssim_destroy(sim);
+
+        if (s->g0.week >= 0 && gpssim_check_start(s->eph->holder, s->g0.week, s->g0.sec) != 0)
+            batchError(file, s->line, "No ephemeris set covers the start time", s->name);
+
+        if (s->motion[0] == '\0')
+            continue;
+
+        for (j = 0; j < b->nmot; j++) {
+            if (strcmp(b->mot[j].file, s->motion) == 0)
+                break;
+        }
+        if (j == b->nmot) {
+            snprintf(b->mot[j].file, MAX_CHAR, "%s", s->motion);
+            b->mot[j].xyz = malloc(USER_MOTION_SIZE * sizeof (*b->mot[j].xyz));
+            if (b->mot[j].xyz == NULL)
+                batchError(file, s->line, "Failed to allocate motion buffer", NULL);
+            b->mot[j].numd = readUserMotion(b->mot[j].xyz, s->motion);
+            if (b->mot[j].numd <= 0)
+                batchError(file, s->line, "Failed to read user motion", s->motion);
+            b->nmot++;
+        }
+        s->mot = &b->mot[j];
+    }
+
+    return;
+}
+
+/*! \brief Check two engine configurations for equal contexts */
+static int configEqual(const gpssim_config_t *a, const gpssim_config_t *b) {
+    return (a->fs_hz == b->fs_hz && a->gen_hz == b->gen_hz && a->nchan == b->nchan && a->fir_taps == b->fir_taps
+            && a->bw_hz == b->bw_hz && a->noise_cn0 == b->noise_cn0 && a->noise_seed == b->noise_seed
+            && a->autoscale == b->autoscale && a->iono == b->iono && a->nrx == b->nrx && a->nelem == b->nelem
+            && a->carr_bits == b->carr_bits && a->phasor == b->phasor && a->tmpl_bound == b->tmpl_bound
+            && a->msb == b->msb);
+}
+
+/*! \brief Render one scenario into its output file
+ *  \returns 0 on success, -1 on error
+ */
+static int runScenario(struct batch_worker *w, const struct scenario *s) {
+    long long left = s->nsamp;
+    int sv, n, shift = iqShift(s->iq_bits, 0);
+    size_t bytes;
+    FILE *fp;
+
+    // Same configuration keeps the context, its filters and buffers
+    if (w->sim == NULL || !configEqual(&w->cfg, &s->cfg)) {
+        gpssim_destroy(w->sim);
+        free(w->iq);
+        free(w->pack);
+        w->iq = NULL;
+        w->pack = NULL;
+        w->eph = NULL;
+        w->sim = gpssim_create(&s->cfg);
+        if (w->sim == NULL)
+            return (-1);
+        w->cfg = s->cfg;
+        w->block = (int) (s->cfg.fs_hz / 10);
+        w->iq = malloc(iqBytes(IQ_FMT_SC16, w->block));
+        w->pack = malloc(iqBytes(IQ_FMT_SC8, w->block));
+        if (w->iq == NULL || w->pack == NULL) {
+            gpssim_destroy(w->sim);
+            w->sim = NULL;
+            return (-1);
+        }
+    }
+
+    if (w->eph != s->eph) {
+        if (gpssim_copy_ephemeris(w->sim, s->eph->holder) <= 0)
+            return (-1);
+        w->eph = s->eph;
+    }
+
+    if (s->mot != NULL) {
+        if (gpssim_set_trajectory(w->sim, 0, (const double (*)[3]) s->mot->xyz, s->mot->numd) != 0)
+            return (-1);
+    } else if (gpssim_set_position(w->sim, 0, s->xyz) != 0) {
+        return (-1);
+    }
+    for (sv = 0; sv < MAX_SAT; sv++)
+        gpssim_set_power(w->sim, sv + 1, s->power[sv]);
+
+    if (gpssim_start(w->sim, s->g0.week, s->g0.sec) != 0)
+        return (-1);
+
+    fp = fopen(s->output, "wb");
+    if (fp == NULL)
+        return (-1);
+
+    while (left > 0) {
+        n = (left < w->block) ? (int) left : w->block;
+        if (gpssim_generate(w->sim, w->iq, n) != n)
+            break;
+        bytes = iqBytes(s->iq_bits, n);
+        if (s->iq_bits == IQ_FMT_SC16) {
+            if (fwrite(w->iq, 1, bytes, fp) != bytes)
+                break;
+        } else {
+            iqCompress(w->iq, w->pack, n, s->iq_bits, shift);
+            if (fwrite(w->pack, 1, bytes, fp) != bytes)
+                break;
+        }
+        left -= n;
+    }
+
+    if (fclose(fp) != 0 || left > 0)
+        return (-1);
+
+    return (0);
+}
+
+static void *batchWorker(void *arg) {
+    struct batch_worker *w = (struct batch_worker *) arg;
+    struct batch *b = w->b;
+    struct timespec t0, t1;
+    struct scenario *s;
+    int i;
+
+    if (w->core >= 0 && thread_to_core(w->core) != 0)
+        fprintf(stderr, "Warning: Failed to pin worker to core %d.\n", w->core);
+
+    while ((i = atomic_fetch_add(&b->next, 1)) < b->nscen) {
+        s = &b->scen[i];
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        s->status = runScenario(w, s);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        s->secs = timeDiffUs(&t1, &t0) / 1.0e6;
+
+        if (s->status != 0)
+            fprintf(stderr, "ERROR: Scenario %s failed.\n", s->name);
+        else
+            fprintf(stderr, "%s: %.1fs to %s in %.2fs (%.1fx real time)\n", s->name, s->duration, s->output,
+                s->secs, s->duration / s->secs);
+    }
+
+    gpssim_destroy(w->sim);
+    free(w->iq);
+    free(w->pack);
+
+    return (NULL);
+}
+
+int main(int argc, char *argv[]) {
+    static struct batch b;
+    struct batch_worker *w;
+    pthread_t *th;
+    struct timespec t0, t1;
+    bool check_only = false;
+    int nthreads = -1;
+    int result, i, nfail = 0;
+
+    while ((result = getopt(argc, argv, "nj:h")) != -1) {
+        switch (result) {
+            case 'n':
+                check_only = true;
+                break;
+            case 'j':
+                nthreads = atoi(optarg);
+                if (nthreads < 0) {
+                    fprintf(stderr, "ERROR: Invalid number of worker threads.\n");
+                    exit(1);
+                }
+                break;
+            case 'h':
+            default:
+                batchUsage();
+                exit((result == 'h') ? 0 : 1);
+        }
+    }
+
+    if (optind != argc - 1) {
+        batchUsage();
+        exit(1);
+    }
+
+    b.scen = calloc(BATCH_MAX_SCENARIOS, sizeof (struct scenario));
+    b.mot = calloc(BATCH_MAX_SCENARIOS, sizeof (struct batch_motion));
+    if (b.scen == NULL || b.mot == NULL) {
+        fprintf(stderr, "ERROR: Failed to allocate scenario list.\n");
+        exit(1);
+    }
+    b.nthreads = 1;
+
+    readScenarioFile(&b, argv[optind]);
+    validateScenarios(&b, argv[optind]);
+
+    if (nthreads >= 0)
+        b.nthreads = nthreads;
+    if (b.nthreads == 0)
+        b.nthreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (b.nthreads > b.nscen)
+        b.nthreads = b.nscen;
+
+    fprintf(stderr, "%d scenarios, %d ephemeris files, %d motion files, %d threads\n",
+            b.nscen, b.neph, b.nmot, b.nthreads);
+    if (check_only)
+        exit(0);
+
+    w = calloc(b.nthreads, sizeof (struct batch_worker));
+    th = calloc(b.nthreads, sizeof (pthread_t));
+    if (w == NULL || th == NULL) {
+        fprintf(stderr, "ERROR: Failed to allocate worker threads.\n");
+        exit(1);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    atomic_init(&b.next, 0);
+    for (i = 0; i < b.nthreads; i++) {
+        w[i].b = &b;
+        w[i].core = (b.ncores > 0) ? b.cores[i % b.ncores] : -1;
+        if (pthread_create(&th[i], NULL, batchWorker, &w[i]) != 0) {
+            fprintf(stderr, "ERROR: Failed to create worker thread.\n");
+            exit(1);
+        }
+    }
+    for (i = 0; i < b.nthreads; i++)
+        pthread_join(th[i], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    for (i = 0; i < b.nscen; i++) {
+        if (b.scen[i].status != 0)
+            nfail++;
+    }
+    fprintf(stderr, "Done, %d of %d scenarios in %.2fs\n", b.nscen - nfail, b.nscen, timeDiffUs(&t1, &t0) / 1.0e6);
+
+    for (i = 0; i < b.neph; i++)
+        gpssim_destroy(b.eph[i].holder);
+    for (i = 0; i < b.nmot; i++)
+        free(b.mot[i].xyz);
+    free(b.mot);
+    free(b.scen);
+    free(w);
+    free(th);
+
+    return ((nfail > 0) ? 1 : 0);
+}
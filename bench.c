@@ -0,0 +1,778 @@
+/**
+ * pluto-gps-bench measures the signal generation hot path of pluto-gps-sim
+ * without ADALM-Pluto hardware attached.
+ *
+ * This file is part of the pluto-gps-sim project at
+ * https://github.com/mictronics/pluto-gps-sim.git
+ *
+ * Copyright © 2019 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "gpssim_int.h"
+
+#define BENCH_MAX_CHAN (32)
+#define BENCH_MAX_RUNS (32)
+
+/*! \brief Samples of the SFDR test tone, power of two */
+#define SFDR_LEN (65536)
+
+/*! \brief Bins around the test tone excluded from the spur search */
+#define SFDR_GUARD (8)
+
+/*! \brief Sample generation kernel */
+typedef void (*kernel_fn_t)(channel_t *, int, int32_t *, int, double, const struct carrier_table *, float *);
+
+/*! \brief Benchmarked kernel variant */
+typedef struct {
+    const char *stage;
+    const char *engine; /*!< Carrier engine name in SFDR report */
+    kernel_fn_t fn;
+    bool tmpl; /*!< Needs code templates */
+} bench_kernel_t;
+
+static const bench_kernel_t benchKernels[] = {
+    {"kernel", "lut", generateSamples, false},
+    {"kernel_tmpl", "lut", generateSamplesTmpl, true},
+    {"kernel_phasor", "phasor", generateSamplesPhasor, false},
+    {"kernel_phasor_tmpl", "phasor", generateSamplesPhasorTmpl, true},
+};
+
+#define BENCH_NUM_KERNELS ((int) (sizeof (benchKernels) / sizeof (benchKernels[0])))
+
+/*! \brief Carrier table of all stages, see initCarrierTable() */
+static struct carrier_table carr;
+
+/*! \brief Set of benchmark parameters */
+typedef struct {
+    int nchan[BENCH_MAX_RUNS]; /*!< Channel counts to sweep */
+    int nruns; /*!< Number of channel counts */
+    long long fs_hz; /*!< Sample rate */
+    int block; /*!< Samples per block */
+    double duration; /*!< Signal time to generate per run in seconds */
+    int iterations; /*!< Iterations of the orbit and navigation message stages */
+    bool sfdr; /*!< Measure carrier spurious-free dynamic range instead of throughput */
+    int carr_bits; /*!< Sin/cos table phase resolution */
+} bench_cfg_t;
+
+static void benchUsage(void) {
+    fprintf(stderr, "Usage: pluto-gps-bench [options]\n"
+            "Options:\n"
+            "  -e <file name>   RINEX navigation file, enables parse stage and uses its ephemerides\n"
+            "  -3               Use RINEX version 3 format\n"
+            "  -n <channels>    Comma separated channel counts 1..%d (default 1,4,8,12,16,32)\n"
+            "  -s <frequency>   Sampling frequency [Hz] (default: %d)\n"
+            "  -b <samples>     Samples per block (default: sampling frequency / 10)\n"
+            "  -d <seconds>     Signal time generated per channel count (default 2.0)\n"
+            "  -i <iterations>  Iterations of orbit and navigation message stages (default 100000)\n"
+            "  -F               Measure spurious-free dynamic range of the carrier engines\n"
+            "  -L <bits>        Sin/cos table phase resolution %d..%d bits (default 9)\n",
+            BENCH_MAX_CHAN, TX_SAMPLE_FREQ, MIN_CARR_TABLE_BITS, MAX_CARR_TABLE_BITS);
+
+    return;
+}
+
+/*! \brief Print one result line in CSV format
+ *  \param[in] stage Name of the benchmarked stage
+ *  \param[in] nchan Number of channels, 0 if not applicable
+ *  \param[in] cfg Benchmark parameters
+ *  \param[in] ops Number of operations (samples or calls) executed
+ *  \param[in] us Elapsed time in microseconds
+ */
+static void benchReport(const char *stage, int nchan, const bench_cfg_t *cfg, double ops, double us) {
+    double ns_per_op = us * 1.0e3 / ops;
+
+    printf("%s,%d,%lld,%d,%.0f,%.6f,%.1f,%.3f,%.3f\n", stage, nchan, cfg->fs_hz, cfg->block,
+            ops, us / 1.0e6, ops * 1.0e6 / us, ns_per_op, (nchan > 0) ? ns_per_op / nchan : ns_per_op);
+    fflush(stdout);
+
+    return;
+}
+
+/*! \brief Fill nominal ephemerides for a 32 SV constellation
+ *  \param[out] eph Array of SV ephemeris data
+ *  \param[in] g Time of ephemeris
+ */
+static void benchEphemeris(ephem_t eph[MAX_SAT], gpstime_t g) {
+    int sv;
+
+    for (sv = 0; sv < MAX_SAT; sv++) {
+        memset(&eph[sv], 0, sizeof (ephem_t));
+        eph[sv].vflg = true;
+        eph[sv].toc = g;
+        eph[sv].toe = g;
+        eph[sv].iode = eph[sv].iodc = sv + 1;
+        eph[sv].sqrta = 5153.6;
+        eph[sv].ecc = 0.005 + 0.001 * (sv % 7);
+        eph[sv].inc0 = 0.96;
+        eph[sv].omg0 = -PI + (sv % 6) * PI / 3.0;
+        eph[sv].m0 = -PI + (sv / 6) * PI / 3.0 + (sv % 6) * 0.3;
+        eph[sv].aop = 0.5 * (sv % 4);
+        eph[sv].omgdot = -8.0e-9;
+        eph[sv].deltan = 4.5e-9;
+        eph[sv].af0 = 1.0e-5;
+        eph[sv].af1 = -1.0e-12;
+
+        eph[sv].A = eph[sv].sqrta * eph[sv].sqrta;
+        eph[sv].n = sqrt(GM_EARTH / (eph[sv].A * eph[sv].A * eph[sv].A)) + eph[sv].deltan;
+        eph[sv].sq1e2 = sqrt(1.0 - eph[sv].ecc * eph[sv].ecc);
+        eph[sv].omgkdot = eph[sv].omgdot - OMEGA_EARTH;
+    }
+
+    return;
+}
+
+/*! \brief Benchmark the sample generation kernel
+ *  \param[in] cfg Benchmark parameters
+ *  \param[in] eph Array of SV ephemeris data
+ *  \param[in] ionoutc Iono/UTC parameters
+ *  \param[in] g Simulation time
+ *  \param[in] nchan Number of active channels
+ *  \param[in] kernel Kernel variant
+ */
+static void benchKernel(const bench_cfg_t *cfg, ephem_t *eph, ionoutc_t ionoutc, gpstime_t g, int nchan,
+        const bench_kernel_t *kernel) {
+    static channel_t chan[BENCH_MAX_CHAN];
+    static navmsg_t nav;
+    static struct signal_model sig; // No echoes, no noise
+    double gain[BENCH_MAX_CHAN];
+    double delt = 1.0 / cfg->fs_hz;
+    long nblocks = (long) ceil(cfg->duration * cfg->fs_hz / cfg->block);
+    struct timespec t0, t1;
+    double us = 0.0;
+    int32_t *acc;
+    float *work;
+    short *iq;
+    long b;
+    int i;
+
+    iq = calloc(cfg->block, 2 * sizeof (short));
+    acc = calloc(cfg->block, 2 * sizeof (int32_t));
+    work = malloc(PHASOR_WORK * sizeof (float));
+    if (iq == NULL || acc == NULL || work == NULL) {
+        fprintf(stderr, "ERROR: Failed to allocate I/Q buffer.\n");
+        exit(1);
+    }
+
+    for (i = 0; i < BENCH_MAX_CHAN; i++) {
+        memset(&chan[i], 0, sizeof (channel_t));
+        if (i >= nchan)
+            continue;
+
+        chan[i].prn = i + 1;
+        chan[i].ca = caCode(i + 1);
+        eph2sbf(eph[i], ionoutc, nav.sbf);
+        generateNavMsg(g, &nav, 1);
+        channelNav(&chan[i], &nav);
+
+        // Spread Doppler over +/-4kHz
+        chan[i].f_carr = -4000.0 + 8000.0 * i / BENCH_MAX_CHAN;
+        chan[i].f_code = CODE_FREQ + chan[i].f_carr * CARR_TO_CODE;
+        chan[i].code_phase = 31.0 * i;
+#ifndef FLOAT_CARR_PHASE
+        chan[i].carr_phasestep = (int) round(512.0 * 65536.0 * chan[i].f_carr * delt);
+#endif
+        chan[i].codeCA = chan[i].ca[(int) chan[i].code_phase];
+        chan[i].dataBit = (int) ((chan[i].dwrd[0] >> 29) & 0x1UL)*2 - 1;
+        gain[i] = 0.9;
+        setChannelGain(&chan[i], gain[i]);
+    }
+
+    // Code templates are rendered once, outside the timed loop
+    if (kernel->tmpl && refreshCodeTemplates(chan, nchan, delt, 1.0e9) != 0) {
+        fprintf(stderr, "ERROR: Failed to allocate code templates.\n");
+        exit(1);
+    }
+
+    sig.carr = carr;
+    for (b = 0; b < nblocks; b++) {
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        kernel->fn(chan, nchan, acc, cfg->block, delt, &carr, work);
+        packSamples(acc, iq, cfg->block, outputScale(chan, nchan, gain, &sig, false), INT16_MAX, 0);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        us += timeDiffUs(&t1, &t0);
+
+        // Keep the word counter inside the nav message buffer on long runs
+        for (i = 0; i < nchan; i++) {
+            if (chan[i].iword >= N_DWRD - 1)
+                chan[i].iword = 0;
+        }
+    }
+
+    benchReport(kernel->stage, nchan, cfg, (double) nblocks * cfg->block, us);
+    freeCodeTemplates(chan, BENCH_MAX_CHAN);
+    free(acc);
+    free(work);
+    free(iq);
+
+    return;
+}
+
+/*! \brief In-place radix-2 FFT
+ *  \param re Real part, \a n values
+ *  \param im Imaginary part, \a n values
+ *  \param[in] n Transform length, power of two
+ */
+static void benchFft(double *re, double *im, int n) {
+    int i, j, k, m;
+    double wr, wi, tr, ti, a;
+
+    for (i = 1, j = 0; i < n; i++) {
+        for (k = n >> 1; j & k; k >>= 1)
+            j ^= k;
+        j ^= k;
+        if (i < j) {
+            tr = re[i], re[i] = re[j], re[j] = tr;
+            ti = im[i], im[i] = im[j], im[j] = ti;
+        }
+    }
+
+    for (m = 2; m <= n; m <<= 1) {
+        for (k = 0; k < m / 2; k++) {
+            a = -2.0 * PI * k / m;
+            wr = cos(a);
+            wi = sin(a);
+            for (i = k; i < n; i += m) {
+                j = i + m / 2;
+                tr = re[j] * wr - im[j] * wi;
+                ti = re[j] * wi + im[j] * wr;
+                re[j] = re[i] - tr;
+                im[j] = im[i] - ti;
+                re[i] += tr;
+                im[i] += ti;
+            }
+        }
+    }
+
+    return;
+}
+
+/*! \brief Measure spurious-free dynamic range of a carrier engine
+ *
+ * One channel with constant code chip and data bit generates a pure tone.
+ * The spectrum is Blackman-Harris windowed, SFDR is the ratio of the tone
+ * to the largest other spectral line.
+ *  \param[in] cfg Benchmark parameters
+ *  \param[in] kernel Kernel variant
+ *  \param[in] f_carr Tone frequency in Hz
+ */
+static void benchSfdr(const bench_cfg_t *cfg, const bench_kernel_t *kernel, double f_carr) {
+    static channel_t chan;
+    static signed char ones[CA_SEQ_LEN];
+    static struct signal_model sig; // No echoes, no noise
+    double gain = 60.0; // Close to 16-bit full scale
+    double delt = 1.0 / cfg->fs_hz;
+    double *re, *im, w, p, peak = 0.0, spur = 0.0;
+    int32_t *acc;
+    float *work;
+    short *iq;
+    int i, ipeak = 0, d;
+
+    iq = calloc(SFDR_LEN, 2 * sizeof (short));
+    acc = calloc(SFDR_LEN, 2 * sizeof (int32_t));
+    work = malloc(PHASOR_WORK * sizeof (float));
+    re = calloc(SFDR_LEN, sizeof (double));
+    im = calloc(SFDR_LEN, sizeof (double));
+    if (iq == NULL || acc == NULL || work == NULL || re == NULL || im == NULL) {
+        fprintf(stderr, "ERROR: Failed to allocate SFDR buffers.\n");
+        exit(1);
+    }
+
+    memset(ones, 1, sizeof (ones));
+    memset(&chan, 0, sizeof (chan));
+    chan.prn = 1;
+    chan.ca = ones;
+    for (i = 0; i < N_DWRD; i++)
+        chan.dwrd[i] = 0x3fffffffUL;
+    chan.f_carr = f_carr;
+    chan.f_code = CODE_FREQ + f_carr * CARR_TO_CODE;
+#ifndef FLOAT_CARR_PHASE
+    chan.carr_phasestep = (int) round(512.0 * 65536.0 * chan.f_carr * delt);
+#endif
+    chan.codeCA = 1;
+    chan.dataBit = 1;
+    setChannelGain(&chan, gain);
+
+    if (kernel->tmpl && refreshCodeTemplates(&chan, 1, delt, 1.0e9) != 0) {
+        fprintf(stderr, "ERROR: Failed to allocate code templates.\n");
+        exit(1);
+    }
+    sig.carr = carr;
+    kernel->fn(&chan, 1, acc, SFDR_LEN, delt, &carr, work);
+    packSamples(acc, iq, SFDR_LEN, outputScale(&chan, 1, &gain, &sig, false), INT16_MAX, 0);
+    freeCodeTemplates(&chan, 1);
+
+    for (i = 0; i < SFDR_LEN; i++) {
+        w = 2.0 * PI * i / (SFDR_LEN - 1);
+        w = 0.35875 - 0.48829 * cos(w) + 0.14128 * cos(2.0 * w) - 0.01168 * cos(3.0 * w);
+        re[i] = iq[2 * i] * w;
+        im[i] = iq[2 * i + 1] * w;
+    }
+    benchFft(re, im, SFDR_LEN);
+
+    for (i = 0; i < SFDR_LEN; i++) {
+        p = re[i] * re[i] + im[i] * im[i];
+        if (p > peak) {
+            peak = p;
+            ipeak = i;
+        }
+    }
+    for (i = 0; i < SFDR_LEN; i++) {
+        d = abs(i - ipeak);
+        if (d <= SFDR_GUARD || d >= SFDR_LEN - SFDR_GUARD)
+            continue;
+        p = re[i] * re[i] + im[i] * im[i];
+        if (p > spur)
+            spur = p;
+    }
+
+    printf("%s,%d,%.1f,%lld,%.2f\n", kernel->engine, carr.bits, f_carr, cfg->fs_hz, 10.0 * log10(peak / spur));
+    fflush(stdout);
+
+    free(acc);
+    free(work);
+    free(iq);
+    free(re);
+    free(im);
+
+    return;
+}
+
+/*! \brief Benchmark the noise stage on one block at a time */
+static void benchAwgn(const bench_cfg_t *cfg) {
+    struct awgn awgn;
+    struct timespec t0, t1;
+    int32_t *acc;
+    long nblocks, n;
+
+    memset(&awgn, 0, sizeof (awgn));
+    acc = calloc((size_t) cfg->block * 2, sizeof (int32_t));
+    if (acc == NULL || awgnInit(&awgn, 45.0, (double) cfg->fs_hz, 1, carr.ampl) != 0) {
+        fprintf(stderr, "ERROR: Failed to set up noise stage.\n");
+        free(acc);
+        return;
+    }
+
+    nblocks = (long) (cfg->duration * cfg->fs_hz / cfg->block + 0.5);
+    if (nblocks < 1)
+        nblocks = 1;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (n = 0; n < nblocks; n++)
+        awgnAdd(&awgn, acc, cfg->block);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    benchReport("awgn", 0, cfg, (double) nblocks * cfg->block, timeDiffUs(&t1, &t0));
+
+    free(acc);
+    awgnFree(&awgn);
+
+    return;
+}
+
+/*! \brief Benchmark multipath echo rendering, 8 echoes on one channel
+ *
+ * Reported per echo, compare ns_per_op_chan with the kernel stages.
+ */
+static void benchEcho(const bench_cfg_t *cfg) {
+    static channel_t chan;
+    static struct signal_model sig;
+    echo_pos_t pos[MAX_ECHOES];
+    double delt = 1.0 / cfg->fs_hz;
+    struct timespec t0, t1;
+    double us = 0.0;
+    int32_t *acc;
+    long nblocks, n;
+    int i, necho;
+
+    acc = calloc((size_t) cfg->block * 2, sizeof (int32_t));
+    if (acc == NULL) {
+        fprintf(stderr, "ERROR: Failed to allocate I/Q buffer.\n");
+        return;
+    }
+
+    memset(&chan, 0, sizeof (chan));
+    chan.prn = 1;
+    chan.ca = caCode(1);
+    chan.f_carr = 1500.0;
+    chan.f_code = CODE_FREQ + chan.f_carr * CARR_TO_CODE;
+#ifndef FLOAT_CARR_PHASE
+    chan.carr_phasestep = (int) round(512.0 * 65536.0 * chan.f_carr * delt);
+#endif
+    setChannelGain(&chan, 0.9);
+
+    sig.necho = 8;
+    for (i = 0; i < sig.necho; i++) {
+        sig.echo[i].prn = 1;
+        sig.echo[i].delay = 30.0 + 60.0 * i;
+        sig.echo[i].gain = 0.5;
+        sig.echo[i].doppler = 0.2 * i;
+        sig.echo[i].phase = 0.1 * i;
+    }
+
+    nblocks = (long) (cfg->duration * cfg->fs_hz / cfg->block + 0.5);
+    if (nblocks < 1)
+        nblocks = 1;
+
+    for (n = 0; n < nblocks; n++) {
+        chan.iword = 0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        necho = echoStart(&sig, &chan, 1, pos, delt, n);
+        echoRender(pos, necho, acc, cfg->block, delt, &carr);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        us += timeDiffUs(&t1, &t0);
+    }
+    benchReport("echo", sig.necho, cfg, (double) nblocks * cfg->block, us);
+
+    free(acc);
+
+    return;
+}
+
+/*! \brief Benchmark the polyphase resampler, generation at half the sample rate */
+static void benchResample(const bench_cfg_t *cfg) {
+    struct fir_filter f;
+    struct timespec t0, t1;
+    int32_t *in, *out;
+    int nin = cfg->block / 2;
+    long nblocks, n;
+
+    in = calloc((size_t) nin * 2, sizeof (int32_t));
+    out = calloc((size_t) nin * 4, sizeof (int32_t));
+    if (in == NULL || out == NULL || firInit(&f, 2, 1, RESAMP_TAPS, RESAMP_CUTOFF) != 0) {
+        fprintf(stderr, "ERROR: Failed to set up resampler.\n");
+        free(in);
+        free(out);
+        return;
+    }
+
+    for (n = 0; n < nin * 2; n++)
+        in[n] = (int32_t) ((n * 2654435761UL) >> 20) - 2048;
+
+    nblocks = (long) (cfg->duration * cfg->fs_hz / cfg->block + 0.5);
+    if (nblocks < 1)
+        nblocks = 1;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (n = 0; n < nblocks; n++)
+        firProcess(&f, in, nin, out);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    benchReport("resample", 0, cfg, (double) nblocks * nin * 2, timeDiffUs(&t1, &t0));
+
+    firFree(&f);
+    free(in);
+    free(out);
+
+    return;
+}
+
+/*! \brief Benchmark the band-limiting FIR in place on one block at a time */
+static void benchFir(const bench_cfg_t *cfg, int ntaps) {
+    struct fir_filter f;
+    struct timespec t0, t1;
+    char stage[32];
+    int32_t *acc;
+    long nblocks, n;
+
+    acc = calloc((size_t) cfg->block * 2, sizeof (int32_t));
+    if (acc == NULL || firInit(&f, 1, 1, ntaps, 0.4) != 0) {
+        fprintf(stderr, "ERROR: Failed to set up FIR filter.\n");
+        free(acc);
+        return;
+    }
+
+    nblocks = (long) (cfg->duration * cfg->fs_hz / cfg->block + 0.5);
+    if (nblocks < 1)
+        nblocks = 1;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (n = 0; n < nblocks; n++)
+        firProcess(&f, acc, cfg->block, acc);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    snprintf(stage, sizeof (stage), "fir%d", ntaps);
+    benchReport(stage, 0, cfg, (double) nblocks * cfg->block, timeDiffUs(&t1, &t0));
+
+    firFree(&f);
+    free(acc);
+
+    return;
+}
+
+/*! \brief Benchmark conversion of one block to a compact I/Q format and back */
+static void benchIqFormat(const bench_cfg_t *cfg, int bits) {
+    struct timespec t0, t1;
+    char stage[32];
+    short *iq;
+    unsigned char *packed;
+    long nblocks, n;
+    int shift = iqShift(bits, 0);
+
+    iq = malloc((size_t) cfg->block * 2 * sizeof (short));
+    packed = malloc(iqBytes(bits, cfg->block));
+    if (iq == NULL || packed == NULL) {
+        fprintf(stderr, "ERROR: Failed to set up I/Q format conversion.\n");
+        free(iq);
+        free(packed);
+        return;
+    }
+
+    for (n = 0; n < cfg->block * 2; n++)
+        iq[n] = (short) (((n * 2654435761UL) >> 20) % 4095) - 2047;
+
+    nblocks = (long) (cfg->duration * cfg->fs_hz / cfg->block + 0.5);
+    if (nblocks < 1)
+        nblocks = 1;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (n = 0; n < nblocks; n++)
+        iqCompress(iq, packed, cfg->block, bits, shift);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    snprintf(stage, sizeof (stage), "pack_sc%d", bits);
+    benchReport(stage, 0, cfg, (double) nblocks * cfg->block, timeDiffUs(&t1, &t0));
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (n = 0; n < nblocks; n++)
+        iqExpand(packed, iq, cfg->block, bits, shift);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    snprintf(stage, sizeof (stage), "unpack_sc%d", bits);
+    benchReport(stage, 0, cfg, (double) nblocks * cfg->block, timeDiffUs(&t1, &t0));
+
+    free(iq);
+    free(packed);
+
+    return;
+}
+
+/*! \brief Benchmark satellite orbit, range and navigation message stages */
+static void benchOrbit(const bench_cfg_t *cfg, ephem_t *eph, ionoutc_t ionoutc, gpstime_t g) {
+    static navmsg_t nav;
+    svstate_t st[MAX_SAT];
+    double xyz[3], llh[3] = {35.681298 / R2D, 139.766247 / R2D, 10.0};
+    double pos[3], vel[3], clk[2];
+    double sink = 0.0;
+    struct timespec t0, t1;
+    range_t rho;
+    gpstime_t gt;
+    int i, sv;
+
+    llh2xyz(llh, xyz);
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < cfg->iterations; i++) {
+        sv = i % MAX_SAT;
+        gt = incGpsTime(g, 0.1 * i);
+        satpos(eph[sv], gt, pos, vel, clk);
+        sink += pos[0];
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    benchReport("satpos", 0, cfg, cfg->iterations, timeDiffUs(&t1, &t0));
+
+    // Per receiver cost, the satellite states are shared
+    for (sv = 0; sv < MAX_SAT; sv++)
+        satpos(eph[sv], g, st[sv].pos, st[sv].vel, st[sv].clk);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < cfg->iterations; i++) {
+        sv = i % MAX_SAT;
+        rangeFromState(&rho, &st[sv], &ionoutc, g, xyz);
+        sink += rho.range;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    benchReport("rangeFromState", 0, cfg, cfg->iterations, timeDiffUs(&t1, &t0));
+
+    // One navigation message is 60 words with checksum
+    eph2sbf(eph[0], ionoutc, nav.sbf);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < cfg->iterations / 60; i++) {
+        generateNavMsg(incGpsTime(g, 30.0 * i), &nav, 1);
+        sink += nav.dwrd[N_DWRD - 1];
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    benchReport("generateNavMsg", 0, cfg, cfg->iterations / 60, timeDiffUs(&t1, &t0));
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < cfg->iterations; i++)
+        sink += computeChecksum(((unsigned long) i * 2654435761UL) & 0xFFFFFFFFUL, i & 1);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    benchReport("computeChecksum", 0, cfg, cfg->iterations, timeDiffUs(&t1, &t0));
+
+    // Keep the compiler from dropping the loops
+    if (sink == 0.123)
+        fprintf(stderr, "%f\n", sink);
+
+    return;
+}
+
+/*! \brief Benchmark RINEX navigation file parsing */
+static void benchRinex(const bench_cfg_t *cfg, const char *navfile, bool use_rinex3) {
+    static ephem_t eph[EPHEM_ARRAY_SIZE][MAX_SAT];
+    ionoutc_t ionoutc;
+    struct timespec t0, t1;
+    int i, n = cfg->iterations / 1000 + 1;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < n; i++) {
+        if (use_rinex3)
+            readRinex3(eph, &ionoutc, navfile);
+        else
+            readRinex2(eph, &ionoutc, navfile);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    benchReport("readRinex", 0, cfg, n, timeDiffUs(&t1, &t0));
+
+    return;
+}
+
+int main(int argc, char *argv[]) {
+    static ephem_t eph[EPHEM_ARRAY_SIZE][MAX_SAT];
+    bench_cfg_t cfg;
+    ionoutc_t ionoutc;
+    const char *navfile = NULL;
+    bool use_rinex3 = false;
+    gpstime_t g;
+    char *tok;
+    int result;
+    int i, sv;
+
+    const int default_chan[] = {1, 4, 8, 12, 16, 32};
+
+    memset(&cfg, 0, sizeof (cfg));
+    for (i = 0; i < (int) (sizeof (default_chan) / sizeof (default_chan[0])); i++)
+        cfg.nchan[cfg.nruns++] = default_chan[i];
+    cfg.fs_hz = TX_SAMPLE_FREQ;
+    cfg.duration = 2.0;
+    cfg.iterations = 100000;
+    cfg.carr_bits = 9;
+
+    memset(&ionoutc, 0, sizeof (ionoutc));
+    ionoutc.enable = true;
+
+    while ((result = getopt(argc, argv, "e:n:s:b:d:i:L:3Fh")) != -1) {
+        switch (result) {
+            case 'e':
+                navfile = optarg;
+                break;
+            case '3':
+                use_rinex3 = true;
+                break;
+            case 'n':
+                cfg.nruns = 0;
+                for (tok = strtok(optarg, ","); tok != NULL && cfg.nruns < BENCH_MAX_RUNS; tok = strtok(NULL, ",")) {
+                    i = atoi(tok);
+                    if (i < 1 || i > BENCH_MAX_CHAN) {
+                        fprintf(stderr, "ERROR: Invalid channel count %s.\n", tok);
+                        exit(1);
+                    }
+                    cfg.nchan[cfg.nruns++] = i;
+                }
+                break;
+            case 's':
+                cfg.fs_hz = (long long) atoi(optarg);
+                if (cfg.fs_hz < MHZ(1.0)) {
+                    fprintf(stderr, "ERROR: Invalid sampling frequency.\n");
+                    exit(1);
+                }
+                break;
+            case 'b':
+                cfg.block = atoi(optarg);
+                break;
+            case 'd':
+                cfg.duration = atof(optarg);
+                break;
+            case 'i':
+                cfg.iterations = atoi(optarg);
+                break;
+            case 'F':
+                cfg.sfdr = true;
+                break;
+            case 'L':
+                cfg.carr_bits = atoi(optarg);
+                break;
+            case 'h':
+            default:
+                benchUsage();
+                exit(1);
+        }
+    }
+
+    if (cfg.block <= 0)
+        cfg.block = (int) (cfg.fs_hz / 10);
+    if (cfg.duration <= 0.0 || cfg.iterations < 60) {
+        fprintf(stderr, "ERROR: Invalid duration or iterations.\n");
+        exit(1);
+    }
+
+    g.week = 2295;
+    g.sec = 86400.0;
+    benchEphemeris(eph[0], g);
+
+    if (navfile != NULL) {
+        int neph = use_rinex3 ? readRinex3(eph, &ionoutc, navfile) : readRinex2(eph, &ionoutc, navfile);
+        if (neph <= 0) {
+            fprintf(stderr, "ERROR: No ephemeris available.\n");
+            exit(1);
+        }
+
+        // Fill missing SVs so every channel count can be benchmarked
+        for (sv = 0; sv < MAX_SAT; sv++) {
+            if (eph[0][sv].vflg == true) {
+                g = eph[0][sv].toc;
+                break;
+            }
+        }
+        for (sv = 0; sv < MAX_SAT; sv++) {
+            if (eph[0][sv].vflg == false) {
+                ephem_t nominal[MAX_SAT];
+                benchEphemeris(nominal, g);
+                eph[0][sv] = nominal[sv];
+            }
+        }
+    }
+
+    if (initCarrierTable(&carr, cfg.carr_bits) != 0) {
+        fprintf(stderr, "ERROR: Invalid carrier table resolution.\n");
+        exit(1);
+    }
+
+    if (cfg.sfdr) {
+        const double tone[] = {-3217.3, 1000.3, 4567.8};
+        int k;
+
+        printf("engine,table_bits,f_carr_hz,fs_hz,sfdr_dbc\n");
+        for (k = 0; k < BENCH_NUM_KERNELS; k++) {
+            if (benchKernels[k].tmpl)
+                continue; // Code path does not change the carrier
+            for (i = 0; i < (int) (sizeof (tone) / sizeof (tone[0])); i++)
+                benchSfdr(&cfg, &benchKernels[k], tone[i]);
+        }
+
+        return (0);
+    }
+
+    printf("stage,channels,fs_hz,block,ops,seconds,ops_per_s,ns_per_op,ns_per_op_chan\n");
+
+    for (i = 0; i < cfg.nruns; i++) {
+        int k;
+
+        for (k = 0; k < BENCH_NUM_KERNELS; k++)
+            benchKernel(&cfg, eph[0], ionoutc, g, cfg.nchan[i], &benchKernels[k]);
+    }
+
+    benchEcho(&cfg);
+    benchAwgn(&cfg);
+    benchResample(&cfg);
+    benchFir(&cfg, 32);
+    benchFir(&cfg, 64);
+    benchIqFormat(&cfg, IQ_FMT_SC8);
+    benchIqFormat(&cfg, IQ_FMT_SC4);
+    benchOrbit(&cfg, eph[0], ionoutc, g);
+
+    if (navfile != NULL)
+        benchRinex(&cfg, navfile, use_rinex3);
+
+    return (0);
+}
@@ -0,0 +1,4873 @@
+/**
+ * libplutogpssim, the signal generation engine of pluto-gps-sim with the C
+ * API of gpssim.h. The engine state lives in the context, the only shared
+ * data are the read-only C/A code and carrier tables. The tools of this
+ * project reach the engine functions through gpssim_int.h.
+ *
+ * This file is part of the pluto-gps-sim project at
+ * https://github.com/mictronics/pluto-gps-sim.git
+ *
+ * Copyright © 2019 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include <zlib.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+#if defined(__MACH__) || defined(__APPLE__)
+#include <mach/mach_init.h>
+#include <mach/thread_act.h>
+#include <mach/mach_port.h>
+#endif
+#include "gpssim_int.h"
+
+#if defined(__MACH__) || defined(__APPLE__)
+
+typedef struct cpu_set {
+    uint32_t count;
+} cpu_set_t;
+
+static inline void
+CPU_ZERO(cpu_set_t *cs) {
+    cs->count = 0;
+}
+
+static inline void
+CPU_SET(int num, cpu_set_t *cs) {
+    cs->count |= (1 << num);
+}
+
+static inline int
+CPU_ISSET(int num, cpu_set_t *cs) {
+    return (cs->count & (1 << num));
+}
+#endif
+/*! \brief Signal pipeline of one receiver or array element
+ *
+ * Generation, resampling to the radio rate, noise and band limiting. The
+ * filters carry their history from block to block, the noise generators are
+ * positioned per block.
+ */
+struct pipeline {
+    const struct signal_model *sig; // Carrier table, echoes and noise level
+    void (*generate)(channel_t *, int, int32_t *, int, double, const struct carrier_table *, float *);
+    double delt; // Sample period at the generation rate
+    int gen_block; // Generated I/Q samples per block
+    int block; // I/Q samples per block at the radio rate
+    int32_t *acc_buff; // Accumulator at the generation rate
+    int32_t *out_acc; // Accumulator at the radio rate, acc_buff without resampler
+    float *work; // Chip buffer of the phasor kernels, PHASOR_WORK floats
+    struct fir_filter resamp; // Resampler from generation to radio rate
+    struct fir_filter shaper; // Band-limiting FIR at radio rate
+    struct awgn noise; // Copy of the configured noise stage
+};
+
+/*! \brief Satellite state shared by all receivers
+ *
+ * Position, velocity and clock of every satellite at the current receiver
+ * time and the navigation message of the current frame depend on ephemeris
+ * and time only. They are computed once per epoch and frame, the receivers
+ * take their pseudoranges from here and copy the message into their channels.
+ */
+struct sky {
+    ephem_t (*eph)[MAX_SAT]; // Ephemeris sets
+    int ieph; // Current ephemeris set
+    ionoutc_t ionoutc;
+    gpstime_t g; // Receiver time of the satellite states
+    svstate_t sv[MAX_SAT];
+    navmsg_t nav[MAX_SAT];
+};
+
+/*! \brief One receiver of a context with its own position
+ *
+ * All receivers share the satellite state, each one has its channels and
+ * signal pipeline.
+ */
+struct receiver {
+    double (*xyz)[3]; // Static position or trajectory
+    int numd; // Trajectory points, 0 = static location
+    channel_t *chan;
+    range_t *rho;
+    double *gain;
+    int allocated[MAX_SAT]; // Channel of each satellite, -1 if not allocated
+    float scale; // Output scale of the current block, see gpssim_render()
+    struct pipeline pl;
+};
+
+/*! \brief Antenna array with one phase-coherent I/Q stream per element
+ *
+ * The elements share code phase, data bits and carrier phase of the
+ * receiver channels. Each element only applies a complex weight per channel,
+ * its gain and the carrier phase offset of its position along the line of
+ * sight, and has its own resampler, noise and band-limiting stages.
+ */
+struct antenna_array {
+    int nelem;
+    double enu[MAX_ARRAY_ELEMENTS][3]; // Element offset from the receiver position, east/north/up (m)
+    double gain[MAX_ARRAY_ELEMENTS]; // Element gain, linear
+    struct pipeline pl[MAX_ARRAY_ELEMENTS];
+    float wr[MAX_CHAN * MAX_ARRAY_ELEMENTS]; // Real part of the element weights, channel major
+    float wi[MAX_CHAN * MAX_ARRAY_ELEMENTS]; // Imaginary part of the element weights, channel major
+};
+
+/*! \brief Engine context */
+struct gpssim {
+    gpssim_config_t cfg;
+    ephem_t (*eph)[MAX_SAT]; // EPHEM_ARRAY_SIZE ephemeris sets
+    int neph;
+    ionoutc_t ionoutc;
+    struct signal_model sig; // Carrier table, power per PRN, echoes and noise
+    struct sky sky; // Satellite state
+    struct receiver *rx; // cfg.nrx receivers, positions, channels and signal pipelines
+    struct antenna_array *arr; // Elements of the first receiver, NULL without array
+    gpstime_t g0; // Scenario start
+    int iblock; // Current block, see gpssim_step()
+    bool stepped; // Channels of the current block are updated, its frame update is pending
+    int out_limit; // Output saturation level, see packSamples()
+    int out_shift;
+    int pos; // Samples of the current block already handed out by gpssim_generate()
+    long long nout; // Samples handed out since start
+    bool started;
+};
+
+static const int sinTable512[] = {
+    1, 7, 13, 19, 26, 32, 38, 44, 51, 57, 63, 69, 75, 82, 88, 94,
+    100, 106, 112, 119, 125, 131, 137, 143, 149, 155, 161, 167, 173, 179, 184, 190,
+    196, 202, 208, 213, 219, 225, 230, 236, 241, 247, 252, 258, 263, 269, 274, 279,
+    284, 290, 295, 300, 305, 310, 315, 320, 325, 329, 334, 339, 344, 348, 353, 357,
+    362, 366, 371, 375, 379, 383, 387, 392, 396, 399, 403, 407, 411, 415, 418, 422,
+    425, 429, 432, 436, 439, 442, 445, 448, 451, 454, 457, 460, 462, 465, 468, 470,
+    473, 475, 477, 479, 482, 484, 486, 488, 489, 491, 493, 495, 496, 498, 499, 500,
+    502, 503, 504, 505, 506, 507, 508, 508, 509, 510, 510, 511, 511, 511, 511, 511,
+    512, 511, 511, 511, 511, 511, 510, 510, 509, 508, 508, 507, 506, 505, 504, 503,
+    502, 500, 499, 498, 496, 495, 493, 491, 489, 488, 486, 484, 482, 479, 477, 475,
+    473, 470, 468, 465, 462, 460, 457, 454, 451, 448, 445, 442, 439, 436, 432, 429,
+    425, 422, 418, 415, 411, 407, 403, 399, 396, 392, 387, 383, 379, 375, 371, 366,
+    362, 357, 353, 348, 344, 339, 334, 329, 325, 320, 315, 310, 305, 300, 295, 290,
+    284, 279, 274, 269, 263, 258, 252, 247, 241, 236, 230, 225, 219, 213, 208, 202,
+    196, 190, 184, 179, 173, 167, 161, 155, 149, 143, 137, 131, 125, 119, 112, 106,
+    100, 94, 88, 82, 75, 69, 63, 57, 51, 44, 38, 32, 26, 19, 13, 7,
+    1, -5, -11, -17, -24, -30, -36, -42, -49, -55, -61, -67, -73, -80, -86, -92,
+    -98, -104, -110, -117, -123, -129, -135, -141, -147, -153, -159, -165, -171, -177, -182, -188,
+    -194, -200, -206, -211, -217, -223, -228, -234, -239, -245, -250, -256, -261, -267, -272, -277,
+    -282, -288, -293, -298, -303, -308, -313, -318, -323, -327, -332, -337, -342, -346, -351, -355,
+    -360, -364, -369, -373, -377, -381, -385, -390, -394, -397, -401, -405, -409, -413, -416, -420,
+    -423, -427, -430, -434, -437, -440, -443, -446, -449, -452, -455, -458, -460, -463, -466, -468,
+    -471, -473, -475, -477, -480, -482, -484, -486, -487, -489, -491, -493, -494, -496, -497, -498,
+    -500, -501, -502, -503, -504, -505, -506, -506, -507, -508, -508, -509, -509, -509, -509, -509,
+    -510, -509, -509, -509, -509, -509, -508, -508, -507, -506, -506, -505, -504, -503, -502, -501,
+    -500, -498, -497, -496, -494, -493, -491, -489, -487, -486, -484, -482, -480, -477, -475, -473,
+    -471, -468, -466, -463, -460, -458, -455, -452, -449, -446, -443, -440, -437, -434, -430, -427,
+    -423, -420, -416, -413, -409, -405, -401, -397, -394, -390, -385, -381, -377, -373, -369, -364,
+    -360, -355, -351, -346, -342, -337, -332, -327, -323, -318, -313, -308, -303, -298, -293, -288,
+    -282, -277, -272, -267, -261, -256, -250, -245, -239, -234, -228, -223, -217, -211, -206, -200,
+    -194, -188, -182, -177, -171, -165, -159, -153, -147, -141, -135, -129, -123, -117, -110, -104,
+    -98, -92, -86, -80, -73, -67, -61, -55, -49, -42, -36, -30, -24, -17, -11, -5,
+};
+
+static const int cosTable512[] = {
+    512, 511, 511, 511, 511, 511, 510, 510, 509, 508, 508, 507, 506, 505, 504, 503,
+    502, 500, 499, 498, 496, 495, 493, 491, 489, 488, 486, 484, 482, 479, 477, 475,
+    473, 470, 468, 465, 462, 460, 457, 454, 451, 448, 445, 442, 439, 436, 432, 429,
+    425, 422, 418, 415, 411, 407, 403, 399, 396, 392, 387, 383, 379, 375, 371, 366,
+    362, 357, 353, 348, 344, 339, 334, 329, 325, 320, 315, 310, 305, 300, 295, 290,
+    284, 279, 274, 269, 263, 258, 252, 247, 241, 236, 230, 225, 219, 213, 208, 202,
+    196, 190, 184, 179, 173, 167, 161, 155, 149, 143, 137, 131, 125, 119, 112, 106,
+    100, 94, 88, 82, 75, 69, 63, 57, 51, 44, 38, 32, 26, 19, 13, 7,
+    1, -5, -11, -17, -24, -30, -36, -42, -49, -55, -61, -67, -73, -80, -86, -92,
+    -98, -104, -110, -117, -123, -129, -135, -141, -147, -153, -159, -165, -171, -177, -182, -188,
+    -194, -200, -206, -211, -217, -223, -228, -234, -239, -245, -250, -256, -261, -267, -272, -277,
+    -282, -288, -293, -298, -303, -308, -313, -318, -323, -327, -332, -337, -342, -346, -351, -355,
+    -360, -364, -369, -373, -377, -381, -385, -390, -394, -397, -401, -405, -409, -413, -416, -420,
+    -423, -427, -430, -434, -437, -440, -443, -446, -449, -452, -455, -458, -460, -463, -466, -468,
+    -471, -473, -475, -477, -480, -482, -484, -486, -487, -489, -491, -493, -494, -496, -497, -498,
+    -500, -501, -502, -503, -504, -505, -506, -506, -507, -508, -508, -509, -509, -509, -509, -509,
+    -510, -509, -509, -509, -509, -509, -508, -508, -507, -506, -506, -505, -504, -503, -502, -501,
+    -500, -498, -497, -496, -494, -493, -491, -489, -487, -486, -484, -482, -480, -477, -475, -473,
+    -471, -468, -466, -463, -460, -458, -455, -452, -449, -446, -443, -440, -437, -434, -430, -427,
+    -423, -420, -416, -413, -409, -405, -401, -397, -394, -390, -385, -381, -377, -373, -369, -364,
+    -360, -355, -351, -346, -342, -337, -332, -327, -323, -318, -313, -308, -303, -298, -293, -288,
+    -282, -277, -272, -267, -261, -256, -250, -245, -239, -234, -228, -223, -217, -211, -206, -200,
+    -194, -188, -182, -177, -171, -165, -159, -153, -147, -141, -135, -129, -123, -117, -110, -104,
+    -98, -92, -86, -80, -73, -67, -61, -55, -49, -42, -36, -30, -24, -17, -11, -5,
+    0, 7, 13, 19, 26, 32, 38, 44, 51, 57, 63, 69, 75, 82, 88, 94,
+    100, 106, 112, 119, 125, 131, 137, 143, 149, 155, 161, 167, 173, 179, 184, 190,
+    196, 202, 208, 213, 219, 225, 230, 236, 241, 247, 252, 258, 263, 269, 274, 279,
+    284, 290, 295, 300, 305, 310, 315, 320, 325, 329, 334, 339, 344, 348, 353, 357,
+    362, 366, 371, 375, 379, 383, 387, 392, 396, 399, 403, 407, 411, 415, 418, 422,
+    425, 429, 432, 436, 439, 442, 445, 448, 451, 454, 457, 460, 462, 465, 468, 470,
+    473, 475, 477, 479, 482, 484, 486, 488, 489, 491, 493, 495, 496, 498, 499, 500,
+    502, 503, 504, 505, 506, 507, 508, 508, 509, 510, 510, 511, 511, 511, 511, 511,
+};
+
+// Receiver antenna attenuation in dB for boresight angle = 0:5:180 [deg]
+static const double ant_pat_db[37] = {
+    0.00, 0.00, 0.22, 0.44, 0.67, 1.11, 1.56, 2.00, 2.44, 2.89, 3.56, 4.22,
+    4.89, 5.56, 6.22, 6.89, 7.56, 8.22, 8.89, 9.78, 10.67, 11.56, 12.44, 13.33,
+    14.44, 15.56, 16.67, 17.78, 18.89, 20.00, 21.33, 22.67, 24.00, 25.56, 27.33, 29.33,
+    31.56
+};
+
+/*! \brief C/A codes of all PRNs as +1/-1 chips, shared by all channels */
+static signed char caTable[MAX_SAT][CA_SEQ_LEN];
+
+static pthread_once_t tablesOnce = PTHREAD_ONCE_INIT;
+
+/*! \brief Subtract two vectors of double
+ *  \param[out] y Result of subtraction
+ *  \param[in] x1 Minuend of subtracion
+ *  \param[in] x2 Subtrahend of subtracion
+ */
+static void subVect(double *y, const double *x1, const double *x2) {
+    y[0] = x1[0] - x2[0];
+    y[1] = x1[1] - x2[1];
+    y[2] = x1[2] - x2[2];
+
+    return;
+}
+
+/*! \brief Compute Norm of Vector
+ *  \param[in] x Input vector
+ *  \returns Length (Norm) of the input vector
+ */
+static double normVect(const double *x) {
+    return (sqrt(x[0] * x[0] + x[1] * x[1] + x[2] * x[2]));
+}
+
+/*! \brief Compute dot-product of two vectors
+ *  \param[in] x1 First multiplicand
+ *  \param[in] x2 Second multiplicand
+ *  \returns Dot-product of both multiplicands
+ */
+static double dotProd(const double *x1, const double *x2) {
+    return (x1[0] * x2[0] + x1[1] * x2[1] + x1[2] * x2[2]);
+}
+
+/* !\brief generate the C/A code sequence for a given Satellite Vehicle PRN
+ *  \param[in] prn PRN nuber of the Satellite Vehicle
+ *  \param[out] ca Caller-allocated integer array of 1023 bytes
+ */
+void codegen(int *ca, int prn) {
+    int delay[] = {
+        5, 6, 7, 8, 17, 18, 139, 140, 141, 251,
+        252, 254, 255, 256, 257, 258, 469, 470, 471, 472,
+        473, 474, 509, 512, 513, 514, 515, 516, 859, 860,
+        861, 862
+    };
+
+    int g1[CA_SEQ_LEN], g2[CA_SEQ_LEN];
+    int r1[N_DWRD_SBF], r2[N_DWRD_SBF];
+    int c1, c2;
+    int i, j;
+
+    if (prn < 1 || prn > 32)
+        return;
+
+    for (i = 0; i < N_DWRD_SBF; i++)
+        r1[i] = r2[i] = -1;
+
+    for (i = 0; i < CA_SEQ_LEN; i++) {
+        g1[i] = r1[9];
+        g2[i] = r2[9];
+        c1 = r1[2] * r1[9];
+        c2 = r2[1] * r2[2] * r2[5] * r2[7] * r2[8] * r2[9];
+
+        for (j = 9; j > 0; j--) {
+            r1[j] = r1[j - 1];
+            r2[j] = r2[j - 1];
+        }
+        r1[0] = c1;
+        r2[0] = c2;
+    }
+
+    for (i = 0, j = CA_SEQ_LEN - delay[prn - 1]; i < CA_SEQ_LEN; i++, j++)
+        ca[i] = (1 - g1[i] * g2[j % CA_SEQ_LEN]) / 2;
+
+    return;
+}
+
+/*! \brief Generate the C/A code table of all PRNs, runs once per process through tablesOnce */
+static void initCodeTable(void) {
+    int ca[CA_SEQ_LEN];
+    int sv, i;
+
+    for (sv = 0; sv < MAX_SAT; sv++) {
+        codegen(ca, sv + 1);
+        for (i = 0; i < CA_SEQ_LEN; i++)
+            caTable[sv][i] = (signed char) (ca[i] * 2 - 1);
+    }
+
+    return;
+}
+
+/*! \brief C/A code of a PRN as +1/-1 chips
+ *  \param[in] prn PRN 1..MAX_SAT
+ *  \returns CA_SEQ_LEN chips
+ */
+const signed char *caCode(int prn) {
+    pthread_once(&tablesOnce, initCodeTable);
+
+    return (caTable[prn - 1]);
+}
+
+/*! \brief Set up a carrier sin/cos table
+ *
+ * The amplitude grows with the phase resolution, packSamples() scales the
+ * sum back to the 9-bit table level. Release a table above 9 bits with free()
+ * of carr->buf.
+ *  \param[out] carr Carrier table
+ *  \param[in] bits Phase resolution in bits, 9 selects the built-in 512 entry table
+ *  \returns 0 on success, -1 on invalid resolution or allocation error
+ */
+int initCarrierTable(struct carrier_table *carr, int bits) {
+    int *tab;
+    int i;
+
+    if (bits < MIN_CARR_TABLE_BITS || bits > MAX_CARR_TABLE_BITS)
+        return (-1);
+
+    carr->buf = NULL;
+    carr->cos = cosTable512;
+    carr->sin = sinTable512;
+    carr->bits = 9;
+    carr->size = 512;
+    carr->ampl = 511.0;
+
+    if (bits == 9)
+        return (0);
+
+    tab = malloc(2 * sizeof (int) << bits);
+    if (tab == NULL)
+        return (-1);
+
+    carr->bits = bits;
+    carr->size = 1 << bits;
+    carr->ampl = 511.0 * (1 << (bits - 9));
+    for (i = 0; i < carr->size; i++) {
+        tab[i] = (int) lrint(carr->ampl * cos(2.0 * PI * i / carr->size));
+        tab[carr->size + i] = (int) lrint(carr->ampl * sin(2.0 * PI * i / carr->size));
+    }
+    carr->buf = tab;
+    carr->cos = tab;
+    carr->sin = tab + carr->size;
+
+    return (0);
+}
+
+/*! \brief Output scale factor of a block
+ *  \param[in] chan Array of channels
+ *  \param[in] nchan Number of channels in \a chan
+ *  \param[in] gain Signal gain per channel
+ *  \param[in] sig Signal model, carrier table, echo and noise power
+ *  \param[in] autoscale Scale signal and noise to OUTPUT_RMS, else keep the 9-bit table level
+ *  \returns Scale factor
+ */
+float outputScale(const channel_t *chan, int nchan, const double *gain, const struct signal_model *sig,
+        bool autoscale) {
+    double scale = 1.0 / (1 << (sig->carr.bits - 9));
+    double a, p = 0.0;
+    int i, j;
+
+    if (autoscale) {
+        // Channels add up in power, I and Q carry half of it each
+        for (i = 0; i < nchan; i++) {
+            if (chan[i].prn > 0) {
+                a = sig->carr.ampl * gain[i];
+                p += 0.5 * a * a;
+                for (j = 0; j < sig->necho; j++) {
+                    if (sig->echo[j].prn == chan[i].prn)
+                        p += 0.5 * a * a * sig->echo[j].gain * sig->echo[j].gain;
+                }
+            }
+        }
+        p += sig->noise.sigma * sig->noise.sigma;
+        if (p > 0.0)
+            scale = OUTPUT_RMS / sqrt(p);
+    }
+
+    return ((float) scale);
+}
+
+/*! \brief Scale one accumulated value to a 16-bit sample with saturation
+ *  \returns 1 if the value saturated, else 0
+ */
+static inline int packValue(int32_t acc, short *iq, float scale, float limit, int shift) {
+    float v = (float) acc * scale;
+    int sat = 0;
+
+    if (v > limit) {
+        v = limit;
+        sat = 1;
+    } else if (v < -limit) {
+        v = -limit;
+        sat = 1;
+    }
+    *iq = (short) (lrintf(v) * (1 << shift));
+
+    return (sat);
+}
+
+/*! \brief Scale accumulated I/Q sums to 16-bit samples with saturation
+ *
+ * Vectorized with SSE2 or NEON where available. Rounding is to nearest even
+ * in all paths, so the result does not depend on the instruction set. With
+ * SSE2 the output bypasses the cache, \a iq is expected to be a DMA or file
+ * buffer that is not read back soon.
+ *  \param[in] acc Interleaved I/Q accumulator
+ *  \param[out] iq Interleaved 16-bit I/Q output buffer
+ *  \param[in] nsamp Number of I/Q samples
+ *  \param[in] scale Scale factor, see outputScale()
+ *  \param[in] limit Max. output magnitude before \a shift
+ *  \param[in] shift Left shift after saturation, 4 gives MSB-aligned 12-bit samples
+ *  \returns Number of saturated I/Q values
+ */
+int packSamples(const int32_t *acc, short *iq, int nsamp, float scale, int limit, int shift) {
+    float flim = (float) limit;
+    int i = 0, n = 2 * nsamp;
+    int nsat = 0;
+
+#if defined(__SSE2__)
+    __m128 vs = _mm_set1_ps(scale);
+    __m128 vmax = _mm_set1_ps(flim);
+    __m128 vmin = _mm_set1_ps(-flim);
+    __m128i vsh = _mm_cvtsi32_si128(shift);
+    __m128i vcnt = _mm_setzero_si128();
+    int32_t cnt[4];
+
+    // Align the destination for streaming stores
+    for (; i < n && ((uintptr_t) (iq + i) & 15) != 0; i++)
+        nsat += packValue(acc[i], &iq[i], scale, flim, shift);
+
+    for (; i + 8 <= n; i += 8) {
+        __m128 a = _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *) (acc + i))), vs);
+        __m128 b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *) (acc + i + 4))), vs);
+
+        // Compare masks are -1 per saturated lane
+        vcnt = _mm_sub_epi32(vcnt, _mm_castps_si128(_mm_or_ps(_mm_cmpgt_ps(a, vmax), _mm_cmplt_ps(a, vmin))));
+        vcnt = _mm_sub_epi32(vcnt, _mm_castps_si128(_mm_or_ps(_mm_cmpgt_ps(b, vmax), _mm_cmplt_ps(b, vmin))));
+        a = _mm_min_ps(_mm_max_ps(a, vmin), vmax);
+        b = _mm_min_ps(_mm_max_ps(b, vmin), vmax);
+
+        _mm_stream_si128((__m128i *) (iq + i),
+                _mm_sll_epi16(_mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)), vsh));
+    }
+    _mm_sfence();
+
+    _mm_storeu_si128((__m128i *) cnt, vcnt);
+    nsat += cnt[0] + cnt[1] + cnt[2] + cnt[3];
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    float32x4_t vs = vdupq_n_f32(scale);
+    float32x4_t vmax = vdupq_n_f32(flim);
+    float32x4_t vmin = vdupq_n_f32(-flim);
+    int16x8_t vsh = vdupq_n_s16((int16_t) shift);
+    uint32x4_t vcnt = vdupq_n_u32(0);
+
+    for (; i + 8 <= n; i += 8) {
+        float32x4_t a = vmulq_f32(vcvtq_f32_s32(vld1q_s32(acc + i)), vs);
+        float32x4_t b = vmulq_f32(vcvtq_f32_s32(vld1q_s32(acc + i + 4)), vs);
+
+        // Compare masks are all ones per saturated lane
+        vcnt = vsubq_u32(vcnt, vorrq_u32(vcgtq_f32(a, vmax), vcltq_f32(a, vmin)));
+        vcnt = vsubq_u32(vcnt, vorrq_u32(vcgtq_f32(b, vmax), vcltq_f32(b, vmin)));
+        a = vminq_f32(vmaxq_f32(a, vmin), vmax);
+        b = vminq_f32(vmaxq_f32(b, vmin), vmax);
+
+        vst1q_s16(iq + i, vshlq_s16(vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(a)), vqmovn_s32(vcvtnq_s32_f32(b))), vsh));
+    }
+
+    nsat += (int) vaddvq_u32(vcnt);
+#endif
+
+    for (; i < n; i++)
+        nsat += packValue(acc[i], &iq[i], scale, flim, shift);
+
+    return (nsat);
+}
+
+/*! \brief Right shift that maps 16-bit samples of the 12-bit DAC range to a compact format
+ *  \param[in] bits Bits per I/Q value, see IQ_FMT_SC16
+ *  \param[in] out_shift Left shift of the 16-bit samples, 4 for MSB-aligned output
+ */
+int iqShift(int bits, int out_shift) {
+    return ((bits < IQ_FMT_SC16) ? 12 + out_shift - bits : 0);
+}
+
+/*! \brief Size in bytes of \a nsamp I/Q samples in given format */
+size_t iqBytes(int bits, int nsamp) {
+    return ((size_t) nsamp * 2 * bits / 8);
+}
+
+/*! \brief Round, shift and saturate one 16-bit value to a compact format */
+static inline int iqNarrow(short v, int shift, int lim) {
+    int x = ((int) v + (1 << (shift - 1))) >> shift;
+
+    return ((x > lim) ? lim : ((x < -lim) ? -lim : x));
+}
+
+/*! \brief Convert 16-bit I/Q samples to sc8 or sc4
+ *  \param[in] iq Interleaved 16-bit I/Q samples
+ *  \param[out] out Compact samples, iqBytes() bytes
+ *  \param[in] nsamp Number of I/Q samples, even for sc4
+ *  \param[in] bits IQ_FMT_SC8 or IQ_FMT_SC4
+ *  \param[in] shift Right shift with rounding, see iqShift()
+ */
+void iqCompress(const short *iq, unsigned char *out, int nsamp, int bits, int shift) {
+    int lim = (1 << (bits - 1)) - 1; // Symmetric range, no bias from the extra negative code
+    int i = 0, n = 2 * nsamp;
+
+#if defined(__SSE2__)
+    __m128i vr = _mm_set1_epi16((short) (1 << (shift - 1)));
+    __m128i vsh = _mm_cvtsi32_si128(shift);
+    __m128i vhi = _mm_set1_epi16((short) lim);
+    __m128i vlo = _mm_set1_epi16((short) -lim);
+    __m128i vnib = _mm_set1_epi16(0x000f);
+
+    for (; i + 16 <= n; i += 16) {
+        // Saturating add keeps the rounding of full scale MSB-aligned values in range
+        __m128i a = _mm_sra_epi16(_mm_adds_epi16(_mm_loadu_si128((const __m128i *) (iq + i)), vr), vsh);
+        __m128i b = _mm_sra_epi16(_mm_adds_epi16(_mm_loadu_si128((const __m128i *) (iq + i + 8)), vr), vsh);
+        __m128i x;
+
+        a = _mm_min_epi16(_mm_max_epi16(a, vlo), vhi);
+        b = _mm_min_epi16(_mm_max_epi16(b, vlo), vhi);
+        x = _mm_packs_epi16(a, b);
+        if (bits == IQ_FMT_SC8) {
+            _mm_storeu_si128((__m128i *) (out + i), x);
+        } else {
+            // 16-bit lane holds I in the low and Q in the high byte
+            x = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(x, vnib), 4), _mm_and_si128(_mm_srli_epi16(x, 8), vnib));
+            _mm_storel_epi64((__m128i *) (out + i / 2), _mm_packus_epi16(x, x));
+        }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    int16x8_t vsh = vdupq_n_s16((int16_t) -shift);
+    int16x8_t vhi = vdupq_n_s16((int16_t) lim);
+    int16x8_t vlo = vdupq_n_s16((int16_t) -lim);
+    uint16x8_t vnib = vdupq_n_u16(0x000f);
+
+    for (; i + 16 <= n; i += 16) {
+        // Rounding shift right
+        int16x8_t a = vrshlq_s16(vld1q_s16(iq + i), vsh);
+        int16x8_t b = vrshlq_s16(vld1q_s16(iq + i + 8), vsh);
+        int8x16_t x;
+        uint16x8_t y;
+
+        a = vminq_s16(vmaxq_s16(a, vlo), vhi);
+        b = vminq_s16(vmaxq_s16(b, vlo), vhi);
+        x = vcombine_s8(vmovn_s16(a), vmovn_s16(b));
+        if (bits == IQ_FMT_SC8) {
+            vst1q_s8((int8_t *) (out + i), x);
+        } else {
+            // 16-bit lane holds I in the low and Q in the high byte
+            y = vreinterpretq_u16_s8(x);
+            y = vorrq_u16(vshlq_n_u16(vandq_u16(y, vnib), 4), vandq_u16(vshrq_n_u16(y, 8), vnib));
+            vst1_u8(out + i / 2, vmovn_u16(y));
+        }
+    }
+#endif
+
+    if (bits == IQ_FMT_SC8) {
+        for (; i < n; i++)
+            out[i] = (unsigned char) (int8_t) iqNarrow(iq[i], shift, lim);
+    } else {
+        for (; i < n; i += 2)
+            out[i / 2] = (unsigned char) (((iqNarrow(iq[i], shift, lim) & 0xf) << 4) | (iqNarrow(iq[i + 1], shift, lim) & 0xf));
+    }
+}
+
+/*! \brief Convert sc8 or sc4 I/Q samples to 16 bit
+ *  \param[in] in Compact samples, iqBytes() bytes
+ *  \param[out] iq Interleaved 16-bit I/Q samples
+ *  \param[in] nsamp Number of I/Q samples, even for sc4
+ *  \param[in] bits IQ_FMT_SC8 or IQ_FMT_SC4
+ *  \param[in] shift Left shift, see iqShift()
+ */
+void iqExpand(const unsigned char *in, short *iq, int nsamp, int bits, int shift) {
+    int i = 0, n = 2 * nsamp;
+
+#if defined(__SSE2__)
+    __m128i vsh = _mm_cvtsi32_si128(shift);
+    __m128i zero = _mm_setzero_si128();
+
+    for (; i + 16 <= n; i += 16) {
+        __m128i a, b;
+
+        if (bits == IQ_FMT_SC8) {
+            // Bytes into the high half of each lane, arithmetic shift back sign extends
+            __m128i x = _mm_loadu_si128((const __m128i *) (in + i));
+            a = _mm_srai_epi16(_mm_unpacklo_epi8(zero, x), 8);
+            b = _mm_srai_epi16(_mm_unpackhi_epi8(zero, x), 8);
+        } else {
+            __m128i x = _mm_unpacklo_epi8(zero, _mm_loadl_epi64((const __m128i *) (in + i / 2)));
+            __m128i vi = _mm_srai_epi16(x, 12);
+            __m128i vq = _mm_srai_epi16(_mm_slli_epi16(x, 4), 12);
+            a = _mm_unpacklo_epi16(vi, vq);
+            b = _mm_unpackhi_epi16(vi, vq);
+        }
+        _mm_storeu_si128((__m128i *) (iq + i), _mm_sll_epi16(a, vsh));
+        _mm_storeu_si128((__m128i *) (iq + i + 8), _mm_sll_epi16(b, vsh));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    int16x8_t vsh = vdupq_n_s16((int16_t) shift);
+
+    for (; i + 16 <= n; i += 16) {
+        int16x8_t a, b;
+
+        if (bits == IQ_FMT_SC8) {
+            int8x16_t x = vld1q_s8((const int8_t *) (in + i));
+            a = vmovl_s8(vget_low_s8(x));
+            b = vmovl_s8(vget_high_s8(x));
+        } else {
+            int16x8_t x = vreinterpretq_s16_u16(vshll_n_u8(vld1_u8(in + i / 2), 8));
+            int16x8x2_t z = vzipq_s16(vshrq_n_s16(x, 12), vshrq_n_s16(vshlq_n_s16(x, 4), 12));
+            a = z.val[0];
+            b = z.val[1];
+        }
+        vst1q_s16(iq + i, vshlq_s16(a, vsh));
+        vst1q_s16(iq + i + 8, vshlq_s16(b, vsh));
+    }
+#endif
+
+    if (bits == IQ_FMT_SC8) {
+        for (; i < n; i++)
+            iq[i] = (short) ((int8_t) in[i] * (1 << shift));
+    } else {
+        for (; i < n; i += 2) {
+            iq[i] = (short) (((int8_t) (in[i / 2] & 0xf0) >> 4) * (1 << shift));
+            iq[i + 1] = (short) (((int8_t) (in[i / 2] << 4) >> 4) * (1 << shift));
+        }
+    }
+}
+
+/*! \brief Receiver antenna gain, interpolated in dB between the 5 degree pattern steps
+ *  \param[in] el Elevation in radians
+ *  \returns Amplitude gain
+ */
+static double antennaGain(double el) {
+    double bs = (90.0 - el * R2D) / 5.0; // Boresight angle in pattern steps
+    double att;
+    int i;
+
+    if (bs < 0.0)
+        bs = 0.0;
+    i = (int) bs;
+    if (i > 35)
+        i = 35;
+    if (bs > 36.0)
+        bs = 36.0;
+    att = ant_pat_db[i] + (bs - i) * (ant_pat_db[i + 1] - ant_pat_db[i]);
+
+    return (pow(10.0, -att / 20.0));
+}
+
+/*! \brief Set the fixed-point gain the sample kernels apply to a channel
+ *  \param chan Channel
+ *  \param[in] gain Signal gain
+ */
+void setChannelGain(channel_t *chan, double gain) {
+    double q = gain * (1 << GAIN_FRAC_BITS);
+
+    if (q > INT32_MAX)
+        q = INT32_MAX;
+    else if (q < 0.0)
+        q = 0.0;
+    chan->gain_q = (int32_t) lrint(q);
+
+    return;
+}
+
+/*! \brief Highest signal gain of a channel
+ *
+ * All channels at this gain together with their echoes stay within
+ * MAX_SIGNAL_ACC of the int32 accumulator, and the fixed-point gain of the
+ * strongest echo stays representable.
+ *  \param[in] sig Signal model, carrier table amplitude and echoes
+ *  \param[in] nchan Number of channels
+ *  \returns Gain limit
+ */
+static double maxChannelGain(const struct signal_model *sig, int nchan) {
+    double paths = nchan, emax = 1.0, g, q;
+    int j;
+
+    // An echo adds its relative gain to the sum of the channel it follows
+    for (j = 0; j < sig->necho; j++) {
+        paths += sig->echo[j].gain;
+        if (sig->echo[j].gain > emax)
+            emax = sig->echo[j].gain;
+    }
+    g = MAX_SIGNAL_ACC / (sig->carr.ampl * paths);
+    q = (double) INT32_MAX / (1 << GAIN_FRAC_BITS) / emax;
+
+    return ((g < q) ? g : q);
+}
+
+/*! \brief Parse a list of per-PRN levels, e.g. "5:-3.0,12:1.5"
+ *  \param[in] arg Option argument
+ *  \param[out] level Level per PRN, MAX_SAT entries, only listed PRNs are written
+ *  \param[in] min Lowest valid level
+ *  \param[in] max Highest valid level
+ *  \returns 0 on success, -1 on syntax error, invalid PRN or level
+ */
+int parsePrnLevels(const char *arg, double *level, double min, double max) {
+    const char *p = arg;
+    char *end;
+    long prn;
+    double v;
+
+    while (*p != '\0') {
+        prn = strtol(p, &end, 10);
+        if (end == p || *end != ':' || prn < 1 || prn > MAX_SAT)
+            return (-1);
+        p = end + 1;
+        v = strtod(p, &end);
+        if (end == p || v < min || v > max)
+            return (-1);
+        level[prn - 1] = v;
+        p = end;
+        if (*p == ',')
+            p++;
+        else if (*p != '\0')
+            return (-1);
+    }
+
+    return (0);
+}
+
+/*! \brief Parse a list of multipath echoes, e.g. "5:150:-6,12:40:-3:0.5:90"
+ *
+ * Each echo is prn:delay:power[:doppler[:phase]] with the excess delay in
+ * meters, the power in dB and the Doppler offset in Hz relative to the
+ * direct path and the phase offset in degree.
+ *  \param sig Signal model the echoes are added to
+ *  \param[in] arg Option argument
+ *  \returns 0 on success, -1 on syntax error or invalid value
+ */
+static int parseEchoes(struct signal_model *sig, const char *arg) {
+    const char *p = arg;
+    char *end;
+    double v[5];
+    int n;
+
+    while (*p != '\0') {
+        if (sig->necho >= MAX_ECHOES)
+            return (-1);
+
+        v[3] = 0.0;
+        v[4] = 0.0;
+        for (n = 0; n < 5; n++) {
+            v[n] = strtod(p, &end);
+            if (end == p)
+                return (-1);
+            p = end;
+            if (*p != ':')
+                break;
+            p++;
+        }
+        if (n < 2 || n == 5 || v[0] < 1 || v[0] > MAX_SAT || v[0] != floor(v[0])
+                || v[1] <= 0.0 || v[1] > MAX_ECHO_DELAY || fabs(v[2]) > MAX_POWER_OFFSET)
+            return (-1);
+
+        sig->echo[sig->necho].prn = (int) v[0];
+        sig->echo[sig->necho].delay = v[1];
+        sig->echo[sig->necho].gain = pow(10.0, v[2] / 20.0);
+        sig->echo[sig->necho].doppler = v[3];
+        sig->echo[sig->necho].phase = v[4] / 360.0;
+        sig->necho++;
+
+        if (*p == ',')
+            p++;
+        else if (*p != '\0')
+            return (-1);
+    }
+
+    return (0);
+}
+
+static inline uint32_t rotl32(uint32_t x, int k) {
+    return ((x << k) | (x >> (32 - k)));
+}
+
+/*! \brief SplitMix64 generator, expands the noise seed into generator states */
+static uint64_t splitMix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+
+    return (z ^ (z >> 31));
+}
+
+/*! \brief Next number of the scalar xoshiro128** stream */
+static inline uint32_t awgnNext(struct awgn *a) {
+    uint32_t *s = a->t;
+    uint32_t r = rotl32(s[1] * 5, 7) * 9;
+    uint32_t t = s[1] << 9;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl32(s[3], 11);
+
+    return (r);
+}
+
+/*! \brief Uniform number in (0,1) of the scalar stream */
+static inline float awgnUniform(struct awgn *a) {
+    return (((float) (awgnNext(a) >> 8) + 0.5f) * (1.0f / 16777216.0f));
+}
+
+/*! \brief Fill a buffer from the interleaved xoshiro128** streams
+ *  \param a Noise stage
+ *  \param[out] r Output buffer
+ *  \param[in] n Number of values, multiple of NOISE_LANES
+ */
+static void awgnFill(struct awgn *a, uint32_t *r, int n) {
+    int i = 0;
+
+#if defined(__SSE2__)
+    __m128i s0 = _mm_loadu_si128((const __m128i *) a->s[0]);
+    __m128i s1 = _mm_loadu_si128((const __m128i *) a->s[1]);
+    __m128i s2 = _mm_loadu_si128((const __m128i *) a->s[2]);
+    __m128i s3 = _mm_loadu_si128((const __m128i *) a->s[3]);
+    __m128i x, t;
+
+    for (; i + NOISE_LANES <= n; i += NOISE_LANES) {
+        // rotl(s1 * 5, 7) * 9, SSE2 has no 32-bit multiply
+        x = _mm_add_epi32(_mm_slli_epi32(s1, 2), s1);
+        x = _mm_or_si128(_mm_slli_epi32(x, 7), _mm_srli_epi32(x, 25));
+        x = _mm_add_epi32(_mm_slli_epi32(x, 3), x);
+        _mm_storeu_si128((__m128i *) (r + i), x);
+
+        t = _mm_slli_epi32(s1, 9);
+        s2 = _mm_xor_si128(s2, s0);
+        s3 = _mm_xor_si128(s3, s1);
+        s1 = _mm_xor_si128(s1, s2);
+        s0 = _mm_xor_si128(s0, s3);
+        s2 = _mm_xor_si128(s2, t);
+        s3 = _mm_or_si128(_mm_slli_epi32(s3, 11), _mm_srli_epi32(s3, 21));
+    }
+
+    _mm_storeu_si128((__m128i *) a->s[0], s0);
+    _mm_storeu_si128((__m128i *) a->s[1], s1);
+    _mm_storeu_si128((__m128i *) a->s[2], s2);
+    _mm_storeu_si128((__m128i *) a->s[3], s3);
+#else
+    uint32_t t;
+    int k;
+
+    for (; i + NOISE_LANES <= n; i += NOISE_LANES) {
+        for (k = 0; k < NOISE_LANES; k++) {
+            r[i + k] = rotl32(a->s[1][k] * 5, 7) * 9;
+
+            t = a->s[1][k] << 9;
+            a->s[2][k] ^= a->s[0][k];
+            a->s[3][k] ^= a->s[1][k];
+            a->s[1][k] ^= a->s[2][k];
+            a->s[0][k] ^= a->s[3][k];
+            a->s[2][k] ^= t;
+            a->s[3][k] = rotl32(a->s[3][k], 11);
+        }
+    }
+#endif
+
+    return;
+}
+
+/*! \brief Ziggurat rejection path, see Marsaglia and Tsang (2000) */
+static float awgnNormalFix(struct awgn *a, int32_t hz, uint32_t iz) {
+    const float r = 3.442620f; // Start of the tail
+    float x, y;
+
+    for (;;) {
+        x = (float) hz * a->wn[iz];
+
+        if (iz == 0) {
+            // Sample from the tail
+            do {
+                x = -logf(awgnUniform(a)) * (1.0f / r);
+                y = -logf(awgnUniform(a));
+            } while (y + y < x * x);
+
+            return ((hz > 0) ? r + x : -r - x);
+        }
+
+        if (a->fn[iz] + awgnUniform(a) * (a->fn[iz - 1] - a->fn[iz]) < expf(-0.5f * x * x))
+            return (x);
+
+        hz = (int32_t) awgnNext(a);
+        iz = (uint32_t) hz & (ZIG_LAYERS - 1);
+        if ((hz < 0 ? 0u - (uint32_t) hz : (uint32_t) hz) < a->kn[iz])
+            return ((float) hz * a->wn[iz]);
+    }
+}
+
+/*! \brief Standard normal deviate from one uniform 32-bit number */
+static inline float awgnNormal(struct awgn *a, uint32_t u) {
+    int32_t hz = (int32_t) u;
+    uint32_t iz = u & (ZIG_LAYERS - 1);
+
+    if ((hz < 0 ? 0u - u : u) < a->kn[iz])
+        return ((float) hz * a->wn[iz]);
+
+    return (awgnNormalFix(a, hz, iz));
+}
+
+/*! \brief Position the noise generators at the start of a block
+ *
+ * Every block has its own generator states derived from the seed and the
+ * block counter, so blocks can be rendered in any order.
+ *  \param a Noise stage
+ *  \param[in] block Block counter since start
+ */
+static void awgnSeek(struct awgn *a, uint64_t block) {
+    uint64_t x = a->seed ^ (0xd1b54a32d192ed03ULL * (block + 1)), v;
+    int i, k;
+
+    // Independent generator states from one seed
+    for (k = 0; k < NOISE_LANES; k++) {
+        for (i = 0; i < 4; i += 2) {
+            v = splitMix64(&x);
+            a->s[i][k] = (uint32_t) v;
+            a->s[i + 1][k] = (uint32_t) (v >> 32);
+        }
+    }
+    for (i = 0; i < 4; i += 2) {
+        v = splitMix64(&x);
+        a->t[i] = (uint32_t) v;
+        a->t[i + 1] = (uint32_t) (v >> 32);
+    }
+}
+
+/*! \brief Set up the noise stage, call after initCarrierTable()
+ *
+ * The noise level is given as C/N0 of a satellite at unity signal gain,
+ * i.e. at 20200km range in the antenna boresight.
+ *  \param a Noise stage
+ *  \param[in] cn0 C/N0 in dB-Hz
+ *  \param[in] fs Sample rate in Hz
+ *  \param[in] seed Generator seed, equal seeds give equal noise
+ *  \param[in] ampl Carrier table amplitude, the signal level of unity gain
+ *  \returns 0 on success, -1 on invalid level
+ */
+int awgnInit(struct awgn *a, double cn0, double fs, uint64_t seed, double ampl) {
+    const double m1 = 2147483648.0;
+    double dn = 3.442619855899, tn = dn, vn = 9.91256303526217e-3;
+    double q;
+    int i;
+
+    if (cn0 < MIN_NOISE_CN0 || cn0 > MAX_NOISE_CN0 || fs <= 0.0)
+        return (-1);
+
+    // Ziggurat tables
+    q = vn / exp(-0.5 * dn * dn);
+    a->kn[0] = (uint32_t) ((dn / q) * m1);
+    a->kn[1] = 0;
+    a->wn[0] = (float) (q / m1);
+    a->wn[ZIG_LAYERS - 1] = (float) (dn / m1);
+    a->fn[0] = 1.0f;
+    a->fn[ZIG_LAYERS - 1] = (float) exp(-0.5 * dn * dn);
+    for (i = ZIG_LAYERS - 2; i >= 1; i--) {
+        dn = sqrt(-2.0 * log(vn / dn + exp(-0.5 * dn * dn)));
+        a->kn[i + 1] = (uint32_t) ((dn / tn) * m1);
+        tn = dn;
+        a->fn[i] = (float) exp(-0.5 * dn * dn);
+        a->wn[i] = (float) (dn / m1);
+    }
+
+    a->seed = seed;
+    awgnSeek(a, 0);
+
+    // Signal power of one channel at unity gain is the table amplitude squared,
+    // N0 * fs splits into I and Q
+    a->sigma = ampl * sqrt(fs / (2.0 * pow(10.0, cn0 / 10.0)));
+
+    return (0);
+}
+
+/*! \brief Add complex white Gaussian noise to a block of accumulated samples
+ *  \param a Noise stage
+ *  \param acc Interleaved I/Q accumulator
+ *  \param[in] nsamp Number of I/Q samples
+ *  \returns 0 on success, -1 on allocation error
+ */
+int awgnAdd(struct awgn *a, int32_t *acc, int nsamp) {
+    int n = (2 * nsamp + NOISE_LANES - 1) / NOISE_LANES * NOISE_LANES;
+    float sigma = (float) a->sigma;
+    uint32_t *rnd;
+    int i;
+
+    if (a->rnd_len < n) {
+        rnd = realloc(a->rnd, n * sizeof (uint32_t));
+        if (rnd == NULL)
+            return (-1);
+        a->rnd = rnd;
+        a->rnd_len = n;
+    }
+
+    awgnFill(a, a->rnd, n);
+
+    for (i = 0; i < 2 * nsamp; i++)
+        acc[i] += (int32_t) lrintf(sigma * awgnNormal(a, a->rnd[i]));
+
+    return (0);
+}
+
+/*! \brief Release the noise stage buffer and turn the stage off */
+void awgnFree(struct awgn *a) {
+    free(a->rnd);
+    a->rnd = NULL;
+    a->rnd_len = 0;
+    a->sigma = 0.0;
+
+    return;
+}
+
+/*! \brief Zeroth order modified Bessel function of the first kind */
+static double besselI0(double x) {
+    double sum = 1.0, term = 1.0;
+    int k;
+
+    for (k = 1; k < 50; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1.0e-12)
+            break;
+    }
+
+    return (sum);
+}
+
+/*! \brief Design a Kaiser windowed sinc lowpass
+ *  \param[out] h Taps
+ *  \param[in] n Number of taps
+ *  \param[in] fc Cutoff frequency relative to the sample rate
+ *  \param[in] gain DC gain
+ */
+static void firDesign(double *h, int n, double fc, double gain) {
+    double t, w, sum = 0.0;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        t = i - (n - 1) / 2.0;
+        w = 2.0 * i / (n - 1) - 1.0;
+        h[i] = (t == 0.0) ? 2.0 * fc : sin(2.0 * PI * fc * t) / (PI * t);
+        h[i] *= besselI0(FIR_KAISER_BETA * sqrt(1.0 - w * w)) / besselI0(FIR_KAISER_BETA);
+        sum += h[i];
+    }
+
+    for (i = 0; i < n; i++)
+        h[i] *= gain / sum;
+
+    return;
+}
+
+/*! \brief Set up a polyphase FIR filter, L = M = 1 gives a plain FIR
+ *  \param[out] f Filter
+ *  \param[in] L Interpolation factor
+ *  \param[in] M Decimation factor
+ *  \param[in] ntaps Taps per phase, multiple of 4
+ *  \param[in] fc Cutoff frequency relative to the input sample rate
+ *  \returns 0 on success, -1 on allocation error
+ */
+int firInit(struct fir_filter *f, int L, int M, int ntaps, double fc) {
+    double *h;
+    int ph, m;
+
+    memset(f, 0, sizeof (struct fir_filter));
+    h = malloc((size_t) L * ntaps * sizeof (double));
+    f->taps = malloc((size_t) L * ntaps * 2 * sizeof (float));
+    f->buf = calloc((size_t) (ntaps - 1 + FIR_CHUNK) * 2, sizeof (float));
+    if (h == NULL || f->taps == NULL || f->buf == NULL) {
+        free(h);
+        free(f->taps);
+        free(f->buf);
+        f->taps = NULL;
+        f->buf = NULL;
+        return (-1);
+    }
+
+    f->L = L;
+    f->M = M;
+    f->ntaps = ntaps;
+
+    // Prototype runs at L times the input rate, every phase gets unity gain
+    firDesign(h, L * ntaps, fc / L, (double) L);
+    for (ph = 0; ph < L; ph++) {
+        for (m = 0; m < ntaps; m++) {
+            f->taps[(ph * ntaps + m) * 2] = (float) h[ph + (ntaps - 1 - m) * L];
+            f->taps[(ph * ntaps + m) * 2 + 1] = f->taps[(ph * ntaps + m) * 2];
+        }
+    }
+    free(h);
+
+    return (0);
+}
+
+/*! \brief Dot product of interleaved I/Q samples with duplicated taps
+ *  \param[in] x Interleaved I/Q samples
+ *  \param[in] h Taps, each duplicated for I and Q
+ *  \param[in] n Number of floats, multiple of 8
+ *  \param[out] y I/Q result
+ */
+static inline void firDot(const float *x, const float *h, int n, float *y) {
+    int i;
+
+#if defined(__SSE2__)
+    __m128 a0 = _mm_setzero_ps();
+    __m128 a1 = _mm_setzero_ps();
+    float t[4];
+
+    for (i = 0; i < n; i += 8) {
+        a0 = _mm_add_ps(a0, _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(h + i)));
+        a1 = _mm_add_ps(a1, _mm_mul_ps(_mm_loadu_ps(x + i + 4), _mm_loadu_ps(h + i + 4)));
+    }
+    _mm_storeu_ps(t, _mm_add_ps(a0, a1));
+    y[0] = t[0] + t[2];
+    y[1] = t[1] + t[3];
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    float32x4_t a0 = vdupq_n_f32(0.0f);
+    float32x4_t a1 = vdupq_n_f32(0.0f);
+    float32x4_t a;
+
+    for (i = 0; i < n; i += 8) {
+        a0 = vmlaq_f32(a0, vld1q_f32(x + i), vld1q_f32(h + i));
+        a1 = vmlaq_f32(a1, vld1q_f32(x + i + 4), vld1q_f32(h + i + 4));
+    }
+    a = vaddq_f32(a0, a1);
+    y[0] = vgetq_lane_f32(a, 0) + vgetq_lane_f32(a, 2);
+    y[1] = vgetq_lane_f32(a, 1) + vgetq_lane_f32(a, 3);
+#else
+    float si = 0.0f, sq = 0.0f;
+
+    for (i = 0; i < n; i += 2) {
+        si += x[i] * h[i];
+        sq += x[i + 1] * h[i + 1];
+    }
+    y[0] = si;
+    y[1] = sq;
+#endif
+
+    return;
+}
+
+/*! \brief Filter one block of interleaved I/Q samples
+ *
+ * The block is processed in chunks of FIR_CHUNK samples, each chunk stays
+ * in cache while all taps run over it. The filter state carries over to the
+ * next block. nin * L has to be a multiple of M, the output then holds
+ * nin * L / M samples.
+ *  \param f Filter
+ *  \param[in] in Input block
+ *  \param[in] nin Input samples
+ *  \param[out] out Output block, may be \a in when L == M
+ *  \returns Number of output samples
+ */
+int firProcess(struct fir_filter *f, const int32_t *in, int nin, int32_t *out) {
+    int hist = (f->ntaps - 1) * 2;
+    int n = 0, c, nc, i;
+    long end;
+    float y[2];
+
+    for (c = 0; c < nin; c += nc) {
+        nc = (nin - c < FIR_CHUNK) ? nin - c : FIR_CHUNK;
+
+        for (i = 0; i < nc * 2; i++)
+            f->buf[hist + i] = (float) in[c * 2 + i];
+
+        // Input sample p / L of the chunk is the newest tap
+        end = (long) nc * f->L;
+        for (; f->p < end; f->p += f->M, n++) {
+            firDot(f->buf + (f->p / f->L) * 2, f->taps + (f->p % f->L) * f->ntaps * 2, f->ntaps * 2, y);
+            out[n * 2] = (int32_t) lrintf(y[0]);
+            out[n * 2 + 1] = (int32_t) lrintf(y[1]);
+        }
+        f->p -= end;
+
+        memmove(f->buf, f->buf + nc * 2, hist * sizeof (float));
+    }
+
+    return (n);
+}
+
+/*! \brief Release a polyphase FIR filter */
+void firFree(struct fir_filter *f) {
+    free(f->taps);
+    free(f->buf);
+    f->taps = NULL;
+    f->buf = NULL;
+
+    return;
+}
+
+/*! \brief Greatest common divisor */
+long long gcdLL(long long a, long long b) {
+    long long t;
+
+    while (b != 0) {
+        t = a % b;
+        a = b;
+        b = t;
+    }
+
+    return (a);
+}
+
+/*! \brief Convert a UTC date into a GPS date
+ *  \param[in] t input date in UTC form
+ *  \param[out] g output date in GPS form
+ */
+void date2gps(const datetime_t *t, gpstime_t *g) {
+    int doy[12] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+    int ye;
+    int de;
+    int lpdays;
+
+    ye = t->y - 1980;
+
+    // Compute the number of leap days since Jan 5/Jan 6, 1980.
+    lpdays = ye / 4 + 1;
+    if ((ye % 4) == 0 && t->m <= 2)
+        lpdays--;
+
+    // Compute the number of days elapsed since Jan 5/Jan 6, 1980.
+    de = ye * 365 + doy[t->m - 1] + t->d + lpdays - 6;
+
+    // Convert time to GPS weeks and seconds.
+    g->week = de / 7;
+    g->sec = (double) (de % 7) * SECONDS_IN_DAY + t->hh * SECONDS_IN_HOUR
+            + t->mm * SECONDS_IN_MINUTE + t->sec;
+
+    return;
+}
+
+void gps2date(const gpstime_t *g, datetime_t *t) {
+    // Convert Julian day number to calendar date
+    int c = (int) (7 * g->week + floor(g->sec / 86400.0) + 2444245.0) + 1537;
+    int d = (int) ((c - 122.1) / 365.25);
+    int e = 365 * d + d / 4;
+    int f = (int) ((c - e) / 30.6001);
+
+    t->d = c - e - (int) (30.6001 * f);
+    t->m = f - 1 - 12 * (f / 14);
+    t->y = d - 4715 - ((7 + t->m) / 10);
+
+    t->hh = ((int) (g->sec / 3600.0)) % 24;
+    t->mm = ((int) (g->sec / 60.0)) % 60;
+    t->sec = g->sec - 60.0 * floor(g->sec / 60.0);
+
+    return;
+}
+
+/*! \brief Convert Earth-centered Earth-fixed (ECEF) into Lat/Long/Heighth
+ *  \param[in] xyz Input Array of X, Y and Z ECEF coordinates
+ *  \param[out] llh Output Array of Latitude, Longitude and Height
+ */
+void xyz2llh(const double *xyz, double *llh) {
+    double a, eps, e, e2;
+    double x, y, z;
+    double rho2, dz, zdz, nh, slat, n, dz_new;
+
+    a = WGS84_RADIUS;
+    e = WGS84_ECCENTRICITY;
+
+    eps = 1.0e-3;
+    e2 = e*e;
+
+    if (normVect(xyz) < eps) {
+        // Invalid ECEF vector
+        llh[0] = 0.0;
+        llh[1] = 0.0;
+        llh[2] = -a;
+
+        return;
+    }
+
+    x = xyz[0];
+    y = xyz[1];
+    z = xyz[2];
+
+    rho2 = x * x + y*y;
+    dz = e2*z;
+
+    while (1) {
+        zdz = z + dz;
+        nh = sqrt(rho2 + zdz * zdz);
+        slat = zdz / nh;
+        n = a / sqrt(1.0 - e2 * slat * slat);
+        dz_new = n * e2*slat;
+
+        if (fabs(dz - dz_new) < eps)
+            break;
+
+        dz = dz_new;
+    }
+
+    llh[0] = atan2(zdz, sqrt(rho2));
+    llh[1] = atan2(y, x);
+    llh[2] = nh - n;
+
+    return;
+}
+
+/*! \brief Convert Lat/Long/Height into Earth-centered Earth-fixed (ECEF)
+ *  \param[in] llh Input Array of Latitude, Longitude and Height
+ *  \param[out] xyz Output Array of X, Y and Z ECEF coordinates
+ */
+void llh2xyz(const double *llh, double *xyz) {
+    double n;
+    double a;
+    double e;
+    double e2;
+    double clat;
+    double slat;
+    double clon;
+    double slon;
+    double d, nph;
+    double tmp;
+
+    a = WGS84_RADIUS;
+    e = WGS84_ECCENTRICITY;
+    e2 = e*e;
+
+    clat = cos(llh[0]);
+    slat = sin(llh[0]);
+    clon = cos(llh[1]);
+    slon = sin(llh[1]);
+    d = e*slat;
+
+    n = a / sqrt(1.0 - d * d);
+    nph = n + llh[2];
+
+    tmp = nph*clat;
+    xyz[0] = tmp*clon;
+    xyz[1] = tmp*slon;
+    xyz[2] = ((1.0 - e2) * n + llh[2]) * slat;
+
+    return;
+}
+
+/*! \brief Compute the intermediate matrix for LLH to ECEF
+ *  \param[in] llh Input position in Latitude-Longitude-Height format
+ *  \param[out] t Three-by-Three output matrix
+ */
+static void ltcmat(const double *llh, double t[3][3]) {
+    double slat, clat;
+    double slon, clon;
+
+    slat = sin(llh[0]);
+    clat = cos(llh[0]);
+    slon = sin(llh[1]);
+    clon = cos(llh[1]);
+
+    t[0][0] = -slat*clon;
+    t[0][1] = -slat*slon;
+    t[0][2] = clat;
+    t[1][0] = -slon;
+    t[1][1] = clon;
+    t[1][2] = 0.0;
+    t[2][0] = clat*clon;
+    t[2][1] = clat*slon;
+    t[2][2] = slat;
+
+    return;
+}
+
+/*! \brief Convert Earth-centered Earth-Fixed to ?
+ *  \param[in] xyz Input position as vector in ECEF format
+ *  \param[in] t Intermediate matrix computed by \ref ltcmat
+ *  \param[out] neu Output position as North-East-Up format
+ */
+static void ecef2neu(const double *xyz, double t[3][3], double *neu) {
+    neu[0] = t[0][0] * xyz[0] + t[0][1] * xyz[1] + t[0][2] * xyz[2];
+    neu[1] = t[1][0] * xyz[0] + t[1][1] * xyz[1] + t[1][2] * xyz[2];
+    neu[2] = t[2][0] * xyz[0] + t[2][1] * xyz[1] + t[2][2] * xyz[2];
+
+    return;
+}
+
+/*! \brief Convert North-Eeast-Up to Azimuth + Elevation
+ *  \param[in] neu Input position in North-East-Up format
+ *  \param[out] azel Output array of azimuth + elevation as double
+ */
+static void neu2azel(double *azel, const double *neu) {
+    double ne;
+
+    azel[0] = atan2(neu[1], neu[0]);
+    if (azel[0] < 0.0)
+        azel[0] += (2.0 * PI);
+
+    ne = sqrt(neu[0] * neu[0] + neu[1] * neu[1]);
+    azel[1] = atan2(neu[2], ne);
+
+    return;
+}
+
+/*! \brief Compute Satellite position, velocity and clock at given time
+ *  \param[in] eph Ephemeris data of the satellite
+ *  \param[in] g GPS time at which position is to be computed
+ *  \param[out] pos Computed position (vector)
+ *  \param[out] vel Computed velociy (vector)
+ *  \param[clk] clk Computed clock
+ */
+void satpos(ephem_t eph, gpstime_t g, double *pos, double *vel, double *clk) {
+    // Computing Satellite Velocity using the Broadcast Ephemeris
+    // http://www.ngs.noaa.gov/gps-toolbox/bc_velo.htm
+
+    double tk;
+    double mk;
+    double ek;
+    double ekold;
+    double ekdot;
+    double cek, sek;
+    double pk;
+    double pkdot;
+    double c2pk, s2pk;
+    double uk;
+    double ukdot;
+    double cuk, suk;
+    double ok;
+    double sok, cok;
+    double ik;
+    double ikdot;
+    double sik, cik;
+    double rk;
+    double rkdot;
+    double xpk, ypk;
+    double xpkdot, ypkdot;
+
+    double relativistic, OneMinusecosE, tmp;
+
+    tk = g.sec - eph.toe.sec;
+
+    if (tk > SECONDS_IN_HALF_WEEK)
+        tk -= SECONDS_IN_WEEK;
+    else if (tk<-SECONDS_IN_HALF_WEEK)
+        tk += SECONDS_IN_WEEK;
+
+    mk = eph.m0 + eph.n*tk;
+    ek = mk;
+    ekold = ek + 1.0;
+
+    OneMinusecosE = 0; // Suppress the uninitialized warning.
+    while (fabs(ek - ekold) > 1.0E-14) {
+        ekold = ek;
+        OneMinusecosE = 1.0 - eph.ecc * cos(ekold);
+        ek = ek + (mk - ekold + eph.ecc * sin(ekold)) / OneMinusecosE;
+    }
+
+    sek = sin(ek);
+    cek = cos(ek);
+
+    ekdot = eph.n / OneMinusecosE;
+
+    relativistic = -4.442807633E-10 * eph.ecc * eph.sqrta*sek;
+
+    pk = atan2(eph.sq1e2*sek, cek - eph.ecc) + eph.aop;
+    pkdot = eph.sq1e2 * ekdot / OneMinusecosE;
+
+    s2pk = sin(2.0 * pk);
+    c2pk = cos(2.0 * pk);
+
+    uk = pk + eph.cus * s2pk + eph.cuc*c2pk;
+    suk = sin(uk);
+    cuk = cos(uk);
+    ukdot = pkdot * (1.0 + 2.0 * (eph.cus * c2pk - eph.cuc * s2pk));
+
+    rk = eph.A * OneMinusecosE + eph.crc * c2pk + eph.crs*s2pk;
+    rkdot = eph.A * eph.ecc * sek * ekdot + 2.0 * pkdot * (eph.crs * c2pk - eph.crc * s2pk);
+
+    ik = eph.inc0 + eph.idot * tk + eph.cic * c2pk + eph.cis*s2pk;
+    sik = sin(ik);
+    cik = cos(ik);
+    ikdot = eph.idot + 2.0 * pkdot * (eph.cis * c2pk - eph.cic * s2pk);
+
+    xpk = rk*cuk;
+    ypk = rk*suk;
+    xpkdot = rkdot * cuk - ypk*ukdot;
+    ypkdot = rkdot * suk + xpk*ukdot;
+
+    ok = eph.omg0 + tk * eph.omgkdot - OMEGA_EARTH * eph.toe.sec;
+    sok = sin(ok);
+    cok = cos(ok);
+
+    pos[0] = xpk * cok - ypk * cik*sok;
+    pos[1] = xpk * sok + ypk * cik*cok;
+    pos[2] = ypk*sik;
+
+    tmp = ypkdot * cik - ypk * sik*ikdot;
+
+    vel[0] = -eph.omgkdot * pos[1] + xpkdot * cok - tmp*sok;
+    vel[1] = eph.omgkdot * pos[0] + xpkdot * sok + tmp*cok;
+    vel[2] = ypk * cik * ikdot + ypkdot*sik;
+
+    // Satellite clock correction
+    tk = g.sec - eph.toc.sec;
+
+    if (tk > SECONDS_IN_HALF_WEEK)
+        tk -= SECONDS_IN_WEEK;
+    else if (tk<-SECONDS_IN_HALF_WEEK)
+        tk += SECONDS_IN_WEEK;
+
+    clk[0] = eph.af0 + tk * (eph.af1 + tk * eph.af2) + relativistic - eph.tgd;
+    clk[1] = eph.af1 + 2.0 * tk * eph.af2;
+
+    return;
+}
+
+/*! \brief Compute Subframe from Ephemeris
+ *  \param[in] eph Ephemeris of given SV
+ *  \param[out] sbf Array of five sub-frames, 10 long words each
+ */
+void eph2sbf(const ephem_t eph, const ionoutc_t ionoutc, unsigned long sbf[5][N_DWRD_SBF]) {
+    unsigned long wn;
+    unsigned long toe;
+    unsigned long toc;
+    unsigned long iode;
+    unsigned long iodc;
+    long deltan;
+    long cuc;
+    long cus;
+    long cic;
+    long cis;
+    long crc;
+    long crs;
+    unsigned long ecc;
+    unsigned long sqrta;
+    long m0;
+    long omg0;
+    long inc0;
+    long aop;
+    long omgdot;
+    long idot;
+    long af0;
+    long af1;
+    long af2;
+    long tgd;
+    int svhlth;
+    int codeL2;
+
+    unsigned long ura = 0UL;
+    unsigned long dataId = 1UL;
+    unsigned long sbf4_page25_svId = 63UL;
+    unsigned long sbf5_page25_svId = 51UL;
+
+    unsigned long wna;
+    unsigned long toa;
+
+    signed long alpha0, alpha1, alpha2, alpha3;
+    signed long beta0, beta1, beta2, beta3;
+    signed long A0, A1;
+    signed long dtls, dtlsf;
+    unsigned long tot, wnt, wnlsf, dn;
+    unsigned long sbf4_page18_svId = 56UL;
+
+    // FIXED: This has to be the "transmission" week number, not for the ephemeris reference time
+    //wn = (unsigned long)(eph.toe.week%1024);
+    wn = 0UL;
+    toe = (unsigned long) (eph.toe.sec / 16.0);
+    toc = (unsigned long) (eph.toc.sec / 16.0);
+    iode = (unsigned long) (eph.iode);
+    iodc = (unsigned long) (eph.iodc);
+    deltan = (long) (eph.deltan / POW2_M43 / PI);
+    cuc = (long) (eph.cuc / POW2_M29);
+    cus = (long) (eph.cus / POW2_M29);
+    cic = (long) (eph.cic / POW2_M29);
+    cis = (long) (eph.cis / POW2_M29);
+    crc = (long) (eph.crc / POW2_M5);
+    crs = (long) (eph.crs / POW2_M5);
+    ecc = (unsigned long) (eph.ecc / POW2_M33);
+    sqrta = (unsigned long) (eph.sqrta / POW2_M19);
+    m0 = (long) (eph.m0 / POW2_M31 / PI);
+    omg0 = (long) (eph.omg0 / POW2_M31 / PI);
+    inc0 = (long) (eph.inc0 / POW2_M31 / PI);
+    aop = (long) (eph.aop / POW2_M31 / PI);
+    omgdot = (long) (eph.omgdot / POW2_M43 / PI);
+    idot = (long) (eph.idot / POW2_M43 / PI);
+    af0 = (long) (eph.af0 / POW2_M31);
+    af1 = (long) (eph.af1 / POW2_M43);
+    af2 = (long) (eph.af2 / POW2_M55);
+    tgd = (long) (eph.tgd / POW2_M31);
+    svhlth = (unsigned long) (eph.svhlth);
+    codeL2 = (unsigned long) (eph.codeL2);
+
+    wna = (unsigned long) (eph.toe.week % 256);
+    toa = (unsigned long) (eph.toe.sec / 4096.0);
+
+    alpha0 = (signed long) round(ionoutc.alpha0 / POW2_M30);
+    alpha1 = (signed long) round(ionoutc.alpha1 / POW2_M27);
+    alpha2 = (signed long) round(ionoutc.alpha2 / POW2_M24);
+    alpha3 = (signed long) round(ionoutc.alpha3 / POW2_M24);
+    beta0 = (signed long) round(ionoutc.beta0 / 2048.0);
+    beta1 = (signed long) round(ionoutc.beta1 / 16384.0);
+    beta2 = (signed long) round(ionoutc.beta2 / 65536.0);
+    beta3 = (signed long) round(ionoutc.beta3 / 65536.0);
+    A0 = (signed long) round(ionoutc.A0 / POW2_M30);
+    A1 = (signed long) round(ionoutc.A1 / POW2_M50);
+    dtls = (signed long) (ionoutc.dtls);
+    tot = (unsigned long) (ionoutc.tot / 4096);
+    wnt = (unsigned long) (ionoutc.wnt % 256);
+    // TO DO: Specify scheduled leap seconds in command options
+    // 2016/12/31 (Sat) -> WNlsf = 1929, DN = 7 (http://navigationservices.agi.com/GNSSWeb/)
+    // Days are counted from 1 to 7 (Sunday is 1).
+    wnlsf = 1929 % 256;
+    dn = 7;
+    dtlsf = 18;
+
+    // Subframe 1
+    sbf[0][0] = 0x8B0000UL << 6;
+    sbf[0][1] = 0x1UL << 8;
+    sbf[0][2] = ((wn & 0x3FFUL) << 20) | ((codeL2 & 0x3UL) << 18) | ((ura & 0xFUL) << 14) | ((svhlth & 0x3FUL) << 8) | (((iodc >> 8)&0x3UL) << 6);
+    sbf[0][3] = 0UL;
+    sbf[0][4] = 0UL;
+    sbf[0][5] = 0UL;
+    sbf[0][6] = (tgd & 0xFFUL) << 6;
+    sbf[0][7] = ((iodc & 0xFFUL) << 22) | ((toc & 0xFFFFUL) << 6);
+    sbf[0][8] = ((af2 & 0xFFUL) << 22) | ((af1 & 0xFFFFUL) << 6);
+    sbf[0][9] = (af0 & 0x3FFFFFUL) << 8;
+
+    // Subframe 2
+    sbf[1][0] = 0x8B0000UL << 6;
+    sbf[1][1] = 0x2UL << 8;
+    sbf[1][2] = ((iode & 0xFFUL) << 22) | ((crs & 0xFFFFUL) << 6);
+    sbf[1][3] = ((deltan & 0xFFFFUL) << 14) | (((m0 >> 24)&0xFFUL) << 6);
+    sbf[1][4] = (m0 & 0xFFFFFFUL) << 6;
+    sbf[1][5] = ((cuc & 0xFFFFUL) << 14) | (((ecc >> 24)&0xFFUL) << 6);
+    sbf[1][6] = (ecc & 0xFFFFFFUL) << 6;
+    sbf[1][7] = ((cus & 0xFFFFUL) << 14) | (((sqrta >> 24)&0xFFUL) << 6);
+    sbf[1][8] = (sqrta & 0xFFFFFFUL) << 6;
+    sbf[1][9] = (toe & 0xFFFFUL) << 14;
+
+    // Subframe 3
+    sbf[2][0] = 0x8B0000UL << 6;
+    sbf[2][1] = 0x3UL << 8;
+    sbf[2][2] = ((cic & 0xFFFFUL) << 14) | (((omg0 >> 24)&0xFFUL) << 6);
+    sbf[2][3] = (omg0 & 0xFFFFFFUL) << 6;
+    sbf[2][4] = ((cis & 0xFFFFUL) << 14) | (((inc0 >> 24)&0xFFUL) << 6);
+    sbf[2][5] = (inc0 & 0xFFFFFFUL) << 6;
+    sbf[2][6] = ((crc & 0xFFFFUL) << 14) | (((aop >> 24)&0xFFUL) << 6);
+    sbf[2][7] = (aop & 0xFFFFFFUL) << 6;
+    sbf[2][8] = (omgdot & 0xFFFFFFUL) << 6;
+    sbf[2][9] = ((iode & 0xFFUL) << 22) | ((idot & 0x3FFFUL) << 8);
+
+    if (ionoutc.vflg == true) {
+        // Subframe 4, page 18
+        sbf[3][0] = 0x8B0000UL << 6;
+        sbf[3][1] = 0x4UL << 8;
+        sbf[3][2] = (dataId << 28) | (sbf4_page18_svId << 22) | ((alpha0 & 0xFFUL) << 14) | ((alpha1 & 0xFFUL) << 6);
+        sbf[3][3] = ((alpha2 & 0xFFUL) << 22) | ((alpha3 & 0xFFUL) << 14) | ((beta0 & 0xFFUL) << 6);
+        sbf[3][4] = ((beta1 & 0xFFUL) << 22) | ((beta2 & 0xFFUL) << 14) | ((beta3 & 0xFFUL) << 6);
+        sbf[3][5] = (A1 & 0xFFFFFFUL) << 6;
+        sbf[3][6] = ((A0 >> 8)&0xFFFFFFUL) << 6;
+        sbf[3][7] = ((A0 & 0xFFUL) << 22) | ((tot & 0xFFUL) << 14) | ((wnt & 0xFFUL) << 6);
+        sbf[3][8] = ((dtls & 0xFFUL) << 22) | ((wnlsf & 0xFFUL) << 14) | ((dn & 0xFFUL) << 6);
+        sbf[3][9] = (dtlsf & 0xFFUL) << 22;
+
+    } else {
+        // Subframe 4, page 25
+        sbf[3][0] = 0x8B0000UL << 6;
+        sbf[3][1] = 0x4UL << 8;
+        sbf[3][2] = (dataId << 28) | (sbf4_page25_svId << 22);
+        sbf[3][3] = 0UL;
+        sbf[3][4] = 0UL;
+        sbf[3][5] = 0UL;
+        sbf[3][6] = 0UL;
+        sbf[3][7] = 0UL;
+        sbf[3][8] = 0UL;
+        sbf[3][9] = 0UL;
+    }
+
+    // Subframe 5, page 25
+    sbf[4][0] = 0x8B0000UL << 6;
+    sbf[4][1] = 0x5UL << 8;
+    sbf[4][2] = (dataId << 28) | (sbf5_page25_svId << 22) | ((toa & 0xFFUL) << 14) | ((wna & 0xFFUL) << 6);
+    sbf[4][3] = 0UL;
+    sbf[4][4] = 0UL;
+    sbf[4][5] = 0UL;
+    sbf[4][6] = 0UL;
+    sbf[4][7] = 0UL;
+    sbf[4][8] = 0UL;
+    sbf[4][9] = 0UL;
+
+    return;
+}
+
+/*! \brief Count number of bits set to 1
+ *  \param[in] v long word in which bits are counted
+ *  \returns Count of bits set to 1
+ */
+static unsigned long countBits(unsigned long v) {
+    unsigned long c;
+    const int S[] = {1, 2, 4, 8, 16};
+    const unsigned long B[] = {
+        0x55555555, 0x33333333, 0x0F0F0F0F, 0x00FF00FF, 0x0000FFFF
+    };
+
+    c = v;
+    c = ((c >> S[0]) & B[0]) + (c & B[0]);
+    c = ((c >> S[1]) & B[1]) + (c & B[1]);
+    c = ((c >> S[2]) & B[2]) + (c & B[2]);
+    c = ((c >> S[3]) & B[3]) + (c & B[3]);
+    c = ((c >> S[4]) & B[4]) + (c & B[4]);
+
+    return (c);
+}
+
+/*! \brief Compute the Checksum for one given word of a subframe
+ *  \param[in] source The input data
+ *  \param[in] nib Does this word contain non-information-bearing bits?
+ *  \returns Computed Checksum
+ */
+unsigned long computeChecksum(unsigned long source, int nib) {
+    /*
+    Bits 31 to 30 = 2 LSBs of the previous transmitted word, D29* and D30*
+    Bits 29 to  6 = Source data bits, d1, d2, ..., d24
+    Bits  5 to  0 = Empty parity bits
+     */
+
+    /*
+    Bits 31 to 30 = 2 LSBs of the previous transmitted word, D29* and D30*
+    Bits 29 to  6 = Data bits transmitted by the SV, D1, D2, ..., D24
+    Bits  5 to  0 = Computed parity bits, D25, D26, ..., D30
+     */
+
+    /*
+                      1            2           3
+    bit    12 3456 7890 1234 5678 9012 3456 7890
+    ---    -------------------------------------
+    D25    11 1011 0001 1111 0011 0100 1000 0000
+    D26    01 1101 1000 1111 1001 1010 0100 0000
+    D27    10 1110 1100 0111 1100 1101 0000 0000
+    D28    01 0111 0110 0011 1110 0110 1000 0000
+    D29    10 1011 1011 0001 1111 0011 0100 0000
+    D30    00 1011 0111 1010 1000 1001 1100 0000
+     */
+
+    unsigned long bmask[6] = {
+        0x3B1F3480UL, 0x1D8F9A40UL, 0x2EC7CD00UL,
+        0x1763E680UL, 0x2BB1F340UL, 0x0B7A89C0UL
+    };
+
+    unsigned long D;
+    unsigned long d = source & 0x3FFFFFC0UL;
+    unsigned long D29 = (source >> 31)&0x1UL;
+    unsigned long D30 = (source >> 30)&0x1UL;
+
+    if (nib) // Non-information bearing bits for word 2 and 10
+    {
+        /*
+        Solve bits 23 and 24 to presearve parity check
+        with zeros in bits 29 and 30.
+         */
+
+        if ((D30 + countBits(bmask[4] & d)) % 2)
+            d ^= (0x1UL << 6);
+        if ((D29 + countBits(bmask[5] & d)) % 2)
+            d ^= (0x1UL << 7);
+    }
+
+    D = d;
+    if (D30)
+        D ^= 0x3FFFFFC0UL;
+
+    D |= ((D29 + countBits(bmask[0] & d)) % 2) << 5;
+    D |= ((D30 + countBits(bmask[1] & d)) % 2) << 4;
+    D |= ((D29 + countBits(bmask[2] & d)) % 2) << 3;
+    D |= ((D30 + countBits(bmask[3] & d)) % 2) << 2;
+    D |= ((D30 + countBits(bmask[4] & d)) % 2) << 1;
+    D |= ((D29 + countBits(bmask[5] & d)) % 2);
+
+    D &= 0x3FFFFFFFUL;
+    //D |= (source & 0xC0000000UL); // Add D29* and D30* from source data bits
+
+    return (D);
+}
+
+/*! \brief Replace all 'E' exponential designators to 'D'
+ *  \param str String in which all occurrences of 'E' are replaced with *  'D'
+ *  \param len Length of input string in bytes
+ *  \returns Number of characters replaced
+ */
+static int replaceExpDesignator(char *str, int len) {
+    int i, n = 0;
+
+    for (i = 0; i < len; i++) {
+        if (str[i] == 0) {
+            break;
+        }
+
+        if (str[i] == 'D' || str[i] == 'd') {
+            n++;
+            str[i] = 'E';
+        }
+    }
+
+    return (n);
+}
+
+double subGpsTime(gpstime_t g1, gpstime_t g0) {
+    double dt;
+
+    dt = g1.sec - g0.sec;
+    dt += (double) (g1.week - g0.week) * SECONDS_IN_WEEK;
+
+    return (dt);
+}
+
+gpstime_t incGpsTime(gpstime_t g0, double dt) {
+    gpstime_t g1;
+
+    g1.week = g0.week;
+    g1.sec = g0.sec + dt;
+
+    g1.sec = round(g1.sec * 1000.0) / 1000.0; // Avoid rounding error
+
+    while (g1.sec >= SECONDS_IN_WEEK) {
+        g1.sec -= SECONDS_IN_WEEK;
+        g1.week++;
+    }
+
+    while (g1.sec < 0.0) {
+        g1.sec += SECONDS_IN_WEEK;
+        g1.week--;
+    }
+
+    return (g1);
+}
+
+/*! \brief Read Ephemeris data from the RINEX v2 Navigation file */
+
+/*  \param[out] eph Array of Output SV ephemeris data
+ *  \param[in] fname File name of the RINEX file
+ *  \returns Number of sets of ephemerides in the file
+ */
+int readRinex2(ephem_t eph[][MAX_SAT], ionoutc_t *ionoutc, const char *fname) {
+    struct gzFile_s *fp;
+    int ieph;
+
+    int sv;
+    char str[MAX_CHAR];
+    char tmp[20];
+    double ver = 0.0;
+
+    datetime_t t;
+    gpstime_t g;
+    gpstime_t g0;
+    double dt;
+
+    int flags = 0x0;
+
+    if (NULL == (fp = gzopen(fname, "rt")))
+        return (-1);
+
+    // Clear valid flag
+    for (ieph = 0; ieph < EPHEM_ARRAY_SIZE; ieph++)
+        for (sv = 0; sv < MAX_SAT; sv++)
+            eph[ieph][sv].vflg = false;
+    ionoutc->date[0] = '\0';
+
+    // Read header lines
+    while (1) {
+        if (NULL == gzgets(fp, str, MAX_CHAR))
+            break;
+
+        if (strncmp(str + 60, "COMMENT", 7) == 0) {
+            continue;
+        } else if (strncmp(str + 60, "END OF HEADER", 13) == 0) {
+            break;
+        } else if (strncmp(str + 60, "RINEX VERSION / TYPE", 20) == 0) {
+            strncpy(tmp, str, 9);
+            tmp[9] = 0;
+            replaceExpDesignator(tmp, 9);
+            ver = atof(tmp);
+            if (ver > 3.0) {
+                gzclose(fp);
+                return -2;
+            }
+
+            if (str[20] != 'N') {
+                gzclose(fp);
+                return -3;
+            }
+        } else if (strncmp(str + 60, "PGM / RUN BY / DATE", 19) == 0) {
+            strncpy(ionoutc->date, str + 40, 20);
+            ionoutc->date[20] = 0;
+        } else if (strncmp(str + 60, "ION ALPHA", 9) == 0) {
+            strncpy(tmp, str + 2, 12);
+            tmp[12] = 0;
+            replaceExpDesignator(tmp, 12);
+            ionoutc->alpha0 = atof(tmp);
+
+            strncpy(tmp, str + 14, 12);
+            tmp[12] = 0;
+            replaceExpDesignator(tmp, 12);
+            ionoutc->alpha1 = atof(tmp);
+
+            strncpy(tmp, str + 26, 12);
+            tmp[12] = 0;
+            replaceExpDesignator(tmp, 12);
+            ionoutc->alpha2 = atof(tmp);
+
+            strncpy(tmp, str + 38, 12);
+            tmp[12] = 0;
+            replaceExpDesignator(tmp, 12);
+            ionoutc->alpha3 = atof(tmp);
+
+            flags |= 0x1;
+        } else if (strncmp(str + 60, "ION BETA", 8) == 0) {
+            strncpy(tmp, str + 2, 12);
+            tmp[12] = 0;
+            replaceExpDesignator(tmp, 12);
+            ionoutc->beta0 = atof(tmp);
+
+            strncpy(tmp, str + 14, 12);
+            tmp[12] = 0;
+            replaceExpDesignator(tmp, 12);
+            ionoutc->beta1 = atof(tmp);
+
+            strncpy(tmp, str + 26, 12);
+            tmp[12] = 0;
+            replaceExpDesignator(tmp, 12);
+            ionoutc->beta2 = atof(tmp);
+
+            strncpy(tmp, str + 38, 12);
+            tmp[12] = 0;
+            replaceExpDesignator(tmp, 12);
+            ionoutc->beta3 = atof(tmp);
+
+            flags |= 0x1 << 1;
+        } else if (strncmp(str + 60, "DELTA-UTC", 9) == 0) {
+            strncpy(tmp, str + 3, 19);
+            tmp[19] = 0;
+            replaceExpDesignator(tmp, 19);
+            ionoutc->A0 = atof(tmp);
+
+            strncpy(tmp, str + 22, 19);
+            tmp[19] = 0;
+            replaceExpDesignator(tmp, 19);
+            ionoutc->A1 = atof(tmp);
+
+            strncpy(tmp, str + 41, 9);
+            tmp[9] = 0;
+            ionoutc->tot = atoi(tmp);
+
+            strncpy(tmp, str + 50, 9);
+            tmp[9] = 0;
+            ionoutc->wnt = atoi(tmp);
+
+            if (ionoutc->tot % 4096 == 0)
+                flags |= 0x1 << 2;
+        } else if (strncmp(str + 60, "LEAP SECONDS", 12) == 0) {
+            strncpy(tmp, str, 6);
+            tmp[6] = 0;
+            ionoutc->dtls = atoi(tmp);
+
+            flags |= 0x1 << 3;
+        }
+    }
+
+    ionoutc->vflg = false;
+    if (flags == 0xF) // Read all Iono/UTC lines
+        ionoutc->vflg = true;
+
+    // Read ephemeris blocks
+    g0.week = -1;
+    ieph = 0;
+
+    while (1) {
+        if (NULL == gzgets(fp, str, MAX_CHAR))
+            break;
+
+        // PRN
+        strncpy(tmp, str, 2);
+        tmp[2] = 0;
+        sv = atoi(tmp) - 1;
+
+        // EPOCH
+        strncpy(tmp, str + 3, 2);
+        tmp[2] = 0;
+        t.y = atoi(tmp) + 2000;
+
+        strncpy(tmp, str + 6, 2);
+        tmp[2] = 0;
+        t.m = atoi(tmp);
+
+        strncpy(tmp, str + 9, 2);
+        tmp[2] = 0;
+        t.d = atoi(tmp);
+
+        strncpy(tmp, str + 12, 2);
+        tmp[2] = 0;
+        t.hh = atoi(tmp);
+
+        strncpy(tmp, str + 15, 2);
+        tmp[2] = 0;
+        t.mm = atoi(tmp);
+
+        strncpy(tmp, str + 18, 4);
+        tmp[2] = 0;
+        t.sec = atof(tmp);
+
+        date2gps(&t, &g);
+
+        if (g0.week == -1)
+            g0 = g;
+
+        // Check current time of clock
+        dt = subGpsTime(g, g0);
+
+        if (dt > SECONDS_IN_HOUR) {
+            g0 = g;
+            ieph++; // a new set of ephemerides
+
+            if (ieph >= EPHEM_ARRAY_SIZE)
+                break;
+        }
+
+        // Date and time
+        eph[ieph][sv].t = t;
+
+        // SV CLK
+        eph[ieph][sv].toc = g;
+
+        strncpy(tmp, str + 22, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19); // tmp[15]='E';
+        eph[ieph][sv].af0 = atof(tmp);
+
+        strncpy(tmp, str + 41, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].af1 = atof(tmp);
+
+        strncpy(tmp, str + 60, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].af2 = atof(tmp);
+
+        // BROADCAST ORBIT - 1
+        if (NULL == gzgets(fp, str, MAX_CHAR))
+            break;
+
+        strncpy(tmp, str + 3, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].iode = (int) atof(tmp);
+
+        strncpy(tmp, str + 22, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].crs = atof(tmp);
+
+        strncpy(tmp, str + 41, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].deltan = atof(tmp);
+
+        strncpy(tmp, str + 60, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].m0 = atof(tmp);
+
+        // BROADCAST ORBIT - 2
+        if (NULL == gzgets(fp, str, MAX_CHAR))
+            break;
+
+        strncpy(tmp, str + 3, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].cuc = atof(tmp);
+
+        strncpy(tmp, str + 22, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].ecc = atof(tmp);
+
+        strncpy(tmp, str + 41, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].cus = atof(tmp);
+
+        strncpy(tmp, str + 60, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].sqrta = atof(tmp);
+
+        // BROADCAST ORBIT - 3
+        if (NULL == gzgets(fp, str, MAX_CHAR))
+            break;
+
+        strncpy(tmp, str + 3, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].toe.sec = atof(tmp);
+
+        strncpy(tmp, str + 22, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].cic = atof(tmp);
+
+        strncpy(tmp, str + 41, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].omg0 = atof(tmp);
+
+        strncpy(tmp, str + 60, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].cis = atof(tmp);
+
+        // BROADCAST ORBIT - 4
+        if (NULL == gzgets(fp, str, MAX_CHAR))
+            break;
+
+        strncpy(tmp, str + 3, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].inc0 = atof(tmp);
+
+        strncpy(tmp, str + 22, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].crc = atof(tmp);
+
+        strncpy(tmp, str + 41, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].aop = atof(tmp);
+
+        strncpy(tmp, str + 60, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].omgdot = atof(tmp);
+
+        // BROADCAST ORBIT - 5
+        if (NULL == gzgets(fp, str, MAX_CHAR))
+            break;
+
+        strncpy(tmp, str + 3, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].idot = atof(tmp);
+
+        strncpy(tmp, str + 22, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].codeL2 = (int) atof(tmp);
+
+        strncpy(tmp, str + 41, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].toe.week = (int) atof(tmp);
+
+        // BROADCAST ORBIT - 6
+        if (NULL == gzgets(fp, str, MAX_CHAR))
+            break;
+
+        strncpy(tmp, str + 22, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].svhlth = (int) atof(tmp);
+        if ((eph[ieph][sv].svhlth > 0) && (eph[ieph][sv].svhlth < 32))
+            eph[ieph][sv].svhlth += 32; // Set MSB to 1
+
+        strncpy(tmp, str + 41, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].tgd = atof(tmp);
+
+        strncpy(tmp, str + 60, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].iodc = (int) atof(tmp);
+
+        // BROADCAST ORBIT - 7
+        if (NULL == gzgets(fp, str, MAX_CHAR))
+            break;
+
+        // Set valid flag
+        eph[ieph][sv].vflg = true;
+
+        // Update the working variables
+        eph[ieph][sv].A = eph[ieph][sv].sqrta * eph[ieph][sv].sqrta;
+        eph[ieph][sv].n = sqrt(GM_EARTH / (eph[ieph][sv].A * eph[ieph][sv].A * eph[ieph][sv].A)) + eph[ieph][sv].deltan;
+        eph[ieph][sv].sq1e2 = sqrt(1.0 - eph[ieph][sv].ecc * eph[ieph][sv].ecc);
+        eph[ieph][sv].omgkdot = eph[ieph][sv].omgdot - OMEGA_EARTH;
+    }
+
+    gzclose(fp);
+
+    if (g0.week >= 0)
+        ieph += 1; // Number of sets of ephemerides
+
+    return (ieph);
+}
+
+/*! \brief Read Ephemeris data from the RINEX v3 Navigation file */
+
+/*  \param[out] eph Array of Output SV ephemeris data
+ *  \param[in] fname File name of the RINEX file
+ *  \returns Number of sets of ephemerides in the file
+ */
+int readRinex3(ephem_t eph[][MAX_SAT], ionoutc_t *ionoutc, const char *fname) {
+    struct gzFile_s *fp;
+    int ieph;
+
+    int sv;
+    char str[MAX_CHAR];
+    char tmp[20];
+    double ver = 0.0;
+
+    datetime_t t;
+    gpstime_t g;
+    gpstime_t g0;
+    double dt;
+
+    int flags = 0x0;
+
+    if (NULL == (fp = gzopen(fname, "rt")))
+        return (-1);
+
+    // Clear valid flag
+    for (ieph = 0; ieph < EPHEM_ARRAY_SIZE; ieph++)
+        for (sv = 0; sv < MAX_SAT; sv++)
+            eph[ieph][sv].vflg = false;
+    ionoutc->date[0] = '\0';
+
+    // Read header lines
+    while (1) {
+        if (NULL == gzgets(fp, str, MAX_CHAR))
+            break;
+
+        if (strncmp(str + 60, "COMMENT", 7) == 0) {
+            continue;
+        } else if (strncmp(str + 60, "END OF HEADER", 13) == 0) {
+            break;
+        } else if (strncmp(str + 60, "RINEX VERSION / TYPE", 20) == 0) {
+            strncpy(tmp, str, 9);
+            tmp[9] = 0;
+            replaceExpDesignator(tmp, 9);
+            ver = atof(tmp);
+            if (ver < 3.0) {
+                gzclose(fp);
+                return -2;
+            }
+
+            if (str[20] != 'N' && str[40] != 'G') {
+                gzclose(fp);
+                return -3;
+            }
+        } else if (strncmp(str + 60, "PGM / RUN BY / DATE", 19) == 0) {
+            strncpy(ionoutc->date, str + 40, 20);
+            ionoutc->date[20] = 0;
+        } else if (strncmp(str + 60, "IONOSPHERIC CORR", 16) == 0) {
+            if (strncmp(str, "GPSA", 4) == 0) {
+                strncpy(tmp, str + 5, 12);
+                tmp[12] = 0;
+                replaceExpDesignator(tmp, 12);
+                ionoutc->alpha0 = atof(tmp);
+
+                strncpy(tmp, str + 17, 12);
+                tmp[12] = 0;
+                replaceExpDesignator(tmp, 12);
+                ionoutc->alpha1 = atof(tmp);
+
+                strncpy(tmp, str + 29, 12);
+                tmp[12] = 0;
+                replaceExpDesignator(tmp, 12);
+                ionoutc->alpha2 = atof(tmp);
+
+                strncpy(tmp, str + 41, 12);
+                tmp[12] = 0;
+                replaceExpDesignator(tmp, 12);
+                ionoutc->alpha3 = atof(tmp);
+
+                flags |= 0x1;
+            } else if (strncmp(str, "GPSB", 4) == 0) {
+                strncpy(tmp, str + 5, 12);
+                tmp[12] = 0;
+                replaceExpDesignator(tmp, 12);
+                ionoutc->beta0 = atof(tmp);
+
+                strncpy(tmp, str + 17, 12);
+                tmp[12] = 0;
+                replaceExpDesignator(tmp, 12);
+                ionoutc->beta1 = atof(tmp);
+
+                strncpy(tmp, str + 29, 12);
+                tmp[12] = 0;
+                replaceExpDesignator(tmp, 12);
+                ionoutc->beta2 = atof(tmp);
+
+                strncpy(tmp, str + 41, 12);
+                tmp[12] = 0;
+                replaceExpDesignator(tmp, 12);
+                ionoutc->beta3 = atof(tmp);
+
+                flags |= 0x1 << 1;
+            }
+        } else if (strncmp(str + 60, "TIME SYSTEM CORR", 16) == 0 && strncmp(str, "GPUT", 4) == 0) {
+            strncpy(tmp, str + 5, 17);
+            tmp[17] = 0;
+            replaceExpDesignator(tmp, 17);
+            ionoutc->A0 = atof(tmp);
+
+            strncpy(tmp, str + 22, 16);
+            tmp[16] = 0;
+            replaceExpDesignator(tmp, 16);
+            ionoutc->A1 = atof(tmp);
+
+            strncpy(tmp, str + 38, 7);
+            tmp[7] = 0;
+            replaceExpDesignator(tmp, 7);
+            ionoutc->tot = atoi(tmp);
+
+            strncpy(tmp, str + 45, 6);
+            tmp[6] = 0;
+            ionoutc->wnt = atoi(tmp);
+
+            if (ionoutc->tot % 4096 == 0)
+                flags |= 0x1 << 2;
+        } else if (strncmp(str + 60, "LEAP SECONDS", 12) == 0) {
+            strncpy(tmp, str, 6);
+            tmp[6] = 0;
+            ionoutc->dtls = atoi(tmp);
+
+            flags |= 0x1 << 3;
+        }
+    }
+
+    ionoutc->vflg = false;
+    if (flags == 0xF) // Read all Iono/UTC lines
+        ionoutc->vflg = true;
+
+    // Read ephemeris blocks
+    g0.week = -1;
+    ieph = 0;
+
+    while (1) {
+        if (NULL == gzgets(fp, str, MAX_CHAR))
+            break;
+
+        // Check for GPS data record
+        if (str[0] != 'G') {
+            continue;
+        }
+
+        // PRN
+        strncpy(tmp, str + 1, 2);
+        tmp[2] = 0;
+        sv = atoi(tmp) - 1;
+
+        // EPOCH
+        strncpy(tmp, str + 4, 4);
+        tmp[4] = 0;
+        t.y = atoi(tmp);
+
+        strncpy(tmp, str + 9, 2);
+        tmp[2] = 0;
+        t.m = atoi(tmp);
+
+        strncpy(tmp, str + 12, 2);
+        tmp[2] = 0;
+        t.d = atoi(tmp);
+
+        strncpy(tmp, str + 15, 2);
+        tmp[2] = 0;
+        t.hh = atoi(tmp);
+
+        strncpy(tmp, str + 18, 2);
+        tmp[2] = 0;
+        t.mm = atoi(tmp);
+
+        strncpy(tmp, str + 21, 2);
+        tmp[2] = 0;
+        t.sec = (double) atoi(tmp);
+
+        date2gps(&t, &g);
+
+        if (g0.week == -1)
+            g0 = g;
+
+        // Check current time of clock
+        dt = subGpsTime(g, g0);
+
+        if (dt > SECONDS_IN_HOUR) {
+            g0 = g;
+            ieph++; // a new set of ephemerides
+
+            if (ieph >= EPHEM_ARRAY_SIZE)
+                break;
+        }
+
+        // Date and time
+        eph[ieph][sv].t = t;
+
+        // SV CLK
+        eph[ieph][sv].toc = g;
+
+        strncpy(tmp, str + 23, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].af0 = atof(tmp);
+
+        strncpy(tmp, str + 42, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].af1 = atof(tmp);
+
+        strncpy(tmp, str + 61, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].af2 = atof(tmp);
+
+        // BROADCAST ORBIT - 1
+        if (NULL == gzgets(fp, str, MAX_CHAR))
+            break;
+
+        strncpy(tmp, str + 4, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].iode = (int) atof(tmp);
+
+        strncpy(tmp, str + 23, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].crs = atof(tmp);
+
+        strncpy(tmp, str + 42, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].deltan = atof(tmp);
+
+        strncpy(tmp, str + 61, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].m0 = atof(tmp);
+
+        // BROADCAST ORBIT - 2
+        if (NULL == gzgets(fp, str, MAX_CHAR))
+            break;
+
+        strncpy(tmp, str + 4, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].cuc = atof(tmp);
+
+        strncpy(tmp, str + 23, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].ecc = atof(tmp);
+
+        strncpy(tmp, str + 42, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].cus = atof(tmp);
+
+        strncpy(tmp, str + 61, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].sqrta = atof(tmp);
+
+        // BROADCAST ORBIT - 3
+        if (NULL == gzgets(fp, str, MAX_CHAR))
+            break;
+
+        strncpy(tmp, str + 4, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].toe.sec = atof(tmp);
+
+        strncpy(tmp, str + 23, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].cic = atof(tmp);
+
+        strncpy(tmp, str + 42, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].omg0 = atof(tmp);
+
+        strncpy(tmp, str + 61, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].cis = atof(tmp);
+
+        // BROADCAST ORBIT - 4
+        if (NULL == gzgets(fp, str, MAX_CHAR))
+            break;
+
+        strncpy(tmp, str + 4, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].inc0 = atof(tmp);
+
+        strncpy(tmp, str + 23, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].crc = atof(tmp);
+
+        strncpy(tmp, str + 42, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].aop = atof(tmp);
+
+        strncpy(tmp, str + 61, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].omgdot = atof(tmp);
+
+        // BROADCAST ORBIT - 5
+        if (NULL == gzgets(fp, str, MAX_CHAR))
+            break;
+
+        strncpy(tmp, str + 4, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].idot = atof(tmp);
+
+        strncpy(tmp, str + 23, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].codeL2 = (int) atof(tmp);
+
+        strncpy(tmp, str + 42, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].toe.week = (int) atof(tmp);
+
+        // BROADCAST ORBIT - 6
+        if (NULL == gzgets(fp, str, MAX_CHAR))
+            break;
+
+        // SV accuracy not read
+
+        strncpy(tmp, str + 23, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].svhlth = (int) atof(tmp);
+        if ((eph[ieph][sv].svhlth > 0) && (eph[ieph][sv].svhlth < 32))
+            eph[ieph][sv].svhlth += 32; // Set MSB to 1
+
+        strncpy(tmp, str + 42, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].tgd = atof(tmp);
+
+        strncpy(tmp, str + 61, 19);
+        tmp[19] = 0;
+        replaceExpDesignator(tmp, 19);
+        eph[ieph][sv].iodc = (int) atof(tmp);
+
+        // BROADCAST ORBIT - 7
+        if (NULL == gzgets(fp, str, MAX_CHAR))
+            break;
+
+        // Set valid flag
+        eph[ieph][sv].vflg = true;
+
+        // Update the working variables
+        eph[ieph][sv].A = eph[ieph][sv].sqrta * eph[ieph][sv].sqrta;
+        eph[ieph][sv].n = sqrt(GM_EARTH / (eph[ieph][sv].A * eph[ieph][sv].A * eph[ieph][sv].A)) + eph[ieph][sv].deltan;
+        eph[ieph][sv].sq1e2 = sqrt(1.0 - eph[ieph][sv].ecc * eph[ieph][sv].ecc);
+        eph[ieph][sv].omgkdot = eph[ieph][sv].omgdot - OMEGA_EARTH;
+    }
+
+    gzclose(fp);
+
+    if (g0.week >= 0)
+        ieph += 1; // Number of sets of ephemerides
+
+    return (ieph);
+}
+
+static double ionosphericDelay(const ionoutc_t *ionoutc, gpstime_t g, double *llh, double *azel) {
+    double iono_delay = 0.0;
+    double E, phi_u, lam_u, F;
+
+    if (ionoutc->enable == false)
+        return (0.0); // No ionospheric delay
+
+    E = azel[1] / PI;
+    phi_u = llh[0] / PI;
+    lam_u = llh[1] / PI;
+
+    // Obliquity factor
+    F = 1.0 + 16.0 * pow((0.53 - E), 3.0);
+
+    if (ionoutc->vflg == false)
+        iono_delay = F * 5.0e-9 * SPEED_OF_LIGHT;
+    else {
+        double t, psi, phi_i, lam_i, phi_m, phi_m2, phi_m3;
+        double AMP, PER, X, X2, X4;
+
+        // Earth's central angle between the user position and the earth projection of
+        // ionospheric intersection point (semi-circles)
+        psi = 0.0137 / (E + 0.11) - 0.022;
+
+        // Geodetic latitude of the earth projection of the ionospheric intersection point
+        // (semi-circles)
+        phi_i = phi_u + psi * cos(azel[0]);
+        if (phi_i > 0.416)
+            phi_i = 0.416;
+        else if (phi_i<-0.416)
+            phi_i = -0.416;
+
+        // Geodetic longitude of the earth projection of the ionospheric intersection point
+        // (semi-circles)
+        lam_i = lam_u + psi * sin(azel[0]) / cos(phi_i * PI);
+
+        // Geomagnetic latitude of the earth projection of the ionospheric intersection
+        // point (mean ionospheric height assumed 350 km) (semi-circles)
+        phi_m = phi_i + 0.064 * cos((lam_i - 1.617) * PI);
+        phi_m2 = phi_m*phi_m;
+        phi_m3 = phi_m2*phi_m;
+
+        AMP = ionoutc->alpha0 + ionoutc->alpha1 * phi_m
+                + ionoutc->alpha2 * phi_m2 + ionoutc->alpha3*phi_m3;
+        if (AMP < 0.0)
+            AMP = 0.0;
+
+        PER = ionoutc->beta0 + ionoutc->beta1 * phi_m
+                + ionoutc->beta2 * phi_m2 + ionoutc->beta3*phi_m3;
+        if (PER < 72000.0)
+            PER = 72000.0;
+
+        // Local time (sec)
+        t = SECONDS_IN_DAY / 2.0 * lam_i + g.sec;
+        while (t >= SECONDS_IN_DAY)
+            t -= SECONDS_IN_DAY;
+        while (t < 0)
+            t += SECONDS_IN_DAY;
+
+        // Phase (radians)
+        X = 2.0 * PI * (t - 50400.0) / PER;
+
+        if (fabs(X) < 1.57) {
+            X2 = X*X;
+            X4 = X2*X2;
+            iono_delay = F * (5.0e-9 + AMP * (1.0 - X2 / 2.0 + X4 / 24.0)) * SPEED_OF_LIGHT;
+        } else
+            iono_delay = F * 5.0e-9 * SPEED_OF_LIGHT;
+    }
+
+    return (iono_delay);
+}
+
+/*! \brief Compute range between a satellite state and the receiver
+ *  \param[out] rho The computed range
+ *  \param[in] sv Satellite position, velocity and clock at \a g
+ *  \param[in] g GPS time at time of receiving the signal
+ *  \param[in] xyz position of the receiver
+ */
+void rangeFromState(range_t *rho, const svstate_t *sv, ionoutc_t *ionoutc, gpstime_t g, double xyz[]) {
+    double pos[3];
+    const double *vel = sv->vel, *clk = sv->clk;
+    double los[3];
+    double tau;
+    double range, rate;
+    double xrot, yrot;
+
+    double llh[3], neu[3];
+    double tmat[3][3];
+
+    // SV position at time of the pseudorange observation.
+    pos[0] = sv->pos[0];
+    pos[1] = sv->pos[1];
+    pos[2] = sv->pos[2];
+
+    // Receiver to satellite vector and light-time.
+    subVect(los, pos, xyz);
+    tau = normVect(los) / SPEED_OF_LIGHT;
+
+    // Extrapolate the satellite position backwards to the transmission time.
+    pos[0] -= vel[0] * tau;
+    pos[1] -= vel[1] * tau;
+    pos[2] -= vel[2] * tau;
+
+    // Earth rotation correction. The change in velocity can be neglected.
+    xrot = pos[0] + pos[1] * OMEGA_EARTH*tau;
+    yrot = pos[1] - pos[0] * OMEGA_EARTH*tau;
+    pos[0] = xrot;
+    pos[1] = yrot;
+
+    // New observer to satellite vector and satellite range.
+    subVect(los, pos, xyz);
+    range = normVect(los);
+    rho->d = range;
+
+    // Pseudorange.
+    rho->range = range - SPEED_OF_LIGHT * clk[0];
+
+    // Relative velocity of SV and receiver.
+    rate = dotProd(vel, los) / range;
+
+    // Pseudorange rate.
+    rho->rate = rate; // - SPEED_OF_LIGHT*clk[1];
+
+    // Time of application.
+    rho->g = g;
+
+    // Azimuth and elevation angles.
+    xyz2llh(xyz, llh);
+    ltcmat(llh, tmat);
+    ecef2neu(los, tmat, neu);
+    neu2azel(rho->azel, neu);
+
+    // Add ionospheric delay
+    rho->iono_delay = ionosphericDelay(ionoutc, g, llh, rho->azel);
+    rho->range += rho->iono_delay;
+
+    return;
+}
+
+/*! \brief Compute the code phase for a given channel (satellite)
+ *  \param chan Channel on which we operate (is updated)
+ *  \param[in] rho1 Current range, after \a dt has expired
+ *  \param[in dt delta-t (time difference) in seconds
+ */
+static void computeCodePhase(channel_t *chan, range_t rho1, double dt) {
+    double ms, phase;
+    int ims;
+    double rhorate;
+
+    // Pseudorange rate.
+    rhorate = (rho1.range - chan->rho0.range) / dt;
+
+    // Carrier and code frequency.
+    chan->f_carr = -rhorate / LAMBDA_L1;
+    chan->f_code = CODE_FREQ + chan->f_carr*CARR_TO_CODE;
+
+    // Initial code phase and data bit counters.
+    ms = ((subGpsTime(chan->rho0.g, chan->g0) + 6.0) - chan->rho0.range / SPEED_OF_LIGHT)*1000.0;
+
+    ims = (int) ms;
+    chan->code_phase = (ms - (double) ims) * CA_SEQ_LEN; // in chip
+
+    chan->iword = ims / 600; // 1 word = 30 bits = 600 ms
+    ims -= chan->iword * 600;
+
+    chan->ibit = ims / 20; // 1 bit = 20 code = 20 ms
+    ims -= chan->ibit * 20;
+
+    chan->icode = ims; // 1 code = 1 ms
+
+    chan->codeCA = chan->ca[(int) chan->code_phase];
+    chan->dataBit = (int) ((chan->dwrd[chan->iword]>>(29 - chan->ibit)) & 0x1UL)*2 - 1;
+
+    // Carrier phase follows the pseudorange, it is not integrated from block to block
+    phase = (chan->carr_ref - chan->rho0.range) / LAMBDA_L1;
+    phase -= floor(phase);
+#ifdef FLOAT_CARR_PHASE
+    chan->carr_phase = phase;
+#else
+    chan->carr_phase = (unsigned int) (512.0 * 65536.0 * phase);
+#endif
+
+    // Save current pseudorange
+    chan->rho0 = rho1;
+
+    return;
+}
+
+/*! \brief Carrier phase of a channel
+ *  \param[in] chan Channel
+ *  \returns Carrier phase in cycles, 0 <= phase < 1
+ */
+double carrierPhase(const channel_t *chan) {
+#ifdef FLOAT_CARR_PHASE
+    return (chan->carr_phase);
+#else
+    return ((double) (chan->carr_phase & 0x1ffffff) / 33554432.0); // 512 * 65536 per cycle
+#endif
+}
+
+/*! \brief Apply the fixed-point channel gain to a sin/cos table value, rounded */
+static inline int gainMul(int v, int32_t gain_q) {
+    return ((int) (((int64_t) v * gain_q + (1 << (GAIN_FRAC_BITS - 1))) >> GAIN_FRAC_BITS));
+}
+
+/*! \brief Advance a channel to the next C/A code period and update the data bit
+ *  \param chan Channel
+ */
+static void nextCodePeriod(channel_t *chan) {
+    chan->icode++;
+
+    if (chan->icode >= 20) // 20 C/A codes = 1 navigation data bit
+    {
+        chan->icode = 0;
+        chan->ibit++;
+
+        if (chan->ibit >= 30) // 30 navigation data bits = 1 word
+        {
+            chan->ibit = 0;
+            chan->iword++;
+        }
+
+        // Set new navigation data bit
+        chan->dataBit = (int) ((chan->dwrd[chan->iword]>>(29 - chan->ibit)) & 0x1UL)*2 - 1;
+    }
+
+    return;
+}
+
+/*! \brief Advance code phase, data bit and carrier phase of a channel by one sample
+ *  \param chan Channel
+ *  \param[in] delt Sample period in seconds
+ */
+static inline void stepChannel(channel_t *chan, double delt) {
+    // Update code phase
+    chan->code_phase += chan->f_code * delt;
+
+    if (chan->code_phase >= CA_SEQ_LEN) {
+        chan->code_phase -= CA_SEQ_LEN;
+        nextCodePeriod(chan);
+    }
+
+    // Set current code chip
+    chan->codeCA = chan->ca[(int) chan->code_phase];
+
+    // Update carrier phase
+#ifdef FLOAT_CARR_PHASE
+    chan->carr_phase += chan->f_carr * delt;
+
+    if (chan->carr_phase >= 1.0)
+        chan->carr_phase -= 1.0;
+    else if (chan->carr_phase < 0.0)
+        chan->carr_phase += 1.0;
+#else
+    chan->carr_phase += chan->carr_phasestep;
+#endif
+
+    return;
+}
+
+/*! \brief Generate a block of baseband samples for all allocated channels
+ *  \param chan Array of channels (phase and data bit state is updated)
+ *  \param[in] nchan Number of channels in \a chan
+ *  \param[out] acc Interleaved I/Q accumulator, 2 * \a nsamp values, see packSamples()
+ *  \param[in] nsamp Number of samples to generate
+ *  \param[in] delt Sample period in seconds
+ *  \param[in] carr Carrier table
+ *  \param work Chip buffer of the phasor kernels, unused
+ */
+void generateSamples(channel_t *chan, int nchan, int32_t *acc, int nsamp, double delt,
+        const struct carrier_table *carr, float *work) {
+    int i, k, isamp;
+    int ip, qp;
+    int iTable;
+    int active[MAX_CHAN];
+    int nactive = 0;
+
+    NOTUSED(work);
+
+    // Compact list of allocated channels, cost scales with active channels only
+    for (i = 0; i < nchan && nactive < MAX_CHAN; i++) {
+        if (chan[i].prn > 0)
+            active[nactive++] = i;
+    }
+
+    for (isamp = 0; isamp < nsamp; isamp++) {
+        int32_t i_acc = 0;
+        int32_t q_acc = 0;
+
+        for (k = 0; k < nactive; k++) {
+            i = active[k];
+
+#ifdef FLOAT_CARR_PHASE
+            iTable = (int) floor(chan[i].carr_phase * carr->size);
+#else
+            iTable = (chan[i].carr_phase >> (25 - carr->bits)) & (carr->size - 1);
+#endif
+            ip = chan[i].dataBit * chan[i].codeCA * gainMul(carr->cos[iTable], chan[i].gain_q);
+            qp = chan[i].dataBit * chan[i].codeCA * gainMul(carr->sin[iTable], chan[i].gain_q);
+
+            // Accumulate for all visible satellites
+            i_acc += ip;
+            q_acc += qp;
+
+            // Update code phase, data bit and carrier phase
+            stepChannel(&chan[i], delt);
+        }
+
+        // Store I/Q sums into accumulator
+        acc[isamp * 2] = i_acc;
+        acc[isamp * 2 + 1] = q_acc;
+    }
+
+    return;
+}
+
+/*! \brief Render the code template of a channel at its current code frequency
+ *
+ * Row p holds the code chip of every sample over one code period, starting
+ * p/CODE_TMPL_PHASES samples after the first chip edge. Two guard samples
+ * continue into the next period.
+ *  \param chan Channel
+ *  \param[in] delt Sample period in seconds
+ *  \returns 0 on success, -1 on allocation error
+ */
+static int renderCodeTemplate(channel_t *chan, double delt) {
+    double step = chan->f_code * delt;
+    int len = (int) ceil(CA_SEQ_LEN / step) + 2;
+    signed char *row;
+    int p, j;
+
+    if (len != chan->tmpl_len || chan->tmpl == NULL) {
+        free(chan->tmpl);
+        chan->tmpl = malloc((size_t) len * CODE_TMPL_PHASES);
+        if (chan->tmpl == NULL) {
+            chan->tmpl_len = 0;
+            return (-1);
+        }
+        chan->tmpl_len = len;
+    }
+
+    for (p = 0; p < CODE_TMPL_PHASES; p++) {
+        row = chan->tmpl + p * len;
+        for (j = 0; j < len; j++)
+            row[j] = chan->ca[(long) ((j + (double) p / CODE_TMPL_PHASES) * step) % CA_SEQ_LEN];
+    }
+
+    chan->tmpl_prn = chan->prn;
+    chan->tmpl_f_code = chan->f_code;
+
+    return (0);
+}
+
+/*! \brief Render code templates of new channels and of channels whose code
+ *  frequency drifted away from their template
+ *  \param chan Array of channels
+ *  \param[in] nchan Number of channels in \a chan
+ *  \param[in] delt Sample period in seconds
+ *  \param[in] bound Max. code frequency drift in Hz before a template is rendered again
+ *  \returns 0 on success, -1 on allocation error
+ */
+int refreshCodeTemplates(channel_t *chan, int nchan, double delt, double bound) {
+    int i;
+
+    for (i = 0; i < nchan; i++) {
+        if (chan[i].prn == 0)
+            continue;
+        if (chan[i].tmpl == NULL || chan[i].tmpl_prn != chan[i].prn
+                || fabs(chan[i].f_code - chan[i].tmpl_f_code) > bound) {
+            if (renderCodeTemplate(&chan[i], delt) != 0)
+                return (-1);
+        }
+    }
+
+    return (0);
+}
+
+/*! \brief Release code templates of all channels */
+void freeCodeTemplates(channel_t *chan, int nchan) {
+    int i;
+
+    for (i = 0; i < nchan; i++) {
+        free(chan[i].tmpl);
+        chan[i].tmpl = NULL;
+        chan[i].tmpl_len = 0;
+    }
+
+    return;
+}
+
+/*! \brief Code template read position of one channel inside a block */
+typedef struct {
+    const signed char *row; /*!< Template row matching the sub-sample offset */
+    int j; /*!< Next sample in row */
+    int end; /*!< Sample in row where the code period ends */
+    int n; /*!< Block sample of last exact code phase */
+    double cp; /*!< Exact code phase at sample n */
+    double step; /*!< Exact code phase increment per sample */
+} code_pos_t;
+
+/*! \brief Seat the template read position on the exact code phase */
+static void seatCodeTemplate(const channel_t *chan, code_pos_t *pos, double delt) {
+    double tstep = chan->tmpl_f_code * delt;
+    double s = pos->cp / tstep;
+    int p;
+
+    pos->j = (int) s;
+    p = (int) ((s - pos->j) * CODE_TMPL_PHASES + 0.5);
+    if (p == CODE_TMPL_PHASES) {
+        pos->j++;
+        p = 0;
+    }
+    pos->row = chan->tmpl + p * chan->tmpl_len;
+    pos->end = (int) ceil(CA_SEQ_LEN / tstep - (double) p / CODE_TMPL_PHASES);
+
+    return;
+}
+
+/*! \brief Start reading the code template of a channel at the beginning of a block */
+static void codeTmplStart(const channel_t *chan, code_pos_t *pos, double delt) {
+    pos->n = 0;
+    pos->cp = chan->code_phase;
+    pos->step = chan->f_code * delt;
+    seatCodeTemplate(chan, pos, delt);
+
+    return;
+}
+
+/*! \brief Read the code chip of block sample \a isamp from the code template */
+static inline int codeTmplChip(channel_t *chan, code_pos_t *pos, int isamp, double delt) {
+    double cp;
+
+    if (pos->j >= pos->end) {
+        // End of code period, resynchronize on exact code phase
+        cp = pos->cp + (isamp - pos->n) * pos->step;
+        if (cp >= CA_SEQ_LEN) {
+            cp -= CA_SEQ_LEN;
+            nextCodePeriod(chan);
+        }
+        pos->cp = cp;
+        pos->n = isamp;
+        seatCodeTemplate(chan, pos, delt);
+    }
+
+    return (pos->row[pos->j++]);
+}
+
+/*! \brief Store the exact code phase after a block of \a nsamp samples */
+static void codeTmplEnd(channel_t *chan, const code_pos_t *pos, int nsamp) {
+    double cp = pos->cp + (nsamp - pos->n) * pos->step;
+
+    if (cp >= CA_SEQ_LEN) {
+        cp -= CA_SEQ_LEN;
+        nextCodePeriod(chan);
+    }
+    chan->code_phase = cp;
+    chan->codeCA = chan->ca[(int) cp];
+
+    return;
+}
+
+/*! \brief Generate a block of baseband samples reading the C/A code from
+ *  pre-resampled code templates, see refreshCodeTemplates()
+ *
+ * The exact code phase is recomputed once per code period, the sub-sample
+ * alignment error is at most 1/(2*CODE_TMPL_PHASES) sample.
+ *  \param chan Array of channels (phase and data bit state is updated)
+ *  \param[in] nchan Number of channels in \a chan
+ *  \param[out] acc Interleaved I/Q accumulator, 2 * \a nsamp values, see packSamples()
+ *  \param[in] nsamp Number of samples to generate
+ *  \param[in] delt Sample period in seconds
+ *  \param[in] carr Carrier table
+ *  \param work Chip buffer of the phasor kernels, unused
+ */
+void generateSamplesTmpl(channel_t *chan, int nchan, int32_t *acc, int nsamp, double delt,
+        const struct carrier_table *carr, float *work) {
+    int i, k, isamp;
+    int ip, qp;
+    int iTable;
+    int active[MAX_CHAN];
+    code_pos_t pos[MAX_CHAN];
+    int nactive = 0;
+
+    NOTUSED(work);
+
+    for (i = 0; i < nchan && nactive < MAX_CHAN; i++) {
+        if (chan[i].prn > 0 && chan[i].tmpl != NULL) {
+            codeTmplStart(&chan[i], &pos[nactive], delt);
+            active[nactive++] = i;
+        }
+    }
+
+    for (isamp = 0; isamp < nsamp; isamp++) {
+        int32_t i_acc = 0;
+        int32_t q_acc = 0;
+
+        for (k = 0; k < nactive; k++) {
+            i = active[k];
+
+            chan[i].codeCA = codeTmplChip(&chan[i], &pos[k], isamp, delt);
+
+#ifdef FLOAT_CARR_PHASE
+            iTable = (int) floor(chan[i].carr_phase * carr->size);
+#else
+            iTable = (chan[i].carr_phase >> (25 - carr->bits)) & (carr->size - 1);
+#endif
+            ip = chan[i].dataBit * chan[i].codeCA * gainMul(carr->cos[iTable], chan[i].gain_q);
+            qp = chan[i].dataBit * chan[i].codeCA * gainMul(carr->sin[iTable], chan[i].gain_q);
+
+            // Accumulate for all visible satellites
+            i_acc += ip;
+            q_acc += qp;
+
+            // Update carrier phase
+#ifdef FLOAT_CARR_PHASE
+            chan[i].carr_phase += chan[i].f_carr * delt;
+
+            if (chan[i].carr_phase >= 1.0)
+                chan[i].carr_phase -= 1.0;
+            else if (chan[i].carr_phase < 0.0)
+                chan[i].carr_phase += 1.0;
+#else
+            chan[i].carr_phase += chan[i].carr_phasestep;
+#endif
+        }
+
+        // Store I/Q sums into accumulator
+        acc[isamp * 2] = i_acc;
+        acc[isamp * 2 + 1] = q_acc;
+    }
+
+    // Exact code phase at end of block
+    for (k = 0; k < nactive; k++)
+        codeTmplEnd(&chan[active[k]], &pos[k], nsamp);
+
+    return;
+}
+
+/*! \brief Accumulate one sample of all channels and rotate their phasors
+ *
+ * Vectorized with SSE2 or NEON across channels. The scalar path keeps the
+ * same PHASOR_LANES partial sums and adds them in the same order, so the
+ * result does not depend on the instruction set.
+ *  \param[in] c Signed amplitude of each channel
+ *  \param re Phasor real parts (is updated)
+ *  \param im Phasor imaginary parts (is updated)
+ *  \param[in] wr Real parts of the phase increment per sample
+ *  \param[in] wi Imaginary parts of the phase increment per sample
+ *  \param[in] nlane Number of channels, a multiple of PHASOR_LANES
+ *  \param[out] iq Sums of I and Q over all channels
+ */
+static inline void phasorStep(const float *c, float *re, float *im, const float *wr, const float *wi, int nlane,
+        float *iq) {
+    int k;
+
+#if defined(__SSE2__)
+    __m128 si = _mm_setzero_ps();
+    __m128 sq = _mm_setzero_ps();
+
+    for (k = 0; k < nlane; k += PHASOR_LANES) {
+        __m128 vc = _mm_loadu_ps(c + k);
+        __m128 vr = _mm_loadu_ps(re + k);
+        __m128 vi = _mm_loadu_ps(im + k);
+        __m128 vwr = _mm_loadu_ps(wr + k);
+        __m128 vwi = _mm_loadu_ps(wi + k);
+
+        si = _mm_add_ps(si, _mm_mul_ps(vc, vr));
+        sq = _mm_add_ps(sq, _mm_mul_ps(vc, vi));
+        _mm_storeu_ps(re + k, _mm_sub_ps(_mm_mul_ps(vr, vwr), _mm_mul_ps(vi, vwi)));
+        _mm_storeu_ps(im + k, _mm_add_ps(_mm_mul_ps(vr, vwi), _mm_mul_ps(vi, vwr)));
+    }
+
+    // Lanes 0+2 and 1+3 first, then both halves
+    si = _mm_add_ps(si, _mm_movehl_ps(si, si));
+    sq = _mm_add_ps(sq, _mm_movehl_ps(sq, sq));
+    iq[0] = _mm_cvtss_f32(_mm_add_ss(si, _mm_shuffle_ps(si, si, 1)));
+    iq[1] = _mm_cvtss_f32(_mm_add_ss(sq, _mm_shuffle_ps(sq, sq, 1)));
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    float32x4_t si = vdupq_n_f32(0.0f);
+    float32x4_t sq = vdupq_n_f32(0.0f);
+    float32x2_t hi, hq;
+
+    for (k = 0; k < nlane; k += PHASOR_LANES) {
+        float32x4_t vc = vld1q_f32(c + k);
+        float32x4_t vr = vld1q_f32(re + k);
+        float32x4_t vi = vld1q_f32(im + k);
+        float32x4_t vwr = vld1q_f32(wr + k);
+        float32x4_t vwi = vld1q_f32(wi + k);
+
+        // Separate multiply and add, a fused multiply-add rounds differently
+        si = vaddq_f32(si, vmulq_f32(vc, vr));
+        sq = vaddq_f32(sq, vmulq_f32(vc, vi));
+        vst1q_f32(re + k, vsubq_f32(vmulq_f32(vr, vwr), vmulq_f32(vi, vwi)));
+        vst1q_f32(im + k, vaddq_f32(vmulq_f32(vr, vwi), vmulq_f32(vi, vwr)));
+    }
+
+    // Lanes 0+2 and 1+3 first, then both halves
+    hi = vadd_f32(vget_low_f32(si), vget_high_f32(si));
+    hq = vadd_f32(vget_low_f32(sq), vget_high_f32(sq));
+    iq[0] = vget_lane_f32(hi, 0) + vget_lane_f32(hi, 1);
+    iq[1] = vget_lane_f32(hq, 0) + vget_lane_f32(hq, 1);
+#else
+    float si[PHASOR_LANES] = {0.0f};
+    float sq[PHASOR_LANES] = {0.0f};
+    float t;
+
+    for (k = 0; k < nlane; k++) {
+        si[k % PHASOR_LANES] += c[k] * re[k];
+        sq[k % PHASOR_LANES] += c[k] * im[k];
+
+        t = re[k] * wr[k] - im[k] * wi[k];
+        im[k] = re[k] * wi[k] + im[k] * wr[k];
+        re[k] = t;
+    }
+
+    iq[0] = (si[0] + si[2]) + (si[1] + si[3]);
+    iq[1] = (sq[0] + sq[2]) + (sq[1] + sq[3]);
+#endif
+
+    return;
+}
+
+/*! \brief Generate a block of baseband samples with a float32 phasor recursion carrier
+ *
+ * Each channel rotates a complex phasor by its carrier phase increment per
+ * sample. The code chips of a sub-block are resolved first, the rotation and
+ * accumulation then runs on plain float arrays across all channels, padded to
+ * whole PHASOR_LANES groups with zero phasors.
+ * The phasors start from the exact carrier phase of every block.
+ *  \param chan Array of channels (phase and data bit state is updated)
+ *  \param[in] nchan Number of channels in \a chan
+ *  \param[out] acc Interleaved I/Q accumulator, 2 * \a nsamp values, see packSamples()
+ *  \param[in] nsamp Number of samples to generate
+ *  \param[in] delt Sample period in seconds
+ *  \param[in] carr Carrier table, sets the amplitude
+ *  \param chip Chip buffer of PHASOR_WORK floats
+ *  \param[in] tmpl Read C/A code from code templates
+ */
+static void phasorKernel(channel_t *chan, int nchan, int32_t *acc, int nsamp, double delt,
+        const struct carrier_table *carr, float *chip, bool tmpl) {
+    int i, k, n, isamp, nsub, nlane;
+    int active[MAX_CHAN];
+    code_pos_t pos[MAX_CHAN];
+    float re[MAX_CHAN], im[MAX_CHAN], wr[MAX_CHAN], wi[MAX_CHAN], amp[MAX_CHAN];
+    float sum[2];
+    int nactive = 0;
+    double step, phase;
+    float g;
+
+    for (i = 0; i < nchan && nactive < MAX_CHAN; i++) {
+        if (chan[i].prn == 0 || (tmpl && chan[i].tmpl == NULL))
+            continue;
+
+        if (tmpl)
+            codeTmplStart(&chan[i], &pos[nactive], delt);
+
+        phase = 2.0 * PI * carrierPhase(&chan[i]);
+        re[nactive] = (float) cos(phase);
+        im[nactive] = (float) sin(phase);
+        phase = 2.0 * PI * chan[i].f_carr * delt;
+        wr[nactive] = (float) cos(phase);
+        wi[nactive] = (float) sin(phase);
+        amp[nactive] = (float) (carr->ampl * chan[i].gain_q / (1 << GAIN_FRAC_BITS));
+        active[nactive++] = i;
+    }
+
+    // Padding lanes rotate a zero phasor with zero amplitude
+    nlane = (nactive + PHASOR_LANES - 1) / PHASOR_LANES * PHASOR_LANES;
+    for (k = nactive; k < nlane; k++) {
+        re[k] = im[k] = wr[k] = wi[k] = 0.0f;
+        for (n = 0; n < PHASOR_SUB; n++)
+            chip[n * nlane + k] = 0.0f;
+    }
+
+    for (isamp = 0; isamp < nsamp; isamp += nsub) {
+        nsub = (nsamp - isamp < PHASOR_SUB) ? nsamp - isamp : PHASOR_SUB;
+
+        // Signed amplitude of every channel, data bit and code chip applied
+        for (k = 0; k < nactive; k++) {
+            i = active[k];
+
+            if (tmpl) {
+                for (n = 0; n < nsub; n++)
+                    chip[n * nlane + k] = amp[k] * chan[i].dataBit * codeTmplChip(&chan[i], &pos[k], isamp + n, delt);
+                continue;
+            }
+
+            step = chan[i].f_code * delt;
+            for (n = 0; n < nsub; n++) {
+                chip[n * nlane + k] = amp[k] * chan[i].dataBit * chan[i].codeCA;
+
+                // Update code phase
+                chan[i].code_phase += step;
+
+                if (chan[i].code_phase >= CA_SEQ_LEN) {
+                    chan[i].code_phase -= CA_SEQ_LEN;
+                    nextCodePeriod(&chan[i]);
+                }
+
+                // Set current code chip
+                chan[i].codeCA = chan[i].ca[(int) chan[i].code_phase];
+            }
+        }
+
+        // Rotate carriers and accumulate, no dependency between channels
+        for (n = 0; n < nsub; n++) {
+            phasorStep(&chip[n * nlane], re, im, wr, wi, nlane, sum);
+
+            // Store I/Q sums into accumulator
+            acc[(isamp + n) * 2] = (int32_t) lrintf(sum[0]);
+            acc[(isamp + n) * 2 + 1] = (int32_t) lrintf(sum[1]);
+        }
+
+        // Keep phasor magnitude at one, first order correction is sufficient
+        for (k = 0; k < nactive; k++) {
+            g = 1.5f - 0.5f * (re[k] * re[k] + im[k] * im[k]);
+            re[k] *= g;
+            im[k] *= g;
+        }
+    }
+
+    for (k = 0; k < nactive; k++) {
+        i = active[k];
+
+        if (tmpl)
+            codeTmplEnd(&chan[i], &pos[k], nsamp);
+
+        // Exact carrier phase at end of block
+#ifdef FLOAT_CARR_PHASE
+        chan[i].carr_phase += chan[i].f_carr * delt * nsamp;
+        chan[i].carr_phase -= floor(chan[i].carr_phase);
+#else
+        chan[i].carr_phase += chan[i].carr_phasestep * (unsigned int) nsamp;
+#endif
+    }
+
+    return;
+}
+
+/*! \brief Phasor carrier kernel with C/A code computed per sample, see phasorKernel() */
+void generateSamplesPhasor(channel_t *chan, int nchan, int32_t *acc, int nsamp, double delt,
+        const struct carrier_table *carr, float *work) {
+    phasorKernel(chan, nchan, acc, nsamp, delt, carr, work, false);
+}
+
+/*! \brief Phasor carrier kernel with C/A code from code templates, see phasorKernel() */
+void generateSamplesPhasorTmpl(channel_t *chan, int nchan, int32_t *acc, int nsamp, double delt,
+        const struct carrier_table *carr, float *work) {
+    phasorKernel(chan, nchan, acc, nsamp, delt, carr, work, true);
+}
+
+/*! \brief Seat the echoes of all allocated channels at the start of a block
+ *
+ * Called with the channel state at the start of the block. The echo phase
+ * is derived from the block counter, so blocks render independently.
+ *  \param[in] sig Signal model with the echoes
+ *  \param[in] chan Array of channels
+ *  \param[in] nchan Number of channels in \a chan
+ *  \param[out] pos Echo read positions, MAX_ECHOES entries
+ *  \param[in] delt Sample period in seconds
+ *  \param[in] iblock Block counter since start
+ *  \returns Number of echoes to render
+ */
+int echoStart(const struct signal_model *sig, const channel_t *chan, int nchan, echo_pos_t *pos, double delt,
+        long iblock) {
+    const echo_t *ec;
+    echo_pos_t *ep;
+    double phase, q;
+    int i, j, n = 0;
+
+    for (j = 0; j < sig->necho; j++) {
+        ec = &sig->echo[j];
+        for (i = 0; i < nchan && chan[i].prn != ec->prn; i++)
+            ;
+        if (i == nchan)
+            continue;
+
+        ep = &pos[n++];
+        ep->chan = &chan[i];
+        ep->iword = chan[i].iword;
+        ep->ibit = chan[i].ibit;
+        ep->icode = chan[i].icode;
+        ep->code_phase = chan[i].code_phase - ec->delay * CODE_FREQ / SPEED_OF_LIGHT;
+        if (ep->code_phase < 0.0) {
+            // Echo is still in the previous code period
+            ep->code_phase += CA_SEQ_LEN;
+            if (--ep->icode < 0) {
+                ep->icode = 19;
+                if (--ep->ibit < 0) {
+                    ep->ibit = 29;
+                    if (--ep->iword < 0) {
+                        // Last bit of the word before, kept as D30* in bit 30 of the first word
+                        ep->iword = 0;
+                        ep->ibit = -1;
+                    }
+                }
+            }
+        }
+        ep->dataBit = (int) ((chan[i].dwrd[ep->iword]>>(29 - ep->ibit)) & 0x1UL)*2 - 1;
+
+        // Excess path, phase offset and Doppler offset accumulated since start
+        phase = ec->phase - ec->delay / LAMBDA_L1 + ec->doppler * 0.1 * (double) iblock;
+        phase -= floor(phase);
+#ifdef FLOAT_CARR_PHASE
+        ep->carr_phase = chan[i].carr_phase + phase;
+        ep->carr_phase -= floor(ep->carr_phase);
+        ep->carr_step = (chan[i].f_carr + ec->doppler) * delt;
+#else
+        ep->carr_phase = chan[i].carr_phase + (unsigned int) (512.0 * 65536.0 * phase);
+        ep->carr_phasestep = chan[i].carr_phasestep + (int) round(512.0 * 65536.0 * ec->doppler * delt);
+#endif
+        // Channel gains are bounded by maxChannelGain(), this only catches rounding
+        q = (double) chan[i].gain_q * ec->gain;
+        ep->gain_q = (q > INT32_MAX) ? INT32_MAX : (int32_t) lrint(q);
+    }
+
+    return (n);
+}
+
+/*! \brief Add multipath echoes to a generated block
+ *
+ * One code phase step, chip and table lookup per echo and sample, the data
+ * bit only changes at code period boundaries.
+ *  \param pos Echo read positions set by echoStart()
+ *  \param[in] necho Number of echoes
+ *  \param acc Interleaved I/Q accumulator, 2 * \a nsamp values
+ *  \param[in] nsamp Number of samples
+ *  \param[in] delt Sample period in seconds
+ *  \param[in] carr Carrier table
+ */
+void echoRender(echo_pos_t *pos, int necho, int32_t *acc, int nsamp, double delt, const struct carrier_table *carr) {
+    echo_pos_t *ep;
+    const signed char *ca;
+    double step;
+    int k, isamp, iTable, chip;
+
+    for (k = 0; k < necho; k++) {
+        ep = &pos[k];
+        ca = ep->chan->ca;
+        step = ep->chan->f_code * delt;
+
+        for (isamp = 0; isamp < nsamp; isamp++) {
+#ifdef FLOAT_CARR_PHASE
+            iTable = (int) floor(ep->carr_phase * carr->size);
+#else
+            iTable = (ep->carr_phase >> (25 - carr->bits)) & (carr->size - 1);
+#endif
+            chip = ep->dataBit * ca[(int) ep->code_phase];
+            acc[isamp * 2] += chip * gainMul(carr->cos[iTable], ep->gain_q);
+            acc[isamp * 2 + 1] += chip * gainMul(carr->sin[iTable], ep->gain_q);
+
+            ep->code_phase += step;
+            if (ep->code_phase >= CA_SEQ_LEN) {
+                ep->code_phase -= CA_SEQ_LEN;
+                if (++ep->icode >= 20) {
+                    ep->icode = 0;
+                    if (++ep->ibit >= 30) {
+                        ep->ibit = 0;
+                        ep->iword++;
+                    }
+                    ep->dataBit = (int) ((ep->chan->dwrd[ep->iword]>>(29 - ep->ibit)) & 0x1UL)*2 - 1;
+                }
+            }
+
+#ifdef FLOAT_CARR_PHASE
+            ep->carr_phase += ep->carr_step;
+
+            if (ep->carr_phase >= 1.0)
+                ep->carr_phase -= 1.0;
+            else if (ep->carr_phase < 0.0)
+                ep->carr_phase += 1.0;
+#else
+            ep->carr_phase += ep->carr_phasestep;
+#endif
+        }
+    }
+
+    return;
+}
+
+/*! \brief Read the list of user motions from the input file
+ *  \param[out] xyz Output array of ECEF vectors for user motion
+ *  \param[[in] filename File name of the text input file
+ *  \returns Number of user data motion records read, -1 on error
+ */
+int readUserMotion(double xyz[USER_MOTION_SIZE][3], const char *filename) {
+    FILE *fp;
+    int numd;
+    char str[MAX_CHAR];
+    double t, x, y, z;
+
+    if (NULL == (fp = fopen(filename, "rt")))
+        return (-1);
+
+    for (numd = 0; numd < USER_MOTION_SIZE; numd++) {
+        if (fgets(str, MAX_CHAR, fp) == NULL)
+            break;
+
+        if (EOF == sscanf(str, "%lf,%lf,%lf,%lf", &t, &x, &y, &z)) // Read CSV line
+            break;
+
+        xyz[numd][0] = x;
+        xyz[numd][1] = y;
+        xyz[numd][2] = z;
+    }
+
+    fclose(fp);
+
+    return (numd);
+}
+
+/*! \brief Generate the data words of the navigation frame starting at or before \a g
+ *  \param[in] g GPS time within the frame
+ *  \param nav Navigation message, subframes set by eph2sbf()
+ *  \param[in] init 1 = first frame, else continue the previous frame
+ */
+int generateNavMsg(gpstime_t g, navmsg_t *nav, int init) {
+    int iwrd, isbf;
+    gpstime_t g0;
+    unsigned long wn, tow;
+    unsigned sbfwrd;
+    unsigned long prevwrd;
+    int nib;
+
+    g0.week = g.week;
+    g0.sec = (double) (((unsigned long) (g.sec + 0.5)) / 30UL) * 30.0; // Align with the full frame length = 30 sec
+    nav->g0 = g0; // Data bit reference time
+    nav->valid = true;
+
+    wn = (unsigned long) (g0.week % 1024);
+    tow = ((unsigned long) g0.sec) / 6UL;
+
+    if (init == 1) // Initialize subframe 5
+    {
+        prevwrd = 0UL;
+
+        for (iwrd = 0; iwrd < N_DWRD_SBF; iwrd++) {
+            sbfwrd = nav->sbf[4][iwrd];
+
+            // Add TOW-count message into HOW
+            if (iwrd == 1)
+                sbfwrd |= ((tow & 0x1FFFFUL) << 13);
+
+            // Compute checksum
+            sbfwrd |= (prevwrd << 30) & 0xC0000000UL; // 2 LSBs of the previous transmitted word
+            nib = ((iwrd == 1) || (iwrd == 9)) ? 1 : 0; // Non-information bearing bits for word 2 and 10
+            nav->dwrd[iwrd] = computeChecksum(sbfwrd, nib);
+
+            prevwrd = nav->dwrd[iwrd];
+        }
+    } else // Save subframe 5
+    {
+        for (iwrd = 0; iwrd < N_DWRD_SBF; iwrd++) {
+            nav->dwrd[iwrd] = nav->dwrd[N_DWRD_SBF * N_SBF + iwrd];
+
+            prevwrd = nav->dwrd[iwrd];
+        }
+        /*
+        // Sanity check
+        if (((nav->dwrd[1])&(0x1FFFFUL<<13)) != ((tow&0x1FFFFUL)<<13))
+        {
+                fprintf(stderr, "\nWARNING: Invalid TOW in subframe 5.\n");
+                return(0);
+        }
+         */
+    }
+
+    for (isbf = 0; isbf < N_SBF; isbf++) {
+        tow++;
+
+        for (iwrd = 0; iwrd < N_DWRD_SBF; iwrd++) {
+            sbfwrd = nav->sbf[isbf][iwrd];
+
+            // Add transmission week number to Subframe 1
+            if ((isbf == 0)&&(iwrd == 2))
+                sbfwrd |= (wn & 0x3FFUL) << 20;
+
+            // Add TOW-count message into HOW
+            if (iwrd == 1)
+                sbfwrd |= ((tow & 0x1FFFFUL) << 13);
+
+            // Compute checksum
+            sbfwrd |= (prevwrd << 30) & 0xC0000000UL; // 2 LSBs of the previous transmitted word
+            nib = ((iwrd == 1) || (iwrd == 9)) ? 1 : 0; // Non-information bearing bits for word 2 and 10
+            nav->dwrd[(isbf + 1) * N_DWRD_SBF + iwrd] = computeChecksum(sbfwrd, nib);
+
+            prevwrd = nav->dwrd[(isbf + 1) * N_DWRD_SBF + iwrd];
+        }
+    }
+
+    return (1);
+}
+
+static int checkSatVisibility(const svstate_t *sv, double *xyz, double elvMask, double *azel) {
+    double llh[3], neu[3];
+    double los[3];
+    double tmat[3][3];
+
+    xyz2llh(xyz, llh);
+    ltcmat(llh, tmat);
+
+    subVect(los, sv->pos, xyz);
+    ecef2neu(los, tmat, neu);
+    neu2azel(azel, neu);
+
+    if (azel[1] * R2D > elvMask)
+        return (1); // Visible
+    // else
+    return (0); // Invisible
+}
+
+/*! \brief Compute position, velocity and clock of all satellites of the current ephemeris set
+ *  \param sky Shared satellite state
+ *  \param[in] g Receiver time
+ */
+static void skyUpdate(struct sky *sky, gpstime_t g) {
+    int sv;
+
+    sky->g = g;
+    for (sv = 0; sv < MAX_SAT; sv++) {
+        if (sky->eph[sky->ieph][sv].vflg == true)
+            satpos(sky->eph[sky->ieph][sv], g, sky->sv[sv].pos, sky->sv[sv].vel, sky->sv[sv].clk);
+    }
+
+    return;
+}
+
+/*! \brief Find the ephemeris set valid at a given time
+ *  \param[in] eph Ephemeris sets
+ *  \param[in] neph Number of sets
+ *  \param[in] g Scenario start time
+ *  \returns Index of the first set with a TOC within one hour of \a g, -1 if none
+ */
+static int selectEphemeris(ephem_t eph[][MAX_SAT], int neph, gpstime_t g) {
+    double dt;
+    int i, sv;
+
+    for (i = 0; i < neph; i++) {
+        for (sv = 0; sv < MAX_SAT; sv++) {
+            if (eph[i][sv].vflg == true) {
+                dt = subGpsTime(g, eph[i][sv].toc);
+                if (dt >= -SECONDS_IN_HOUR && dt < SECONDS_IN_HOUR)
+                    return (i);
+            }
+        }
+    }
+
+    return (-1);
+}
+
+/*! \brief Set up the shared satellite state and the first navigation frame
+ *  \param[out] sky Shared satellite state
+ *  \param[in] eph Ephemeris sets
+ *  \param[in] ieph Current ephemeris set
+ *  \param[in] ionoutc Ionospheric parameters
+ *  \param[in] g Scenario start time
+ */
+static void skyInit(struct sky *sky, ephem_t eph[][MAX_SAT], int ieph, ionoutc_t ionoutc, gpstime_t g) {
+    int sv;
+
+    memset(sky, 0, sizeof (struct sky));
+    sky->eph = eph;
+    sky->ieph = ieph;
+    sky->ionoutc = ionoutc;
+
+    for (sv = 0; sv < MAX_SAT; sv++) {
+        if (eph[ieph][sv].vflg == true) {
+            eph2sbf(eph[ieph][sv], ionoutc, sky->nav[sv].sbf);
+            generateNavMsg(g, &sky->nav[sv], 1);
+        }
+    }
+    skyUpdate(sky, g);
+
+    return;
+}
+
+/*! \brief Advance navigation messages and ephemeris set at a frame boundary, call after skyUpdate()
+ *  \param sky Shared satellite state
+ *  \param[in] g Receiver time of the frame boundary
+ */
+static void skyFrame(struct sky *sky, gpstime_t g) {
+    double dt;
+    int sv, k;
+
+    // Update navigation message
+    for (sv = 0; sv < MAX_SAT; sv++) {
+        if (sky->nav[sv].valid)
+            generateNavMsg(g, &sky->nav[sv], 0);
+    }
+
+    // Refresh ephemeris and subframes
+    // Quick and dirty fix. Need more elegant way.
+    for (sv = 0; sv < MAX_SAT; sv++) {
+        if (sky->eph[sky->ieph + 1][sv].vflg == true) {
+            dt = subGpsTime(sky->eph[sky->ieph + 1][sv].toc, g);
+            if (dt < SECONDS_IN_HOUR) {
+                sky->ieph++;
+
+                for (k = 0; k < MAX_SAT; k++) {
+                    if (sky->eph[sky->ieph][k].vflg == true) {
+                        eph2sbf(sky->eph[sky->ieph][k], sky->ionoutc, sky->nav[k].sbf);
+                        if (!sky->nav[k].valid)
+                            generateNavMsg(g, &sky->nav[k], 1);
+                    }
+                }
+                // Channel allocation uses the new set
+                skyUpdate(sky, g);
+            }
+            break;
+        }
+    }
+
+    return;
+}
+
+/*! \brief Copy the current navigation frame of a satellite into a channel */
+void channelNav(channel_t *chan, const navmsg_t *nav) {
+    chan->g0 = nav->g0;
+    memcpy(chan->dwrd, nav->dwrd, sizeof (chan->dwrd));
+}
+
+static int allocateChannel(channel_t *chan, int nchan, int *allocated, struct sky *sky, gpstime_t grx,
+        double *xyz, double elvMask) {
+    NOTUSED(elvMask);
+    int nsat = 0;
+    int i, sv;
+    double azel[2];
+
+    range_t rho;
+    double ref[3] = {0.0};
+    double r_ref, r_xyz;
+    double phase_ini;
+
+    for (sv = 0; sv < MAX_SAT; sv++) {
+        if (sky->eph[sky->ieph][sv].vflg == true && checkSatVisibility(&sky->sv[sv], xyz, 0.0, azel) == 1) {
+            nsat++; // Number of visible satellites
+
+            if (allocated[sv] == -1) // Visible but not allocated
+            {
+                // Allocated new satellite
+                for (i = 0; i < nchan; i++) {
+                    if (chan[i].prn == 0) {
+                        // Initialize channel
+                        chan[i].prn = sv + 1;
+                        chan[i].azel[0] = azel[0];
+                        chan[i].azel[1] = azel[1];
+
+                        // C/A code from shared table
+                        chan[i].ca = caTable[sv];
+
+                        // Navigation message of the current frame
+                        channelNav(&chan[i], &sky->nav[sv]);
+
+                        // Initialize pseudorange
+                        rangeFromState(&rho, &sky->sv[sv], &sky->ionoutc, grx, xyz);
+                        chan[i].rho0 = rho;
+
+                        // Initialize carrier phase
+                        r_xyz = rho.range;
+
+                        rangeFromState(&rho, &sky->sv[sv], &sky->ionoutc, grx, ref);
+                        r_ref = rho.range;
+
+                        chan[i].carr_ref = 2.0 * r_ref;
+                        phase_ini = (chan[i].carr_ref - r_xyz) / LAMBDA_L1;
+#ifdef FLOAT_CARR_PHASE
+                        chan[i].carr_phase = phase_ini - floor(phase_ini);
+#else
+                        phase_ini -= floor(phase_ini);
+                        chan[i].carr_phase = (unsigned int) (512.0 * 65536.0 * phase_ini);
+#endif
+                        // Done.
+                        break;
+                    }
+                }
+
+                // Set satellite allocation channel
+                if (i < nchan)
+                    allocated[sv] = i;
+            }
+        } else if (allocated[sv] >= 0) // Not visible but allocated
+        {
+            // Clear channel
+            chan[allocated[sv]].prn = 0;
+
+            // Clear satellite allocation flag
+            allocated[sv] = -1;
+        }
+    }
+
+    return (nsat);
+}
+
+/*! \brief Update pseudorange, code phase, Doppler and gain of all allocated channels for one block
+ *  \param chan Channel array
+ *  \param[in] nchan Number of channels in array
+ *  \param[out] rho Pseudorange of each channel at \a grx
+ *  \param[out] gain Signal gain of each channel
+ *  \param[in] sig Signal model, power per PRN
+ *  \param[in] sky Shared satellite state at \a grx
+ *  \param[in] grx Receiver time at the end of the block
+ *  \param[in] xyz Receiver position
+ *  \param[in] delt Sample period at the generation rate
+ */
+static void updateChannels(channel_t *chan, int nchan, range_t *rho, double *gain, const struct signal_model *sig,
+        struct sky *sky, gpstime_t grx, double *xyz, double delt) {
+    double path_loss, ant_gain, gmax = maxChannelGain(sig, nchan);
+    int i, sv;
+
+    for (i = 0; i < nchan; i++) {
+        if (chan[i].prn > 0) {
+            // Refresh code phase and data bit counters
+            sv = chan[i].prn - 1;
+
+            // Current pseudorange
+            rangeFromState(&rho[i], &sky->sv[sv], &sky->ionoutc, grx, xyz);
+
+            chan[i].azel[0] = rho[i].azel[0];
+            chan[i].azel[1] = rho[i].azel[1];
+
+            // Update code phase and data bit counters
+            computeCodePhase(&chan[i], rho[i], 0.1);
+#ifndef FLOAT_CARR_PHASE
+            chan[i].carr_phasestep = (int) round(512.0 * 65536.0 * chan[i].f_carr * delt);
+#else
+            NOTUSED(delt);
+#endif
+            if (sig->prn_fixed[sv] > 0.0) {
+                // Absolute C/N0 target
+                gain[i] = sig->prn_fixed[sv];
+            } else {
+                // Path loss
+                path_loss = 20200000.0 / rho[i].d;
+
+                // Receiver antenna gain
+                ant_gain = antennaGain(rho[i].azel[1]);
+
+                // Signal gain with power offset
+                gain[i] = path_loss * ant_gain * sig->prn_gain[sv];
+            }
+
+            // Power offsets near the receiver could overflow the accumulator
+            if (gain[i] > gmax)
+                gain[i] = gmax;
+            setChannelGain(&chan[i], gain[i]);
+        }
+    }
+
+    return;
+}
+
+/*! \brief Receiver position of a block, the user motion repeats */
+static double *rxPos(const struct receiver *rx, int iblock) {
+    return ((rx->numd > 0) ? rx->xyz[iblock % rx->numd] : rx->xyz[0]);
+}
+
+/*! \brief Check for a 30 second navigation frame boundary at the end of a block
+ *  \param[in] grx Receiver time at the end of the block
+ */
+static bool frameBoundary(gpstime_t grx) {
+    int igrx = (int) (grx.sec * 10.0 + 0.5);
+
+    return ((igrx % 300) == 0);
+}
+
+/*! \brief Update navigation message and channel allocation of one receiver at a frame boundary
+ *
+ * Call after skyFrame() advanced the shared navigation messages.
+ *  \param chan Channel array
+ *  \param[in] nchan Number of channels in array
+ *  \param allocated Channel of each satellite, -1 if not allocated
+ *  \param[in] sky Shared satellite state
+ *  \param[in] grx Receiver time of the frame boundary
+ *  \param[in] xyz Receiver position
+ *  \param[in] elvmask Elevation mask in degree
+ */
+static void updateFrame(channel_t *chan, int nchan, int *allocated, struct sky *sky, gpstime_t grx, double *xyz,
+        double elvmask) {
+    int i;
+
+    // Update navigation message
+    for (i = 0; i < nchan; i++) {
+        if (chan[i].prn > 0)
+            channelNav(&chan[i], &sky->nav[chan[i].prn - 1]);
+    }
+
+    // Update channel allocation
+    allocateChannel(chan, nchan, allocated, sky, grx, xyz, elvmask);
+
+    return;
+}
+
+/*! \brief Set up the signal pipeline of one receiver or array element, call after awgnInit()
+ *  \param[out] pl Pipeline
+ *  \param[in] sig Signal model, the pipeline keeps a reference
+ *  \param[in] generate Sample generator
+ *  \param[in] gen_fs Generation rate (Hz)
+ *  \param[in] fs Radio sample rate (Hz)
+ *  \param[in] fir_taps Band-limiting FIR taps, 0 = off
+ *  \param[in] fir_fc Band-limiting FIR cutoff relative to \a fs
+ *  \returns 0 on success, -1 on allocation error
+ */
+static int pipelineInit(struct pipeline *pl, const struct signal_model *sig,
+        void (*generate)(channel_t *, int, int32_t *, int, double, const struct carrier_table *, float *),
+        long long gen_fs, long long fs, int fir_taps, double fir_fc) {
+    int d = (int) gcdLL(fs, gen_fs);
+
+    memset(pl, 0, sizeof (struct pipeline));
+    pl->sig = sig;
+    pl->generate = generate;
+    pl->delt = 1.0 / (double) gen_fs;
+    pl->gen_block = (int) (gen_fs / 10);
+    pl->block = (int) (fs / 10);
+    pl->noise = sig->noise;
+    pl->noise.rnd = NULL;
+    pl->noise.rnd_len = 0;
+
+    pl->acc_buff = calloc((size_t) pl->gen_block * 2, sizeof (int32_t));
+    if (pl->acc_buff == NULL)
+        return (-1);
+    pl->out_acc = pl->acc_buff;
+
+    if (generate == generateSamplesPhasor || generate == generateSamplesPhasorTmpl) {
+        pl->work = malloc(PHASOR_WORK * sizeof (float));
+        if (pl->work == NULL)
+            return (-1);
+    }
+
+    if (gen_fs != fs) {
+        pl->out_acc = calloc((size_t) pl->block * 2, sizeof (int32_t));
+        if (pl->out_acc == NULL
+                || firInit(&pl->resamp, (int) (fs / d), (int) (gen_fs / d), RESAMP_TAPS, RESAMP_CUTOFF) != 0)
+            return (-1);
+    }
+
+    if (fir_taps > 0 && firInit(&pl->shaper, 1, 1, fir_taps, fir_fc) != 0)
+        return (-1);
+
+    return (0);
+}
+
+/*! \brief Run the stages after generation on pl->acc_buff into pl->out_acc
+ *  \param pl Pipeline
+ *  \param[in] iblock Block counter since start, positions the noise generators
+ *  \returns 0 on success, -1 on allocation error
+ */
+static int pipelinePost(struct pipeline *pl, long iblock) {
+    if (pl->resamp.taps != NULL)
+        firProcess(&pl->resamp, pl->acc_buff, pl->gen_block, pl->out_acc);
+
+    if (pl->noise.sigma > 0.0) {
+        awgnSeek(&pl->noise, (uint64_t) iblock);
+        if (awgnAdd(&pl->noise, pl->out_acc, pl->block) != 0)
+            return (-1);
+    }
+
+    if (pl->shaper.taps != NULL)
+        firProcess(&pl->shaper, pl->out_acc, pl->block, pl->out_acc);
+
+    return (0);
+}
+
+/*! \brief Generate one block through all pipeline stages into pl->out_acc
+ *  \param pl Pipeline
+ *  \param chan Channel array
+ *  \param[in] nchan Number of channels in array
+ *  \param[in] iblock Block counter since start, positions the noise generators
+ *  \returns 0 on success, -1 on allocation error
+ */
+static int pipelineRun(struct pipeline *pl, channel_t *chan, int nchan, long iblock) {
+    echo_pos_t pos[MAX_ECHOES];
+    int necho = echoStart(pl->sig, chan, nchan, pos, pl->delt, iblock);
+
+    pl->generate(chan, nchan, pl->acc_buff, pl->gen_block, pl->delt, &pl->sig->carr, pl->work);
+
+    // Echoes start from the direct path state before generation
+    if (necho > 0)
+        echoRender(pos, necho, pl->acc_buff, pl->gen_block, pl->delt, &pl->sig->carr);
+
+    return (pipelinePost(pl, iblock));
+}
+
+/*! \brief Release the buffers of a signal pipeline */
+static void pipelineFree(struct pipeline *pl) {
+    if (pl->out_acc != pl->acc_buff)
+        free(pl->out_acc);
+    free(pl->acc_buff);
+    free(pl->work);
+    firFree(&pl->resamp);
+    firFree(&pl->shaper);
+    awgnFree(&pl->noise);
+    pl->acc_buff = NULL;
+    pl->out_acc = NULL;
+    pl->work = NULL;
+
+    return;
+}
+
+#if defined(__MACH__) || defined(__APPLE__)
+
+static int pthread_setaffinity_np(pthread_t thread, size_t cpu_size,
+        cpu_set_t *cpu_set) {
+    thread_port_t mach_thread;
+    size_t core = 0;
+
+    for (core = 0; core < 8 * cpu_size; core++) {
+        if (CPU_ISSET(core, cpu_set)) break;
+    }
+    printf("binding to core %ld\n", core);
+    thread_affinity_policy_data_t policy = {core};
+    mach_thread = pthread_mach_thread_np(thread);
+    thread_policy_set(mach_thread, THREAD_AFFINITY_POLICY,
+            (thread_policy_t) & policy, 1);
+    return 0;
+}
+#endif
+
+// Set affinity of calling thread to specific core on a multi-core CPU
+
+int thread_to_core(int core_id) {
+    int num_cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (core_id < 0 || core_id >= num_cores)
+        return EINVAL;
+
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(core_id, &cpuset);
+
+    pthread_t current_thread = pthread_self();
+    return pthread_setaffinity_np(current_thread, sizeof (cpu_set_t), &cpuset);
+}
+
+/*! \brief Time difference between two monotonic time stamps
+ *  \param[in] t1 Later time stamp
+ *  \param[in] t0 Earlier time stamp
+ *  \returns Difference in microseconds
+ */
+double timeDiffUs(const struct timespec *t1, const struct timespec *t0) {
+    return ((double) (t1->tv_sec - t0->tv_sec) * 1.0e6 + (double) (t1->tv_nsec - t0->tv_nsec) / 1.0e3);
+}
+
+/*! \brief Set the element weights of all channels from the line of sight
+ *
+ * An element closer to the satellite along the line of sight receives the
+ * carrier earlier, its phase leads by the projected offset in wavelengths.
+ * Code phase and data bits are the same for all elements.
+ *  \param arr Antenna array
+ *  \param[in] chan Channel array, azimuth and elevation of the current epoch
+ *  \param[in] nchan Number of channels in array
+ */
+static void arrayUpdate(struct antenna_array *arr, const channel_t *chan, int nchan) {
+    double u[3], d, phase;
+    int i, e, w;
+
+    for (i = 0; i < nchan; i++) {
+        if (chan[i].prn == 0)
+            continue;
+
+        // Unit vector to the satellite, east/north/up
+        u[0] = cos(chan[i].azel[1]) * sin(chan[i].azel[0]);
+        u[1] = cos(chan[i].azel[1]) * cos(chan[i].azel[0]);
+        u[2] = sin(chan[i].azel[1]);
+
+        for (e = 0; e < arr->nelem; e++) {
+            d = arr->enu[e][0] * u[0] + arr->enu[e][1] * u[1] + arr->enu[e][2] * u[2];
+            phase = 2.0 * PI * d / LAMBDA_L1;
+            w = i * MAX_ARRAY_ELEMENTS + e;
+            arr->wr[w] = (float) (arr->gain[e] * cos(phase));
+            arr->wi[w] = (float) (arr->gain[e] * sin(phase));
+        }
+    }
+
+    return;
+}
+
+/*! \brief Rotate one channel sample into all array elements and accumulate it
+ *
+ * Vectorized with SSE2 or NEON across elements. Each element keeps its own
+ * sum with separate multiply and add, so the result does not depend on the
+ * instruction set.
+ *  \param[in] ip In-phase value of the channel
+ *  \param[in] qp Quadrature value of the channel
+ *  \param[in] wr Real parts of the element weights
+ *  \param[in] wi Imaginary parts of the element weights
+ *  \param[in] nlane Number of elements, a multiple of PHASOR_LANES
+ *  \param i_acc I sums of the elements (is updated)
+ *  \param q_acc Q sums of the elements (is updated)
+ */
+static inline void arrayRotate(float ip, float qp, const float *wr, const float *wi, int nlane, float *i_acc,
+        float *q_acc) {
+    int e;
+
+#if defined(__SSE2__)
+    __m128 vip = _mm_set1_ps(ip);
+    __m128 vqp = _mm_set1_ps(qp);
+
+    for (e = 0; e < nlane; e += PHASOR_LANES) {
+        __m128 vwr = _mm_loadu_ps(wr + e);
+        __m128 vwi = _mm_loadu_ps(wi + e);
+
+        _mm_storeu_ps(i_acc + e, _mm_add_ps(_mm_loadu_ps(i_acc + e),
+                _mm_sub_ps(_mm_mul_ps(vip, vwr), _mm_mul_ps(vqp, vwi))));
+        _mm_storeu_ps(q_acc + e, _mm_add_ps(_mm_loadu_ps(q_acc + e),
+                _mm_add_ps(_mm_mul_ps(vip, vwi), _mm_mul_ps(vqp, vwr))));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    float32x4_t vip = vdupq_n_f32(ip);
+    float32x4_t vqp = vdupq_n_f32(qp);
+
+    for (e = 0; e < nlane; e += PHASOR_LANES) {
+        float32x4_t vwr = vld1q_f32(wr + e);
+        float32x4_t vwi = vld1q_f32(wi + e);
+
+        vst1q_f32(i_acc + e, vaddq_f32(vld1q_f32(i_acc + e), vsubq_f32(vmulq_f32(vip, vwr), vmulq_f32(vqp, vwi))));
+        vst1q_f32(q_acc + e, vaddq_f32(vld1q_f32(q_acc + e), vaddq_f32(vmulq_f32(vip, vwi), vmulq_f32(vqp, vwr))));
+    }
+#else
+    for (e = 0; e < nlane; e++) {
+        i_acc[e] += ip * wr[e] - qp * wi[e];
+        q_acc[e] += ip * wi[e] + qp * wr[e];
+    }
+#endif
+
+    return;
+}
+
+/*! \brief Generate one block of all array elements into their pipeline accumulators
+ *
+ * The code chip, data bit and sin/cos table lookup of a channel are computed
+ * once per sample, the elements only rotate and scale that value by their
+ * weight, see arrayRotate(). The element sums are float, so an element at the
+ * receiver position with unit gain matches generateSamples() exactly only as
+ * long as the I/Q sums stay below 2^24.
+ *  \param chan Array of channels (phase and data bit state is updated)
+ *  \param[in] nchan Number of channels in \a chan
+ *  \param arr Antenna array, weights set by arrayUpdate()
+ *  \param[in] carr Carrier table
+ */
+static void generateArray(channel_t *chan, int nchan, struct antenna_array *arr, const struct carrier_table *carr) {
+    int i, k, e, isamp;
+    int iTable;
+    int active[MAX_CHAN];
+    int nactive = 0;
+    int nlane = (arr->nelem + PHASOR_LANES - 1) / PHASOR_LANES * PHASOR_LANES; // Padding elements have zero weight
+    int nsamp = arr->pl[0].gen_block;
+    double delt = arr->pl[0].delt;
+    float ip, qp;
+    float i_acc[MAX_ARRAY_ELEMENTS], q_acc[MAX_ARRAY_ELEMENTS];
+
+    for (i = 0; i < nchan && nactive < MAX_CHAN; i++) {
+        if (chan[i].prn > 0)
+            active[nactive++] = i;
+    }
+
+    for (isamp = 0; isamp < nsamp; isamp++) {
+        for (e = 0; e < nlane; e++) {
+            i_acc[e] = 0.0f;
+            q_acc[e] = 0.0f;
+        }
+
+        for (k = 0; k < nactive; k++) {
+            i = active[k];
+
+#ifdef FLOAT_CARR_PHASE
+            iTable = (int) floor(chan[i].carr_phase * carr->size);
+#else
+            iTable = (chan[i].carr_phase >> (25 - carr->bits)) & (carr->size - 1);
+#endif
+            ip = (float) (chan[i].dataBit * chan[i].codeCA * gainMul(carr->cos[iTable], chan[i].gain_q));
+            qp = (float) (chan[i].dataBit * chan[i].codeCA * gainMul(carr->sin[iTable], chan[i].gain_q));
+
+            // Rotate into every element
+            arrayRotate(ip, qp, &arr->wr[i * MAX_ARRAY_ELEMENTS], &arr->wi[i * MAX_ARRAY_ELEMENTS], nlane,
+                i_acc, q_acc);
+
+            // Update code phase, data bit and carrier phase
+            stepChannel(&chan[i], delt);
+        }
+
+        // Store I/Q sums into the element accumulators
+        for (e = 0; e < arr->nelem; e++) {
+            arr->pl[e].acc_buff[isamp * 2] = (int32_t) lrintf(i_acc[e]);
+            arr->pl[e].acc_buff[isamp * 2 + 1] = (int32_t) lrintf(q_acc[e]);
+        }
+    }
+
+    return;
+}
+
+/*! \brief Pseudorange reference of the allocated channels after a position or ionosphere change
+ *
+ * The reference is taken again at the time of the current satellite state, so
+ * the next block starts from the new geometry without a Doppler spike.
+ *  \param rx Receiver
+ *  \param[in] nchan Number of channels
+ *  \param[in] sky Satellite state
+ *  \param[in] xyz Receiver position
+ */
+static void rebase(struct receiver *rx, int nchan, struct sky *sky, double *xyz) {
+    int i;
+
+    for (i = 0; i < nchan; i++) {
+        if (rx->chan[i].prn > 0)
+            rangeFromState(&rx->chan[i].rho0, &sky->sv[rx->chan[i].prn - 1], &sky->ionoutc, sky->g, xyz);
+    }
+}
+
+/*! \brief Finish the current block, advance navigation message and channel allocation at a frame boundary
+ *
+ * Runs before the next block or any change of the context, so a change
+ * between two blocks sees the state the next block starts from.
+ */
+static void blockEnd(gpssim_t *sim) {
+    gpstime_t grx;
+    int k;
+
+    if (!sim->stepped)
+        return;
+
+    grx = incGpsTime(sim->g0, 0.1 * (sim->iblock + 1));
+    sim->iblock++;
+    sim->stepped = false;
+
+    // Update navigation message and channel allocation every 30 seconds
+    if (frameBoundary(grx)) {
+        skyFrame(&sim->sky, grx);
+        for (k = 0; k < sim->cfg.nrx; k++)
+            updateFrame(sim->rx[k].chan, sim->cfg.nchan, sim->rx[k].allocated, &sim->sky, grx,
+                rxPos(&sim->rx[k], sim->iblock - 1), 0.0);
+    }
+
+    return;
+}
+
+void gpssim_config_default(gpssim_config_t *cfg) {
+    memset(cfg, 0, sizeof (gpssim_config_t));
+    cfg->fs_hz = TX_SAMPLE_FREQ;
+    cfg->nchan = DEFAULT_CHAN;
+    cfg->bw_hz = TX_SAMPLE_FREQ * 2;
+    cfg->noise_cn0 = -1.0;
+    cfg->noise_seed = 1;
+    cfg->iono = 1;
+    cfg->nrx = 1;
+    cfg->carr_bits = 9;
+}
+
+/*! \brief Check a configuration the way pluto-gps-sim checks its options */
+static int configValid(const gpssim_config_t *cfg) {
+    long long gen_hz = (cfg->gen_hz > 0) ? cfg->gen_hz : cfg->fs_hz;
+
+    if (cfg->fs_hz < MHZ(1.0) || cfg->fs_hz % 10 != 0 || gen_hz < MHZ(1.0) || gen_hz % 10 != 0
+            || gen_hz > cfg->fs_hz || cfg->fs_hz / gcdLL(cfg->fs_hz, gen_hz) > RESAMP_MAX_PHASES)
+        return (0);
+    if (cfg->nchan < 1 || cfg->nchan > MAX_CHAN)
+        return (0);
+    if (cfg->fir_taps != 0 && (cfg->fir_taps < MIN_FIR_TAPS || cfg->fir_taps > MAX_FIR_TAPS
+            || cfg->fir_taps % 4 != 0 || cfg->bw_hz <= 0.0 || cfg->bw_hz >= cfg->fs_hz))
+        return (0);
+    if (cfg->noise_cn0 >= 0.0 && (cfg->noise_cn0 < MIN_NOISE_CN0 || cfg->noise_cn0 > MAX_NOISE_CN0))
+        return (0);
+    if (cfg->nrx < 1 || cfg->nrx > MAX_RECEIVERS || cfg->nelem < 0 || cfg->nelem > MAX_ARRAY_ELEMENTS)
+        return (0);
+    if (cfg->carr_bits < MIN_CARR_TABLE_BITS || cfg->carr_bits > MAX_CARR_TABLE_BITS || cfg->tmpl_bound < 0.0)
+        return (0);
+    // The array renders all elements in one pass of the table kernel
+    if (cfg->nelem > 0 && (cfg->nrx > 1 || cfg->phasor || cfg->tmpl_bound > 0.0))
+        return (0);
+
+    return (1);
+}
+
+gpssim_t *gpssim_create(const gpssim_config_t *cfg) {
+    void (*generate)(channel_t *, int, int32_t *, int, double, const struct carrier_table *, float *);
+    gpssim_t *sim;
+    struct receiver *rx;
+    double fir_fc;
+    int sv, k, e;
+
+    if (!configValid(cfg))
+        return (NULL);
+
+    pthread_once(&tablesOnce, initCodeTable);
+
+    sim = calloc(1, sizeof (gpssim_t));
+    if (sim == NULL)
+        return (NULL);
+    sim->cfg = *cfg;
+    if (sim->cfg.gen_hz <= 0)
+        sim->cfg.gen_hz = cfg->fs_hz;
+    sim->out_limit = (cfg->autoscale || cfg->msb) ? DAC_FULL_SCALE : INT16_MAX;
+    sim->out_shift = cfg->msb ? 4 : 0;
+    fir_fc = 0.5 * cfg->bw_hz / cfg->fs_hz;
+
+    if (cfg->phasor)
+        generate = (cfg->tmpl_bound > 0.0) ? generateSamplesPhasorTmpl : generateSamplesPhasor;
+    else
+        generate = (cfg->tmpl_bound > 0.0) ? generateSamplesTmpl : generateSamples;
+
+    for (sv = 0; sv < MAX_SAT; sv++)
+        sim->sig.prn_gain[sv] = 1.0;
+
+    // Carrier table first, the noise level follows its amplitude
+    sim->eph = calloc(EPHEM_ARRAY_SIZE, sizeof (*sim->eph));
+    sim->rx = calloc(cfg->nrx, sizeof (struct receiver));
+    if (sim->eph == NULL || sim->rx == NULL || initCarrierTable(&sim->sig.carr, cfg->carr_bits) != 0
+            || (cfg->noise_cn0 >= 0.0 && awgnInit(&sim->sig.noise, cfg->noise_cn0, (double) cfg->fs_hz,
+            cfg->noise_seed, sim->sig.carr.ampl) != 0)) {
+        gpssim_destroy(sim);
+        return (NULL);
+    }
+
+    // Filters are designed once per context
+    for (k = 0; k < cfg->nrx; k++) {
+        rx = &sim->rx[k];
+        rx->xyz = calloc(1, sizeof (*rx->xyz));
+        rx->chan = calloc(cfg->nchan, sizeof (channel_t));
+        rx->rho = calloc(cfg->nchan, sizeof (range_t));
+        rx->gain = calloc(cfg->nchan, sizeof (double));
+        if (rx->xyz == NULL || rx->chan == NULL || rx->rho == NULL || rx->gain == NULL
+                || pipelineInit(&rx->pl, &sim->sig, generate, sim->cfg.gen_hz, cfg->fs_hz, cfg->fir_taps, fir_fc) != 0) {
+            gpssim_destroy(sim);
+            return (NULL);
+        }
+    }
+
+    if (cfg->nelem > 0) {
+        sim->arr = calloc(1, sizeof (struct antenna_array));
+        if (sim->arr == NULL) {
+            gpssim_destroy(sim);
+            return (NULL);
+        }
+        sim->arr->nelem = cfg->nelem;
+        // Resampler, noise and band limit per element, independent noise per element
+        for (e = 0; e < cfg->nelem; e++) {
+            sim->arr->gain[e] = 1.0;
+            if (pipelineInit(&sim->arr->pl[e], &sim->sig, NULL, sim->cfg.gen_hz, cfg->fs_hz, cfg->fir_taps, fir_fc) != 0) {
+                gpssim_destroy(sim);
+                return (NULL);
+            }
+            sim->arr->pl[e].noise.seed += 0x9e3779b97f4a7c15ULL * (uint64_t) e;
+        }
+    }
+
+    return (sim);
+}
+
+void gpssim_destroy(gpssim_t *sim) {
+    int k, e;
+
+    if (sim == NULL)
+        return;
+
+    for (k = 0; sim->rx != NULL && k < sim->cfg.nrx; k++) {
+        pipelineFree(&sim->rx[k].pl);
+        if (sim->rx[k].chan != NULL)
+            freeCodeTemplates(sim->rx[k].chan, sim->cfg.nchan);
+        free(sim->rx[k].chan);
+        free(sim->rx[k].rho);
+        free(sim->rx[k].gain);
+        free(sim->rx[k].xyz);
+    }
+    for (e = 0; sim->arr != NULL && e < sim->cfg.nelem; e++)
+        pipelineFree(&sim->arr->pl[e]);
+    awgnFree(&sim->sig.noise);
+    free(sim->sig.carr.buf);
+    free(sim->arr);
+    free(sim->rx);
+    free(sim->eph);
+    free(sim);
+}
+
+gpssim_t *gpssim_clone(const gpssim_t *sim) {
+    gpssim_t *c;
+    const struct receiver *rx;
+    int k;
+
+    c = gpssim_create(&sim->cfg);
+    if (c == NULL)
+        return (NULL);
+
+    memcpy(c->eph, sim->eph, EPHEM_ARRAY_SIZE * sizeof (*sim->eph));
+    c->neph = sim->neph;
+    c->ionoutc = sim->ionoutc;
+    memcpy(c->sig.prn_gain, sim->sig.prn_gain, sizeof (c->sig.prn_gain));
+    memcpy(c->sig.prn_fixed, sim->sig.prn_fixed, sizeof (c->sig.prn_fixed));
+    memcpy(c->sig.echo, sim->sig.echo, sizeof (c->sig.echo));
+    c->sig.necho = sim->sig.necho;
+
+    for (k = 0; k < sim->cfg.nrx; k++) {
+        rx = &sim->rx[k];
+        if (gpssim_set_trajectory(c, k, (const double (*)[3]) rx->xyz, (rx->numd > 0) ? rx->numd : 1) != 0) {
+            gpssim_destroy(c);
+            return (NULL);
+        }
+    }
+    if (sim->arr != NULL) {
+        memcpy(c->arr->enu, sim->arr->enu, sizeof (c->arr->enu));
+        memcpy(c->arr->gain, sim->arr->gain, sizeof (c->arr->gain));
+    }
+
+    return (c);
+}
+
+int gpssim_load_ephemeris(gpssim_t *sim, const char *filename, int rinex3) {
+    int neph;
+
+    neph = rinex3 ? readRinex3(sim->eph, &sim->ionoutc, filename) : readRinex2(sim->eph, &sim->ionoutc, filename);
+    if (neph <= 0)
+        return (-1);
+    sim->neph = neph;
+    sim->ionoutc.enable = (sim->cfg.iono != 0);
+
+    return (neph);
+}
+
+void gpssim_llh_to_xyz(const double llh[3], double xyz[3]) {
+    double rad[3] = {llh[0] / R2D, llh[1] / R2D, llh[2]};
+
+    llh2xyz(rad, xyz);
+}
+
+int gpssim_copy_ephemeris(gpssim_t *sim, const gpssim_t *from) {
+    if (from->neph <= 0)
+        return (-1);
+    memcpy(sim->eph, from->eph, EPHEM_ARRAY_SIZE * sizeof (*sim->eph));
+    sim->neph = from->neph;
+    sim->ionoutc = from->ionoutc;
+    sim->ionoutc.enable = (sim->cfg.iono != 0);
+
+    return (sim->neph);
+}
+
+/*! \brief TOC of the first valid satellite of an ephemeris set
+ *  \returns 0 on success, -1 if the set is empty
+ */
+static int ephemerisToc(ephem_t eph[MAX_SAT], gpstime_t *g) {
+    int sv;
+
+    for (sv = 0; sv < MAX_SAT; sv++) {
+        if (eph[sv].vflg == true) {
+            *g = eph[sv].toc;
+            return (0);
+        }
+    }
+
+    return (-1);
+}
+
+int gpssim_get_ephemeris_range(const gpssim_t *sim, int *week0, double *sec0, int *week1, double *sec1) {
+    gpstime_t gmin, gmax = {0, 0.0};
+
+    if (sim->neph <= 0 || ephemerisToc(sim->eph[0], &gmin) != 0)
+        return (-1);
+    ephemerisToc(sim->eph[sim->neph - 1], &gmax);
+    *week0 = gmin.week;
+    *sec0 = gmin.sec;
+    *week1 = gmax.week;
+    *sec1 = gmax.sec;
+
+    return (0);
+}
+
+int gpssim_shift_ephemeris(gpssim_t *sim, int week, double sec) {
+    gpstime_t gmin, gtmp;
+    datetime_t ttmp;
+    double dsec;
+    int i, sv;
+
+    if (sim->started || sim->neph <= 0 || ephemerisToc(sim->eph[0], &gmin) != 0)
+        return (-1);
+
+    gtmp.week = week;
+    gtmp.sec = (double) (((int) (sec)) / 7200)*7200.0;
+
+    dsec = subGpsTime(gtmp, gmin);
+
+    // Overwrite the UTC reference week number
+    sim->ionoutc.wnt = gtmp.week;
+    sim->ionoutc.tot = (int) gtmp.sec;
+
+    // Overwrite the TOC and TOE to the scenario start time
+    for (sv = 0; sv < MAX_SAT; sv++) {
+        for (i = 0; i < sim->neph; i++) {
+            if (sim->eph[i][sv].vflg == true) {
+                gtmp = incGpsTime(sim->eph[i][sv].toc, dsec);
+                gps2date(&gtmp, &ttmp);
+                sim->eph[i][sv].toc = gtmp;
+                sim->eph[i][sv].t = ttmp;
+
+                gtmp = incGpsTime(sim->eph[i][sv].toe, dsec);
+                sim->eph[i][sv].toe = gtmp;
+            }
+        }
+    }
+
+    return (0);
+}
+
+int gpssim_check_start(const gpssim_t *sim, int week, double sec) {
+    gpstime_t g = {week, sec};
+
+    return ((selectEphemeris(sim->eph, sim->neph, g) < 0) ? -1 : 0);
+}
+
+int gpssim_set_position(gpssim_t *sim, int rx, const double xyz[3]) {
+    struct receiver *r;
+
+    if (gpssim_set_trajectory(sim, rx, (const double (*)[3]) xyz, 1) != 0)
+        return (-1);
+
+    if (sim->started) {
+        // The next block starts from the new position, as after a jump of the receiver
+        r = &sim->rx[rx];
+        rebase(r, sim->cfg.nchan, &sim->sky, r->xyz[0]);
+        allocateChannel(r->chan, sim->cfg.nchan, r->allocated, &sim->sky, sim->sky.g, r->xyz[0], 0.0);
+    }
+
+    return (0);
+}
+
+int gpssim_set_trajectory(gpssim_t *sim, int rx, const double (*xyz)[3], int npoints) {
+    double (*traj)[3];
+
+    if (rx < 0 || rx >= sim->cfg.nrx || npoints < 1)
+        return (-1);
+    traj = malloc((size_t) npoints * sizeof (*traj));
+    if (traj == NULL)
+        return (-1);
+    memcpy(traj, xyz, (size_t) npoints * sizeof (*traj));
+
+    // The frame update of the current block uses the old position
+    blockEnd(sim);
+    free(sim->rx[rx].xyz);
+    sim->rx[rx].xyz = traj;
+    sim->rx[rx].numd = (npoints > 1) ? npoints : 0;
+
+    return (0);
+}
+
+int gpssim_set_element(gpssim_t *sim, int elem, const double enu[3], double gain_db) {
+    if (sim->arr == NULL || elem < 0 || elem >= sim->arr->nelem)
+        return (-1);
+    sim->arr->enu[elem][0] = enu[0];
+    sim->arr->enu[elem][1] = enu[1];
+    sim->arr->enu[elem][2] = enu[2];
+    sim->arr->gain[elem] = pow(10.0, gain_db / 20.0);
+
+    return (0);
+}
+
+int gpssim_set_power(gpssim_t *sim, int prn, double db) {
+    if (prn < 1 || prn > MAX_SAT || fabs(db) > MAX_POWER_OFFSET)
+        return (-1);
+    // An offset replaces the absolute C/N0 target of the PRN
+    sim->sig.prn_gain[prn - 1] = pow(10.0, db / 20.0);
+    sim->sig.prn_fixed[prn - 1] = 0.0;
+
+    return (0);
+}
+
+int gpssim_set_cn0(gpssim_t *sim, int prn, double dbhz) {
+    double gain;
+
+    if (prn < 1 || prn > MAX_SAT || sim->cfg.noise_cn0 < 0.0 || (dbhz >= 0.0 && (dbhz < MIN_NOISE_CN0
+            || dbhz > MAX_NOISE_CN0)))
+        return (-1);
+    // Relative to the noise stage level, all channels at the target must fit the accumulator
+    gain = (dbhz >= 0.0) ? pow(10.0, (dbhz - sim->cfg.noise_cn0) / 20.0) : 0.0;
+    if (gain > maxChannelGain(&sim->sig, sim->cfg.nchan))
+        return (-1);
+    sim->sig.prn_fixed[prn - 1] = gain;
+
+    return (0);
+}
+
+int gpssim_add_echoes(gpssim_t *sim, const char *spec) {
+    struct signal_model sig = sim->sig;
+
+    // The array kernel renders no echoes, a bad list adds none
+    if (sim->arr != NULL || parseEchoes(&sig, spec) != 0)
+        return (-1);
+    memcpy(sim->sig.echo, sig.echo, sizeof (sig.echo));
+    sim->sig.necho = sig.necho;
+
+    return (0);
+}
+
+void gpssim_set_iono(gpssim_t *sim, int on) {
+    int k;
+
+    sim->cfg.iono = on;
+    sim->ionoutc.enable = (on != 0);
+    if (!sim->started)
+        return;
+
+    blockEnd(sim);
+    sim->sky.ionoutc.enable = (on != 0);
+    for (k = 0; k < sim->cfg.nrx; k++)
+        rebase(&sim->rx[k], sim->cfg.nchan, &sim->sky, rxPos(&sim->rx[k], (sim->iblock > 0) ? sim->iblock - 1 : 0));
+
+    return;
+}
+
+/*! \brief Clear the sample history of a FIR filter, the taps are kept */
+static void firReset(struct fir_filter *f) {
+    if (f->taps == NULL)
+        return;
+    memset(f->buf, 0, (size_t) (f->ntaps - 1) * 2 * sizeof (float));
+    f->p = 0;
+
+    return;
+}
+
+/*! \brief Restart a signal pipeline at block 0 without designing the filters again */
+static void pipelineReset(struct pipeline *pl) {
+    firReset(&pl->resamp);
+    firReset(&pl->shaper);
+
+    return;
+}
+
+int gpssim_start(gpssim_t *sim, int week, double sec) {
+    struct receiver *rx;
+    int ieph, sv, k, e;
+
+    if (sim->neph <= 0)
+        return (-1);
+
+    if (week < 0) {
+        // First ephemeris set, as pluto-gps-sim without -t
+        if (ephemerisToc(sim->eph[0], &sim->g0) != 0)
+            return (-1);
+    } else {
+        sim->g0.week = week;
+        sim->g0.sec = sec;
+    }
+
+    ieph = selectEphemeris(sim->eph, sim->neph, sim->g0);
+    if (ieph < 0)
+        return (-1);
+
+    // The filters start without history
+    for (e = 0; sim->arr != NULL && e < sim->arr->nelem; e++)
+        pipelineReset(&sim->arr->pl[e]);
+
+    skyInit(&sim->sky, sim->eph, ieph, sim->ionoutc, sim->g0);
+
+    for (k = 0; k < sim->cfg.nrx; k++) {
+        rx = &sim->rx[k];
+        pipelineReset(&rx->pl);
+        freeCodeTemplates(rx->chan, sim->cfg.nchan);
+        memset(rx->chan, 0, sim->cfg.nchan * sizeof (channel_t));
+        for (sv = 0; sv < MAX_SAT; sv++)
+            rx->allocated[sv] = -1;
+        allocateChannel(rx->chan, sim->cfg.nchan, rx->allocated, &sim->sky, sim->g0, rxPos(rx, 0), 0.0);
+    }
+
+    sim->iblock = 0;
+    sim->stepped = false;
+    sim->pos = sim->rx[0].pl.block;
+    sim->nout = 0;
+    sim->started = true;
+
+    return (0);
+}
+
+int gpssim_step(gpssim_t *sim) {
+    struct receiver *rx;
+    gpstime_t grx;
+    int k;
+
+    if (!sim->started)
+        return (-1);
+
+    blockEnd(sim);
+    grx = incGpsTime(sim->g0, 0.1 * (sim->iblock + 1));
+
+    // Satellite states of this block, shared by all receivers
+    skyUpdate(&sim->sky, grx);
+
+    for (k = 0; k < sim->cfg.nrx; k++) {
+        rx = &sim->rx[k];
+        updateChannels(rx->chan, sim->cfg.nchan, rx->rho, rx->gain, &sim->sig, &sim->sky, grx,
+                rxPos(rx, sim->iblock), rx->pl.delt);
+        if (sim->cfg.tmpl_bound > 0.0 && refreshCodeTemplates(rx->chan, sim->cfg.nchan, rx->pl.delt,
+                sim->cfg.tmpl_bound) != 0)
+            return (-1);
+    }
+    sim->stepped = true;
+
+    return (0);
+}
+
+int gpssim_render(gpssim_t *sim, int rx) {
+    struct antenna_array *arr = sim->arr;
+    struct receiver *r;
+    int e;
+
+    if (!sim->stepped || rx < 0 || rx >= sim->cfg.nrx)
+        return (-1);
+    r = &sim->rx[rx];
+
+    if (arr != NULL) {
+        // All elements from one pass over the channels
+        arrayUpdate(arr, r->chan, sim->cfg.nchan);
+        generateArray(r->chan, sim->cfg.nchan, arr, &sim->sig.carr);
+        for (e = 0; e < arr->nelem; e++) {
+            if (pipelinePost(&arr->pl[e], sim->iblock) != 0)
+                return (-1);
+        }
+    } else if (pipelineRun(&r->pl, r->chan, sim->cfg.nchan, sim->iblock) != 0) {
+        return (-1);
+    }
+    // Common scale keeps the element amplitudes relative to each other
+    r->scale = outputScale(r->chan, sim->cfg.nchan, r->gain, &sim->sig, sim->cfg.autoscale != 0);
+
+    return (0);
+}
+
+int gpssim_pack(const gpssim_t *sim, int rx, int elem, short *iq) {
+    const struct pipeline *pl;
+
+    if (!sim->stepped || rx < 0 || rx >= sim->cfg.nrx || elem < 0 || elem >= ((sim->arr != NULL) ? sim->arr->nelem : 1))
+        return (-1);
+    pl = (sim->arr != NULL) ? &sim->arr->pl[elem] : &sim->rx[rx].pl;
+
+    return (packSamples(pl->out_acc, iq, pl->block, sim->rx[rx].scale, sim->out_limit, sim->out_shift));
+}
+
+int gpssim_seek(gpssim_t *sim, int block) {
+    struct receiver *rx;
+    gpstime_t grx;
+    bool frame;
+    int i, k;
+
+    if (!sim->started)
+        return (-1);
+    blockEnd(sim);
+    if (block < sim->iblock)
+        return (-1);
+
+    // Only frame boundaries change the state, the pseudorange of the last
+    // skipped block becomes the reference of the next rendered block
+    for (i = sim->iblock; i < block; i++) {
+        grx = incGpsTime(sim->g0, 0.1 * (i + 1));
+        frame = frameBoundary(grx);
+
+        if (i == block - 1 || frame)
+            skyUpdate(&sim->sky, grx);
+
+        for (k = 0; i == block - 1 && k < sim->cfg.nrx; k++) {
+            rx = &sim->rx[k];
+            rebase(rx, sim->cfg.nchan, &sim->sky, rxPos(rx, i));
+        }
+
+        if (frame) {
+            skyFrame(&sim->sky, grx);
+            for (k = 0; k < sim->cfg.nrx; k++) {
+                rx = &sim->rx[k];
+                updateFrame(rx->chan, sim->cfg.nchan, rx->allocated, &sim->sky, grx, rxPos(rx, i), 0.0);
+            }
+        }
+    }
+    sim->iblock = block;
+
+    return (0);
+}
+
+long gpssim_generate(gpssim_t *sim, short *iq, long nsamp) {
+    const struct pipeline *pl;
+    long n = 0;
+    int len;
+
+    if (!sim->started)
+        return (-1);
+    pl = (sim->arr != NULL) ? &sim->arr->pl[0] : &sim->rx[0].pl;
+
+    while (n < nsamp) {
+        if (sim->pos == pl->block) {
+            if (gpssim_step(sim) != 0 || gpssim_render(sim, 0) != 0)
+                return (-1);
+            sim->pos = 0;
+        }
+
+        // Pack from the accumulator straight into the caller buffer
+        len = pl->block - sim->pos;
+        if (len > nsamp - n)
+            len = (int) (nsamp - n);
+        packSamples(pl->out_acc + 2 * sim->pos, iq + 2 * n, len, sim->rx[0].scale, sim->out_limit, sim->out_shift);
+        sim->pos += len;
+        n += len;
+    }
+    sim->nout += n;
+
+    return (n);
+}
+
+int gpssim_get_time(const gpssim_t *sim, int *week, double *sec) {
+    gpstime_t g;
+
+    if (!sim->started)
+        return (-1);
+    g = incGpsTime(sim->g0, (double) sim->nout / (double) sim->cfg.fs_hz);
+    *week = g.week;
+    *sec = g.sec;
+
+    return (0);
+}
+
+int gpssim_get_block(const gpssim_t *sim, int *block, int *week, double *sec) {
+    gpstime_t g;
+
+    if (!sim->started)
+        return (-1);
+    g = incGpsTime(sim->g0, 0.1 * (sim->iblock + 1));
+    *block = sim->iblock;
+    *week = g.week;
+    *sec = g.sec;
+
+    return (0);
+}
+
+int gpssim_get_position(const gpssim_t *sim, int rx, double xyz[3]) {
+    const double *pos;
+
+    if (rx < 0 || rx >= sim->cfg.nrx)
+        return (-1);
+    pos = rxPos(&sim->rx[rx], sim->iblock);
+    xyz[0] = pos[0];
+    xyz[1] = pos[1];
+    xyz[2] = pos[2];
+
+    return (0);
+}
+
+int gpssim_get_channels(const gpssim_t *sim, int rx, gpssim_channel_t *ch, int max) {
+    const channel_t *chan;
+    const double *gain;
+    int i, n = 0;
+
+    if (rx < 0 || rx >= sim->cfg.nrx)
+        return (-1);
+    chan = sim->rx[rx].chan;
+    gain = sim->rx[rx].gain;
+
+    for (i = 0; i < sim->cfg.nchan && n < max; i++) {
+        if (chan[i].prn == 0)
+            continue;
+        ch[n].prn = chan[i].prn;
+        ch[n].az = chan[i].azel[0] * R2D;
+        ch[n].el = chan[i].azel[1] * R2D;
+        ch[n].range = chan[i].rho0.range;
+        ch[n].doppler = chan[i].f_carr;
+        ch[n].code_phase = chan[i].code_phase;
+        ch[n].carr_phase = carrierPhase(&chan[i]);
+        ch[n].gain_db = (gain[i] > 0.0) ? 20.0 * log10(gain[i]) : -999.0;
+        n++;
+    }
+
+    return (n);
+}
+
+int gpssim_rx_state(const gpssim_t *sim, int rx, const channel_t **chan, const range_t **rho, const double **gain) {
+    if (rx < 0 || rx >= sim->cfg.nrx)
+        return (-1);
+    *chan = sim->rx[rx].chan;
+    *rho = sim->rx[rx].rho;
+    *gain = sim->rx[rx].gain;
+
+    return (0);
+}
+
+const ionoutc_t *gpssim_ionoutc(const gpssim_t *sim) {
+    return (&sim->ionoutc);
+}
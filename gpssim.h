@@ -0,0 +1,246 @@
+/**
+ * C API of the pluto-gps-sim signal generation engine (libplutogpssim).
+ *
+ * One gpssim_t context holds everything a simulation needs: ephemeris,
+ * satellite state, receivers with their channels and signal pipelines, an
+ * optional antenna array and the signal levels. Contexts are independent,
+ * several of them may run in one process, each one from a single thread at a
+ * time.
+ *
+ * gpssim_generate() streams the first receiver. Several receivers, array
+ * elements or one block to several sinks use the block API: gpssim_step()
+ * advances all receivers by one 0.1s block, gpssim_render() and
+ * gpssim_pack() produce the samples of one receiver or element.
+ *
+ * This file is part of the pluto-gps-sim project at
+ * https://github.com/mictronics/pluto-gps-sim.git
+ *
+ * Copyright © 2019 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+#ifndef GPSSIM_H
+#define GPSSIM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! \brief Engine context, opaque */
+typedef struct gpssim gpssim_t;
+
+/*! \brief Engine configuration, see gpssim_config_default() */
+typedef struct {
+    long long fs_hz; /*!< Output sample rate in Hz, multiple of 10 (default 3000000) */
+    long long gen_hz; /*!< Generation rate in Hz, resampled to fs_hz, 0 = fs_hz */
+    int nchan; /*!< Number of channels (default 32) */
+    int fir_taps; /*!< Band-limiting FIR taps, 0 = off */
+    double bw_hz; /*!< Band-limiting FIR bandwidth in Hz */
+    double noise_cn0; /*!< White Gaussian noise C/N0 in dB-Hz, < 0 = off */
+    uint64_t noise_seed; /*!< Noise generator seed */
+    int autoscale; /*!< Scale output to the 12-bit DAC range */
+    int iono; /*!< Apply the ionospheric delay */
+    int nrx; /*!< Number of receivers sharing the satellite state (default 1) */
+    int nelem; /*!< Antenna array elements of the only receiver, 0 = no array */
+    int carr_bits; /*!< Carrier table phase resolution in bits (default 9) */
+    int phasor; /*!< Phasor carrier kernel instead of the table one */
+    double tmpl_bound; /*!< Code template refresh bound in Hz, 0 = off */
+    int msb; /*!< MSB-aligned 12-bit output samples */
+} gpssim_config_t;
+
+/*! \brief State of one allocated channel */
+typedef struct {
+    int prn;
+    double az; /*!< Azimuth in degree */
+    double el; /*!< Elevation in degree */
+    double range; /*!< Pseudorange in meters */
+    double doppler; /*!< Carrier Doppler in Hz */
+    double code_phase; /*!< Code phase in chips */
+    double carr_phase; /*!< Carrier phase in cycles */
+    double gain_db; /*!< Signal gain in dB */
+} gpssim_channel_t;
+
+/*! \brief Fill a configuration with the defaults of pluto-gps-sim */
+void gpssim_config_default(gpssim_config_t *cfg);
+
+/*! \brief Create an engine context
+ *  \returns Context, NULL on invalid configuration or allocation error
+ */
+gpssim_t *gpssim_create(const gpssim_config_t *cfg);
+
+/*! \brief Release an engine context */
+void gpssim_destroy(gpssim_t *sim);
+
+/*! \brief Load a RINEX navigation file, plain or gzip compressed
+ *  \param[in] rinex3 Non-zero for RINEX version 3
+ *  \returns Number of ephemeris sets, -1 on error
+ */
+int gpssim_load_ephemeris(gpssim_t *sim, const char *filename, int rinex3);
+
+/*! \brief Take the ephemeris of another context without parsing the file again
+ *  \returns Number of ephemeris sets, -1 if \a from has none
+ */
+int gpssim_copy_ephemeris(gpssim_t *sim, const gpssim_t *from);
+
+/*! \brief Convert latitude, longitude in degree and height in meters to ECEF in meters */
+void gpssim_llh_to_xyz(const double llh[3], double xyz[3]);
+
+/*! \brief Create a context with the configuration, ephemeris, signal levels and positions of another
+ *
+ * The copy is not started, it renders the same scenario as the original,
+ * e.g. one part of it in another thread.
+ *  \returns Context, NULL on allocation error
+ */
+gpssim_t *gpssim_clone(const gpssim_t *sim);
+
+/*! \brief Time of the first and the last ephemeris set
+ *  \returns 0 on success, -1 without ephemeris
+ */
+int gpssim_get_ephemeris_range(const gpssim_t *sim, int *week0, double *sec0, int *week1, double *sec1);
+
+/*! \brief Move the ephemeris to a start time, as pluto-gps-sim -T
+ *
+ * TOC and TOE of all sets and the UTC reference are shifted so the first set
+ * starts at the 2 hour boundary before the given time.
+ *  \returns 0 on success, -1 without ephemeris or once started
+ */
+int gpssim_shift_ephemeris(gpssim_t *sim, int week, double sec);
+
+/*! \brief Check that an ephemeris set covers a start time
+ *  \returns 0 if gpssim_start() can start there, -1 if not
+ */
+int gpssim_check_start(const gpssim_t *sim, int week, double sec);
+
+/*! \brief Set a static receiver position, ECEF in meters
+ *
+ * Once started the receiver jumps there with the next 0.1s block, the
+ * visible satellites are allocated again.
+ *  \param[in] rx Receiver, 0 .. nrx - 1
+ *  \returns 0 on success, -1 on error
+ */
+int gpssim_set_position(gpssim_t *sim, int rx, const double xyz[3]);
+
+/*! \brief Set a receiver trajectory, ECEF points in meters at 10Hz
+ *
+ * The points are copied, the trajectory repeats after the last point. It
+ * takes effect with the next 0.1s block.
+ *  \param[in] rx Receiver, 0 .. nrx - 1
+ *  \returns 0 on success, -1 on error
+ */
+int gpssim_set_trajectory(gpssim_t *sim, int rx, const double (*xyz)[3], int npoints);
+
+/*! \brief Set position and gain of one antenna array element
+ *  \param[in] elem Element, 0 .. nelem - 1
+ *  \param[in] enu Offset from the receiver position, east/north/up in meters
+ *  \param[in] gain_db Element gain in dB
+ *  \returns 0 on success, -1 without array or on invalid element
+ */
+int gpssim_set_element(gpssim_t *sim, int elem, const double enu[3], double gain_db);
+
+/*! \brief Set the signal power offset of one PRN in dB, takes effect with the next 0.1s block */
+int gpssim_set_power(gpssim_t *sim, int prn, double db);
+
+/*! \brief Set an absolute C/N0 target of one PRN in dB-Hz, relative to the noise stage
+ *
+ * The target replaces path loss, antenna pattern and power offset of the PRN.
+ * It may lie at most about 90dB above the noise C/N0 with the 9-bit carrier
+ * table and 32 channels, less with more channels or larger tables.
+ *  \param[in] dbhz C/N0 target, < 0 returns to the modelled level
+ *  \returns 0 on success, -1 on invalid value, a target too far above the noise or without noise stage
+ */
+int gpssim_set_cn0(gpssim_t *sim, int prn, double dbhz);
+
+/*! \brief Add multipath echoes, e.g. "5:150:-6,12:40:-3:0.5:90"
+ *
+ * Each echo is prn:delay:power[:doppler[:phase]] with the excess delay in
+ * meters, the power in dB, the Doppler offset in Hz and the phase offset in
+ * degree relative to the direct path.
+ *  \returns 0 on success, -1 on syntax error, too many echoes or with an antenna array
+ */
+int gpssim_add_echoes(gpssim_t *sim, const char *spec);
+
+/*! \brief Switch the ionospheric delay on or off, takes effect with the next 0.1s block */
+void gpssim_set_iono(gpssim_t *sim, int on);
+
+/*! \brief Start the scenario, allocate the visible satellites of all receivers
+ *
+ * A context can be started again for the next scenario, the signal pipelines
+ * and their filters are kept.
+ *  \param[in] week GPS week, < 0 starts at the first ephemeris set
+ *  \param[in] sec GPS seconds of week
+ *  \returns 0 on success, -1 if no ephemeris set covers the start time
+ */
+int gpssim_start(gpssim_t *sim, int week, double sec);
+
+/*! \brief Advance all receivers to the next 0.1s block
+ *
+ * Updates satellite states, channels and navigation message of all
+ * receivers. The samples of the block follow from gpssim_render().
+ *  \returns 0 on success, -1 if not started or on allocation error
+ */
+int gpssim_step(gpssim_t *sim);
+
+/*! \brief Render the current block of one receiver, all array elements with an array
+ *  \returns 0 on success, -1 before gpssim_step() or on allocation error
+ */
+int gpssim_render(gpssim_t *sim, int rx);
+
+/*! \brief Scale the rendered block of a receiver or array element to 16-bit I/Q
+ *
+ * May be called for any number of output buffers, e.g. one per device the
+ * block goes to.
+ *  \param[in] elem Array element, 0 without array
+ *  \param[out] iq Buffer for one block, fs_hz / 10 I/Q samples
+ *  \returns Number of saturated values, -1 on error
+ */
+int gpssim_pack(const gpssim_t *sim, int rx, int elem, short *iq);
+
+/*! \brief Skip blocks without rendering them
+ *
+ * The block before the target is the last one skipped, render it with
+ * gpssim_step() and gpssim_render() to give the filters their history.
+ *  \param[in] block Next block to step to, not before the current one
+ *  \returns 0 on success, -1 if not started or on a block in the past
+ */
+int gpssim_seek(gpssim_t *sim, int block);
+
+/*! \brief Generate the next samples of the first receiver into a caller buffer
+ *
+ * Samples are interleaved 16-bit I/Q and written straight from the pipeline
+ * into \a iq. Any count is allowed, blocks continue across calls. With an
+ * antenna array this is the first element. Do not mix with the block API.
+ *  \param[out] iq Buffer for 2 * \a nsamp values
+ *  \param[in] nsamp Number of I/Q samples
+ *  \returns Number of samples written, -1 on error
+ */
+long gpssim_generate(gpssim_t *sim, short *iq, long nsamp);
+
+/*! \brief Time of the next generated sample
+ *  \returns 0 on success, -1 if not started
+ */
+int gpssim_get_time(const gpssim_t *sim, int *week, double *sec);
+
+/*! \brief Current block and its receiver time, see gpssim_step()
+ *  \returns 0 on success, -1 if not started
+ */
+int gpssim_get_block(const gpssim_t *sim, int *block, int *week, double *sec);
+
+/*! \brief Position of a receiver in the current block, ECEF in meters
+ *  \returns 0 on success, -1 on invalid receiver
+ */
+int gpssim_get_position(const gpssim_t *sim, int rx, double xyz[3]);
+
+/*! \brief State of the allocated channels of a receiver at the end of the last generated 0.1s block
+ *  \param[out] ch Channel states
+ *  \param[in] max Entries of \a ch
+ *  \returns Number of channels written, -1 on invalid receiver
+ */
+int gpssim_get_channels(const gpssim_t *sim, int rx, gpssim_channel_t *ch, int max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GPSSIM_H */
@@ -0,0 +1,235 @@
+/**
+ * Internal interface of the libplutogpssim engine, shared by the tools of
+ * this project. It is not installed, applications use gpssim.h.
+ *
+ * The engine exports the functions declared here with the gpssim_ prefix,
+ * the defines below map the names the tools use onto the exported ones.
+ * Everything else in gpssim.c stays static.
+ *
+ * This file is part of the pluto-gps-sim project at
+ * https://github.com/mictronics/pluto-gps-sim.git
+ *
+ * Copyright © 2019 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+#ifndef GPSSIM_INT_H
+#define GPSSIM_INT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "plutogpssim.h"
+#include "gpssim.h"
+
+#define codegen gpssim_codegen
+#define caCode gpssim_caCode
+#define initCarrierTable gpssim_initCarrierTable
+#define outputScale gpssim_outputScale
+#define packSamples gpssim_packSamples
+#define iqShift gpssim_iqShift
+#define iqBytes gpssim_iqBytes
+#define iqCompress gpssim_iqCompress
+#define iqExpand gpssim_iqExpand
+#define setChannelGain gpssim_setChannelGain
+#define parsePrnLevels gpssim_parsePrnLevels
+#define awgnInit gpssim_awgnInit
+#define awgnAdd gpssim_awgnAdd
+#define awgnFree gpssim_awgnFree
+#define firInit gpssim_firInit
+#define firProcess gpssim_firProcess
+#define firFree gpssim_firFree
+#define gcdLL gpssim_gcdLL
+#define date2gps gpssim_date2gps
+#define gps2date gpssim_gps2date
+#define xyz2llh gpssim_xyz2llh
+#define llh2xyz gpssim_llh2xyz
+#define satpos gpssim_satpos
+#define eph2sbf gpssim_eph2sbf
+#define computeChecksum gpssim_computeChecksum
+#define subGpsTime gpssim_subGpsTime
+#define incGpsTime gpssim_incGpsTime
+#define readRinex2 gpssim_readRinex2
+#define readRinex3 gpssim_readRinex3
+#define rangeFromState gpssim_rangeFromState
+#define carrierPhase gpssim_carrierPhase
+#define generateSamples gpssim_generateSamples
+#define generateSamplesTmpl gpssim_generateSamplesTmpl
+#define generateSamplesPhasor gpssim_generateSamplesPhasor
+#define generateSamplesPhasorTmpl gpssim_generateSamplesPhasorTmpl
+#define refreshCodeTemplates gpssim_refreshCodeTemplates
+#define freeCodeTemplates gpssim_freeCodeTemplates
+#define echoStart gpssim_echoStart
+#define echoRender gpssim_echoRender
+#define readUserMotion gpssim_readUserMotion
+#define generateNavMsg gpssim_generateNavMsg
+#define channelNav gpssim_channelNav
+#define thread_to_core gpssim_thread_to_core
+#define timeDiffUs gpssim_timeDiffUs
+
+/*! \brief Samples per phasor sub-block, phasors are renormalized after each */
+#define PHASOR_SUB (256)
+
+/*! \brief Channels the phasor kernel rotates together, one SIMD vector */
+#define PHASOR_LANES (4)
+
+/*! \brief Floats in the chip buffer of the phasor kernels, see pipelineInit() */
+#define PHASOR_WORK (PHASOR_SUB * MAX_CHAN)
+
+/*! \brief Carrier sin/cos table of a run, see initCarrierTable() */
+struct carrier_table {
+    const int *cos;
+    const int *sin;
+    int bits; // Phase resolution
+    int size;
+    double ampl; // Amplitude, scaled with phase resolution
+    int *buf; // Table above 9 bits, NULL for the built-in one
+};
+
+/*! \brief Additive white Gaussian noise stage
+ *
+ * NOISE_LANES interleaved xoshiro128** streams produce the uniform numbers in
+ * bulk, a Ziggurat turns them into normal deviates. A separate scalar stream
+ * serves the rare Ziggurat rejections, so the output does not depend on the
+ * instruction set.
+ */
+struct awgn {
+    uint32_t s[4][NOISE_LANES]; // Vector generator state, word major
+    uint32_t t[4]; // Scalar generator state
+    uint32_t kn[ZIG_LAYERS];
+    float wn[ZIG_LAYERS];
+    float fn[ZIG_LAYERS];
+    uint32_t *rnd; // Uniform numbers of one block
+    int rnd_len;
+    uint64_t seed;
+    double sigma; // Noise RMS per I/Q component at accumulator level, 0 = off
+};
+
+/*! \brief Signal levels of a run: carrier table, power per PRN, multipath echoes and noise
+ *
+ * Shared read-only by the channel updates and signal pipelines of all
+ * receivers of one engine context.
+ */
+struct signal_model {
+    struct carrier_table carr;
+    double prn_gain[MAX_SAT]; // Linear power offset applied to the modelled gain
+    double prn_fixed[MAX_SAT]; // Gain of an absolute C/N0 target, 0 = modelled
+    echo_t echo[MAX_ECHOES]; // Multipath echoes, see parseEchoes()
+    int necho;
+    struct awgn noise; // Configured noise stage, each pipeline runs a copy
+};
+
+/*! \brief Polyphase FIR resampler for interleaved I/Q
+ *
+ * Resamples by L/M with a prototype lowpass of L * ntaps taps. The taps of
+ * each phase are stored reversed and duplicated for I and Q, so one output
+ * sample is a single dot product over the interleaved input history.
+ */
+struct fir_filter {
+    int L; // Interpolation factor, number of phases
+    int M; // Decimation factor
+    int ntaps; // Taps per phase
+    float *taps; // L phases of 2 * ntaps taps
+    float *buf; // ntaps - 1 samples history followed by one input chunk
+    long p; // Next output position in 1/L input samples, relative to the chunk
+};
+
+/*! \brief Read position of one multipath echo inside a block
+ *
+ * The echo follows the direct path with a fixed code delay. It reads the C/A
+ * code and the data words of the direct channel and keeps only its own
+ * counters, carrier phase and gain.
+ */
+typedef struct {
+    const channel_t *chan; /*!< Direct path channel */
+    double code_phase; /*!< Code phase in chips */
+    int iword, ibit, icode; /*!< Data bit counters */
+    int dataBit;
+#ifdef FLOAT_CARR_PHASE
+    double carr_phase;
+    double carr_step;
+#else
+    unsigned int carr_phase;
+    int carr_phasestep;
+#endif
+    int32_t gain_q; /*!< Fixed-point gain, see setChannelGain() */
+} echo_pos_t;
+
+// C/A code and carrier
+void codegen(int *ca, int prn);
+const signed char *caCode(int prn);
+int initCarrierTable(struct carrier_table *carr, int bits);
+
+// Output stage and I/Q file formats
+float outputScale(const channel_t *chan, int nchan, const double *gain, const struct signal_model *sig,
+        bool autoscale);
+int packSamples(const int32_t *acc, short *iq, int nsamp, float scale, int limit, int shift);
+int iqShift(int bits, int out_shift);
+size_t iqBytes(int bits, int nsamp);
+void iqCompress(const short *iq, unsigned char *out, int nsamp, int bits, int shift);
+void iqExpand(const unsigned char *in, short *iq, int nsamp, int bits, int shift);
+
+// Signal levels, noise and filters
+void setChannelGain(channel_t *chan, double gain);
+int parsePrnLevels(const char *arg, double *level, double min, double max);
+int awgnInit(struct awgn *a, double cn0, double fs, uint64_t seed, double ampl);
+int awgnAdd(struct awgn *a, int32_t *acc, int nsamp);
+void awgnFree(struct awgn *a);
+int firInit(struct fir_filter *f, int L, int M, int ntaps, double fc);
+int firProcess(struct fir_filter *f, const int32_t *in, int nin, int32_t *out);
+void firFree(struct fir_filter *f);
+long long gcdLL(long long a, long long b);
+
+// Time, coordinates, orbits and navigation message
+void date2gps(const datetime_t *t, gpstime_t *g);
+void gps2date(const gpstime_t *g, datetime_t *t);
+void xyz2llh(const double *xyz, double *llh);
+void llh2xyz(const double *llh, double *xyz);
+void satpos(ephem_t eph, gpstime_t g, double *pos, double *vel, double *clk);
+void eph2sbf(const ephem_t eph, const ionoutc_t ionoutc, unsigned long sbf[5][N_DWRD_SBF]);
+unsigned long computeChecksum(unsigned long source, int nib);
+double subGpsTime(gpstime_t g1, gpstime_t g0);
+gpstime_t incGpsTime(gpstime_t g0, double dt);
+int readRinex2(ephem_t eph[][MAX_SAT], ionoutc_t *ionoutc, const char *fname);
+int readRinex3(ephem_t eph[][MAX_SAT], ionoutc_t *ionoutc, const char *fname);
+void rangeFromState(range_t *rho, const svstate_t *sv, ionoutc_t *ionoutc, gpstime_t g, double xyz[]);
+int readUserMotion(double xyz[USER_MOTION_SIZE][3], const char *filename);
+int generateNavMsg(gpstime_t g, navmsg_t *nav, int init);
+void channelNav(channel_t *chan, const navmsg_t *nav);
+
+// Sample kernels, see generateSamples()
+double carrierPhase(const channel_t *chan);
+void generateSamples(channel_t *chan, int nchan, int32_t *acc, int nsamp, double delt,
+        const struct carrier_table *carr, float *work);
+void generateSamplesTmpl(channel_t *chan, int nchan, int32_t *acc, int nsamp, double delt,
+        const struct carrier_table *carr, float *work);
+void generateSamplesPhasor(channel_t *chan, int nchan, int32_t *acc, int nsamp, double delt,
+        const struct carrier_table *carr, float *work);
+void generateSamplesPhasorTmpl(channel_t *chan, int nchan, int32_t *acc, int nsamp, double delt,
+        const struct carrier_table *carr, float *work);
+int refreshCodeTemplates(channel_t *chan, int nchan, double delt, double bound);
+void freeCodeTemplates(channel_t *chan, int nchan);
+int echoStart(const struct signal_model *sig, const channel_t *chan, int nchan, echo_pos_t *pos, double delt,
+        long iblock);
+void echoRender(echo_pos_t *pos, int necho, int32_t *acc, int nsamp, double delt, const struct carrier_table *carr);
+
+// Threads and timing of the tools
+int thread_to_core(int core_id);
+double timeDiffUs(const struct timespec *t1, const struct timespec *t0);
+
+/*! \brief Channel state of a receiver in the current block
+ *
+ * Valid from gpssim_step() to the next call that changes the context, the
+ * arrays have gpssim_config_t::nchan entries.
+ *  \param[out] chan Channels
+ *  \param[out] rho Pseudorange of each channel at the end of the block
+ *  \param[out] gain Signal gain of each channel
+ *  \returns 0 on success, -1 on invalid receiver
+ */
+int gpssim_rx_state(const gpssim_t *sim, int rx, const channel_t **chan, const range_t **rho, const double **gain);
+
+/*! \brief Ionospheric and UTC parameters of the loaded ephemeris */
+const ionoutc_t *gpssim_ionoutc(const gpssim_t *sim);
+
+#endif /* GPSSIM_INT_H */
@@ -0,0 +1,293 @@
+/**
+ * iqcheck compares I/Q sample files and golden reference state files
+ * written by pluto-gps-sim in deterministic file sink mode.
+ *
+ * This file is part of the pluto-gps-sim project at
+ * https://github.com/mictronics/pluto-gps-sim.git
+ *
+ * Copyright © 2019 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#define DEFAULT_BLOCK (300000)
+#define MAX_LINE (256)
+#define MAX_REPORT (10)
+
+/*! \brief Comparison tolerances, 0 means bit-exact */
+typedef struct {
+    double rms; /*!< Max. RMS difference of one I/Q block in LSB */
+    double code; /*!< Max. code phase difference in chips */
+    double carr; /*!< Max. carrier phase difference in cycles */
+    double doppler; /*!< Max. Doppler difference in Hz */
+} tolerance_t;
+
+/*! \brief One line of a golden reference state file */
+typedef struct {
+    char type; /*!< 'C' channel state, 'B' block hash */
+    int block;
+    int prn;
+    double code_phase;
+    double carr_phase;
+    double f_carr;
+    int iword, ibit, icode, dataBit;
+    unsigned long long hash;
+} state_t;
+
+static void usage(void) {
+    fprintf(stderr, "Usage: iqcheck [options]\n"
+            "Options:\n"
+            "  -r <file name>   Reference I/Q file (16-bit interleaved)\n"
+            "  -t <file name>   I/Q file under test\n"
+            "  -R <file name>   Reference golden state file (pluto-gps-sim -g)\n"
+            "  -T <file name>   Golden state file under test\n"
+            "  -b <samples>     Samples per block (default %d)\n"
+            "  -m <lsb>         Max. RMS difference per I/Q block (default 0, bit-exact)\n"
+            "  -c <chips>       Max. code phase difference (default 0)\n"
+            "  -p <cycles>      Max. carrier phase difference (default 0)\n"
+            "  -D <hz>          Max. Doppler difference (default 0)\n",
+            DEFAULT_BLOCK);
+
+    return;
+}
+
+/*! \brief Compare two I/Q files block by block
+ *  \returns Number of blocks out of tolerance, -1 on error
+ */
+static long compareIQ(const char *ref_name, const char *test_name, int block, const tolerance_t *tol) {
+    FILE *fref, *ftest;
+    short *ref, *test;
+    size_t nref, ntest, k;
+    long iblock = 0, failed = 0;
+    double sum, d, rms, max_rms = 0.0;
+
+    fref = fopen(ref_name, "rb");
+    ftest = fopen(test_name, "rb");
+    ref = malloc((size_t) block * 2 * sizeof (short));
+    test = malloc((size_t) block * 2 * sizeof (short));
+    if (fref == NULL || ftest == NULL || ref == NULL || test == NULL) {
+        fprintf(stderr, "ERROR: Failed to open I/Q files.\n");
+        failed = -1;
+        goto compare_iq_exit;
+    }
+
+    while (1) {
+        nref = fread(ref, 2 * sizeof (short), block, fref);
+        ntest = fread(test, 2 * sizeof (short), block, ftest);
+        if (nref != ntest) {
+            printf("IQ block %ld: length differs (%zu vs %zu samples)\n", iblock, nref, ntest);
+            failed++;
+            break;
+        }
+        if (nref == 0)
+            break;
+
+        if (tol->rms <= 0.0) {
+            if (memcmp(ref, test, nref * 2 * sizeof (short)) != 0) {
+                if (failed < MAX_REPORT)
+                    printf("IQ block %ld: not bit-exact\n", iblock);
+                failed++;
+            }
+        } else {
+            sum = 0.0;
+            for (k = 0; k < nref * 2; k++) {
+                d = (double) ref[k] - (double) test[k];
+                sum += d * d;
+            }
+            rms = sqrt(sum / (double) (nref * 2));
+            if (rms > max_rms)
+                max_rms = rms;
+            if (rms > tol->rms) {
+                if (failed < MAX_REPORT)
+                    printf("IQ block %ld: RMS difference %.3f LSB\n", iblock, rms);
+                failed++;
+            }
+        }
+        iblock++;
+    }
+
+    printf("IQ: %ld blocks compared, %ld failed", iblock, failed);
+    if (tol->rms > 0.0)
+        printf(", max. RMS difference %.3f LSB", max_rms);
+    printf("\n");
+
+compare_iq_exit:
+    if (fref)
+        fclose(fref);
+    if (ftest)
+        fclose(ftest);
+    free(ref);
+    free(test);
+
+    return (failed);
+}
+
+/*! \brief Read the next line of a golden reference state file
+ *  \returns true on success, false at end of file
+ */
+static bool readState(FILE *fp, state_t *st) {
+    char str[MAX_LINE];
+
+    while (fgets(str, MAX_LINE, fp) != NULL) {
+        memset(st, 0, sizeof (state_t));
+        st->type = str[0];
+        if (st->type == 'C') {
+            if (sscanf(str + 1, "%d %d %lf %lf %lf %d %d %d %d", &st->block, &st->prn,
+                    &st->code_phase, &st->carr_phase, &st->f_carr,
+                    &st->iword, &st->ibit, &st->icode, &st->dataBit) == 9)
+                return (true);
+        } else if (st->type == 'B') {
+            if (sscanf(str + 1, "%d %llx", &st->block, &st->hash) == 2)
+                return (true);
+        }
+    }
+
+    return (false);
+}
+
+/*! \brief Compare two golden reference state files line by line
+ *  \returns Number of lines out of tolerance, -1 on error
+ */
+static long compareState(const char *ref_name, const char *test_name, const tolerance_t *tol) {
+    FILE *fref, *ftest;
+    state_t r, t;
+    bool has_r, has_t;
+    long nline = 0, failed = 0;
+    double dcarr;
+
+    fref = fopen(ref_name, "r");
+    ftest = fopen(test_name, "r");
+    if (fref == NULL || ftest == NULL) {
+        fprintf(stderr, "ERROR: Failed to open state files.\n");
+        if (fref)
+            fclose(fref);
+        if (ftest)
+            fclose(ftest);
+        return (-1);
+    }
+
+    while (1) {
+        has_r = readState(fref, &r);
+        has_t = readState(ftest, &t);
+        if (!has_r || !has_t) {
+            if (has_r != has_t) {
+                printf("State: length differs after %ld lines\n", nline);
+                failed++;
+            }
+            break;
+        }
+        nline++;
+
+        if (r.type != t.type || r.block != t.block || r.prn != t.prn) {
+            printf("State block %d: channel allocation differs (PRN %d vs %d)\n", r.block, r.prn, t.prn);
+            failed++;
+            break;
+        }
+
+        if (r.type == 'B') {
+            // Block hashes only apply to bit-exact comparison
+            if (tol->rms <= 0.0 && r.hash != t.hash) {
+                if (failed < MAX_REPORT)
+                    printf("State block %d: I/Q hash differs\n", r.block);
+                failed++;
+            }
+            continue;
+        }
+
+        // Carrier phase wraps at one cycle
+        dcarr = fabs(r.carr_phase - t.carr_phase);
+        if (dcarr > 0.5)
+            dcarr = 1.0 - dcarr;
+
+        if (fabs(r.code_phase - t.code_phase) > tol->code || dcarr > tol->carr
+                || fabs(r.f_carr - t.f_carr) > tol->doppler
+                || r.iword != t.iword || r.ibit != t.ibit || r.icode != t.icode || r.dataBit != t.dataBit) {
+            if (failed < MAX_REPORT)
+                printf("State block %d PRN %02d: code %.9f/%.9f carr %.9f/%.9f doppler %.6f/%.6f bit %d/%d\n",
+                    r.block, r.prn, r.code_phase, t.code_phase, r.carr_phase, t.carr_phase,
+                    r.f_carr, t.f_carr, r.dataBit, t.dataBit);
+            failed++;
+        }
+    }
+
+    printf("State: %ld lines compared, %ld failed\n", nline, failed);
+
+    fclose(fref);
+    fclose(ftest);
+
+    return (failed);
+}
+
+int main(int argc, char *argv[]) {
+    const char *ref_iq = NULL, *test_iq = NULL;
+    const char *ref_state = NULL, *test_state = NULL;
+    tolerance_t tol = {0.0, 0.0, 0.0, 0.0};
+    int block = DEFAULT_BLOCK;
+    long failed = 0, n;
+    int result;
+
+    while ((result = getopt(argc, argv, "r:t:R:T:b:m:c:p:D:h")) != -1) {
+        switch (result) {
+            case 'r':
+                ref_iq = optarg;
+                break;
+            case 't':
+                test_iq = optarg;
+                break;
+            case 'R':
+                ref_state = optarg;
+                break;
+            case 'T':
+                test_state = optarg;
+                break;
+            case 'b':
+                block = atoi(optarg);
+                break;
+            case 'm':
+                tol.rms = atof(optarg);
+                break;
+            case 'c':
+                tol.code = atof(optarg);
+                break;
+            case 'p':
+                tol.carr = atof(optarg);
+                break;
+            case 'D':
+                tol.doppler = atof(optarg);
+                break;
+            default:
+                usage();
+                exit(2);
+        }
+    }
+
+    if (block <= 0 || ((ref_iq == NULL) != (test_iq == NULL)) || ((ref_state == NULL) != (test_state == NULL))
+            || (ref_iq == NULL && ref_state == NULL)) {
+        usage();
+        exit(2);
+    }
+
+    if (ref_iq != NULL) {
+        n = compareIQ(ref_iq, test_iq, block, &tol);
+        if (n < 0)
+            exit(2);
+        failed += n;
+    }
+
+    if (ref_state != NULL) {
+        n = compareState(ref_state, test_state, &tol);
+        if (n < 0)
+            exit(2);
+        failed += n;
+    }
+
+    printf("%s\n", (failed == 0) ? "PASS" : "FAIL");
+
+    return ((failed == 0) ? 0 : 1);
+}
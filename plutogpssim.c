@@ -1,2819 +1,2854 @@
-/**
- * pluto-gps-sim generates a IQ data stream on-the-fly to simulate a
- * GPS L1 baseband signal using the ADALM-Pluto SDR platform.
- *
- * This file is part of the pluto-gps-sim project at
- * https://github.com/mictronics/pluto-gps-sim.git
- *
- * Copyright © 2019 Mictronics
- * Distributed under the MIT License.
- *
- */
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <math.h>
-#include <time.h>
-#include <pthread.h>
-#include <errno.h>
-#include <signal.h>
-#include <sched.h>
-#include <unistd.h>
-#include <curl/curl.h>
-#include <iio.h>
-#include <ad9361.h>
-#include <zlib.h>
-#if defined(__MACH__) || defined(__APPLE__)
-#include <mach/mach_init.h>
-#include <mach/thread_act.h>
-#include <mach/mach_port.h>
-#endif
-#include "plutogpssim.h"
-
-#define RINEX2_FILE_NAME "rinex2.gz"
-#define RINEX3_FILE_NAME "rinex3.gz"
-#define RINEX_FTP_URL "ftp://igs.bkg.bund.de/IGS/"
-#define RINEX2_SUBFOLDER "nrt"
-#define RINEX3_SUBFOLDER "nrt_v3"
-#define RINEX_FTP_FILE "%s/%03i/%02i/%4s%03i%c.%02in.gz"
-
-#define NOTUSED(V) ((void) V)
-#define MHZ(x) ((long long)(x*1000000.0 + .5))
-#define GHZ(x) ((long long)(x*1000000000.0 + .5))
-#define TX_SAMPLE_FREQ 3000000
-#define NUM_SAMPLES (TX_SAMPLE_FREQ / 10)
-#define BUFFER_SIZE (NUM_SAMPLES * 2 * sizeof(int16_t))
-
-#if defined(__MACH__) || defined(__APPLE__)
-
-typedef struct cpu_set {
-    uint32_t count;
-} cpu_set_t;
-
-static inline void
-CPU_ZERO(cpu_set_t *cs) {
-    cs->count = 0;
-}
-
-static inline void
-CPU_SET(int num, cpu_set_t *cs) {
-    cs->count |= (1 << num);
-}
-
-static inline int
-CPU_ISSET(int num, cpu_set_t *cs) {
-    return (cs->count & (1 << num));
-}
-#endif
-
-struct stream_cfg {
-    long long bw_hz; // Analog banwidth in Hz
-    long long fs_hz; // Baseband sample rate in Hz
-    long long lo_hz; // Local oscillator frequency in Hz
-    const char* rfport; // Port name
-    double gain_db; // Hardware gain
-    pthread_cond_t data_cond;
-    pthread_t tx_thread;
-    pthread_mutex_t data_mutex; // Mutex to synchronize buffer access
-    const char *uri;
-    const char *hostname;
-    bool exit; // Exit from the main loop when true
-};
-
-static struct stream_cfg plutotx;
-static short *iq_buff = NULL;
-static pthread_t pluto_thread;
-static char rinex_date[21];
-
-struct ftp_file {
-    const char *filename;
-    FILE *stream;
-};
-
-const int sinTable512[] = {
-    1, 7, 13, 19, 26, 32, 38, 44, 51, 57, 63, 69, 75, 82, 88, 94,
-    100, 106, 112, 119, 125, 131, 137, 143, 149, 155, 161, 167, 173, 179, 184, 190,
-    196, 202, 208, 213, 219, 225, 230, 236, 241, 247, 252, 258, 263, 269, 274, 279,
-    284, 290, 295, 300, 305, 310, 315, 320, 325, 329, 334, 339, 344, 348, 353, 357,
-    362, 366, 371, 375, 379, 383, 387, 392, 396, 399, 403, 407, 411, 415, 418, 422,
-    425, 429, 432, 436, 439, 442, 445, 448, 451, 454, 457, 460, 462, 465, 468, 470,
-    473, 475, 477, 479, 482, 484, 486, 488, 489, 491, 493, 495, 496, 498, 499, 500,
-    502, 503, 504, 505, 506, 507, 508, 508, 509, 510, 510, 511, 511, 511, 511, 511,
-    512, 511, 511, 511, 511, 511, 510, 510, 509, 508, 508, 507, 506, 505, 504, 503,
-    502, 500, 499, 498, 496, 495, 493, 491, 489, 488, 486, 484, 482, 479, 477, 475,
-    473, 470, 468, 465, 462, 460, 457, 454, 451, 448, 445, 442, 439, 436, 432, 429,
-    425, 422, 418, 415, 411, 407, 403, 399, 396, 392, 387, 383, 379, 375, 371, 366,
-    362, 357, 353, 348, 344, 339, 334, 329, 325, 320, 315, 310, 305, 300, 295, 290,
-    284, 279, 274, 269, 263, 258, 252, 247, 241, 236, 230, 225, 219, 213, 208, 202,
-    196, 190, 184, 179, 173, 167, 161, 155, 149, 143, 137, 131, 125, 119, 112, 106,
-    100, 94, 88, 82, 75, 69, 63, 57, 51, 44, 38, 32, 26, 19, 13, 7,
-    1, -5, -11, -17, -24, -30, -36, -42, -49, -55, -61, -67, -73, -80, -86, -92,
-    -98, -104, -110, -117, -123, -129, -135, -141, -147, -153, -159, -165, -171, -177, -182, -188,
-    -194, -200, -206, -211, -217, -223, -228, -234, -239, -245, -250, -256, -261, -267, -272, -277,
-    -282, -288, -293, -298, -303, -308, -313, -318, -323, -327, -332, -337, -342, -346, -351, -355,
-    -360, -364, -369, -373, -377, -381, -385, -390, -394, -397, -401, -405, -409, -413, -416, -420,
-    -423, -427, -430, -434, -437, -440, -443, -446, -449, -452, -455, -458, -460, -463, -466, -468,
-    -471, -473, -475, -477, -480, -482, -484, -486, -487, -489, -491, -493, -494, -496, -497, -498,
-    -500, -501, -502, -503, -504, -505, -506, -506, -507, -508, -508, -509, -509, -509, -509, -509,
-    -510, -509, -509, -509, -509, -509, -508, -508, -507, -506, -506, -505, -504, -503, -502, -501,
-    -500, -498, -497, -496, -494, -493, -491, -489, -487, -486, -484, -482, -480, -477, -475, -473,
-    -471, -468, -466, -463, -460, -458, -455, -452, -449, -446, -443, -440, -437, -434, -430, -427,
-    -423, -420, -416, -413, -409, -405, -401, -397, -394, -390, -385, -381, -377, -373, -369, -364,
-    -360, -355, -351, -346, -342, -337, -332, -327, -323, -318, -313, -308, -303, -298, -293, -288,
-    -282, -277, -272, -267, -261, -256, -250, -245, -239, -234, -228, -223, -217, -211, -206, -200,
-    -194, -188, -182, -177, -171, -165, -159, -153, -147, -141, -135, -129, -123, -117, -110, -104,
-    -98, -92, -86, -80, -73, -67, -61, -55, -49, -42, -36, -30, -24, -17, -11, -5,
-};
-
-const int cosTable512[] = {
-    512, 511, 511, 511, 511, 511, 510, 510, 509, 508, 508, 507, 506, 505, 504, 503,
-    502, 500, 499, 498, 496, 495, 493, 491, 489, 488, 486, 484, 482, 479, 477, 475,
-    473, 470, 468, 465, 462, 460, 457, 454, 451, 448, 445, 442, 439, 436, 432, 429,
-    425, 422, 418, 415, 411, 407, 403, 399, 396, 392, 387, 383, 379, 375, 371, 366,
-    362, 357, 353, 348, 344, 339, 334, 329, 325, 320, 315, 310, 305, 300, 295, 290,
-    284, 279, 274, 269, 263, 258, 252, 247, 241, 236, 230, 225, 219, 213, 208, 202,
-    196, 190, 184, 179, 173, 167, 161, 155, 149, 143, 137, 131, 125, 119, 112, 106,
-    100, 94, 88, 82, 75, 69, 63, 57, 51, 44, 38, 32, 26, 19, 13, 7,
-    1, -5, -11, -17, -24, -30, -36, -42, -49, -55, -61, -67, -73, -80, -86, -92,
-    -98, -104, -110, -117, -123, -129, -135, -141, -147, -153, -159, -165, -171, -177, -182, -188,
-    -194, -200, -206, -211, -217, -223, -228, -234, -239, -245, -250, -256, -261, -267, -272, -277,
-    -282, -288, -293, -298, -303, -308, -313, -318, -323, -327, -332, -337, -342, -346, -351, -355,
-    -360, -364, -369, -373, -377, -381, -385, -390, -394, -397, -401, -405, -409, -413, -416, -420,
-    -423, -427, -430, -434, -437, -440, -443, -446, -449, -452, -455, -458, -460, -463, -466, -468,
-    -471, -473, -475, -477, -480, -482, -484, -486, -487, -489, -491, -493, -494, -496, -497, -498,
-    -500, -501, -502, -503, -504, -505, -506, -506, -507, -508, -508, -509, -509, -509, -509, -509,
-    -510, -509, -509, -509, -509, -509, -508, -508, -507, -506, -506, -505, -504, -503, -502, -501,
-    -500, -498, -497, -496, -494, -493, -491, -489, -487, -486, -484, -482, -480, -477, -475, -473,
-    -471, -468, -466, -463, -460, -458, -455, -452, -449, -446, -443, -440, -437, -434, -430, -427,
-    -423, -420, -416, -413, -409, -405, -401, -397, -394, -390, -385, -381, -377, -373, -369, -364,
-    -360, -355, -351, -346, -342, -337, -332, -327, -323, -318, -313, -308, -303, -298, -293, -288,
-    -282, -277, -272, -267, -261, -256, -250, -245, -239, -234, -228, -223, -217, -211, -206, -200,
-    -194, -188, -182, -177, -171, -165, -159, -153, -147, -141, -135, -129, -123, -117, -110, -104,
-    -98, -92, -86, -80, -73, -67, -61, -55, -49, -42, -36, -30, -24, -17, -11, -5,
-    0, 7, 13, 19, 26, 32, 38, 44, 51, 57, 63, 69, 75, 82, 88, 94,
-    100, 106, 112, 119, 125, 131, 137, 143, 149, 155, 161, 167, 173, 179, 184, 190,
-    196, 202, 208, 213, 219, 225, 230, 236, 241, 247, 252, 258, 263, 269, 274, 279,
-    284, 290, 295, 300, 305, 310, 315, 320, 325, 329, 334, 339, 344, 348, 353, 357,
-    362, 366, 371, 375, 379, 383, 387, 392, 396, 399, 403, 407, 411, 415, 418, 422,
-    425, 429, 432, 436, 439, 442, 445, 448, 451, 454, 457, 460, 462, 465, 468, 470,
-    473, 475, 477, 479, 482, 484, 486, 488, 489, 491, 493, 495, 496, 498, 499, 500,
-    502, 503, 504, 505, 506, 507, 508, 508, 509, 510, 510, 511, 511, 511, 511, 511,
-};
-
-// Receiver antenna attenuation in dB for boresight angle = 0:5:180 [deg]
-const double ant_pat_db[37] = {
-    0.00, 0.00, 0.22, 0.44, 0.67, 1.11, 1.56, 2.00, 2.44, 2.89, 3.56, 4.22,
-    4.89, 5.56, 6.22, 6.89, 7.56, 8.22, 8.89, 9.78, 10.67, 11.56, 12.44, 13.33,
-    14.44, 15.56, 16.67, 17.78, 18.89, 20.00, 21.33, 22.67, 24.00, 25.56, 27.33, 29.33,
-    31.56
-};
-
-static int allocatedSat[MAX_SAT];
-
-/*! \brief Subtract two vectors of double
- *  \param[out] y Result of subtraction
- *  \param[in] x1 Minuend of subtracion
- *  \param[in] x2 Subtrahend of subtracion
- */
-static void subVect(double *y, const double *x1, const double *x2) {
-    y[0] = x1[0] - x2[0];
-    y[1] = x1[1] - x2[1];
-    y[2] = x1[2] - x2[2];
-
-    return;
-}
-
-/*! \brief Compute Norm of Vector
- *  \param[in] x Input vector
- *  \returns Length (Norm) of the input vector
- */
-static double normVect(const double *x) {
-    return (sqrt(x[0] * x[0] + x[1] * x[1] + x[2] * x[2]));
-}
-
-/*! \brief Compute dot-product of two vectors
- *  \param[in] x1 First multiplicand
- *  \param[in] x2 Second multiplicand
- *  \returns Dot-product of both multiplicands
- */
-static double dotProd(const double *x1, const double *x2) {
-    return (x1[0] * x2[0] + x1[1] * x2[1] + x1[2] * x2[2]);
-}
-
-/* !\brief generate the C/A code sequence for a given Satellite Vehicle PRN
- *  \param[in] prn PRN nuber of the Satellite Vehicle
- *  \param[out] ca Caller-allocated integer array of 1023 bytes
- */
-static void codegen(int *ca, int prn) {
-    int delay[] = {
-        5, 6, 7, 8, 17, 18, 139, 140, 141, 251,
-        252, 254, 255, 256, 257, 258, 469, 470, 471, 472,
-        473, 474, 509, 512, 513, 514, 515, 516, 859, 860,
-        861, 862
-    };
-
-    int g1[CA_SEQ_LEN], g2[CA_SEQ_LEN];
-    int r1[N_DWRD_SBF], r2[N_DWRD_SBF];
-    int c1, c2;
-    int i, j;
-
-    if (prn < 1 || prn > 32)
-        return;
-
-    for (i = 0; i < N_DWRD_SBF; i++)
-        r1[i] = r2[i] = -1;
-
-    for (i = 0; i < CA_SEQ_LEN; i++) {
-        g1[i] = r1[9];
-        g2[i] = r2[9];
-        c1 = r1[2] * r1[9];
-        c2 = r2[1] * r2[2] * r2[5] * r2[7] * r2[8] * r2[9];
-
-        for (j = 9; j > 0; j--) {
-            r1[j] = r1[j - 1];
-            r2[j] = r2[j - 1];
-        }
-        r1[0] = c1;
-        r2[0] = c2;
-    }
-
-    for (i = 0, j = CA_SEQ_LEN - delay[prn - 1]; i < CA_SEQ_LEN; i++, j++)
-        ca[i] = (1 - g1[i] * g2[j % CA_SEQ_LEN]) / 2;
-
-    return;
-}
-
-/*! \brief Convert a UTC date into a GPS date
- *  \param[in] t input date in UTC form
- *  \param[out] g output date in GPS form
- */
-static void date2gps(const datetime_t *t, gpstime_t *g) {
-    int doy[12] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
-    int ye;
-    int de;
-    int lpdays;
-
-    ye = t->y - 1980;
-
-    // Compute the number of leap days since Jan 5/Jan 6, 1980.
-    lpdays = ye / 4 + 1;
-    if ((ye % 4) == 0 && t->m <= 2)
-        lpdays--;
-
-    // Compute the number of days elapsed since Jan 5/Jan 6, 1980.
-    de = ye * 365 + doy[t->m - 1] + t->d + lpdays - 6;
-
-    // Convert time to GPS weeks and seconds.
-    g->week = de / 7;
-    g->sec = (double) (de % 7) * SECONDS_IN_DAY + t->hh * SECONDS_IN_HOUR
-            + t->mm * SECONDS_IN_MINUTE + t->sec;
-
-    return;
-}
-
-static void gps2date(const gpstime_t *g, datetime_t *t) {
-    // Convert Julian day number to calendar date
-    int c = (int) (7 * g->week + floor(g->sec / 86400.0) + 2444245.0) + 1537;
-    int d = (int) ((c - 122.1) / 365.25);
-    int e = 365 * d + d / 4;
-    int f = (int) ((c - e) / 30.6001);
-
-    t->d = c - e - (int) (30.6001 * f);
-    t->m = f - 1 - 12 * (f / 14);
-    t->y = d - 4715 - ((7 + t->m) / 10);
-
-    t->hh = ((int) (g->sec / 3600.0)) % 24;
-    t->mm = ((int) (g->sec / 60.0)) % 60;
-    t->sec = g->sec - 60.0 * floor(g->sec / 60.0);
-
-    return;
-}
-
-/*! \brief Convert Earth-centered Earth-fixed (ECEF) into Lat/Long/Heighth
- *  \param[in] xyz Input Array of X, Y and Z ECEF coordinates
- *  \param[out] llh Output Array of Latitude, Longitude and Height
- */
-static void xyz2llh(const double *xyz, double *llh) {
-    double a, eps, e, e2;
-    double x, y, z;
-    double rho2, dz, zdz, nh, slat, n, dz_new;
-
-    a = WGS84_RADIUS;
-    e = WGS84_ECCENTRICITY;
-
-    eps = 1.0e-3;
-    e2 = e*e;
-
-    if (normVect(xyz) < eps) {
-        // Invalid ECEF vector
-        llh[0] = 0.0;
-        llh[1] = 0.0;
-        llh[2] = -a;
-
-        return;
-    }
-
-    x = xyz[0];
-    y = xyz[1];
-    z = xyz[2];
-
-    rho2 = x * x + y*y;
-    dz = e2*z;
-
-    while (1) {
-        zdz = z + dz;
-        nh = sqrt(rho2 + zdz * zdz);
-        slat = zdz / nh;
-        n = a / sqrt(1.0 - e2 * slat * slat);
-        dz_new = n * e2*slat;
-
-        if (fabs(dz - dz_new) < eps)
-            break;
-
-        dz = dz_new;
-    }
-
-    llh[0] = atan2(zdz, sqrt(rho2));
-    llh[1] = atan2(y, x);
-    llh[2] = nh - n;
-
-    return;
-}
-
-/*! \brief Convert Lat/Long/Height into Earth-centered Earth-fixed (ECEF)
- *  \param[in] llh Input Array of Latitude, Longitude and Height
- *  \param[out] xyz Output Array of X, Y and Z ECEF coordinates
- */
-static void llh2xyz(const double *llh, double *xyz) {
-    double n;
-    double a;
-    double e;
-    double e2;
-    double clat;
-    double slat;
-    double clon;
-    double slon;
-    double d, nph;
-    double tmp;
-
-    a = WGS84_RADIUS;
-    e = WGS84_ECCENTRICITY;
-    e2 = e*e;
-
-    clat = cos(llh[0]);
-    slat = sin(llh[0]);
-    clon = cos(llh[1]);
-    slon = sin(llh[1]);
-    d = e*slat;
-
-    n = a / sqrt(1.0 - d * d);
-    nph = n + llh[2];
-
-    tmp = nph*clat;
-    xyz[0] = tmp*clon;
-    xyz[1] = tmp*slon;
-    xyz[2] = ((1.0 - e2) * n + llh[2]) * slat;
-
-    return;
-}
-
-/*! \brief Compute the intermediate matrix for LLH to ECEF
- *  \param[in] llh Input position in Latitude-Longitude-Height format
- *  \param[out] t Three-by-Three output matrix
- */
-static void ltcmat(const double *llh, double t[3][3]) {
-    double slat, clat;
-    double slon, clon;
-
-    slat = sin(llh[0]);
-    clat = cos(llh[0]);
-    slon = sin(llh[1]);
-    clon = cos(llh[1]);
-
-    t[0][0] = -slat*clon;
-    t[0][1] = -slat*slon;
-    t[0][2] = clat;
-    t[1][0] = -slon;
-    t[1][1] = clon;
-    t[1][2] = 0.0;
-    t[2][0] = clat*clon;
-    t[2][1] = clat*slon;
-    t[2][2] = slat;
-
-    return;
-}
-
-/*! \brief Convert Earth-centered Earth-Fixed to ?
- *  \param[in] xyz Input position as vector in ECEF format
- *  \param[in] t Intermediate matrix computed by \ref ltcmat
- *  \param[out] neu Output position as North-East-Up format
- */
-static void ecef2neu(const double *xyz, double t[3][3], double *neu) {
-    neu[0] = t[0][0] * xyz[0] + t[0][1] * xyz[1] + t[0][2] * xyz[2];
-    neu[1] = t[1][0] * xyz[0] + t[1][1] * xyz[1] + t[1][2] * xyz[2];
-    neu[2] = t[2][0] * xyz[0] + t[2][1] * xyz[1] + t[2][2] * xyz[2];
-
-    return;
-}
-
-/*! \brief Convert North-Eeast-Up to Azimuth + Elevation
- *  \param[in] neu Input position in North-East-Up format
- *  \param[out] azel Output array of azimuth + elevation as double
- */
-static void neu2azel(double *azel, const double *neu) {
-    double ne;
-
-    azel[0] = atan2(neu[1], neu[0]);
-    if (azel[0] < 0.0)
-        azel[0] += (2.0 * PI);
-
-    ne = sqrt(neu[0] * neu[0] + neu[1] * neu[1]);
-    azel[1] = atan2(neu[2], ne);
-
-    return;
-}
-
-/*! \brief Compute Satellite position, velocity and clock at given time
- *  \param[in] eph Ephemeris data of the satellite
- *  \param[in] g GPS time at which position is to be computed
- *  \param[out] pos Computed position (vector)
- *  \param[out] vel Computed velociy (vector)
- *  \param[clk] clk Computed clock
- */
-static void satpos(ephem_t eph, gpstime_t g, double *pos, double *vel, double *clk) {
-    // Computing Satellite Velocity using the Broadcast Ephemeris
-    // http://www.ngs.noaa.gov/gps-toolbox/bc_velo.htm
-
-    double tk;
-    double mk;
-    double ek;
-    double ekold;
-    double ekdot;
-    double cek, sek;
-    double pk;
-    double pkdot;
-    double c2pk, s2pk;
-    double uk;
-    double ukdot;
-    double cuk, suk;
-    double ok;
-    double sok, cok;
-    double ik;
-    double ikdot;
-    double sik, cik;
-    double rk;
-    double rkdot;
-    double xpk, ypk;
-    double xpkdot, ypkdot;
-
-    double relativistic, OneMinusecosE, tmp;
-
-    tk = g.sec - eph.toe.sec;
-
-    if (tk > SECONDS_IN_HALF_WEEK)
-        tk -= SECONDS_IN_WEEK;
-    else if (tk<-SECONDS_IN_HALF_WEEK)
-        tk += SECONDS_IN_WEEK;
-
-    mk = eph.m0 + eph.n*tk;
-    ek = mk;
-    ekold = ek + 1.0;
-
-    OneMinusecosE = 0; // Suppress the uninitialized warning.
-    while (fabs(ek - ekold) > 1.0E-14) {
-        ekold = ek;
-        OneMinusecosE = 1.0 - eph.ecc * cos(ekold);
-        ek = ek + (mk - ekold + eph.ecc * sin(ekold)) / OneMinusecosE;
-    }
-
-    sek = sin(ek);
-    cek = cos(ek);
-
-    ekdot = eph.n / OneMinusecosE;
-
-    relativistic = -4.442807633E-10 * eph.ecc * eph.sqrta*sek;
-
-    pk = atan2(eph.sq1e2*sek, cek - eph.ecc) + eph.aop;
-    pkdot = eph.sq1e2 * ekdot / OneMinusecosE;
-
-    s2pk = sin(2.0 * pk);
-    c2pk = cos(2.0 * pk);
-
-    uk = pk + eph.cus * s2pk + eph.cuc*c2pk;
-    suk = sin(uk);
-    cuk = cos(uk);
-    ukdot = pkdot * (1.0 + 2.0 * (eph.cus * c2pk - eph.cuc * s2pk));
-
-    rk = eph.A * OneMinusecosE + eph.crc * c2pk + eph.crs*s2pk;
-    rkdot = eph.A * eph.ecc * sek * ekdot + 2.0 * pkdot * (eph.crs * c2pk - eph.crc * s2pk);
-
-    ik = eph.inc0 + eph.idot * tk + eph.cic * c2pk + eph.cis*s2pk;
-    sik = sin(ik);
-    cik = cos(ik);
-    ikdot = eph.idot + 2.0 * pkdot * (eph.cis * c2pk - eph.cic * s2pk);
-
-    xpk = rk*cuk;
-    ypk = rk*suk;
-    xpkdot = rkdot * cuk - ypk*ukdot;
-    ypkdot = rkdot * suk + xpk*ukdot;
-
-    ok = eph.omg0 + tk * eph.omgkdot - OMEGA_EARTH * eph.toe.sec;
-    sok = sin(ok);
-    cok = cos(ok);
-
-    pos[0] = xpk * cok - ypk * cik*sok;
-    pos[1] = xpk * sok + ypk * cik*cok;
-    pos[2] = ypk*sik;
-
-    tmp = ypkdot * cik - ypk * sik*ikdot;
-
-    vel[0] = -eph.omgkdot * pos[1] + xpkdot * cok - tmp*sok;
-    vel[1] = eph.omgkdot * pos[0] + xpkdot * sok + tmp*cok;
-    vel[2] = ypk * cik * ikdot + ypkdot*sik;
-
-    // Satellite clock correction
-    tk = g.sec - eph.toc.sec;
-
-    if (tk > SECONDS_IN_HALF_WEEK)
-        tk -= SECONDS_IN_WEEK;
-    else if (tk<-SECONDS_IN_HALF_WEEK)
-        tk += SECONDS_IN_WEEK;
-
-    clk[0] = eph.af0 + tk * (eph.af1 + tk * eph.af2) + relativistic - eph.tgd;
-    clk[1] = eph.af1 + 2.0 * tk * eph.af2;
-
-    return;
-}
-
-/*! \brief Compute Subframe from Ephemeris
- *  \param[in] eph Ephemeris of given SV
- *  \param[out] sbf Array of five sub-frames, 10 long words each
- */
-static void eph2sbf(const ephem_t eph, const ionoutc_t ionoutc, unsigned long sbf[5][N_DWRD_SBF]) {
-    unsigned long wn;
-    unsigned long toe;
-    unsigned long toc;
-    unsigned long iode;
-    unsigned long iodc;
-    long deltan;
-    long cuc;
-    long cus;
-    long cic;
-    long cis;
-    long crc;
-    long crs;
-    unsigned long ecc;
-    unsigned long sqrta;
-    long m0;
-    long omg0;
-    long inc0;
-    long aop;
-    long omgdot;
-    long idot;
-    long af0;
-    long af1;
-    long af2;
-    long tgd;
-    int svhlth;
-    int codeL2;
-
-    unsigned long ura = 0UL;
-    unsigned long dataId = 1UL;
-    unsigned long sbf4_page25_svId = 63UL;
-    unsigned long sbf5_page25_svId = 51UL;
-
-    unsigned long wna;
-    unsigned long toa;
-
-    signed long alpha0, alpha1, alpha2, alpha3;
-    signed long beta0, beta1, beta2, beta3;
-    signed long A0, A1;
-    signed long dtls, dtlsf;
-    unsigned long tot, wnt, wnlsf, dn;
-    unsigned long sbf4_page18_svId = 56UL;
-
-    // FIXED: This has to be the "transmission" week number, not for the ephemeris reference time
-    //wn = (unsigned long)(eph.toe.week%1024);
-    wn = 0UL;
-    toe = (unsigned long) (eph.toe.sec / 16.0);
-    toc = (unsigned long) (eph.toc.sec / 16.0);
-    iode = (unsigned long) (eph.iode);
-    iodc = (unsigned long) (eph.iodc);
-    deltan = (long) (eph.deltan / POW2_M43 / PI);
-    cuc = (long) (eph.cuc / POW2_M29);
-    cus = (long) (eph.cus / POW2_M29);
-    cic = (long) (eph.cic / POW2_M29);
-    cis = (long) (eph.cis / POW2_M29);
-    crc = (long) (eph.crc / POW2_M5);
-    crs = (long) (eph.crs / POW2_M5);
-    ecc = (unsigned long) (eph.ecc / POW2_M33);
-    sqrta = (unsigned long) (eph.sqrta / POW2_M19);
-    m0 = (long) (eph.m0 / POW2_M31 / PI);
-    omg0 = (long) (eph.omg0 / POW2_M31 / PI);
-    inc0 = (long) (eph.inc0 / POW2_M31 / PI);
-    aop = (long) (eph.aop / POW2_M31 / PI);
-    omgdot = (long) (eph.omgdot / POW2_M43 / PI);
-    idot = (long) (eph.idot / POW2_M43 / PI);
-    af0 = (long) (eph.af0 / POW2_M31);
-    af1 = (long) (eph.af1 / POW2_M43);
-    af2 = (long) (eph.af2 / POW2_M55);
-    tgd = (long) (eph.tgd / POW2_M31);
-    svhlth = (unsigned long) (eph.svhlth);
-    codeL2 = (unsigned long) (eph.codeL2);
-
-    wna = (unsigned long) (eph.toe.week % 256);
-    toa = (unsigned long) (eph.toe.sec / 4096.0);
-
-    alpha0 = (signed long) round(ionoutc.alpha0 / POW2_M30);
-    alpha1 = (signed long) round(ionoutc.alpha1 / POW2_M27);
-    alpha2 = (signed long) round(ionoutc.alpha2 / POW2_M24);
-    alpha3 = (signed long) round(ionoutc.alpha3 / POW2_M24);
-    beta0 = (signed long) round(ionoutc.beta0 / 2048.0);
-    beta1 = (signed long) round(ionoutc.beta1 / 16384.0);
-    beta2 = (signed long) round(ionoutc.beta2 / 65536.0);
-    beta3 = (signed long) round(ionoutc.beta3 / 65536.0);
-    A0 = (signed long) round(ionoutc.A0 / POW2_M30);
-    A1 = (signed long) round(ionoutc.A1 / POW2_M50);
-    dtls = (signed long) (ionoutc.dtls);
-    tot = (unsigned long) (ionoutc.tot / 4096);
-    wnt = (unsigned long) (ionoutc.wnt % 256);
-    // TO DO: Specify scheduled leap seconds in command options
-    // 2016/12/31 (Sat) -> WNlsf = 1929, DN = 7 (http://navigationservices.agi.com/GNSSWeb/)
-    // Days are counted from 1 to 7 (Sunday is 1).
-    wnlsf = 1929 % 256;
-    dn = 7;
-    dtlsf = 18;
-
-    // Subframe 1
-    sbf[0][0] = 0x8B0000UL << 6;
-    sbf[0][1] = 0x1UL << 8;
-    sbf[0][2] = ((wn & 0x3FFUL) << 20) | ((codeL2 & 0x3UL) << 18) | ((ura & 0xFUL) << 14) | ((svhlth & 0x3FUL) << 8) | (((iodc >> 8)&0x3UL) << 6);
-    sbf[0][3] = 0UL;
-    sbf[0][4] = 0UL;
-    sbf[0][5] = 0UL;
-    sbf[0][6] = (tgd & 0xFFUL) << 6;
-    sbf[0][7] = ((iodc & 0xFFUL) << 22) | ((toc & 0xFFFFUL) << 6);
-    sbf[0][8] = ((af2 & 0xFFUL) << 22) | ((af1 & 0xFFFFUL) << 6);
-    sbf[0][9] = (af0 & 0x3FFFFFUL) << 8;
-
-    // Subframe 2
-    sbf[1][0] = 0x8B0000UL << 6;
-    sbf[1][1] = 0x2UL << 8;
-    sbf[1][2] = ((iode & 0xFFUL) << 22) | ((crs & 0xFFFFUL) << 6);
-    sbf[1][3] = ((deltan & 0xFFFFUL) << 14) | (((m0 >> 24)&0xFFUL) << 6);
-    sbf[1][4] = (m0 & 0xFFFFFFUL) << 6;
-    sbf[1][5] = ((cuc & 0xFFFFUL) << 14) | (((ecc >> 24)&0xFFUL) << 6);
-    sbf[1][6] = (ecc & 0xFFFFFFUL) << 6;
-    sbf[1][7] = ((cus & 0xFFFFUL) << 14) | (((sqrta >> 24)&0xFFUL) << 6);
-    sbf[1][8] = (sqrta & 0xFFFFFFUL) << 6;
-    sbf[1][9] = (toe & 0xFFFFUL) << 14;
-
-    // Subframe 3
-    sbf[2][0] = 0x8B0000UL << 6;
-    sbf[2][1] = 0x3UL << 8;
-    sbf[2][2] = ((cic & 0xFFFFUL) << 14) | (((omg0 >> 24)&0xFFUL) << 6);
-    sbf[2][3] = (omg0 & 0xFFFFFFUL) << 6;
-    sbf[2][4] = ((cis & 0xFFFFUL) << 14) | (((inc0 >> 24)&0xFFUL) << 6);
-    sbf[2][5] = (inc0 & 0xFFFFFFUL) << 6;
-    sbf[2][6] = ((crc & 0xFFFFUL) << 14) | (((aop >> 24)&0xFFUL) << 6);
-    sbf[2][7] = (aop & 0xFFFFFFUL) << 6;
-    sbf[2][8] = (omgdot & 0xFFFFFFUL) << 6;
-    sbf[2][9] = ((iode & 0xFFUL) << 22) | ((idot & 0x3FFFUL) << 8);
-
-    if (ionoutc.vflg == true) {
-        // Subframe 4, page 18
-        sbf[3][0] = 0x8B0000UL << 6;
-        sbf[3][1] = 0x4UL << 8;
-        sbf[3][2] = (dataId << 28) | (sbf4_page18_svId << 22) | ((alpha0 & 0xFFUL) << 14) | ((alpha1 & 0xFFUL) << 6);
-        sbf[3][3] = ((alpha2 & 0xFFUL) << 22) | ((alpha3 & 0xFFUL) << 14) | ((beta0 & 0xFFUL) << 6);
-        sbf[3][4] = ((beta1 & 0xFFUL) << 22) | ((beta2 & 0xFFUL) << 14) | ((beta3 & 0xFFUL) << 6);
-        sbf[3][5] = (A1 & 0xFFFFFFUL) << 6;
-        sbf[3][6] = ((A0 >> 8)&0xFFFFFFUL) << 6;
-        sbf[3][7] = ((A0 & 0xFFUL) << 22) | ((tot & 0xFFUL) << 14) | ((wnt & 0xFFUL) << 6);
-        sbf[3][8] = ((dtls & 0xFFUL) << 22) | ((wnlsf & 0xFFUL) << 14) | ((dn & 0xFFUL) << 6);
-        sbf[3][9] = (dtlsf & 0xFFUL) << 22;
-
-    } else {
-        // Subframe 4, page 25
-        sbf[3][0] = 0x8B0000UL << 6;
-        sbf[3][1] = 0x4UL << 8;
-        sbf[3][2] = (dataId << 28) | (sbf4_page25_svId << 22);
-        sbf[3][3] = 0UL;
-        sbf[3][4] = 0UL;
-        sbf[3][5] = 0UL;
-        sbf[3][6] = 0UL;
-        sbf[3][7] = 0UL;
-        sbf[3][8] = 0UL;
-        sbf[3][9] = 0UL;
-    }
-
-    // Subframe 5, page 25
-    sbf[4][0] = 0x8B0000UL << 6;
-    sbf[4][1] = 0x5UL << 8;
-    sbf[4][2] = (dataId << 28) | (sbf5_page25_svId << 22) | ((toa & 0xFFUL) << 14) | ((wna & 0xFFUL) << 6);
-    sbf[4][3] = 0UL;
-    sbf[4][4] = 0UL;
-    sbf[4][5] = 0UL;
-    sbf[4][6] = 0UL;
-    sbf[4][7] = 0UL;
-    sbf[4][8] = 0UL;
-    sbf[4][9] = 0UL;
-
-    return;
-}
-
-/*! \brief Count number of bits set to 1
- *  \param[in] v long word in which bits are counted
- *  \returns Count of bits set to 1
- */
-static unsigned long countBits(unsigned long v) {
-    unsigned long c;
-    const int S[] = {1, 2, 4, 8, 16};
-    const unsigned long B[] = {
-        0x55555555, 0x33333333, 0x0F0F0F0F, 0x00FF00FF, 0x0000FFFF
-    };
-
-    c = v;
-    c = ((c >> S[0]) & B[0]) + (c & B[0]);
-    c = ((c >> S[1]) & B[1]) + (c & B[1]);
-    c = ((c >> S[2]) & B[2]) + (c & B[2]);
-    c = ((c >> S[3]) & B[3]) + (c & B[3]);
-    c = ((c >> S[4]) & B[4]) + (c & B[4]);
-
-    return (c);
-}
-
-/*! \brief Compute the Checksum for one given word of a subframe
- *  \param[in] source The input data
- *  \param[in] nib Does this word contain non-information-bearing bits?
- *  \returns Computed Checksum
- */
-static unsigned long computeChecksum(unsigned long source, int nib) {
-    /*
-    Bits 31 to 30 = 2 LSBs of the previous transmitted word, D29* and D30*
-    Bits 29 to  6 = Source data bits, d1, d2, ..., d24
-    Bits  5 to  0 = Empty parity bits
-     */
-
-    /*
-    Bits 31 to 30 = 2 LSBs of the previous transmitted word, D29* and D30*
-    Bits 29 to  6 = Data bits transmitted by the SV, D1, D2, ..., D24
-    Bits  5 to  0 = Computed parity bits, D25, D26, ..., D30
-     */
-
-    /*
-                      1            2           3
-    bit    12 3456 7890 1234 5678 9012 3456 7890
-    ---    -------------------------------------
-    D25    11 1011 0001 1111 0011 0100 1000 0000
-    D26    01 1101 1000 1111 1001 1010 0100 0000
-    D27    10 1110 1100 0111 1100 1101 0000 0000
-    D28    01 0111 0110 0011 1110 0110 1000 0000
-    D29    10 1011 1011 0001 1111 0011 0100 0000
-    D30    00 1011 0111 1010 1000 1001 1100 0000
-     */
-
-    unsigned long bmask[6] = {
-        0x3B1F3480UL, 0x1D8F9A40UL, 0x2EC7CD00UL,
-        0x1763E680UL, 0x2BB1F340UL, 0x0B7A89C0UL
-    };
-
-    unsigned long D;
-    unsigned long d = source & 0x3FFFFFC0UL;
-    unsigned long D29 = (source >> 31)&0x1UL;
-    unsigned long D30 = (source >> 30)&0x1UL;
-
-    if (nib) // Non-information bearing bits for word 2 and 10
-    {
-        /*
-        Solve bits 23 and 24 to presearve parity check
-        with zeros in bits 29 and 30.
-         */
-
-        if ((D30 + countBits(bmask[4] & d)) % 2)
-            d ^= (0x1UL << 6);
-        if ((D29 + countBits(bmask[5] & d)) % 2)
-            d ^= (0x1UL << 7);
-    }
-
-    D = d;
-    if (D30)
-        D ^= 0x3FFFFFC0UL;
-
-    D |= ((D29 + countBits(bmask[0] & d)) % 2) << 5;
-    D |= ((D30 + countBits(bmask[1] & d)) % 2) << 4;
-    D |= ((D29 + countBits(bmask[2] & d)) % 2) << 3;
-    D |= ((D30 + countBits(bmask[3] & d)) % 2) << 2;
-    D |= ((D30 + countBits(bmask[4] & d)) % 2) << 1;
-    D |= ((D29 + countBits(bmask[5] & d)) % 2);
-
-    D &= 0x3FFFFFFFUL;
-    //D |= (source & 0xC0000000UL); // Add D29* and D30* from source data bits
-
-    return (D);
-}
-
-/*! \brief Replace all 'E' exponential designators to 'D'
- *  \param str String in which all occurrences of 'E' are replaced with *  'D'
- *  \param len Length of input string in bytes
- *  \returns Number of characters replaced
- */
-static int replaceExpDesignator(char *str, int len) {
-    int i, n = 0;
-
-    for (i = 0; i < len; i++) {
-        if (str[i] == 0) {
-            break;
-        }
-
-        if (str[i] == 'D' || str[i] == 'd') {
-            n++;
-            str[i] = 'E';
-        }
-    }
-
-    return (n);
-}
-
-static double subGpsTime(gpstime_t g1, gpstime_t g0) {
-    double dt;
-
-    dt = g1.sec - g0.sec;
-    dt += (double) (g1.week - g0.week) * SECONDS_IN_WEEK;
-
-    return (dt);
-}
-
-static gpstime_t incGpsTime(gpstime_t g0, double dt) {
-    gpstime_t g1;
-
-    g1.week = g0.week;
-    g1.sec = g0.sec + dt;
-
-    g1.sec = round(g1.sec * 1000.0) / 1000.0; // Avoid rounding error
-
-    while (g1.sec >= SECONDS_IN_WEEK) {
-        g1.sec -= SECONDS_IN_WEEK;
-        g1.week++;
-    }
-
-    while (g1.sec < 0.0) {
-        g1.sec += SECONDS_IN_WEEK;
-        g1.week--;
-    }
-
-    return (g1);
-}
-
-/*! \brief Read Ephemeris data from the RINEX v2 Navigation file */
-
-/*  \param[out] eph Array of Output SV ephemeris data
- *  \param[in] fname File name of the RINEX file
- *  \returns Number of sets of ephemerides in the file
- */
-static int readRinex2(ephem_t eph[][MAX_SAT], ionoutc_t *ionoutc, const char *fname) {
-    struct gzFile_s *fp;
-    int ieph;
-
-    int sv;
-    char str[MAX_CHAR];
-    char tmp[20];
-    double ver = 0.0;
-
-    datetime_t t;
-    gpstime_t g;
-    gpstime_t g0;
-    double dt;
-
-    int flags = 0x0;
-
-    if (NULL == (fp = gzopen(fname, "rt")))
-        return (-1);
-
-    // Clear valid flag
-    for (ieph = 0; ieph < EPHEM_ARRAY_SIZE; ieph++)
-        for (sv = 0; sv < MAX_SAT; sv++)
-            eph[ieph][sv].vflg = false;
-
-    // Read header lines
-    while (1) {
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        if (strncmp(str + 60, "COMMENT", 7) == 0) {
-            continue;
-        } else if (strncmp(str + 60, "END OF HEADER", 13) == 0) {
-            break;
-        } else if (strncmp(str + 60, "RINEX VERSION / TYPE", 20) == 0) {
-            strncpy(tmp, str, 9);
-            tmp[9] = 0;
-            replaceExpDesignator(tmp, 9);
-            ver = atof(tmp);
-            if (ver > 3.0) {
-                gzclose(fp);
-                return -2;
-            }
-
-            if (str[20] != 'N') {
-                gzclose(fp);
-                return -3;
-            }
-        } else if (strncmp(str + 60, "PGM / RUN BY / DATE", 19) == 0) {
-            strncpy(rinex_date, str + 40, 20);
-            rinex_date[20] = 0;
-        } else if (strncmp(str + 60, "ION ALPHA", 9) == 0) {
-            strncpy(tmp, str + 2, 12);
-            tmp[12] = 0;
-            replaceExpDesignator(tmp, 12);
-            ionoutc->alpha0 = atof(tmp);
-
-            strncpy(tmp, str + 14, 12);
-            tmp[12] = 0;
-            replaceExpDesignator(tmp, 12);
-            ionoutc->alpha1 = atof(tmp);
-
-            strncpy(tmp, str + 26, 12);
-            tmp[12] = 0;
-            replaceExpDesignator(tmp, 12);
-            ionoutc->alpha2 = atof(tmp);
-
-            strncpy(tmp, str + 38, 12);
-            tmp[12] = 0;
-            replaceExpDesignator(tmp, 12);
-            ionoutc->alpha3 = atof(tmp);
-
-            flags |= 0x1;
-        } else if (strncmp(str + 60, "ION BETA", 8) == 0) {
-            strncpy(tmp, str + 2, 12);
-            tmp[12] = 0;
-            replaceExpDesignator(tmp, 12);
-            ionoutc->beta0 = atof(tmp);
-
-            strncpy(tmp, str + 14, 12);
-            tmp[12] = 0;
-            replaceExpDesignator(tmp, 12);
-            ionoutc->beta1 = atof(tmp);
-
-            strncpy(tmp, str + 26, 12);
-            tmp[12] = 0;
-            replaceExpDesignator(tmp, 12);
-            ionoutc->beta2 = atof(tmp);
-
-            strncpy(tmp, str + 38, 12);
-            tmp[12] = 0;
-            replaceExpDesignator(tmp, 12);
-            ionoutc->beta3 = atof(tmp);
-
-            flags |= 0x1 << 1;
-        } else if (strncmp(str + 60, "DELTA-UTC", 9) == 0) {
-            strncpy(tmp, str + 3, 19);
-            tmp[19] = 0;
-            replaceExpDesignator(tmp, 19);
-            ionoutc->A0 = atof(tmp);
-
-            strncpy(tmp, str + 22, 19);
-            tmp[19] = 0;
-            replaceExpDesignator(tmp, 19);
-            ionoutc->A1 = atof(tmp);
-
-            strncpy(tmp, str + 41, 9);
-            tmp[9] = 0;
-            ionoutc->tot = atoi(tmp);
-
-            strncpy(tmp, str + 50, 9);
-            tmp[9] = 0;
-            ionoutc->wnt = atoi(tmp);
-
-            if (ionoutc->tot % 4096 == 0)
-                flags |= 0x1 << 2;
-        } else if (strncmp(str + 60, "LEAP SECONDS", 12) == 0) {
-            strncpy(tmp, str, 6);
-            tmp[6] = 0;
-            ionoutc->dtls = atoi(tmp);
-
-            flags |= 0x1 << 3;
-        }
-    }
-
-    ionoutc->vflg = false;
-    if (flags == 0xF) // Read all Iono/UTC lines
-        ionoutc->vflg = true;
-
-    // Read ephemeris blocks
-    g0.week = -1;
-    ieph = 0;
-
-    while (1) {
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        // PRN
-        strncpy(tmp, str, 2);
-        tmp[2] = 0;
-        sv = atoi(tmp) - 1;
-
-        // EPOCH
-        strncpy(tmp, str + 3, 2);
-        tmp[2] = 0;
-        t.y = atoi(tmp) + 2000;
-
-        strncpy(tmp, str + 6, 2);
-        tmp[2] = 0;
-        t.m = atoi(tmp);
-
-        strncpy(tmp, str + 9, 2);
-        tmp[2] = 0;
-        t.d = atoi(tmp);
-
-        strncpy(tmp, str + 12, 2);
-        tmp[2] = 0;
-        t.hh = atoi(tmp);
-
-        strncpy(tmp, str + 15, 2);
-        tmp[2] = 0;
-        t.mm = atoi(tmp);
-
-        strncpy(tmp, str + 18, 4);
-        tmp[2] = 0;
-        t.sec = atof(tmp);
-
-        date2gps(&t, &g);
-
-        if (g0.week == -1)
-            g0 = g;
-
-        // Check current time of clock
-        dt = subGpsTime(g, g0);
-
-        if (dt > SECONDS_IN_HOUR) {
-            g0 = g;
-            ieph++; // a new set of ephemerides
-
-            if (ieph >= EPHEM_ARRAY_SIZE)
-                break;
-        }
-
-        // Date and time
-        eph[ieph][sv].t = t;
-
-        // SV CLK
-        eph[ieph][sv].toc = g;
-
-        strncpy(tmp, str + 22, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19); // tmp[15]='E';
-        eph[ieph][sv].af0 = atof(tmp);
-
-        strncpy(tmp, str + 41, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].af1 = atof(tmp);
-
-        strncpy(tmp, str + 60, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].af2 = atof(tmp);
-
-        // BROADCAST ORBIT - 1
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        strncpy(tmp, str + 3, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].iode = (int) atof(tmp);
-
-        strncpy(tmp, str + 22, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].crs = atof(tmp);
-
-        strncpy(tmp, str + 41, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].deltan = atof(tmp);
-
-        strncpy(tmp, str + 60, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].m0 = atof(tmp);
-
-        // BROADCAST ORBIT - 2
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        strncpy(tmp, str + 3, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].cuc = atof(tmp);
-
-        strncpy(tmp, str + 22, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].ecc = atof(tmp);
-
-        strncpy(tmp, str + 41, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].cus = atof(tmp);
-
-        strncpy(tmp, str + 60, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].sqrta = atof(tmp);
-
-        // BROADCAST ORBIT - 3
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        strncpy(tmp, str + 3, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].toe.sec = atof(tmp);
-
-        strncpy(tmp, str + 22, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].cic = atof(tmp);
-
-        strncpy(tmp, str + 41, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].omg0 = atof(tmp);
-
-        strncpy(tmp, str + 60, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].cis = atof(tmp);
-
-        // BROADCAST ORBIT - 4
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        strncpy(tmp, str + 3, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].inc0 = atof(tmp);
-
-        strncpy(tmp, str + 22, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].crc = atof(tmp);
-
-        strncpy(tmp, str + 41, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].aop = atof(tmp);
-
-        strncpy(tmp, str + 60, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].omgdot = atof(tmp);
-
-        // BROADCAST ORBIT - 5
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        strncpy(tmp, str + 3, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].idot = atof(tmp);
-
-        strncpy(tmp, str + 22, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].codeL2 = (int) atof(tmp);
-
-        strncpy(tmp, str + 41, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].toe.week = (int) atof(tmp);
-
-        // BROADCAST ORBIT - 6
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        strncpy(tmp, str + 22, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].svhlth = (int) atof(tmp);
-        if ((eph[ieph][sv].svhlth > 0) && (eph[ieph][sv].svhlth < 32))
-            eph[ieph][sv].svhlth += 32; // Set MSB to 1
-
-        strncpy(tmp, str + 41, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].tgd = atof(tmp);
-
-        strncpy(tmp, str + 60, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].iodc = (int) atof(tmp);
-
-        // BROADCAST ORBIT - 7
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        // Set valid flag
-        eph[ieph][sv].vflg = true;
-
-        // Update the working variables
-        eph[ieph][sv].A = eph[ieph][sv].sqrta * eph[ieph][sv].sqrta;
-        eph[ieph][sv].n = sqrt(GM_EARTH / (eph[ieph][sv].A * eph[ieph][sv].A * eph[ieph][sv].A)) + eph[ieph][sv].deltan;
-        eph[ieph][sv].sq1e2 = sqrt(1.0 - eph[ieph][sv].ecc * eph[ieph][sv].ecc);
-        eph[ieph][sv].omgkdot = eph[ieph][sv].omgdot - OMEGA_EARTH;
-    }
-
-    gzclose(fp);
-
-    if (g0.week >= 0)
-        ieph += 1; // Number of sets of ephemerides
-
-    return (ieph);
-}
-
-/*! \brief Read Ephemeris data from the RINEX v3 Navigation file */
-
-/*  \param[out] eph Array of Output SV ephemeris data
- *  \param[in] fname File name of the RINEX file
- *  \returns Number of sets of ephemerides in the file
- */
-static int readRinex3(ephem_t eph[][MAX_SAT], ionoutc_t *ionoutc, const char *fname) {
-    struct gzFile_s *fp;
-    int ieph;
-
-    int sv;
-    char str[MAX_CHAR];
-    char tmp[20];
-    double ver = 0.0;
-
-    datetime_t t;
-    gpstime_t g;
-    gpstime_t g0;
-    double dt;
-
-    int flags = 0x0;
-
-    if (NULL == (fp = gzopen(fname, "rt")))
-        return (-1);
-
-    // Clear valid flag
-    for (ieph = 0; ieph < EPHEM_ARRAY_SIZE; ieph++)
-        for (sv = 0; sv < MAX_SAT; sv++)
-            eph[ieph][sv].vflg = false;
-
-    // Read header lines
-    while (1) {
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        if (strncmp(str + 60, "COMMENT", 7) == 0) {
-            continue;
-        } else if (strncmp(str + 60, "END OF HEADER", 13) == 0) {
-            break;
-        } else if (strncmp(str + 60, "RINEX VERSION / TYPE", 20) == 0) {
-            strncpy(tmp, str, 9);
-            tmp[9] = 0;
-            replaceExpDesignator(tmp, 9);
-            ver = atof(tmp);
-            if (ver < 3.0) {
-                gzclose(fp);
-                return -2;
-            }
-
-            if (str[20] != 'N' && str[40] != 'G') {
-                gzclose(fp);
-                return -3;
-            }
-        } else if (strncmp(str + 60, "PGM / RUN BY / DATE", 19) == 0) {
-            strncpy(rinex_date, str + 40, 20);
-            rinex_date[20] = 0;
-        } else if (strncmp(str + 60, "IONOSPHERIC CORR", 16) == 0) {
-            if (strncmp(str, "GPSA", 4) == 0) {
-                strncpy(tmp, str + 5, 12);
-                tmp[12] = 0;
-                replaceExpDesignator(tmp, 12);
-                ionoutc->alpha0 = atof(tmp);
-
-                strncpy(tmp, str + 17, 12);
-                tmp[12] = 0;
-                replaceExpDesignator(tmp, 12);
-                ionoutc->alpha1 = atof(tmp);
-
-                strncpy(tmp, str + 29, 12);
-                tmp[12] = 0;
-                replaceExpDesignator(tmp, 12);
-                ionoutc->alpha2 = atof(tmp);
-
-                strncpy(tmp, str + 41, 12);
-                tmp[12] = 0;
-                replaceExpDesignator(tmp, 12);
-                ionoutc->alpha3 = atof(tmp);
-
-                flags |= 0x1;
-            } else if (strncmp(str, "GPSB", 4) == 0) {
-                strncpy(tmp, str + 5, 12);
-                tmp[12] = 0;
-                replaceExpDesignator(tmp, 12);
-                ionoutc->beta0 = atof(tmp);
-
-                strncpy(tmp, str + 17, 12);
-                tmp[12] = 0;
-                replaceExpDesignator(tmp, 12);
-                ionoutc->beta1 = atof(tmp);
-
-                strncpy(tmp, str + 29, 12);
-                tmp[12] = 0;
-                replaceExpDesignator(tmp, 12);
-                ionoutc->beta2 = atof(tmp);
-
-                strncpy(tmp, str + 41, 12);
-                tmp[12] = 0;
-                replaceExpDesignator(tmp, 12);
-                ionoutc->beta3 = atof(tmp);
-
-                flags |= 0x1 << 1;
-            }
-        } else if (strncmp(str + 60, "TIME SYSTEM CORR", 16) == 0 && strncmp(str, "GPUT", 4) == 0) {
-            strncpy(tmp, str + 5, 17);
-            tmp[17] = 0;
-            replaceExpDesignator(tmp, 17);
-            ionoutc->A0 = atof(tmp);
-
-            strncpy(tmp, str + 22, 16);
-            tmp[16] = 0;
-            replaceExpDesignator(tmp, 16);
-            ionoutc->A1 = atof(tmp);
-
-            strncpy(tmp, str + 38, 7);
-            tmp[7] = 0;
-            replaceExpDesignator(tmp, 7);
-            ionoutc->tot = atoi(tmp);
-
-            strncpy(tmp, str + 45, 6);
-            tmp[6] = 0;
-            ionoutc->wnt = atoi(tmp);
-
-            if (ionoutc->tot % 4096 == 0)
-                flags |= 0x1 << 2;
-        } else if (strncmp(str + 60, "LEAP SECONDS", 12) == 0) {
-            strncpy(tmp, str, 6);
-            tmp[6] = 0;
-            ionoutc->dtls = atoi(tmp);
-
-            flags |= 0x1 << 3;
-        }
-    }
-
-    ionoutc->vflg = false;
-    if (flags == 0xF) // Read all Iono/UTC lines
-        ionoutc->vflg = true;
-
-    // Read ephemeris blocks
-    g0.week = -1;
-    ieph = 0;
-
-    while (1) {
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        // Check for GPS data record
-        if (str[0] != 'G') {
-            continue;
-        }
-
-        // PRN
-        strncpy(tmp, str + 1, 2);
-        tmp[2] = 0;
-        sv = atoi(tmp) - 1;
-
-        // EPOCH
-        strncpy(tmp, str + 4, 4);
-        tmp[4] = 0;
-        t.y = atoi(tmp);
-
-        strncpy(tmp, str + 9, 2);
-        tmp[2] = 0;
-        t.m = atoi(tmp);
-
-        strncpy(tmp, str + 12, 2);
-        tmp[2] = 0;
-        t.d = atoi(tmp);
-
-        strncpy(tmp, str + 15, 2);
-        tmp[2] = 0;
-        t.hh = atoi(tmp);
-
-        strncpy(tmp, str + 18, 2);
-        tmp[2] = 0;
-        t.mm = atoi(tmp);
-
-        strncpy(tmp, str + 21, 2);
-        tmp[2] = 0;
-        t.sec = (double) atoi(tmp);
-
-        date2gps(&t, &g);
-
-        if (g0.week == -1)
-            g0 = g;
-
-        // Check current time of clock
-        dt = subGpsTime(g, g0);
-
-        if (dt > SECONDS_IN_HOUR) {
-            g0 = g;
-            ieph++; // a new set of ephemerides
-
-            if (ieph >= EPHEM_ARRAY_SIZE)
-                break;
-        }
-
-        // Date and time
-        eph[ieph][sv].t = t;
-
-        // SV CLK
-        eph[ieph][sv].toc = g;
-
-        strncpy(tmp, str + 23, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].af0 = atof(tmp);
-
-        strncpy(tmp, str + 42, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].af1 = atof(tmp);
-
-        strncpy(tmp, str + 61, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].af2 = atof(tmp);
-
-        // BROADCAST ORBIT - 1
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        strncpy(tmp, str + 4, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].iode = (int) atof(tmp);
-
-        strncpy(tmp, str + 23, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].crs = atof(tmp);
-
-        strncpy(tmp, str + 42, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].deltan = atof(tmp);
-
-        strncpy(tmp, str + 61, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].m0 = atof(tmp);
-
-        // BROADCAST ORBIT - 2
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        strncpy(tmp, str + 4, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].cuc = atof(tmp);
-
-        strncpy(tmp, str + 23, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].ecc = atof(tmp);
-
-        strncpy(tmp, str + 42, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].cus = atof(tmp);
-
-        strncpy(tmp, str + 61, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].sqrta = atof(tmp);
-
-        // BROADCAST ORBIT - 3
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        strncpy(tmp, str + 4, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].toe.sec = atof(tmp);
-
-        strncpy(tmp, str + 23, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].cic = atof(tmp);
-
-        strncpy(tmp, str + 42, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].omg0 = atof(tmp);
-
-        strncpy(tmp, str + 61, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].cis = atof(tmp);
-
-        // BROADCAST ORBIT - 4
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        strncpy(tmp, str + 4, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].inc0 = atof(tmp);
-
-        strncpy(tmp, str + 23, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].crc = atof(tmp);
-
-        strncpy(tmp, str + 42, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].aop = atof(tmp);
-
-        strncpy(tmp, str + 61, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].omgdot = atof(tmp);
-
-        // BROADCAST ORBIT - 5
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        strncpy(tmp, str + 4, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].idot = atof(tmp);
-
-        strncpy(tmp, str + 23, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].codeL2 = (int) atof(tmp);
-
-        strncpy(tmp, str + 42, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].toe.week = (int) atof(tmp);
-
-        // BROADCAST ORBIT - 6
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        // SV accuracy not read
-
-        strncpy(tmp, str + 23, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].svhlth = (int) atof(tmp);
-        if ((eph[ieph][sv].svhlth > 0) && (eph[ieph][sv].svhlth < 32))
-            eph[ieph][sv].svhlth += 32; // Set MSB to 1
-
-        strncpy(tmp, str + 42, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].tgd = atof(tmp);
-
-        strncpy(tmp, str + 61, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].iodc = (int) atof(tmp);
-
-        // BROADCAST ORBIT - 7
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        // Set valid flag
-        eph[ieph][sv].vflg = true;
-
-        // Update the working variables
-        eph[ieph][sv].A = eph[ieph][sv].sqrta * eph[ieph][sv].sqrta;
-        eph[ieph][sv].n = sqrt(GM_EARTH / (eph[ieph][sv].A * eph[ieph][sv].A * eph[ieph][sv].A)) + eph[ieph][sv].deltan;
-        eph[ieph][sv].sq1e2 = sqrt(1.0 - eph[ieph][sv].ecc * eph[ieph][sv].ecc);
-        eph[ieph][sv].omgkdot = eph[ieph][sv].omgdot - OMEGA_EARTH;
-    }
-
-    gzclose(fp);
-
-    if (g0.week >= 0)
-        ieph += 1; // Number of sets of ephemerides
-
-    return (ieph);
-}
-
-static double ionosphericDelay(const ionoutc_t *ionoutc, gpstime_t g, double *llh, double *azel) {
-    double iono_delay = 0.0;
-    double E, phi_u, lam_u, F;
-
-    if (ionoutc->enable == false)
-        return (0.0); // No ionospheric delay
-
-    E = azel[1] / PI;
-    phi_u = llh[0] / PI;
-    lam_u = llh[1] / PI;
-
-    // Obliquity factor
-    F = 1.0 + 16.0 * pow((0.53 - E), 3.0);
-
-    if (ionoutc->vflg == false)
-        iono_delay = F * 5.0e-9 * SPEED_OF_LIGHT;
-    else {
-        double t, psi, phi_i, lam_i, phi_m, phi_m2, phi_m3;
-        double AMP, PER, X, X2, X4;
-
-        // Earth's central angle between the user position and the earth projection of
-        // ionospheric intersection point (semi-circles)
-        psi = 0.0137 / (E + 0.11) - 0.022;
-
-        // Geodetic latitude of the earth projection of the ionospheric intersection point
-        // (semi-circles)
-        phi_i = phi_u + psi * cos(azel[0]);
-        if (phi_i > 0.416)
-            phi_i = 0.416;
-        else if (phi_i<-0.416)
-            phi_i = -0.416;
-
-        // Geodetic longitude of the earth projection of the ionospheric intersection point
-        // (semi-circles)
-        lam_i = lam_u + psi * sin(azel[0]) / cos(phi_i * PI);
-
-        // Geomagnetic latitude of the earth projection of the ionospheric intersection
-        // point (mean ionospheric height assumed 350 km) (semi-circles)
-        phi_m = phi_i + 0.064 * cos((lam_i - 1.617) * PI);
-        phi_m2 = phi_m*phi_m;
-        phi_m3 = phi_m2*phi_m;
-
-        AMP = ionoutc->alpha0 + ionoutc->alpha1 * phi_m
-                + ionoutc->alpha2 * phi_m2 + ionoutc->alpha3*phi_m3;
-        if (AMP < 0.0)
-            AMP = 0.0;
-
-        PER = ionoutc->beta0 + ionoutc->beta1 * phi_m
-                + ionoutc->beta2 * phi_m2 + ionoutc->beta3*phi_m3;
-        if (PER < 72000.0)
-            PER = 72000.0;
-
-        // Local time (sec)
-        t = SECONDS_IN_DAY / 2.0 * lam_i + g.sec;
-        while (t >= SECONDS_IN_DAY)
-            t -= SECONDS_IN_DAY;
-        while (t < 0)
-            t += SECONDS_IN_DAY;
-
-        // Phase (radians)
-        X = 2.0 * PI * (t - 50400.0) / PER;
-
-        if (fabs(X) < 1.57) {
-            X2 = X*X;
-            X4 = X2*X2;
-            iono_delay = F * (5.0e-9 + AMP * (1.0 - X2 / 2.0 + X4 / 24.0)) * SPEED_OF_LIGHT;
-        } else
-            iono_delay = F * 5.0e-9 * SPEED_OF_LIGHT;
-    }
-
-    return (iono_delay);
-}
-
-/*! \brief Compute range between a satellite and the receiver
- *  \param[out] rho The computed range
- *  \param[in] eph Ephemeris data of the satellite
- *  \param[in] g GPS time at time of receiving the signal
- *  \param[in] xyz position of the receiver
- */
-static void computeRange(range_t *rho, ephem_t eph, ionoutc_t *ionoutc, gpstime_t g, double xyz[]) {
-    double pos[3], vel[3], clk[2];
-    double los[3];
-    double tau;
-    double range, rate;
-    double xrot, yrot;
-
-    double llh[3], neu[3];
-    double tmat[3][3];
-
-    // SV position at time of the pseudorange observation.
-    satpos(eph, g, pos, vel, clk);
-
-    // Receiver to satellite vector and light-time.
-    subVect(los, pos, xyz);
-    tau = normVect(los) / SPEED_OF_LIGHT;
-
-    // Extrapolate the satellite position backwards to the transmission time.
-    pos[0] -= vel[0] * tau;
-    pos[1] -= vel[1] * tau;
-    pos[2] -= vel[2] * tau;
-
-    // Earth rotation correction. The change in velocity can be neglected.
-    xrot = pos[0] + pos[1] * OMEGA_EARTH*tau;
-    yrot = pos[1] - pos[0] * OMEGA_EARTH*tau;
-    pos[0] = xrot;
-    pos[1] = yrot;
-
-    // New observer to satellite vector and satellite range.
-    subVect(los, pos, xyz);
-    range = normVect(los);
-    rho->d = range;
-
-    // Pseudorange.
-    rho->range = range - SPEED_OF_LIGHT * clk[0];
-
-    // Relative velocity of SV and receiver.
-    rate = dotProd(vel, los) / range;
-
-    // Pseudorange rate.
-    rho->rate = rate; // - SPEED_OF_LIGHT*clk[1];
-
-    // Time of application.
-    rho->g = g;
-
-    // Azimuth and elevation angles.
-    xyz2llh(xyz, llh);
-    ltcmat(llh, tmat);
-    ecef2neu(los, tmat, neu);
-    neu2azel(rho->azel, neu);
-
-    // Add ionospheric delay
-    rho->iono_delay = ionosphericDelay(ionoutc, g, llh, rho->azel);
-    rho->range += rho->iono_delay;
-
-    return;
-}
-
-/*! \brief Compute the code phase for a given channel (satellite)
- *  \param chan Channel on which we operate (is updated)
- *  \param[in] rho1 Current range, after \a dt has expired
- *  \param[in dt delta-t (time difference) in seconds
- */
-static void computeCodePhase(channel_t *chan, range_t rho1, double dt) {
-    double ms;
-    int ims;
-    double rhorate;
-
-    // Pseudorange rate.
-    rhorate = (rho1.range - chan->rho0.range) / dt;
-
-    // Carrier and code frequency.
-    chan->f_carr = -rhorate / LAMBDA_L1;
-    chan->f_code = CODE_FREQ + chan->f_carr*CARR_TO_CODE;
-
-    // Initial code phase and data bit counters.
-    ms = ((subGpsTime(chan->rho0.g, chan->g0) + 6.0) - chan->rho0.range / SPEED_OF_LIGHT)*1000.0;
-
-    ims = (int) ms;
-    chan->code_phase = (ms - (double) ims) * CA_SEQ_LEN; // in chip
-
-    chan->iword = ims / 600; // 1 word = 30 bits = 600 ms
-    ims -= chan->iword * 600;
-
-    chan->ibit = ims / 20; // 1 bit = 20 code = 20 ms
-    ims -= chan->ibit * 20;
-
-    chan->icode = ims; // 1 code = 1 ms
-
-    chan->codeCA = chan->ca[(int) chan->code_phase]*2 - 1;
-    chan->dataBit = (int) ((chan->dwrd[chan->iword]>>(29 - chan->ibit)) & 0x1UL)*2 - 1;
-
-    // Save current pseudorange
-    chan->rho0 = rho1;
-
-    return;
-}
-
-/*! \brief Read the list of user motions from the input file
- *  \param[out] xyz Output array of ECEF vectors for user motion
- *  \param[[in] filename File name of the text input file
- *  \returns Number of user data motion records read, -1 on error
- */
-static int readUserMotion(double xyz[USER_MOTION_SIZE][3], const char *filename) {
-    FILE *fp;
-    int numd;
-    char str[MAX_CHAR];
-    double t, x, y, z;
-
-    if (NULL == (fp = fopen(filename, "rt")))
-        return (-1);
-
-    for (numd = 0; numd < USER_MOTION_SIZE; numd++) {
-        if (fgets(str, MAX_CHAR, fp) == NULL)
-            break;
-
-        if (EOF == sscanf(str, "%lf,%lf,%lf,%lf", &t, &x, &y, &z)) // Read CSV line
-            break;
-
-        xyz[numd][0] = x;
-        xyz[numd][1] = y;
-        xyz[numd][2] = z;
-    }
-
-    fclose(fp);
-
-    return (numd);
-}
-
-static int generateNavMsg(gpstime_t g, channel_t *chan, int init) {
-    int iwrd, isbf;
-    gpstime_t g0;
-    unsigned long wn, tow;
-    unsigned sbfwrd;
-    unsigned long prevwrd;
-    int nib;
-
-    g0.week = g.week;
-    g0.sec = (double) (((unsigned long) (g.sec + 0.5)) / 30UL) * 30.0; // Align with the full frame length = 30 sec
-    chan->g0 = g0; // Data bit reference time
-
-    wn = (unsigned long) (g0.week % 1024);
-    tow = ((unsigned long) g0.sec) / 6UL;
-
-    if (init == 1) // Initialize subframe 5
-    {
-        prevwrd = 0UL;
-
-        for (iwrd = 0; iwrd < N_DWRD_SBF; iwrd++) {
-            sbfwrd = chan->sbf[4][iwrd];
-
-            // Add TOW-count message into HOW
-            if (iwrd == 1)
-                sbfwrd |= ((tow & 0x1FFFFUL) << 13);
-
-            // Compute checksum
-            sbfwrd |= (prevwrd << 30) & 0xC0000000UL; // 2 LSBs of the previous transmitted word
-            nib = ((iwrd == 1) || (iwrd == 9)) ? 1 : 0; // Non-information bearing bits for word 2 and 10
-            chan->dwrd[iwrd] = computeChecksum(sbfwrd, nib);
-
-            prevwrd = chan->dwrd[iwrd];
-        }
-    } else // Save subframe 5
-    {
-        for (iwrd = 0; iwrd < N_DWRD_SBF; iwrd++) {
-            chan->dwrd[iwrd] = chan->dwrd[N_DWRD_SBF * N_SBF + iwrd];
-
-            prevwrd = chan->dwrd[iwrd];
-        }
-        /*
-        // Sanity check
-        if (((chan->dwrd[1])&(0x1FFFFUL<<13)) != ((tow&0x1FFFFUL)<<13))
-        {
-                fprintf(stderr, "\nWARNING: Invalid TOW in subframe 5.\n");
-                return(0);
-        }
-         */
-    }
-
-    for (isbf = 0; isbf < N_SBF; isbf++) {
-        tow++;
-
-        for (iwrd = 0; iwrd < N_DWRD_SBF; iwrd++) {
-            sbfwrd = chan->sbf[isbf][iwrd];
-
-            // Add transmission week number to Subframe 1
-            if ((isbf == 0)&&(iwrd == 2))
-                sbfwrd |= (wn & 0x3FFUL) << 20;
-
-            // Add TOW-count message into HOW
-            if (iwrd == 1)
-                sbfwrd |= ((tow & 0x1FFFFUL) << 13);
-
-            // Compute checksum
-            sbfwrd |= (prevwrd << 30) & 0xC0000000UL; // 2 LSBs of the previous transmitted word
-            nib = ((iwrd == 1) || (iwrd == 9)) ? 1 : 0; // Non-information bearing bits for word 2 and 10
-            chan->dwrd[(isbf + 1) * N_DWRD_SBF + iwrd] = computeChecksum(sbfwrd, nib);
-
-            prevwrd = chan->dwrd[(isbf + 1) * N_DWRD_SBF + iwrd];
-        }
-    }
-
-    return (1);
-}
-
-static int checkSatVisibility(ephem_t eph, gpstime_t g, double *xyz, double elvMask, double *azel) {
-    double llh[3], neu[3];
-    double pos[3], vel[3], clk[3], los[3];
-    double tmat[3][3];
-
-    if (eph.vflg == false)
-        return (-1); // Invalid
-
-    xyz2llh(xyz, llh);
-    ltcmat(llh, tmat);
-
-    satpos(eph, g, pos, vel, clk);
-    subVect(los, pos, xyz);
-    ecef2neu(los, tmat, neu);
-    neu2azel(azel, neu);
-
-    if (azel[1] * R2D > elvMask)
-        return (1); // Visible
-    // else
-    return (0); // Invisible
-}
-
-static int allocateChannel(channel_t *chan, ephem_t *eph, ionoutc_t ionoutc, gpstime_t grx, double *xyz, double elvMask) {
-    NOTUSED(elvMask);
-    int nsat = 0;
-    int i, sv;
-    double azel[2];
-
-    range_t rho;
-    double ref[3] = {0.0};
-    double r_ref, r_xyz;
-    double phase_ini;
-
-    for (sv = 0; sv < MAX_SAT; sv++) {
-        if (checkSatVisibility(eph[sv], grx, xyz, 0.0, azel) == 1) {
-            nsat++; // Number of visible satellites
-
-            if (allocatedSat[sv] == -1) // Visible but not allocated
-            {
-                // Allocated new satellite
-                for (i = 0; i < MAX_CHAN; i++) {
-                    if (chan[i].prn == 0) {
-                        // Initialize channel
-                        chan[i].prn = sv + 1;
-                        chan[i].azel[0] = azel[0];
-                        chan[i].azel[1] = azel[1];
-
-                        // C/A code generation
-                        codegen(chan[i].ca, chan[i].prn);
-
-                        // Generate subframe
-                        eph2sbf(eph[sv], ionoutc, chan[i].sbf);
-
-                        // Generate navigation message
-                        generateNavMsg(grx, &chan[i], 1);
-
-                        // Initialize pseudorange
-                        computeRange(&rho, eph[sv], &ionoutc, grx, xyz);
-                        chan[i].rho0 = rho;
-
-                        // Initialize carrier phase
-                        r_xyz = rho.range;
-
-                        computeRange(&rho, eph[sv], &ionoutc, grx, ref);
-                        r_ref = rho.range;
-
-                        phase_ini = (2.0 * r_ref - r_xyz) / LAMBDA_L1;
-#ifdef FLOAT_CARR_PHASE
-                        chan[i].carr_phase = phase_ini - floor(phase_ini);
-#else
-                        phase_ini -= floor(phase_ini);
-                        chan[i].carr_phase = (unsigned int) (512.0 * 65536.0 * phase_ini);
-#endif
-                        // Done.
-                        break;
-                    }
-                }
-
-                // Set satellite allocation channel
-                if (i < MAX_CHAN)
-                    allocatedSat[sv] = i;
-            }
-        } else if (allocatedSat[sv] >= 0) // Not visible but allocated
-        {
-            // Clear channel
-            chan[allocatedSat[sv]].prn = 0;
-
-            // Clear satellite allocation flag
-            allocatedSat[sv] = -1;
-        }
-    }
-
-    return (nsat);
-}
-
-static void usage(void) {
-    fprintf(stderr, "Usage: pluto-gps-sim [options]\n"
-            "Options:\n"
-            "  -e <file name>   RINEX navigation file for GPS ephemerides (required)\n"
-            "  -u <file name>   User motion file (dynamic mode) 10Hz, Max %u points\n"
-            "  -3               Use RINEX version 3 format\n"
-            "  -f               Pull actual RINEX navigation file from NASA FTP server\n"
-            "  -c <location>    ECEF X,Y,Z in meters (static mode) e.g. 3967283.154,1022538.181,4872414.484\n"
-            "  -l <location>    Lat,Lon,Hgt (static mode) e.g. 35.681298,139.766247,10.0\n"
-            "  -t <date,time>   Scenario start time YYYY/MM/DD,hh:mm:ss\n"
-            "  -T <date,time>   Overwrite TOC and TOE to scenario start time (use 'now' for actual time)\n"
-            "  -s <frequency>   Sampling frequency [Hz] (default: 2600000)\n"
-            "  -i               Disable ionospheric delay for spacecraft scenario\n"
-            "  -v               Show details about simulated channels\n"
-            "  -A <attenuation> Set TX attenuation [dB] (default -20.0)\n"
-            "  -B <bw>          Set RF bandwidth [MHz] (default 3.0)\n"
-            "  -U <uri>         ADALM-Pluto URI\n"
-            "  -N <network>     ADALM-Pluto network IP or hostname (default pluto.local)\n",
-            (unsigned int) USER_MOTION_SIZE);
-
-    return;
-}
-
-static void handle_sig(int sig) {
-    NOTUSED(sig);
-    signal(SIGINT, SIG_DFL); // reset signal handler - bit extra safety
-    pthread_mutex_unlock(&plutotx.data_mutex);
-    plutotx.exit = true;
-    pthread_join(pluto_thread, NULL); /* Wait on Pluto TX thread exit */
-    pthread_mutex_destroy(&plutotx.data_mutex);
-    pthread_cond_destroy(&plutotx.data_cond);
-}
-
-#if defined(__MACH__) || defined(__APPLE__)
-
-static int pthread_setaffinity_np(pthread_t thread, size_t cpu_size,
-        cpu_set_t *cpu_set) {
-    thread_port_t mach_thread;
-    size_t core = 0;
-
-    for (core = 0; core < 8 * cpu_size; core++) {
-        if (CPU_ISSET(core, cpu_set)) break;
-    }
-    printf("binding to core %ld\n", core);
-    thread_affinity_policy_data_t policy = {core};
-    mach_thread = pthread_mach_thread_np(thread);
-    thread_policy_set(mach_thread, THREAD_AFFINITY_POLICY,
-            (thread_policy_t) & policy, 1);
-    return 0;
-}
-#endif
-
-// Set affinity of calling thread to specific core on a multi-core CPU
-
-static int thread_to_core(int core_id) {
-    int num_cores = sysconf(_SC_NPROCESSORS_ONLN);
-    if (core_id < 0 || core_id >= num_cores)
-        return EINVAL;
-
-    cpu_set_t cpuset;
-    CPU_ZERO(&cpuset);
-    CPU_SET(core_id, &cpuset);
-
-    pthread_t current_thread = pthread_self();
-    return pthread_setaffinity_np(current_thread, sizeof (cpu_set_t), &cpuset);
-}
-
-void *pluto_tx_thread_ep(void *arg) {
-    NOTUSED(arg);
-    char buf[1024];
-    struct iio_context *ctx = NULL;
-    struct iio_device *tx = NULL;
-    struct iio_device *phydev = NULL;
-    struct iio_channel *tx0_i = NULL;
-    struct iio_channel *tx0_q = NULL;
-    struct iio_buffer *tx_buffer = NULL;
-
-    // Try sticking this thread to core 2
-    thread_to_core(2);
-
-    // Create IIO context to access ADALM-Pluto
-    ctx = iio_create_default_context();
-    if (ctx == NULL) {
-        if (plutotx.hostname != NULL) {
-            ctx = iio_create_network_context(plutotx.hostname);
-        } else if (plutotx.uri != NULL) {
-            ctx = iio_create_context_from_uri(plutotx.uri);
-        } else {
-            ctx = iio_create_network_context("pluto.local");
-        }
-    }
-
-    if (ctx == NULL) {
-        iio_strerror(errno, buf, sizeof (buf));
-        fprintf(stderr, "Failed creating IIO context: %s\n", buf);
-        goto pluto_thread_exit;
-    }
-
-    int device_count = iio_context_get_devices_count(ctx);
-    if (!device_count) {
-        fprintf(stderr, "No supported PLUTOSDR devices found.\n");
-        goto pluto_thread_exit;
-    }
-
-    tx = iio_context_find_device(ctx, "cf-ad9361-dds-core-lpc");
-    if (tx == NULL) {
-        iio_strerror(errno, buf, sizeof (buf));
-        fprintf(stderr, "Error opening PLUTOSDR TX device: %s\n", buf);
-        goto pluto_thread_exit;
-    }
-
-    // Additional IQ kernel buffers, default is 4
-    iio_device_set_kernel_buffers_count(tx, 12);
-
-    phydev = iio_context_find_device(ctx, "ad9361-phy");
-    struct iio_channel* phy_chn = iio_device_find_channel(phydev, "voltage0", true);
-    iio_channel_attr_write(phy_chn, "rf_port_select", plutotx.rfport);
-    iio_channel_attr_write_longlong(phy_chn, "rf_bandwidth", plutotx.bw_hz);
-    iio_channel_attr_write_longlong(phy_chn, "sampling_frequency", plutotx.fs_hz);
-    iio_channel_attr_write_double(phy_chn, "hardwaregain", plutotx.gain_db);
-
-    iio_channel_attr_write_bool(
-            iio_device_find_channel(phydev, "altvoltage0", true)
-            , "powerdown", true); // Turn OFF RX LO
-
-    iio_channel_attr_write_longlong(
-            iio_device_find_channel(phydev, "altvoltage1", true)
-            , "frequency", plutotx.lo_hz); // Set TX LO frequency
-
-    tx0_i = iio_device_find_channel(tx, "voltage0", true);
-    if (!tx0_i)
-        tx0_i = iio_device_find_channel(tx, "altvoltage0", true);
-
-    tx0_q = iio_device_find_channel(tx, "voltage1", true);
-    if (!tx0_q)
-        tx0_q = iio_device_find_channel(tx, "altvoltage1", true);
-
-    iio_channel_enable(tx0_i);
-    iio_channel_enable(tx0_q);
-
-    ad9361_set_bb_rate(iio_context_find_device(ctx, "ad9361-phy"), plutotx.fs_hz);
-
-    tx_buffer = iio_device_create_buffer(tx, NUM_SAMPLES, false);
-    if (!tx_buffer) {
-        fprintf(stderr, "Could not create TX buffer.\n");
-        goto pluto_thread_exit;
-    }
-
-    iio_channel_attr_write_bool(
-            iio_device_find_channel(iio_context_find_device(ctx, "ad9361-phy"), "altvoltage1", true)
-            , "powerdown", false); // Turn ON TX LO
-
-    int32_t ntx = 0;
-    char *ptx_buffer = (char *) iio_buffer_start(tx_buffer);
-
-    while (!plutotx.exit) {
-        pthread_mutex_lock(&plutotx.data_mutex);
-        memcpy(ptx_buffer, iq_buff, BUFFER_SIZE);
-        pthread_cond_signal(&plutotx.data_cond);
-        pthread_mutex_unlock(&plutotx.data_mutex);
-        // Schedule TX buffer
-        ntx = iio_buffer_push(tx_buffer);
-        if (ntx < 0) {
-            fprintf(stderr, "Error pushing buf %d\n", (int) ntx);
-            break;
-            ;
-        }
-    }
-
-pluto_thread_exit:
-    if (ctx) {
-        iio_channel_attr_write_bool(
-                iio_device_find_channel(iio_context_find_device(ctx, "ad9361-phy"), "altvoltage1", true)
-                , "powerdown", true); // Turn OFF TX LO
-    }
-
-    if (tx_buffer) {
-        iio_buffer_destroy(tx_buffer);
-    }
-    if (tx0_i) {
-        iio_channel_disable(tx0_i);
-    }
-    if (tx0_q) {
-        iio_channel_disable(tx0_q);
-    }
-    if (ctx) {
-        iio_context_destroy(ctx);
-    }
-
-    // Wake the main thread (if it's still waiting)
-    pthread_mutex_lock(&plutotx.data_mutex);
-    plutotx.exit = true; // just in case
-    pthread_cond_signal(&plutotx.data_cond);
-    pthread_mutex_unlock(&plutotx.data_mutex);
-#ifndef _WIN32
-    pthread_exit(NULL);
-#else
-    return NULL;
-#endif
-}
-
-static size_t fwrite_rinex(void *buffer, size_t size, size_t nmemb, void *stream) {
-    struct ftp_file *out = (struct ftp_file *) stream;
-    if (out && !out->stream) {
-        /* open file for writing */
-        out->stream = fopen(out->filename, "wb");
-        if (!out->stream)
-            return -1; /* failure, can't open file to write */
-    }
-    return fwrite(buffer, size, nmemb, out->stream);
-}
-
-int main(int argc, char *argv[]) {
-    int sv;
-    int neph, ieph;
-    ephem_t eph[EPHEM_ARRAY_SIZE][MAX_SAT];
-    gpstime_t g0;
-
-    double llh[3];
-
-    int i;
-    channel_t chan[MAX_CHAN];
-    double elvmask = 0.0; // in degree
-
-    int ip, qp;
-    int iTable;
-
-    gpstime_t grx;
-    double delt;
-    int isamp;
-
-    int numd = 0, iumd = 0;
-    // Allocate user motion array
-    double xyz[USER_MOTION_SIZE][3];
-
-    int staticLocationMode = true;
-
-    bool use_rinex3 = false;
-    bool use_ftp = false;
-    CURL *curl;
-    CURLcode res = CURLE_GOT_NOTHING;
-    struct ftp_file ftp = {
-        RINEX2_FILE_NAME,
-        NULL
-    };
-
-    const char* navfile = NULL;
-    const char* umfile = NULL;
-
-    int result;
-    double gain[MAX_CHAN];
-    double path_loss;
-    double ant_gain;
-    double ant_pat[37];
-    int ibs; // boresight angle index
-
-    datetime_t t0, tmin, tmax;
-    gpstime_t gmin, gmax;
-    double dt;
-    int igrx;
-
-    bool verb;
-    bool timeoverwrite = false; // Overwirte the TOC and TOE in the RINEX file
-    ionoutc_t ionoutc;
-
-    ////////////////////////////////////////////////////////////
-    // Read options
-    ////////////////////////////////////////////////////////////
-
-    // Default options
-    g0.week = -1; // Invalid start time
-    verb = false;
-    ionoutc.enable = true;
-
-    // Default static location; Tokyo
-    llh[0] = 35.681298 / R2D;
-    llh[1] = 139.766247 / R2D;
-    llh[2] = 10.0;
-
-    plutotx.bw_hz = (TX_SAMPLE_FREQ * 2);
-    plutotx.fs_hz = TX_SAMPLE_FREQ;
-    plutotx.lo_hz = GHZ(1.575420); // 1.57542 GHz RF frequency
-    plutotx.rfport = "A";
-    plutotx.gain_db = -20.0;
-    plutotx.hostname = NULL;
-    plutotx.uri = NULL;
-
-    pthread_mutex_init(&plutotx.data_mutex, NULL);
-    pthread_cond_init(&plutotx.data_cond, NULL);
-
-    // signal handlers:
-    signal(SIGINT, handle_sig);
-    signal(SIGTERM, handle_sig);
-    signal(SIGQUIT, handle_sig);
-
-    /* On a multi-core CPU we run the main thread and reader thread on different cores.
-     * Try sticking the main thread to core 1
-     */
-    thread_to_core(1);
-
-    if (argc < 3) {
-        usage();
-        exit(1);
-    }
-
-    while ((result = getopt(argc, argv, "e:3:u:g:c:l:s:T:t:A:B:U:N:vfi?")) != -1) {
-        switch (result) {
-            case 'e':
-                navfile = optarg;
-                break;
-            case 'u':
-                umfile = optarg;
-                staticLocationMode = false;
-                break;
-            case '3':
-                use_rinex3 = true;
-                ftp.filename = RINEX3_FILE_NAME;
-                break;
-            case 'f':
-                use_ftp = true;
-                break;
-            case 'c':
-                // Static ECEF coordinates input mode
-                sscanf(optarg, "%lf,%lf,%lf", &xyz[0][0], &xyz[0][1], &xyz[0][2]);
-                break;
-            case 'l':
-                // Static geodetic coordinates input mode
-                // Added by scateu@gmail.com
-                sscanf(optarg, "%lf,%lf,%lf", &llh[0], &llh[1], &llh[2]);
-                llh[0] = llh[0] / R2D; // convert to RAD
-                llh[1] = llh[1] / R2D; // convert to RAD
-                llh2xyz(llh, xyz[0]); // Convert llh to xyz
-                break;
-            case 's':
-                plutotx.fs_hz = (long long) atoi(optarg);
-                if (plutotx.fs_hz < MHZ(1.0)) {
-                    fprintf(stderr, "ERROR: Invalid sampling frequency.\n");
-                    exit(1);
-                }
-                break;
-            case 'T':
-                timeoverwrite = true;
-                if (strncmp(optarg, "now", 3) == 0) {
-                    time_t timer;
-                    struct tm *gmt;
-
-                    time(&timer);
-                    gmt = gmtime(&timer);
-
-                    t0.y = gmt->tm_year + 1900;
-                    t0.m = gmt->tm_mon + 1;
-                    t0.d = gmt->tm_mday;
-                    t0.hh = gmt->tm_hour;
-                    t0.mm = gmt->tm_min;
-                    t0.sec = (double) gmt->tm_sec;
-
-                    date2gps(&t0, &g0);
-
-                }
-                break;
-            case 't':
-                sscanf(optarg, "%d/%d/%d,%d:%d:%lf", &t0.y, &t0.m, &t0.d, &t0.hh, &t0.mm, &t0.sec);
-                if (t0.y <= 1980 || t0.m < 1 || t0.m > 12 || t0.d < 1 || t0.d > 31 ||
-                        t0.hh < 0 || t0.hh > 23 || t0.mm < 0 || t0.mm > 59 || t0.sec < 0.0 || t0.sec >= 60.0) {
-                    fprintf(stderr, "ERROR: Invalid date and time.\n");
-                    exit(1);
-                }
-                t0.sec = floor(t0.sec);
-                date2gps(&t0, &g0);
-                break;
-            case 'i':
-                ionoutc.enable = false; // Disable ionospheric correction
-                break;
-            case 'v':
-                verb = true;
-                break;
-            case 'A':
-                plutotx.gain_db = atof(optarg);
-                if (plutotx.gain_db > 0.0) plutotx.gain_db = 0.0;
-                if (plutotx.gain_db < -80.0) plutotx.gain_db = -80.0;
-                break;
-            case 'B':
-                plutotx.bw_hz = MHZ(atof(optarg));
-                if (plutotx.bw_hz > MHZ(5.0)) plutotx.bw_hz = MHZ(5.0);
-                if (plutotx.bw_hz < MHZ(1.0)) plutotx.bw_hz = MHZ(1.0);
-                break;
-            case 'U':
-                plutotx.uri = optarg;
-                break;
-            case 'N':
-                plutotx.hostname = optarg;
-                break;
-            case ':':
-            case '?':
-                usage();
-                exit(1);
-            default:
-                break;
-        }
-    }
-
-    if ((navfile == NULL) && (use_ftp == false)) {
-        fprintf(stderr, "ERROR: GPS ephemeris file is not specified.\n");
-        exit(1);
-    }
-
-    delt = 1.0 / plutotx.fs_hz;
-
-    ////////////////////////////////////////////////////////////
-    // Receiver position
-    ////////////////////////////////////////////////////////////
-
-    if (!staticLocationMode) {
-        // Read user motion file
-        numd = readUserMotion(xyz, umfile);
-
-        if (numd == -1) {
-            fprintf(stderr, "ERROR: Failed to open user motion file.\n");
-            exit(1);
-        } else if (numd == 0) {
-            fprintf(stderr, "ERROR: Failed to read user motion data.\n");
-            exit(1);
-        }
-
-        fprintf(stderr, "Using user motion mode.\n");
-    } else {
-        // Static geodetic coordinates input mode: "-l"
-        fprintf(stderr, "Using static location mode.\n");
-    }
-
-    /*
-    fprintf(stderr, "xyz = %11.1f, %11.1f, %11.1f\n", xyz[0][0], xyz[0][1], xyz[0][2]);
-    fprintf(stderr, "llh = %11.6f, %11.6f, %11.1f\n", llh[0]*R2D, llh[1]*R2D, llh[2]);
-     */
-    ////////////////////////////////////////////////////////////
-    // Read ephemeris
-    ////////////////////////////////////////////////////////////
-    if (use_ftp) {
-        time_t t = time(NULL);
-        struct tm *tm = gmtime(&t);
-        char* url = malloc(NAME_MAX);
-        const char *station = stations_v2[14].id_v2;
-        // We fetch data from previous hour because the actual hour is still in progress
-        tm->tm_hour -= 1;
-        if (tm->tm_hour < 0) {
-            tm->tm_hour = 23;
-        }
-
-        if (use_rinex3) {
-            station = stations_v3[0].id_v2;
-        }
-
-        // Compose FTP URL
-        snprintf(url, NAME_MAX, RINEX_FTP_URL RINEX_FTP_FILE, (use_rinex3) ? RINEX3_SUBFOLDER : RINEX2_SUBFOLDER,
-                tm->tm_yday + 1, tm->tm_hour, station, tm->tm_yday + 1, 'a' + tm->tm_hour, tm->tm_year - 100);
-
-        curl_global_init(CURL_GLOBAL_DEFAULT);
-        curl = curl_easy_init();
-        if (curl) {
-            curl_easy_setopt(curl, CURLOPT_URL, url);
-            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, fwrite_rinex);
-            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &ftp);
-            curl_easy_setopt(curl, CURLOPT_USE_SSL, CURLUSESSL_NONE);
-            if (verb) {
-                curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
-            } else {
-                curl_easy_setopt(curl, CURLOPT_VERBOSE, 0L);
-            }
-            curl_easy_setopt(curl, CURLOPT_USERPWD, "anonymous:anonymous");
-            res = curl_easy_perform(curl);
-            curl_easy_cleanup(curl);
-        }
-
-        if (ftp.stream)
-            fclose(ftp.stream);
-
-        free(url);
-        curl_global_cleanup();
-
-        if (res != CURLE_OK) {
-            fprintf(stderr, "Curl error: %d\n", res);
-            exit(1);
-        }
-    }
-
-    if (use_rinex3) {
-        neph = readRinex3(eph, &ionoutc, navfile);
-    } else {
-        neph = readRinex2(eph, &ionoutc, navfile);
-    }
-
-    if (neph == 0) {
-        fprintf(stderr, "ERROR: No ephemeris available.\n");
-        exit(1);
-    }
-
-    if ((verb == true)&&(ionoutc.vflg == true)) {
-        fprintf(stderr, "  %12.3e %12.3e %12.3e %12.3e\n",
-                ionoutc.alpha0, ionoutc.alpha1, ionoutc.alpha2, ionoutc.alpha3);
-        fprintf(stderr, "  %12.3e %12.3e %12.3e %12.3e\n",
-                ionoutc.beta0, ionoutc.beta1, ionoutc.beta2, ionoutc.beta3);
-        fprintf(stderr, "   %19.11e %19.11e  %9d %9d\n",
-                ionoutc.A0, ionoutc.A1, ionoutc.tot, ionoutc.wnt);
-        fprintf(stderr, "%6d\n", ionoutc.dtls);
-    }
-
-    for (sv = 0; sv < MAX_SAT; sv++) {
-        if (eph[0][sv].vflg == true) {
-            gmin = eph[0][sv].toc;
-            tmin = eph[0][sv].t;
-            break;
-        }
-    }
-
-    gmax.sec = 0;
-    gmax.week = 0;
-    tmax.sec = 0;
-    tmax.mm = 0;
-    tmax.hh = 0;
-    tmax.d = 0;
-    tmax.m = 0;
-    tmax.y = 0;
-    for (sv = 0; sv < MAX_SAT; sv++) {
-        if (eph[neph - 1][sv].vflg == true) {
-            gmax = eph[neph - 1][sv].toc;
-            tmax = eph[neph - 1][sv].t;
-            break;
-        }
-    }
-
-    if (g0.week >= 0) // Scenario start time has been set.
-    {
-        if (timeoverwrite == true) {
-            gpstime_t gtmp;
-            datetime_t ttmp;
-            double dsec;
-
-            gtmp.week = g0.week;
-            gtmp.sec = (double) (((int) (g0.sec)) / 7200)*7200.0;
-
-            dsec = subGpsTime(gtmp, gmin);
-
-            // Overwrite the UTC reference week number
-            ionoutc.wnt = gtmp.week;
-            ionoutc.tot = (int) gtmp.sec;
-
-            // Iono/UTC parameters may no longer valid
-            //ionoutc.vflg = FALSE;
-
-            // Overwrite the TOC and TOE to the scenario start time
-            for (sv = 0; sv < MAX_SAT; sv++) {
-                for (i = 0; i < neph; i++) {
-                    if (eph[i][sv].vflg == true) {
-                        gtmp = incGpsTime(eph[i][sv].toc, dsec);
-                        gps2date(&gtmp, &ttmp);
-                        eph[i][sv].toc = gtmp;
-                        eph[i][sv].t = ttmp;
-
-                        gtmp = incGpsTime(eph[i][sv].toe, dsec);
-                        eph[i][sv].toe = gtmp;
-                    }
-                }
-            }
-        } else {
-            if (subGpsTime(g0, gmin) < 0.0 || subGpsTime(gmax, g0) < 0.0) {
-                fprintf(stderr, "ERROR: Invalid start time.\n");
-                fprintf(stderr, "tmin = %4d/%02d/%02d,%02d:%02d:%02.0f (%d:%.0f)\n",
-                        tmin.y, tmin.m, tmin.d, tmin.hh, tmin.mm, tmin.sec,
-                        gmin.week, gmin.sec);
-                fprintf(stderr, "tmax = %4d/%02d/%02d,%02d:%02d:%02.0f (%d:%.0f)\n",
-                        tmax.y, tmax.m, tmax.d, tmax.hh, tmax.mm, tmax.sec,
-                        gmax.week, gmax.sec);
-                exit(1);
-            }
-        }
-    } else {
-        g0 = gmin;
-        t0 = tmin;
-    }
-
-    fprintf(stderr, "Gain: %.1fdB\n", plutotx.gain_db);
-    fprintf(stderr, "RINEX date = %s\n", rinex_date);
-    fprintf(stderr, "Start time = %4d/%02d/%02d,%02d:%02d:%02.0f (%d:%.0f)\n",
-            t0.y, t0.m, t0.d, t0.hh, t0.mm, t0.sec, g0.week, g0.sec);
-
-    // Select the current set of ephemerides
-    ieph = -1;
-
-    for (i = 0; i < neph; i++) {
-        for (sv = 0; sv < MAX_SAT; sv++) {
-            if (eph[i][sv].vflg == true) {
-                dt = subGpsTime(g0, eph[i][sv].toc);
-                if (dt >= -SECONDS_IN_HOUR && dt < SECONDS_IN_HOUR) {
-                    ieph = i;
-                    break;
-                }
-            }
-        }
-
-        if (ieph >= 0) // ieph has been set
-            break;
-    }
-
-    if (ieph == -1) {
-        fprintf(stderr, "ERROR: No current set of ephemerides has been found.\n");
-        exit(1);
-    }
-
-    ////////////////////////////////////////////////////////////
-    // Baseband signal buffer and output file
-    ////////////////////////////////////////////////////////////
-
-    // Allocate I/Q buffer
-    iq_buff = calloc(NUM_SAMPLES, 4);
-
-    if (iq_buff == NULL) {
-        fprintf(stderr, "ERROR: Faild to allocate 16-bit I/Q buffer.\n");
-        goto exit_main_thread;
-    }
-
-    ////////////////////////////////////////////////////////////
-    // Start ADALM-Pluto TX thread
-    ////////////////////////////////////////////////////////////
-    pthread_create(&pluto_thread, NULL, pluto_tx_thread_ep, NULL);
-
-    ////////////////////////////////////////////////////////////
-    // Initialize channels
-    ////////////////////////////////////////////////////////////
-
-    // Clear all channels
-    for (i = 0; i < MAX_CHAN; i++)
-        chan[i].prn = 0;
-
-    // Clear satellite allocation flag
-    for (sv = 0; sv < MAX_SAT; sv++)
-        allocatedSat[sv] = -1;
-
-    // Initial reception time
-    grx = incGpsTime(g0, 0.0);
-
-    // Allocate visible satellites
-    allocateChannel(chan, eph[ieph], ionoutc, grx, xyz[0], elvmask);
-
-    fprintf(stderr, "PRN   Az    El     Range     Iono\n");
-    for (i = 0; i < MAX_CHAN; i++) {
-        if (chan[i].prn > 0)
-            fprintf(stderr, "%02d %6.1f %5.1f %11.1f %5.1f\n", chan[i].prn,
-                chan[i].azel[0] * R2D, chan[i].azel[1] * R2D, chan[i].rho0.d, chan[i].rho0.iono_delay);
-    }
-
-    ////////////////////////////////////////////////////////////
-    // Receiver antenna gain pattern
-    ////////////////////////////////////////////////////////////
-
-    for (i = 0; i < 37; i++)
-        ant_pat[i] = pow(10.0, -ant_pat_db[i] / 20.0);
-
-    ////////////////////////////////////////////////////////////
-    // Generate baseband signals
-    ////////////////////////////////////////////////////////////
-
-    // Update receiver time
-    grx = incGpsTime(grx, 0.1);
-
-    while (!plutotx.exit) {
-        for (i = 0; i < MAX_CHAN; i++) {
-            if (chan[i].prn > 0) {
-                // Refresh code phase and data bit counters
-                range_t rho;
-                sv = chan[i].prn - 1;
-
-                // Current pseudorange
-                if (!staticLocationMode) {
-                    computeRange(&rho, eph[ieph][sv], &ionoutc, grx, xyz[iumd]);
-                } else {
-                    computeRange(&rho, eph[ieph][sv], &ionoutc, grx, xyz[0]);
-                }
-
-                chan[i].azel[0] = rho.azel[0];
-                chan[i].azel[1] = rho.azel[1];
-
-                // Update code phase and data bit counters
-                computeCodePhase(&chan[i], rho, 0.1);
-#ifndef FLOAT_CARR_PHASE
-                chan[i].carr_phasestep = (int) round(512.0 * 65536.0 * chan[i].f_carr * delt);
-#endif
-                // Path loss
-                path_loss = 20200000.0 / rho.d;
-
-                // Receiver antenna gain
-                ibs = (int) ((90.0 - rho.azel[1] * R2D) / 5.0); // covert elevation to boresight
-                ant_gain = ant_pat[ibs];
-
-                // Signal gain
-                gain[i] = (double) (path_loss * ant_gain);
-            }
-        }
-
-        pthread_mutex_lock(&plutotx.data_mutex);
-        for (isamp = 0; isamp < NUM_SAMPLES; isamp++) {
-            int64_t i_acc = 0;
-            int64_t q_acc = 0;
-
-            for (i = 0; i < MAX_CHAN; i++) {
-                if (chan[i].prn > 0) {
-#ifdef FLOAT_CARR_PHASE
-                    iTable = (int) floor(chan[i].carr_phase * 512.0);
-#else
-                    iTable = (chan[i].carr_phase >> 16) & 0x1ff; // 9-bit index
-#endif
-                    ip = chan[i].dataBit * chan[i].codeCA * cosTable512[iTable] * gain[i];
-                    qp = chan[i].dataBit * chan[i].codeCA * sinTable512[iTable] * gain[i];
-
-                    // Accumulate for all visible satellites
-                    i_acc += ip;
-                    q_acc += qp;
-
-                    // Update code phase
-                    chan[i].code_phase += chan[i].f_code * delt;
-
-                    if (chan[i].code_phase >= CA_SEQ_LEN) {
-                        chan[i].code_phase -= CA_SEQ_LEN;
-
-                        chan[i].icode++;
-
-                        if (chan[i].icode >= 20) // 20 C/A codes = 1 navigation data bit
-                        {
-                            chan[i].icode = 0;
-                            chan[i].ibit++;
-
-                            if (chan[i].ibit >= 30) // 30 navigation data bits = 1 word
-                            {
-                                chan[i].ibit = 0;
-                                chan[i].iword++;
-                                /*
-                                if (chan[i].iword>=N_DWRD)
-                                        fprintf(stderr, "\nWARNING: Subframe word buffer overflow.\n");
-                                 */
-                            }
-
-                            // Set new navigation data bit
-                            chan[i].dataBit = (int) ((chan[i].dwrd[chan[i].iword]>>(29 - chan[i].ibit)) & 0x1UL)*2 - 1;
-                        }
-                    }
-
-                    // Set current code chip
-                    chan[i].codeCA = chan[i].ca[(int) chan[i].code_phase]*2 - 1;
-
-                    // Update carrier phase
-#ifdef FLOAT_CARR_PHASE
-                    chan[i].carr_phase += chan[i].f_carr * delt;
-
-                    if (chan[i].carr_phase >= 1.0)
-                        chan[i].carr_phase -= 1.0;
-                    else if (chan[i].carr_phase < 0.0)
-                        chan[i].carr_phase += 1.0;
-#else
-                    chan[i].carr_phase += chan[i].carr_phasestep;
-#endif
-                }
-            }
-
-            // Store I/Q samples into buffer
-            iq_buff[isamp * 2] = (short) i_acc;
-            iq_buff[isamp * 2 + 1] = (short) q_acc;
-        }
-        pthread_cond_signal(&plutotx.data_cond);
-        pthread_cond_wait(&plutotx.data_cond, &plutotx.data_mutex);
-        pthread_mutex_unlock(&plutotx.data_mutex);
-
-        //
-        // Update navigation message and channel allocation every 30 seconds
-        //
-        igrx = (int) (grx.sec * 10.0 + 0.5);
-
-        if (igrx % 300 == 0) // Every 30 seconds
-        {
-            // Update navigation message
-            for (i = 0; i < MAX_CHAN; i++) {
-                if (chan[i].prn > 0)
-                    generateNavMsg(grx, &chan[i], 0);
-            }
-
-            // Refresh ephemeris and subframes
-            // Quick and dirty fix. Need more elegant way.
-            for (sv = 0; sv < MAX_SAT; sv++) {
-                if (eph[ieph + 1][sv].vflg == true) {
-                    dt = subGpsTime(eph[ieph + 1][sv].toc, grx);
-                    if (dt < SECONDS_IN_HOUR) {
-                        ieph++;
-
-                        for (i = 0; i < MAX_CHAN; i++) {
-                            // Generate new subframes if allocated
-                            if (chan[i].prn != 0)
-                                eph2sbf(eph[ieph][chan[i].prn - 1], ionoutc, chan[i].sbf);
-                        }
-                    }
-                    break;
-                }
-            }
-
-            // Update channel allocation
-            if (!staticLocationMode) {
-                allocateChannel(chan, eph[ieph], ionoutc, grx, xyz[iumd], elvmask);
-            } else {
-                allocateChannel(chan, eph[ieph], ionoutc, grx, xyz[0], elvmask);
-            }
-        }
-        // Update receiver time
-        grx = incGpsTime(grx, 0.1);
-        // update postition index
-        iumd++;
-        if (iumd >= numd) {
-            iumd = 0;
-        }
-    }
-
-exit_main_thread:
-    pthread_mutex_unlock(&plutotx.data_mutex);
-    plutotx.exit = true;
-    pthread_join(pluto_thread, NULL); /* Wait on Pluto TX thread exit */
-    pthread_mutex_destroy(&plutotx.data_mutex);
-
-    // Free I/Q buffers
-    if (iq_buff) {
-        free(iq_buff);
-    }
-    return (0);
-}
+/**
+ * pluto-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using the ADALM-Pluto SDR platform.
+ *
+ * This file is part of the pluto-gps-sim project at
+ * https://github.com/mictronics/pluto-gps-sim.git
+ *
+ * Copyright © 2019 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <curl/curl.h>
+#include <iio.h>
+#include <ad9361.h>
+#include "gpssim_int.h"
+
+#define RINEX2_FILE_NAME "rinex2.gz"
+#define RINEX3_FILE_NAME "rinex3.gz"
+#define RINEX_FTP_URL "ftp://igs.bkg.bund.de/IGS/"
+#define RINEX2_SUBFOLDER "nrt"
+#define RINEX3_SUBFOLDER "nrt_v3"
+#define RINEX_FTP_FILE "%s/%03i/%02i/%4s%03i%c.%02in.gz"
+
+struct stream_cfg {
+    long long bw_hz; // Analog banwidth in Hz
+    long long fs_hz; // Baseband sample rate in Hz
+    int block; // I/Q samples per 0.1s block at fs_hz
+    long long lo_hz; // Local oscillator frequency in Hz
+    const char* rfport; // Port name
+    double gain_db; // Hardware gain of devices without their own
+    bool exit; // Exit from the main loop when true
+    double stats_interval; // TX timing report interval in seconds, 0 = off
+    FILE *stats_fp; // TX timing report output
+    FILE *sink_fp; // IQ file sink, Pluto TX is bypassed when set
+};
+
+/*! \brief One ADALM-Pluto with its own TX thread, kernel buffer ring and buffer hand-off */
+struct tx_device {
+    char uri[256]; // IIO context URI, empty = default context or pluto.local
+    double gain_db; // Hardware gain, NAN = stream_cfg gain
+    pthread_t thread;
+    bool started; // TX thread created
+    pthread_cond_t data_cond;
+    pthread_mutex_t data_mutex; // Mutex to synchronize buffer access
+    double gen_us; // Generation time of the last block in microseconds
+    int saturated; // Saturated I/Q values of the last block
+    short *tx_buff; // Free TX buffer handed to the main thread, NULL while in use
+    bool data_ready; // TX buffer filled by the main thread
+    _Atomic double gain_req; // Hardware gain requested at runtime, applied before the next push
+    tx_stats_t stats; // TX timing telemetry
+};
+
+static struct stream_cfg plutotx;
+static struct tx_device txdev[MAX_TX_DEVICES];
+static int ntxdev = 0;
+
+/*! \brief Truth log ring buffer size in bytes, power of two */
+#define TRUTH_RING_SIZE (1 << 20)
+
+/*! \brief Asynchronous writer of the per-epoch truth log
+ *
+ * Single producer (main thread), single consumer (writer thread) byte ring.
+ * The producer never waits, an epoch that does not fit is dropped and counted.
+ */
+struct truth_log {
+    FILE *fp;
+    unsigned char *ring;
+    _Atomic size_t head; // Write position, owned by main thread
+    _Atomic size_t tail; // Read position, owned by writer thread
+    atomic_bool exit;
+    pthread_t thread;
+    uint32_t dropped;
+};
+
+static struct truth_log truthlog;
+
+/*! \brief Runtime control command queue size, power of two */
+#define CTRL_QUEUE_SIZE (64)
+/*! \brief Maximum number of simultaneous control clients */
+#define CTRL_MAX_CLIENTS (4)
+/*! \brief Maximum length of one control command line */
+#define CTRL_LINE_LEN (256)
+
+/*! \brief One connected control client */
+struct ctrl_client {
+    int fd; // Socket, -1 = free
+    size_t len; // Bytes of the pending command line
+    char line[CTRL_LINE_LEN];
+};
+
+/*! \brief Runtime control server, see -Z
+ *
+ * The server thread parses the command lines of the clients and queues the
+ * commands in a single producer, single consumer ring. The main thread drains
+ * it at the next epoch boundary and never waits. The status snapshot goes the
+ * other way, published once per epoch under a sequence counter that the
+ * server thread retries on.
+ */
+struct control {
+    int fd; // Listening socket, -1 = off
+    char path[108]; // Unix socket path to remove at exit, empty for TCP
+    pthread_t thread;
+    atomic_bool exit;
+    bool movable; // Single static receiver, position commands allowed
+    ctrl_cmd_t cmd[CTRL_QUEUE_SIZE];
+    _Atomic size_t head; // Write position, owned by server thread
+    _Atomic size_t tail; // Read position, owned by main thread
+    atomic_uint seq; // Status sequence counter, odd while the main thread writes
+    ctrl_status_t status;
+    struct ctrl_client client[CTRL_MAX_CLIENTS];
+};
+
+/*! \brief Position and I/Q sink of one receiver of a run
+ *
+ * Channels and signal pipeline of the receiver live in the engine, see
+ * gpssim_step().
+ */
+struct rx_output {
+    double (*xyz)[3]; // Static position or user motion
+    int numd; // User motion points, 0 = static location
+    FILE *fp; // I/Q output file, NULL = ADALM-Pluto
+    int dev0; // First TX device fed by this receiver
+    int ndev; // Number of TX devices fed by this receiver
+};
+
+/*! \brief Geometry and I/Q output file of one antenna array element */
+struct element_output {
+    double enu[3]; // Offset from the receiver position, east/north/up (m)
+    double gain_db;
+    FILE *fp;
+};
+
+/*! \brief Writer of a pre-rendered scenario cache
+ *
+ * The I/Q blocks are written as they are generated, the time index is kept
+ * in memory and appended when the cache is closed.
+ */
+struct scenario_cache {
+    FILE *fp;
+    cache_header_t hdr;
+    cache_index_t *index;
+    size_t nalloc; // Allocated index entries
+};
+
+static struct scenario_cache cache;
+
+/*! \brief Segments per render thread, smaller segments balance better but cost more warm-up */
+#define RENDER_SEG_PER_THREAD (4)
+/*! \brief Segment length limits in blocks */
+#define RENDER_SEG_MIN (20)
+#define RENDER_SEG_MAX (600)
+
+/*! \brief Time-sliced offline render of the file sink
+ *
+ * The channel state of a block follows from ephemeris, receiver position and
+ * time alone, so the timeline is cut into segments rendered concurrently by
+ * a pool of workers, each one with its own copy of the engine context.
+ * Segments are handed out in time order and written to their final file
+ * offset.
+ */
+struct render_job {
+    const gpssim_t *sim; // Context set up for the run, copied by each worker
+    gpstime_t g0;
+    const struct rx_output *out; // Output file of each receiver
+    int nrx;
+    int block; // I/Q samples per block
+    int iq_bits;
+    int out_shift;
+    bool warmup; // Resampler or band-limiting FIR need the block before a segment
+    int nblock;
+    int seg_len; // Blocks per segment
+    off_t base; // File offset of the first block
+    atomic_int next_seg;
+    atomic_ulong sat_total;
+    atomic_ulong sat_blocks;
+    atomic_bool error;
+};
+
+/*! \brief One worker thread of a render job */
+struct render_worker {
+    struct render_job *job;
+    int id;
+    pthread_t thread;
+};
+
+struct ftp_file {
+    const char *filename;
+    FILE *stream;
+};
+
+/**
+ * Stations providing Rinex v3 format.
+ * 4-characters station ID
+ * 9-characters station ID
+ * Station name
+ * Including Ionosphere data in Rinex file
+ */
+static const stations_t stations_v3[] = {
+    {"func", "FUNC00PRT", "Funchal"},
+    {"flrs", "FLRS00PRT", "Santa Cruz das Flore"},
+    {"pdel", "PDEL00PRT", "PONTA DELGADA"}
+};
+
+/**
+ * Stations providing Rinex v2 format.
+ * 4-characters station ID
+ * 9-characters station ID
+ * Station name
+ * Including Ionosphere data in Rinex file
+ */
+static const stations_t stations_v2[] = {
+    {"abmf", "ABMF00GLP", "Aeroport du Raizet"},
+    {"aggo", "AGGO00ARG", "AGGO"},
+    {"ajac", "AJAC00FRA", "Ajaccio"},
+    {"ankr", "ANKR00TUR", "Ankara"},
+    {"areg", "AREG00PER", "Arequipa"},
+    {"ascg", "ASCG00SHN", "Ascension"},
+    {"bogi", "BOGI00POL", "Borowa Gora"},
+    {"bor1", "BOR100POL", "Borowiec"},
+    {"brst", "BRST00FRA", "Brest"},
+    {"chpg", "CHPG00BRA", "Cachoeira Paulista"},
+    {"cibg", "CIBG00IDN", "Cibinong"},
+    {"cpvg", "CPVG00CPV", "CAP-VERT"},
+    {"djig", "DJIG00DJI", "Djibouti"},
+    {"dlf1", "DLF100NLD", "Delft"},
+    {"ffmj", "FFMJ00DEU", "Frankfurt/Main"},
+    {"ftna", "FTNA00WLF", "Futuna"},
+    {"gamb", "GAMB00PYF", "Rikitea"},
+    {"gamg", "GAMG00KOR", "Geochang"},
+    {"glps", "GLPS00ECU", "Galapagos Permanent Station"},
+    {"glsv", "GLSV00UKR", "Kiev/Golosiiv"},
+    {"gmsd", "GMSD00JPN", "GUTS Masda"},
+    {"gop6", "GOP600CZE", "Pecny, Ondrejov"},
+    {"gop7", "GOP700CZE", "Pecny, Ondrejov"},
+    {"gope", "GOPE00CZE", "Pecny, Ondrejov"},
+    {"grac", "GRAC00FRA", "Grasse"},
+    {"gras", "GRAS00FRA", "Observatoire de Calern - OCA"},
+    {"holb", "HOLB00CAN", "Holberg"},
+    {"hueg", "HUEG00DEU", "Huegelheim"},
+    {"ieng", "IENG00ITA", "Torino"},
+    {"ista", "ISTA00TUR", "Istanbul"},
+    {"izmi", "IZMI00TUR", "Izmir"},
+    {"jfng", "JFNG00CHN", "Juifeng"},
+    {"joz2", "JOZ200POL", "Jozefoslaw"},
+    {"joze", "JOZE00POL", "Jozefoslaw"},
+    {"kerg", "KERG00ATF", "Kerguelen Islands"},
+    {"kitg", "KITG00UZB", "Kitab"},
+    {"koug", "KOUG00GUF", "Kourou"},
+    {"krgg", "KRGG00ATF", "Kerguelen Islands"},
+    {"krs1", "KRS100TUR", "Kars"},
+    {"lama", "LAMA00POL", "Lamkowo"},
+    {"leij", "LEIJ00DEU", "Leipzig"},
+    {"lmmf", "LMMF00MTQ", "Aeroport Aime CESAIRE-LE LAMENTIN"},
+    {"lroc", "LROC00FRA", "La Rochelle"},
+    {"mad2", "MAD200ESP", "Madrid Deep Space Tracking Station"},
+    {"madr", "MADR00ESP", "Madrid Deep Space Tracking Station"},
+    {"mayg", "MAYG00MYT", "Dzaoudzi"},
+    {"mers", "MERS00TUR", "Mersin"},
+    {"mikl", "MIKL00UKR", "Mykolaiv"},
+    {"morp", "MORP00GBR", "Morpeth"},
+    {"nklg", "NKLG00GAB", "N'KOLTANG"},
+    {"nyal", "NYAL00NOR", "Ny-Alesund"},
+    {"nya1", "NYA100NOR", "Ny-Alesund"},
+    {"ohi2", "OHI200ATA", "O'Higgins"},
+    {"orid", "ORID00MKD", "Ohrid"},
+    {"owmg", "OWMG00NZL", "Chatham Island"},
+    {"polv", "POLV00UKR", "Poltava"},
+    {"ptbb", "PTBB00DEU", "Braunschweig"},
+    {"ptgg", "PTGG00PHL", "Manilla"},
+    {"rabt", "RABT00MAR", "Rabat, EMI"},
+    {"reun", "REUN00REU", "La Reunion - Observatoire Volcanologique"},
+    {"rgdg", "RGDG00ARG", "Rio Grande"},
+    {"riga", "RIGA00LVA", "RIGA permanent GPS"},
+    {"seyg", "SEYG00SYC", "Mahe"},
+    {"sofi", "SOFI00BGR", "Sofia"},
+    {"stj3", "STJ300CAN", "STJ3 CACS-GSD"},
+    {"sulp", "SULP00UKR", "Lviv Polytechnic"},
+    {"svtl", "SVTL00RUS", "Svetloe"},
+    {"tana", "TANA00ETH", "ILA, Bahir Dar University"},
+    {"thtg", "THTG00PYF", "Papeete Tahiti"},
+    {"thti", "THTI00PYF", "Tahiti"},
+    {"tit2", "TIT200DEU", "Titz / Jackerath"},
+    {"tlse", "TLSE00FRA", "Toulouse"},
+    {"tro1", "TRO100NOR", "Tromsoe"},
+    {"warn", "WARN00DEU", "Warnemuende"},
+    {"whit", "WHIT00CAN", "WHIT CACS-GSD"},
+    {"wroc", "WROC00POL", "Wroclaw"},
+    {"wtza", "WTZA00DEU", "Wettzell"},
+    {"yel2", "YEL200CAN", "Yellow Knife"},
+    {"zeck", "ZECK00RUS", "Zelenchukskaya"},
+    {"zim2", "ZIM200CHE", "Zimmerwald"},
+    {"zimm", "ZIMM00CHE", "Zimmerwald L+T 88"},
+};
+
+/*! \brief Compute 64-bit FNV-1a hash
+ *  \param[in] data Input data
+ *  \param[in] len Length of input data in bytes
+ *  \returns Hash value
+ */
+static uint64_t fnv1a64(const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char *) data;
+    uint64_t h = 0xcbf29ce484222325ULL;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+
+    return (h);
+}
+
+/*! \brief Write channel state at the start of a block to the golden reference file
+ *  \param[in] fp Output file
+ *  \param[in] block Block counter since start
+ *  \param[in] chan Array of channels
+ *  \param[in] nchan Number of channels in \a chan
+ */
+static void writeGoldenState(FILE *fp, int block, const channel_t *chan, int nchan) {
+    int i;
+
+    for (i = 0; i < nchan; i++) {
+        if (chan[i].prn > 0) {
+            fprintf(fp, "C %d %d %.9f %.9f %.6f %d %d %d %d\n", block, chan[i].prn,
+                    chan[i].code_phase, (double) chan[i].carr_phase, chan[i].f_carr,
+                    chan[i].iword, chan[i].ibit, chan[i].icode, chan[i].dataBit);
+        }
+    }
+
+    return;
+}
+
+/*! \brief Write the hash of a generated block to the golden reference file
+ *  \param[in] fp Output file
+ *  \param[in] block Block counter since start
+ *  \param[in] iq Generated I/Q samples of the block
+ *  \param[in] nsamp Number of samples in \a iq
+ */
+static void writeGoldenHash(FILE *fp, int block, const short *iq, int nsamp) {
+    fprintf(fp, "B %d %016llx\n", block, (unsigned long long) fnv1a64(iq, (size_t) nsamp * 2 * sizeof (short)));
+
+    return;
+}
+
+static void usage(void) {
+    fprintf(stderr, "Usage: pluto-gps-sim [options]\n"
+            "Options:\n"
+            "  -e <file name>   RINEX navigation file for GPS ephemerides (required)\n"
+            "  -u <file name>   User motion file (dynamic mode) 10Hz, Max %u points\n"
+            "  -3               Use RINEX version 3 format\n"
+            "  -f               Pull actual RINEX navigation file from NASA FTP server\n"
+            "  -c <location>    ECEF X,Y,Z in meters (static mode) e.g. 3967283.154,1022538.181,4872414.484\n"
+            "  -l <location>    Lat,Lon,Hgt (static mode) e.g. 35.681298,139.766247,10.0\n"
+            "  -t <date,time>   Scenario start time YYYY/MM/DD,hh:mm:ss\n"
+            "  -T <date,time>   Overwrite TOC and TOE to scenario start time (use 'now' for actual time)\n"
+            "  -s <frequency>   Sampling frequency [Hz] (default: 2600000)\n"
+            "  -i               Disable ionospheric delay for spacecraft scenario\n"
+            "  -v               Show details about simulated channels\n"
+            "  -A <attenuation> Set TX attenuation [dB] (default -20.0)\n"
+            "  -B <bw>          Set RF bandwidth [MHz] (default 3.0)\n"
+            "  -U <uri>[,<att>] ADALM-Pluto URI, repeat for several devices\n"
+            "  -N <net>[,<att>] ADALM-Pluto network IP or hostname (default pluto.local), repeat for several devices\n"
+            "  -S <interval>    Report TX timing statistics every <interval> seconds\n"
+            "  -W <file name>   Write TX timing statistics to file instead of stderr\n"
+            "  -o <file name>   Write I/Q samples to file instead of ADALM-Pluto (deterministic mode)\n"
+            "  -d <duration>    Duration [sec] written to file (default 300)\n"
+            "  -g <file name>   Write golden reference of channel state and I/Q block hashes\n"
+            "  -X <file name>   Write per-epoch binary truth log of channel state\n"
+            "  -C <channels>    Number of channels (default %d, max %d)\n"
+            "  -Q <bound>       Use pre-resampled code templates, render again on code Doppler change > <bound> [Hz]\n"
+            "  -P               Use float32 phasor carrier generator instead of sin/cos table\n"
+            "  -L <bits>        Sin/cos table phase resolution %d..%d bits (default 9)\n"
+            "  -a               Scale output to the 12-bit DAC range\n"
+            "  -M               Write 12-bit samples MSB-aligned in 16 bit (implies 12-bit range)\n"
+            "  -n <C/N0>        Add white Gaussian noise, C/N0 [dB-Hz] at 20200km in antenna boresight\n"
+            "  -r <seed>        Noise generator seed (default 1)\n"
+            "  -p <prn:dB,...>  Signal power offset per PRN, e.g. 5:-3.0,12:6.0\n"
+            "  -k <prn:C/N0,...> Absolute C/N0 [dB-Hz] per PRN, needs -n\n"
+            "  -I <frequency>   Generate at this rate [Hz] and resample to the sampling frequency\n"
+            "  -F <taps>        Band-limit the output to the -B bandwidth with a FIR of %d..%d taps\n"
+            "  -R <file name>   Render the scenario once into a cache file with time index\n"
+            "  -Y <file name>   Replay a scenario cache to ADALM-Pluto or the -o file, no ephemeris needed\n"
+            "  -q <bits>        I/Q file format of -o and -R: 16, 8 or 4 bits per value (default 16, implies -a below 16)\n"
+            "  -J <threads>     Render -o or -R in time slices on <threads> cores, 0 = all\n"
+            "  -m <file name>   Receiver list, one I/Q file or ADALM-Pluto per receiver sharing the satellite state\n"
+            "  -K <file name>   Antenna array geometry, one phase-coherent I/Q file per element\n"
+            "  -E <prn:m:dB[:Hz[:deg]],...> Multipath echo per PRN: excess delay, power, Doppler and phase offset\n"
+            "  -Z <path|port>   Runtime control server on a Unix socket or localhost TCP port\n",
+            (unsigned int) USER_MOTION_SIZE, DEFAULT_CHAN, MAX_CHAN, MIN_CARR_TABLE_BITS, MAX_CARR_TABLE_BITS,
+            MIN_FIR_TAPS, MAX_FIR_TAPS);
+
+    return;
+}
+
+static void handle_sig(int sig) {
+    NOTUSED(sig);
+    signal(SIGINT, SIG_DFL); // reset signal handler - bit extra safety
+    // Main loop and TX thread check the flag at least once per block,
+    // the main loop joins the TX thread and closes the file sink
+    plutotx.exit = true;
+}
+
+static void histReset(timing_hist_t *h) {
+    memset(h, 0, sizeof (timing_hist_t));
+}
+
+/*! \brief Add a sample to a timing histogram
+ *  \param h Histogram (is updated)
+ *  \param[in] us Sample value in microseconds
+ */
+static void histAdd(timing_hist_t *h, double us) {
+    int bin = 0;
+    int e;
+    double m;
+
+    if (us < 0.0)
+        us = 0.0;
+
+    if (h->count == 0 || us < h->min)
+        h->min = us;
+    if (h->count == 0 || us > h->max)
+        h->max = us;
+    h->sum += us;
+    h->count++;
+
+    // Log-linear bin: power of two plus TIMING_HIST_SUB linear steps
+    if (us >= 1.0) {
+        m = frexp(us, &e); // us = m * 2^e, 0.5 <= m < 1
+        bin = (e - 1) * TIMING_HIST_SUB + (int) ((2.0 * m - 1.0) * TIMING_HIST_SUB);
+        if (bin >= TIMING_HIST_BINS)
+            bin = TIMING_HIST_BINS - 1;
+    }
+    h->bins[bin]++;
+}
+
+/*! \brief Estimate a percentile from a timing histogram
+ *  \param[in] h Histogram
+ *  \param[in] p Percentile 0.0 to 1.0
+ *  \returns Upper edge of the bin holding the percentile in microseconds
+ */
+static double histPercentile(const timing_hist_t *h, double p) {
+    unsigned long n = 0;
+    unsigned long target;
+    int bin;
+    double edge;
+
+    if (h->count == 0)
+        return (0.0);
+
+    target = (unsigned long) ceil(p * (double) h->count);
+    for (bin = 0; bin < TIMING_HIST_BINS; bin++) {
+        n += h->bins[bin];
+        if (n >= target)
+            break;
+    }
+
+    if (bin >= TIMING_HIST_BINS)
+        return (h->max);
+
+    edge = ldexp(1.0 + (double) (bin % TIMING_HIST_SUB + 1) / TIMING_HIST_SUB, bin / TIMING_HIST_SUB);
+    return ((edge > h->max) ? h->max : edge);
+}
+
+static void printHist(FILE *fp, const char *name, const timing_hist_t *h) {
+    fprintf(fp, " %s %.2f/%.2f/%.2f/%.2f", name,
+            h->min / 1000.0, (h->count > 0) ? h->sum / h->count / 1000.0 : 0.0,
+            h->max / 1000.0, histPercentile(h, 0.99) / 1000.0);
+}
+
+/*! \brief Print TX timing report of one device and restart the report interval
+ *  \param dev TX device
+ *  \param[in] now Current time stamp
+ */
+static void reportTxStats(struct tx_device *dev, const struct timespec *now) {
+    FILE *fp = (plutotx.stats_fp != NULL) ? plutotx.stats_fp : stderr;
+    tx_stats_t *st = &dev->stats;
+
+    // Several TX threads share the report output
+    flockfile(fp);
+    if (ntxdev > 1)
+        fprintf(fp, "TX%d", (int) (dev - txdev));
+    else
+        fprintf(fp, "TX");
+    fprintf(fp, " %.1fs blocks %lu min/avg/max/p99 [ms]:",
+            timeDiffUs(now, &st->t_report) / 1.0e6, st->gen.count);
+    printHist(fp, "gen", &st->gen);
+    printHist(fp, "push", &st->push);
+    printHist(fp, "period", &st->period);
+    printHist(fp, "slack", &st->slack);
+    fprintf(fp, " underruns %lu (total %lu) saturated %lu (total %lu)\n", st->underruns, st->underruns_total,
+            st->saturated, st->saturated_total);
+    fflush(fp);
+    funlockfile(fp);
+
+    histReset(&st->gen);
+    histReset(&st->push);
+    histReset(&st->period);
+    histReset(&st->slack);
+    st->underruns = 0;
+    st->saturated = 0;
+    st->t_report = *now;
+}
+
+/*! \brief Update TX timing telemetry of one device after a buffer push
+ *  \param dev TX device
+ *  \param[in] t_start Time stamp when the push was issued
+ *  \param[in] t_end Time stamp when the push returned
+ *  \param[in] gen_us Generation time of the pushed block in microseconds
+ *  \param[in] saturated Saturated I/Q values of the pushed block
+ */
+static void updateTxStats(struct tx_device *dev, const struct timespec *t_start, const struct timespec *t_end,
+        double gen_us, int saturated) {
+    tx_stats_t *st = &dev->stats;
+    double slack;
+
+    histAdd(&st->gen, gen_us);
+    st->saturated += saturated;
+    st->saturated_total += saturated;
+    histAdd(&st->push, timeDiffUs(t_end, t_start));
+
+    if (st->blocks_total == 0) {
+        // First block starts the DAC, use it as queue reference time
+        st->t_ref = *t_end;
+        st->t_report = *t_end;
+    } else {
+        histAdd(&st->period, timeDiffUs(t_end, &st->t_push));
+    }
+    st->t_push = *t_end;
+    st->blocks_total++;
+
+    // Signal time handed to the DAC minus wall time elapsed is the amount of
+    // samples still queued in the kernel buffers. Negative means the DAC ran dry.
+    st->pushed_us += (double) plutotx.block * 1.0e6 / plutotx.fs_hz;
+    slack = st->pushed_us - timeDiffUs(t_end, &st->t_ref);
+    if (slack < 0.0) {
+        st->underruns++;
+        st->underruns_total++;
+        // Restart queue estimate from this block
+        st->t_ref = *t_end;
+        st->pushed_us = (double) plutotx.block * 1.0e6 / plutotx.fs_hz;
+        slack = 0.0;
+    }
+    histAdd(&st->slack, slack);
+
+    if (timeDiffUs(t_end, &st->t_report) >= plutotx.stats_interval * 1.0e6)
+        reportTxStats(dev, t_end);
+}
+
+/*! \brief Truth log writer thread, drains the ring buffer into the log file */
+static void *truthLogThread(void *arg) {
+    NOTUSED(arg);
+    struct timespec idle = {0, 20000000}; // 20ms
+    size_t head, tail, n;
+    bool done;
+
+    while (1) {
+        done = atomic_load_explicit(&truthlog.exit, memory_order_acquire);
+        head = atomic_load_explicit(&truthlog.head, memory_order_acquire);
+        tail = atomic_load_explicit(&truthlog.tail, memory_order_relaxed);
+
+        if (head == tail) {
+            if (done)
+                break;
+            nanosleep(&idle, NULL);
+            continue;
+        }
+
+        // Write up to the end of the ring, wrap around on next turn
+        n = head - tail;
+        if ((tail & (TRUTH_RING_SIZE - 1)) + n > TRUTH_RING_SIZE)
+            n = TRUTH_RING_SIZE - (tail & (TRUTH_RING_SIZE - 1));
+        if (fwrite(truthlog.ring + (tail & (TRUTH_RING_SIZE - 1)), 1, n, truthlog.fp) != n) {
+            fprintf(stderr, "ERROR: Failed to write truth log file.\n");
+            // Keep draining so the main thread never stalls
+        }
+        atomic_store_explicit(&truthlog.tail, tail + n, memory_order_release);
+    }
+
+    fflush(truthlog.fp);
+
+    return NULL;
+}
+
+/*! \brief Open truth log file and start writer thread
+ *  \param[in] filename Name of the truth log file
+ *  \param[in] fs Sample rate in Hz
+ *  \returns 0 on success, -1 on error
+ */
+static int truthLogOpen(const char *filename, double fs) {
+    truth_header_t hdr;
+
+    truthlog.fp = fopen(filename, "wb");
+    truthlog.ring = malloc(TRUTH_RING_SIZE);
+    if (truthlog.fp == NULL || truthlog.ring == NULL) {
+        fprintf(stderr, "ERROR: Failed to open truth log file.\n");
+        goto truth_log_error;
+    }
+
+    memset(&hdr, 0, sizeof (hdr));
+    hdr.magic = TRUTH_MAGIC;
+    hdr.version = TRUTH_VERSION;
+    hdr.interval = 0.1;
+    hdr.fs = fs;
+    fwrite(&hdr, sizeof (hdr), 1, truthlog.fp);
+
+    atomic_init(&truthlog.head, 0);
+    atomic_init(&truthlog.tail, 0);
+    atomic_init(&truthlog.exit, false);
+    truthlog.dropped = 0;
+
+    if (pthread_create(&truthlog.thread, NULL, truthLogThread, NULL) != 0) {
+        fprintf(stderr, "ERROR: Failed to start truth log thread.\n");
+        goto truth_log_error;
+    }
+
+    return (0);
+
+truth_log_error:
+    if (truthlog.fp)
+        fclose(truthlog.fp);
+    free(truthlog.ring);
+    truthlog.fp = NULL;
+    truthlog.ring = NULL;
+
+    return (-1);
+}
+
+/*! \brief Copy data into the truth log ring at given position */
+static void truthLogCopy(size_t pos, const void *data, size_t len) {
+    size_t off = pos & (TRUTH_RING_SIZE - 1);
+    size_t n = (off + len > TRUTH_RING_SIZE) ? TRUTH_RING_SIZE - off : len;
+
+    memcpy(truthlog.ring + off, data, n);
+    memcpy(truthlog.ring, (const unsigned char *) data + n, len - n);
+}
+
+/*! \brief Queue the state of all active channels at the end of the block, never blocks
+ *
+ * The channels hold code and carrier phase at the block start, they are
+ * advanced over the 0.1s block to the time of the pseudorange.
+ *  \param[in] chan Channel array
+ *  \param[in] nchan Number of channels in array
+ *  \param[in] gain Signal gain of each channel
+ *  \param[in] rho Pseudorange of each channel at the end of the block
+ *  \param[in] epoch Epoch counter, the block number
+ *  \param[in] rx Receiver index
+ *  \param[in] g Receiver time at the end of the block
+ *  \param[in] xyz Receiver position ECEF
+ */
+static void truthLogEpoch(const channel_t *chan, int nchan, const double *gain, const range_t *rho,
+        int epoch, int rx, gpstime_t g, const double *xyz) {
+    truth_epoch_t ep;
+    truth_chan_t tc;
+    size_t head, tail, len, pos;
+    int i;
+
+    if (truthlog.fp == NULL)
+        return;
+
+    memset(&ep, 0, sizeof (ep));
+    ep.magic = TRUTH_MAGIC;
+    for (i = 0; i < nchan; i++) {
+        if (chan[i].prn > 0)
+            ep.nchan++;
+    }
+    ep.epoch = epoch;
+    ep.rx = rx;
+    ep.g = g;
+    ep.xyz[0] = xyz[0];
+    ep.xyz[1] = xyz[1];
+    ep.xyz[2] = xyz[2];
+
+    len = sizeof (ep) + ep.nchan * sizeof (tc);
+    head = atomic_load_explicit(&truthlog.head, memory_order_relaxed);
+    tail = atomic_load_explicit(&truthlog.tail, memory_order_acquire);
+    if (TRUTH_RING_SIZE - (head - tail) < len) {
+        // Writer fell behind, drop this epoch rather than stall the signal generator
+        truthlog.dropped++;
+        return;
+    }
+    ep.dropped = truthlog.dropped;
+
+    truthLogCopy(head, &ep, sizeof (ep));
+    pos = head + sizeof (ep);
+    memset(&tc, 0, sizeof (tc));
+    for (i = 0; i < nchan; i++) {
+        if (chan[i].prn == 0)
+            continue;
+        tc.prn = chan[i].prn;
+        tc.range = rho[i].range;
+        tc.rate = rho[i].rate;
+        tc.iono_delay = rho[i].iono_delay;
+        tc.azel[0] = rho[i].azel[0];
+        tc.azel[1] = rho[i].azel[1];
+        tc.f_carr = chan[i].f_carr;
+        tc.f_code = chan[i].f_code;
+        tc.code_phase = fmod(chan[i].code_phase + chan[i].f_code * 0.1, CA_SEQ_LEN);
+        tc.carr_phase = carrierPhase(&chan[i]) + chan[i].f_carr * 0.1;
+        tc.carr_phase -= floor(tc.carr_phase);
+        tc.gain = gain[i];
+        truthLogCopy(pos, &tc, sizeof (tc));
+        pos += sizeof (tc);
+    }
+
+    atomic_store_explicit(&truthlog.head, pos, memory_order_release);
+}
+
+/*! \brief Flush pending epochs, stop writer thread and close truth log */
+static void truthLogClose(void) {
+    if (truthlog.fp == NULL)
+        return;
+
+    atomic_store_explicit(&truthlog.exit, true, memory_order_release);
+    pthread_join(truthlog.thread, NULL);
+    if (truthlog.dropped > 0)
+        fprintf(stderr, "Truth log dropped %u epochs.\n", truthlog.dropped);
+    fclose(truthlog.fp);
+    free(truthlog.ring);
+    truthlog.fp = NULL;
+    truthlog.ring = NULL;
+}
+
+/*! \brief Create a scenario cache file, the I/Q blocks follow at CACHE_DATA_OFFSET
+ *  \param[in] filename Scenario cache file
+ *  \param[in] fs Sample rate (Hz)
+ *  \param[in] block I/Q samples per block
+ *  \param[in] bits Sample format, see IQ_FMT_SC16
+ *  \param[in] shift Left shift that expands compact samples, see iqShift()
+ *  \returns File to write the I/Q blocks to, NULL on error
+ */
+static FILE *cacheOpen(const char *filename, double fs, int block, int bits, int shift) {
+    memset(&cache, 0, sizeof (cache));
+    cache.fp = fopen(filename, "wb");
+    if (cache.fp == NULL) {
+        fprintf(stderr, "ERROR: Failed to open scenario cache file.\n");
+        return (NULL);
+    }
+
+    cache.hdr.magic = CACHE_MAGIC;
+    cache.hdr.version = CACHE_VERSION;
+    cache.hdr.format = (uint32_t) bits;
+    cache.hdr.block = (uint32_t) block;
+    cache.hdr.shift = (uint32_t) shift;
+    cache.hdr.fs = fs;
+
+    // Header is rewritten on close, the first block starts on a page boundary
+    if (fseeko(cache.fp, CACHE_DATA_OFFSET, SEEK_SET) != 0) {
+        fprintf(stderr, "ERROR: Failed to write scenario cache file.\n");
+        fclose(cache.fp);
+        cache.fp = NULL;
+    }
+
+    return (cache.fp);
+}
+
+/*! \brief Add the block just written to the scenario cache time index
+ *  \param[in] g Receiver time of block
+ *  \returns 0 on success, -1 on allocation failure
+ */
+static int cacheAddBlock(gpstime_t g) {
+    cache_index_t *index;
+    uint64_t n = cache.hdr.nblocks;
+
+    if (cache.fp == NULL)
+        return (0);
+
+    if (n >= cache.nalloc) {
+        index = realloc(cache.index, (cache.nalloc + 600) * sizeof (cache_index_t));
+        if (index == NULL)
+            return (-1);
+        cache.index = index;
+        cache.nalloc += 600;
+    }
+
+    if (n == 0)
+        cache.hdr.start = g;
+    cache.index[n].g = g;
+    cache.index[n].offset = CACHE_DATA_OFFSET + n * iqBytes(cache.hdr.format, cache.hdr.block);
+    cache.hdr.nblocks++;
+
+    return (0);
+}
+
+/*! \brief Append the time index, write the final header and close the scenario cache */
+static void cacheClose(void) {
+    if (cache.fp == NULL)
+        return;
+
+    cache.hdr.index_offset = CACHE_DATA_OFFSET + cache.hdr.nblocks * iqBytes(cache.hdr.format, cache.hdr.block);
+    if (fseeko(cache.fp, (off_t) cache.hdr.index_offset, SEEK_SET) != 0
+            || fwrite(cache.index, sizeof (cache_index_t), cache.hdr.nblocks, cache.fp) != cache.hdr.nblocks
+            || fseeko(cache.fp, 0, SEEK_SET) != 0
+            || fwrite(&cache.hdr, sizeof (cache.hdr), 1, cache.fp) != 1)
+        fprintf(stderr, "ERROR: Failed to write scenario cache file.\n");
+    else
+        fprintf(stderr, "Scenario cache holds %.1fs of I/Q samples.\n", cache.hdr.nblocks / 10.0);
+
+    fclose(cache.fp);
+    free(cache.index);
+    cache.fp = NULL;
+    cache.index = NULL;
+}
+
+/*! \brief Wake the main thread waiting on any TX device, after setting the exit flag
+ *  \param first Device to wake first, the main thread waits on at most one device
+ */
+static void txWakeAll(struct tx_device *first) {
+    int i;
+
+    for (i = -1; i < ntxdev; i++) {
+        struct tx_device *dev = (i < 0) ? first : &txdev[i];
+        if (dev == NULL || (i >= 0 && dev == first))
+            continue;
+        pthread_mutex_lock(&dev->data_mutex);
+        plutotx.exit = true;
+        pthread_cond_broadcast(&dev->data_cond);
+        pthread_mutex_unlock(&dev->data_mutex);
+    }
+}
+
+/*! \brief TX thread of one ADALM-Pluto
+ *  \param arg TX device
+ */
+void *pluto_tx_thread_ep(void *arg) {
+    struct tx_device *dev = (struct tx_device *) arg;
+    char buf[1024];
+    struct iio_context *ctx = NULL;
+    struct iio_device *tx = NULL;
+    struct iio_device *phydev = NULL;
+    struct iio_channel *tx0_i = NULL;
+    struct iio_channel *tx0_q = NULL;
+    struct iio_buffer *tx_buffer = NULL;
+
+    // Try sticking the TX threads to core 2 and up
+    thread_to_core(2 + (int) (dev - txdev));
+
+    // Create IIO context to access ADALM-Pluto, several devices need their URI
+    if (dev->uri[0] != '\0') {
+        ctx = iio_create_context_from_uri(dev->uri);
+    } else {
+        ctx = iio_create_default_context();
+        if (ctx == NULL)
+            ctx = iio_create_network_context("pluto.local");
+    }
+
+    if (ctx == NULL) {
+        iio_strerror(errno, buf, sizeof (buf));
+        fprintf(stderr, "Failed creating IIO context %s: %s\n", dev->uri, buf);
+        goto pluto_thread_exit;
+    }
+
+    int device_count = iio_context_get_devices_count(ctx);
+    if (!device_count) {
+        fprintf(stderr, "No supported PLUTOSDR devices found.\n");
+        goto pluto_thread_exit;
+    }
+
+    tx = iio_context_find_device(ctx, "cf-ad9361-dds-core-lpc");
+    if (tx == NULL) {
+        iio_strerror(errno, buf, sizeof (buf));
+        fprintf(stderr, "Error opening PLUTOSDR TX device: %s\n", buf);
+        goto pluto_thread_exit;
+    }
+
+    // Additional IQ kernel buffers, default is 4
+    iio_device_set_kernel_buffers_count(tx, 12);
+
+    phydev = iio_context_find_device(ctx, "ad9361-phy");
+    struct iio_channel* phy_chn = iio_device_find_channel(phydev, "voltage0", true);
+    iio_channel_attr_write(phy_chn, "rf_port_select", plutotx.rfport);
+    iio_channel_attr_write_longlong(phy_chn, "rf_bandwidth", plutotx.bw_hz);
+    iio_channel_attr_write_longlong(phy_chn, "sampling_frequency", plutotx.fs_hz);
+    iio_channel_attr_write_double(phy_chn, "hardwaregain", dev->gain_db);
+
+    iio_channel_attr_write_bool(
+            iio_device_find_channel(phydev, "altvoltage0", true)
+            , "powerdown", true); // Turn OFF RX LO
+
+    iio_channel_attr_write_longlong(
+            iio_device_find_channel(phydev, "altvoltage1", true)
+            , "frequency", plutotx.lo_hz); // Set TX LO frequency
+
+    tx0_i = iio_device_find_channel(tx, "voltage0", true);
+    if (!tx0_i)
+        tx0_i = iio_device_find_channel(tx, "altvoltage0", true);
+
+    tx0_q = iio_device_find_channel(tx, "voltage1", true);
+    if (!tx0_q)
+        tx0_q = iio_device_find_channel(tx, "altvoltage1", true);
+
+    iio_channel_enable(tx0_i);
+    iio_channel_enable(tx0_q);
+
+    ad9361_set_bb_rate(iio_context_find_device(ctx, "ad9361-phy"), plutotx.fs_hz);
+
+    tx_buffer = iio_device_create_buffer(tx, plutotx.block, false);
+    if (!tx_buffer) {
+        fprintf(stderr, "Could not create TX buffer.\n");
+        goto pluto_thread_exit;
+    }
+
+    iio_channel_attr_write_bool(
+            iio_device_find_channel(iio_context_find_device(ctx, "ad9361-phy"), "altvoltage1", true)
+            , "powerdown", false); // Turn ON TX LO
+
+    int32_t ntx = 0;
+    struct timespec t_start, t_end;
+    double gen_us, gain;
+    int saturated;
+
+    pthread_mutex_lock(&dev->data_mutex);
+    while (!plutotx.exit) {
+        // Hand the free TX buffer to the main thread, it writes the samples in place
+        dev->tx_buff = (short *) iio_buffer_start(tx_buffer);
+        pthread_cond_signal(&dev->data_cond);
+        while (!dev->data_ready && !plutotx.exit)
+            pthread_cond_wait(&dev->data_cond, &dev->data_mutex);
+        if (plutotx.exit)
+            break;
+        dev->data_ready = false;
+        gen_us = dev->gen_us;
+        saturated = dev->saturated;
+        pthread_mutex_unlock(&dev->data_mutex);
+        // Runtime gain change, takes effect with this block
+        gain = atomic_load_explicit(&dev->gain_req, memory_order_relaxed);
+        if (gain != dev->gain_db) {
+            iio_channel_attr_write_double(phy_chn, "hardwaregain", gain);
+            dev->gain_db = gain;
+        }
+        // Schedule TX buffer
+        clock_gettime(CLOCK_MONOTONIC, &t_start);
+        ntx = iio_buffer_push(tx_buffer);
+        clock_gettime(CLOCK_MONOTONIC, &t_end);
+        pthread_mutex_lock(&dev->data_mutex);
+        if (ntx < 0) {
+            fprintf(stderr, "Error pushing buf %d\n", (int) ntx);
+            break;
+        }
+
+        if (plutotx.stats_interval > 0.0)
+            updateTxStats(dev, &t_start, &t_end, gen_us, saturated);
+    }
+    dev->tx_buff = NULL;
+    pthread_mutex_unlock(&dev->data_mutex);
+
+pluto_thread_exit:
+    if (ctx) {
+        iio_channel_attr_write_bool(
+                iio_device_find_channel(iio_context_find_device(ctx, "ad9361-phy"), "altvoltage1", true)
+                , "powerdown", true); // Turn OFF TX LO
+    }
+
+    if (tx_buffer) {
+        iio_buffer_destroy(tx_buffer);
+    }
+    if (tx0_i) {
+        iio_channel_disable(tx0_i);
+    }
+    if (tx0_q) {
+        iio_channel_disable(tx0_q);
+    }
+    if (ctx) {
+        iio_context_destroy(ctx);
+    }
+
+    // Wake the main thread (if it's still waiting), one failed device stops all
+    txWakeAll(dev);
+#ifndef _WIN32
+    pthread_exit(NULL);
+#else
+    return NULL;
+#endif
+}
+
+/*! \brief Add a TX device from a command line or receiver list argument
+ *  \param[in] arg "<uri>[,<gain>]", empty URI selects the default context
+ *  \param[in] network URI is a network IP or hostname
+ *  \returns Index of the device, -1 on error
+ */
+static int txAddDevice(const char *arg, bool network) {
+    struct tx_device *dev;
+    const char *sep = strchr(arg, ',');
+    size_t len = (sep != NULL) ? (size_t) (sep - arg) : strlen(arg);
+
+    if (ntxdev >= MAX_TX_DEVICES) {
+        fprintf(stderr, "ERROR: Too many TX devices, max. %d.\n", MAX_TX_DEVICES);
+        return (-1);
+    }
+    if (len + 4 > sizeof (txdev[0].uri)) {
+        fprintf(stderr, "ERROR: TX device URI too long.\n");
+        return (-1);
+    }
+
+    dev = &txdev[ntxdev];
+    memset(dev, 0, sizeof (*dev));
+    if (len > 0)
+        snprintf(dev->uri, sizeof (dev->uri), "%s%.*s", network ? "ip:" : "", (int) len, arg);
+    dev->gain_db = NAN;
+    pthread_mutex_init(&dev->data_mutex, NULL);
+    pthread_cond_init(&dev->data_cond, NULL);
+    if (sep != NULL) {
+        dev->gain_db = atof(sep + 1);
+        if (dev->gain_db > 0.0) dev->gain_db = 0.0;
+        if (dev->gain_db < -80.0) dev->gain_db = -80.0;
+    }
+
+    return (ntxdev++);
+}
+
+/*! \brief Start the TX threads of all devices */
+static void txStart(void) {
+    struct tx_device *dev;
+    int i;
+
+    for (i = 0; i < ntxdev; i++) {
+        dev = &txdev[i];
+        if (isnan(dev->gain_db))
+            dev->gain_db = plutotx.gain_db;
+        atomic_init(&dev->gain_req, dev->gain_db);
+        fprintf(stderr, "TX%d: %s, gain %.1fdB\n", i, (dev->uri[0] != '\0') ? dev->uri : "default", dev->gain_db);
+        dev->started = (pthread_create(&dev->thread, NULL, pluto_tx_thread_ep, dev) == 0);
+        if (!dev->started) {
+            fprintf(stderr, "ERROR: Failed to start TX thread.\n");
+            txWakeAll(NULL);
+            break;
+        }
+    }
+}
+
+/*! \brief Wait for the free TX buffer of a TX thread, the data mutex is held on success
+ *  \param dev TX device
+ *  \returns TX buffer to write one block into, NULL on exit
+ */
+static short *txAcquire(struct tx_device *dev) {
+    pthread_mutex_lock(&dev->data_mutex);
+    while (dev->tx_buff == NULL && !plutotx.exit)
+        pthread_cond_wait(&dev->data_cond, &dev->data_mutex);
+    if (plutotx.exit) {
+        pthread_mutex_unlock(&dev->data_mutex);
+        return (NULL);
+    }
+
+    return (dev->tx_buff);
+}
+
+/*! \brief Hand the filled TX buffer back to the TX thread and release the data mutex
+ *  \param dev TX device
+ *  \param[in] gen_us Generation time of the block in microseconds
+ *  \param[in] saturated Saturated I/Q values of the block
+ */
+static void txRelease(struct tx_device *dev, double gen_us, int saturated) {
+    dev->gen_us = gen_us;
+    dev->saturated = saturated;
+    dev->tx_buff = NULL;
+    dev->data_ready = true;
+    pthread_cond_signal(&dev->data_cond);
+    pthread_mutex_unlock(&dev->data_mutex);
+}
+
+/*! \brief Copy one block to a range of TX devices
+ *  \param[in] buff 16-bit I/Q block
+ *  \param[in] dev0 First device
+ *  \param[in] ndev Number of devices
+ *  \param[in] gen_us Generation time of the block in microseconds
+ *  \param[in] saturated Saturated I/Q values of the block
+ *  \returns 0 on success, -1 on exit
+ */
+static int txFanOut(const short *buff, int dev0, int ndev, double gen_us, int saturated) {
+    short *out;
+    int i;
+
+    // The main thread holds one data mutex at a time
+    for (i = dev0; i < dev0 + ndev; i++) {
+        if ((out = txAcquire(&txdev[i])) == NULL)
+            return (-1);
+        memcpy(out, buff, (size_t) plutotx.block * 2 * sizeof (short));
+        txRelease(&txdev[i], gen_us, saturated);
+    }
+
+    return (0);
+}
+
+/*! \brief Stop the TX threads and wait for their exit */
+static void txStop(void) {
+    int i;
+
+    txWakeAll(NULL);
+    for (i = 0; i < ntxdev; i++) {
+        if (txdev[i].started)
+            pthread_join(txdev[i].thread, NULL);
+        txdev[i].started = false;
+        pthread_mutex_destroy(&txdev[i].data_mutex);
+        pthread_cond_destroy(&txdev[i].data_cond);
+    }
+}
+
+/*! \brief Stream a pre-rendered scenario cache to Pluto or the I/Q file sink
+ *
+ * The cache is mapped read-only in windows of CACHE_WINDOW bytes, each block
+ * is copied straight into the TX buffer or expanded from a compact format.
+ * Nothing else is computed, the kernel reads CACHE_READAHEAD blocks ahead. The
+ * -o file gets 16-bit samples, several TX devices all get the same block.
+ *  \param[in] filename Scenario cache file written with -R
+ *  \returns Exit code
+ */
+static int replayScenario(const char *filename) {
+    cache_header_t hdr;
+    const unsigned char *win = NULL, *blk;
+    struct timespec t_start, t_end;
+    struct stat st;
+    datetime_t t;
+    size_t bytes, page, win_len = 0;
+    off_t win_off = 0, blk_off;
+    uint64_t k;
+    short *out, *sink_buff = NULL;
+    int fd, ret = 0;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size < CACHE_DATA_OFFSET
+            || pread(fd, &hdr, sizeof (hdr), 0) != (ssize_t) sizeof (hdr)) {
+        fprintf(stderr, "ERROR: Failed to open scenario cache file.\n");
+        if (fd >= 0)
+            close(fd);
+        return (1);
+    }
+
+    bytes = iqBytes(hdr.format, hdr.block);
+    if (hdr.magic != CACHE_MAGIC || hdr.version != CACHE_VERSION || hdr.shift > 12 || (hdr.block & 1) != 0
+            || (hdr.format != IQ_FMT_SC16 && hdr.format != IQ_FMT_SC8 && hdr.format != IQ_FMT_SC4)
+            || hdr.block == 0 || hdr.nblocks == 0
+            || CACHE_DATA_OFFSET + hdr.nblocks * bytes > (uint64_t) st.st_size) {
+        fprintf(stderr, "ERROR: Invalid scenario cache file.\n");
+        close(fd);
+        return (1);
+    }
+
+    plutotx.fs_hz = (long long) hdr.fs;
+    plutotx.block = (int) hdr.block;
+    page = (size_t) sysconf(_SC_PAGESIZE);
+
+    gps2date(&hdr.start, &t);
+    fprintf(stderr, "Replaying %.1fs of sc%u I/Q samples at %.0f Hz from %4d/%02d/%02d,%02d:%02d:%02.0f.\n",
+            hdr.nblocks / 10.0, hdr.format, hdr.fs, t.y, t.m, t.d, t.hh, t.mm, t.sec);
+
+    if ((plutotx.sink_fp != NULL || ntxdev > 1) && hdr.format != IQ_FMT_SC16) {
+        sink_buff = malloc((size_t) hdr.block * 2 * sizeof (short));
+        if (sink_buff == NULL) {
+            fprintf(stderr, "ERROR: Faild to allocate 16-bit I/Q buffer.\n");
+            close(fd);
+            return (1);
+        }
+    }
+
+    if (plutotx.sink_fp == NULL)
+        txStart();
+
+    for (k = 0; k < hdr.nblocks && !plutotx.exit; k++) {
+        blk_off = CACHE_DATA_OFFSET + (off_t) k * (off_t) bytes;
+
+        if (win == NULL || blk_off + (off_t) bytes > win_off + (off_t) win_len) {
+            // Slide the window on, a long cache never needs the full address space
+            if (win != NULL)
+                munmap((void *) win, win_len);
+            win_off = blk_off & ~(off_t) (page - 1);
+            win_len = (CACHE_WINDOW > bytes) ? CACHE_WINDOW : bytes + page;
+            if (win_off + (off_t) win_len > st.st_size)
+                win_len = (size_t) (st.st_size - win_off);
+            win = mmap(NULL, win_len, PROT_READ, MAP_SHARED, fd, win_off);
+            if (win == MAP_FAILED) {
+                fprintf(stderr, "ERROR: Failed to map scenario cache file.\n");
+                win = NULL;
+                ret = 1;
+                break;
+            }
+            madvise((void *) win, win_len, MADV_SEQUENTIAL);
+        }
+        blk = win + (blk_off - win_off);
+
+        // Prefetch the next blocks, the hint also crosses the window end
+        if ((k % CACHE_READAHEAD) == 0)
+            posix_fadvise(fd, blk_off + (off_t) bytes, (off_t) (CACHE_READAHEAD * bytes), POSIX_FADV_WILLNEED);
+
+        if (plutotx.sink_fp != NULL) {
+            if (sink_buff != NULL) {
+                iqExpand(blk, sink_buff, plutotx.block, hdr.format, hdr.shift);
+                blk = (const unsigned char *) sink_buff;
+            }
+            if (fwrite(blk, 2 * sizeof (short), plutotx.block, plutotx.sink_fp) != (size_t) plutotx.block) {
+                fprintf(stderr, "ERROR: Failed to write I/Q output file.\n");
+                ret = 1;
+                break;
+            }
+        } else if (ntxdev > 1) {
+            // Same block to every device
+            clock_gettime(CLOCK_MONOTONIC, &t_start);
+            if (sink_buff != NULL) {
+                iqExpand(blk, sink_buff, plutotx.block, hdr.format, hdr.shift);
+                blk = (const unsigned char *) sink_buff;
+            }
+            clock_gettime(CLOCK_MONOTONIC, &t_end);
+            if (txFanOut((const short *) blk, 0, ntxdev, timeDiffUs(&t_end, &t_start), 0) != 0)
+                break;
+        } else {
+            if ((out = txAcquire(&txdev[0])) == NULL)
+                break;
+            clock_gettime(CLOCK_MONOTONIC, &t_start);
+            if (hdr.format == IQ_FMT_SC16)
+                memcpy(out, blk, bytes);
+            else
+                iqExpand(blk, out, plutotx.block, hdr.format, hdr.shift);
+            clock_gettime(CLOCK_MONOTONIC, &t_end);
+            txRelease(&txdev[0], timeDiffUs(&t_end, &t_start), 0);
+        }
+    }
+
+    if (plutotx.sink_fp == NULL)
+        txStop();
+    else
+        fclose(plutotx.sink_fp);
+    if (plutotx.stats_fp)
+        fclose(plutotx.stats_fp);
+    free(sink_buff);
+    if (win != NULL)
+        munmap((void *) win, win_len);
+    close(fd);
+
+    return (ret);
+}
+
+/*! \brief Render worker, takes segments until the timeline is covered
+ *
+ * A segment that does not continue the previous one of the same worker first
+ * renders the block before it without output, so resampler and band-limiting
+ * FIR start with the history a serial run would have.
+ */
+static void *renderWorker(void *arg) {
+    struct render_worker *w = (struct render_worker *) arg;
+    struct render_job *job = w->job;
+    gpssim_t *sim;
+    short *iq;
+    unsigned char *pack = NULL;
+    const void *out;
+    size_t bytes = iqBytes(job->iq_bits, job->block);
+    int seg, start, end, next = 0, i, k, nsat;
+    int ncores = (int) sysconf(_SC_NPROCESSORS_ONLN), core = 0;
+
+    // Threads inherit the single core of the main thread, spread them over
+    // all other cores and leave core 1 to the main thread
+    if (ncores > 1) {
+        core = w->id % (ncores - 1);
+        if (core >= 1)
+            core++;
+    }
+    thread_to_core(core);
+
+    sim = gpssim_clone(job->sim);
+    iq = malloc((size_t) job->block * 2 * sizeof (short));
+    if (job->iq_bits != IQ_FMT_SC16)
+        pack = malloc(bytes);
+    if (sim == NULL || iq == NULL || (job->iq_bits != IQ_FMT_SC16 && pack == NULL)
+            || gpssim_start(sim, job->g0.week, job->g0.sec) != 0) {
+        fprintf(stderr, "ERROR: Failed to allocate render thread.\n");
+        atomic_store(&job->error, true);
+        goto render_worker_exit;
+    }
+
+    while (!atomic_load(&job->error) && !plutotx.exit) {
+        seg = atomic_fetch_add(&job->next_seg, 1);
+        start = seg * job->seg_len;
+        if (start >= job->nblock)
+            break;
+        end = start + job->seg_len;
+        if (end > job->nblock)
+            end = job->nblock;
+
+        if (start != next) {
+            // Filters need the block before the segment
+            next = job->warmup ? start - 1 : start;
+            if (gpssim_seek(sim, next) != 0) {
+                fprintf(stderr, "ERROR: Failed to seek block %d.\n", next);
+                atomic_store(&job->error, true);
+                break;
+            }
+        }
+
+        for (i = next; i < end && !atomic_load(&job->error); i++) {
+            if (gpssim_step(sim) != 0) {
+                fprintf(stderr, "ERROR: Failed to step block %d.\n", i);
+                atomic_store(&job->error, true);
+                break;
+            }
+
+            for (k = 0; k < job->nrx; k++) {
+                if (gpssim_render(sim, k) != 0) {
+                    fprintf(stderr, "ERROR: Failed to render block %d.\n", i);
+                    atomic_store(&job->error, true);
+                    break;
+                }
+                if (i < start)
+                    continue;
+
+                nsat = gpssim_pack(sim, k, 0, iq);
+                out = iq;
+                if (pack != NULL) {
+                    iqCompress(iq, pack, job->block, job->iq_bits, iqShift(job->iq_bits, job->out_shift));
+                    out = pack;
+                }
+                if (pwrite(fileno(job->out[k].fp), out, bytes, job->base + (off_t) i * (off_t) bytes) != (ssize_t) bytes) {
+                    fprintf(stderr, "ERROR: Failed to write I/Q output file.\n");
+                    atomic_store(&job->error, true);
+                    break;
+                }
+                if (nsat > 0) {
+                    atomic_fetch_add(&job->sat_total, (unsigned long) nsat);
+                    atomic_fetch_add(&job->sat_blocks, 1);
+                }
+            }
+        }
+        next = end;
+    }
+
+render_worker_exit:
+    gpssim_destroy(sim);
+    free(iq);
+    free(pack);
+
+    return (NULL);
+}
+
+/*! \brief Render the whole file sink with a pool of worker threads
+ *  \param job Render job, set up except for the counters
+ *  \param[in] nthreads Number of worker threads
+ *  \returns 0 on success, -1 on error
+ */
+static int renderParallel(struct render_job *job, int nthreads) {
+    struct render_worker *w;
+    int i, n = 0;
+
+    job->seg_len = job->nblock / (nthreads * RENDER_SEG_PER_THREAD);
+    if (job->seg_len < RENDER_SEG_MIN)
+        job->seg_len = RENDER_SEG_MIN;
+    if (job->seg_len > RENDER_SEG_MAX)
+        job->seg_len = RENDER_SEG_MAX;
+    atomic_init(&job->next_seg, 0);
+    atomic_init(&job->sat_total, 0);
+    atomic_init(&job->sat_blocks, 0);
+    atomic_init(&job->error, false);
+
+    w = calloc(nthreads, sizeof (struct render_worker));
+    if (w == NULL)
+        return (-1);
+
+    for (i = 0; i < nthreads; i++) {
+        w[i].job = job;
+        w[i].id = i;
+        if (pthread_create(&w[i].thread, NULL, renderWorker, &w[i]) != 0) {
+            fprintf(stderr, "ERROR: Failed to start render thread.\n");
+            atomic_store(&job->error, true);
+            break;
+        }
+        n++;
+    }
+
+    for (i = 0; i < n; i++)
+        pthread_join(w[i].thread, NULL);
+    free(w);
+
+    return (atomic_load(&job->error) ? -1 : 0);
+}
+
+/*! \brief Read the element list of an antenna array
+ *
+ * One element per line: I/Q output file, "east,north,up" offset from the
+ * receiver position in meters and an optional gain in dB. Empty lines and
+ * lines starting with # are skipped.
+ *  \param[in] filename Array geometry file
+ *  \param[out] el Array elements, MAX_ARRAY_ELEMENTS entries
+ *  \returns Number of elements, -1 on error
+ */
+static int readArray(const char *filename, struct element_output *el) {
+    FILE *fp;
+    char str[512], out[512];
+    int n = 0, line = 0, nf;
+
+    fp = fopen(filename, "rt");
+    if (fp == NULL) {
+        fprintf(stderr, "ERROR: Failed to open array geometry file.\n");
+        return (-1);
+    }
+
+    while (fgets(str, sizeof (str), fp) != NULL) {
+        line++;
+        if (sscanf(str, "%511s", out) != 1 || out[0] == '#')
+            continue;
+        if (n >= MAX_ARRAY_ELEMENTS) {
+            fprintf(stderr, "ERROR: Too many array elements, max. %d.\n", MAX_ARRAY_ELEMENTS);
+            goto read_array_error;
+        }
+
+        el[n].gain_db = 0.0;
+        nf = sscanf(str, "%511s %lf,%lf,%lf %lf", out, &el[n].enu[0], &el[n].enu[1], &el[n].enu[2], &el[n].gain_db);
+        if (nf < 4) {
+            fprintf(stderr, "ERROR: Invalid element in line %d of the array geometry.\n", line);
+            goto read_array_error;
+        }
+
+        el[n].fp = fopen(out, "wb");
+        if (el[n].fp == NULL) {
+            fprintf(stderr, "ERROR: Failed to open I/Q output file %s.\n", out);
+            goto read_array_error;
+        }
+        n++;
+    }
+    fclose(fp);
+
+    if (n == 0)
+        fprintf(stderr, "ERROR: Array geometry is empty.\n");
+
+    return ((n > 0) ? n : -1);
+
+read_array_error:
+    fclose(fp);
+    while (n-- > 0)
+        fclose(el[n].fp);
+
+    return (-1);
+}
+
+/*! \brief Read the receiver list of a multi-receiver run
+ *
+ * One receiver per line: I/Q output file or "pluto:<uri>[,<gain>]" followed
+ * by "llh lat,lon,hgt", "xyz x,y,z" or "motion <user motion file>". Empty
+ * lines and lines starting with # are skipped.
+ *  \param[in] filename Receiver list file
+ *  \param[out] rx Receivers, MAX_RECEIVERS entries
+ *  \returns Number of receivers, -1 on error
+ */
+static int readReceivers(const char *filename, struct rx_output *rx) {
+    FILE *fp;
+    char str[512], out[512], mode[512], arg[512];
+    double llh[3];
+    int n = 0, line = 0, ok;
+
+    fp = fopen(filename, "rt");
+    if (fp == NULL) {
+        fprintf(stderr, "ERROR: Failed to open receiver list file.\n");
+        return (-1);
+    }
+
+    while (fgets(str, sizeof (str), fp) != NULL) {
+        line++;
+        if (sscanf(str, "%511s", out) != 1 || out[0] == '#')
+            continue;
+        if (n >= MAX_RECEIVERS) {
+            fprintf(stderr, "ERROR: Too many receivers, max. %d.\n", MAX_RECEIVERS);
+            goto read_receivers_error;
+        }
+
+        ok = (sscanf(str, "%511s %511s %511s", out, mode, arg) == 3);
+        if (ok && strcmp(mode, "motion") == 0) {
+            rx[n].xyz = malloc(USER_MOTION_SIZE * sizeof (rx[n].xyz[0]));
+            ok = (rx[n].xyz != NULL && (rx[n].numd = readUserMotion(rx[n].xyz, arg)) > 0);
+        } else if (ok && strcmp(mode, "llh") == 0) {
+            rx[n].xyz = malloc(sizeof (rx[n].xyz[0]));
+            ok = (rx[n].xyz != NULL && sscanf(arg, "%lf,%lf,%lf", &llh[0], &llh[1], &llh[2]) == 3);
+            if (ok) {
+                llh[0] = llh[0] / R2D;
+                llh[1] = llh[1] / R2D;
+                llh2xyz(llh, rx[n].xyz[0]);
+            }
+        } else if (ok && strcmp(mode, "xyz") == 0) {
+            rx[n].xyz = malloc(sizeof (rx[n].xyz[0]));
+            ok = (rx[n].xyz != NULL && sscanf(arg, "%lf,%lf,%lf", &rx[n].xyz[0][0], &rx[n].xyz[0][1], &rx[n].xyz[0][2]) == 3);
+        } else {
+            ok = 0;
+        }
+        if (!ok) {
+            fprintf(stderr, "ERROR: Invalid receiver in line %d of the receiver list.\n", line);
+            n++; // Free the position
+            goto read_receivers_error;
+        }
+
+        if (strncmp(out, "pluto:", 6) == 0) {
+            // Own ADALM-Pluto and TX thread for this receiver
+            rx[n].dev0 = txAddDevice(out + 6, false);
+            rx[n].ndev = 1;
+            if (rx[n++].dev0 < 0)
+                goto read_receivers_error;
+            continue;
+        }
+        rx[n].fp = fopen(out, "wb");
+        n++;
+        if (rx[n - 1].fp == NULL) {
+            fprintf(stderr, "ERROR: Failed to open I/Q output file %s.\n", out);
+            goto read_receivers_error;
+        }
+    }
+    fclose(fp);
+
+    if (n == 0)
+        fprintf(stderr, "ERROR: Receiver list is empty.\n");
+
+    return ((n > 0) ? n : -1);
+
+read_receivers_error:
+    fclose(fp);
+    while (n-- > 0) {
+        free(rx[n].xyz);
+        if (rx[n].fp != NULL)
+            fclose(rx[n].fp);
+    }
+
+    return (-1);
+}
+
+/*! \brief Queue a control command for the next epoch, server thread only
+ *  \returns 0 on success, -1 when the queue is full
+ */
+static int ctrlPush(struct control *ctrl, const ctrl_cmd_t *cmd) {
+    size_t head = atomic_load_explicit(&ctrl->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ctrl->tail, memory_order_acquire);
+
+    if (head - tail >= CTRL_QUEUE_SIZE)
+        return (-1);
+    ctrl->cmd[head & (CTRL_QUEUE_SIZE - 1)] = *cmd;
+    atomic_store_explicit(&ctrl->head, head + 1, memory_order_release);
+
+    return (0);
+}
+
+/*! \brief Publish the state of the first receiver, main thread only, never blocks
+ *  \param ctrl Control server
+ *  \param[in] iblock Block counter
+ *  \param[in] chan Channels of the receiver
+ *  \param[in] rho Pseudorange of each channel
+ *  \param[in] gain Signal gain of each channel
+ *  \param[in] nchan Number of channels
+ *  \param[in] g Receiver time of the block
+ *  \param[in] xyz Receiver position of the block
+ *  \param[in] iono Ionospheric delay enabled
+ */
+static void ctrlPublish(struct control *ctrl, int iblock, const channel_t *chan, const range_t *rho,
+        const double *gain, int nchan, gpstime_t g, const double *xyz, bool iono) {
+    ctrl_status_t *st = &ctrl->status;
+    unsigned int seq;
+    int i;
+
+    if (ctrl->fd < 0)
+        return;
+
+    seq = atomic_load_explicit(&ctrl->seq, memory_order_relaxed);
+    atomic_store_explicit(&ctrl->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    st->block = iblock;
+    st->g = g;
+    st->xyz[0] = xyz[0];
+    st->xyz[1] = xyz[1];
+    st->xyz[2] = xyz[2];
+    st->iono = iono;
+    st->nsat = 0;
+    for (i = 0; i < nchan && st->nsat < MAX_SAT; i++) {
+        if (chan[i].prn == 0)
+            continue;
+        st->chan[st->nsat].prn = chan[i].prn;
+        st->chan[st->nsat].az = rho[i].azel[0] * R2D;
+        st->chan[st->nsat].el = rho[i].azel[1] * R2D;
+        st->chan[st->nsat].range = rho[i].range;
+        st->chan[st->nsat].doppler = chan[i].f_carr;
+        st->chan[st->nsat].gain_db = (gain[i] > 0.0) ? 20.0 * log10(gain[i]) : -999.0;
+        st->nsat++;
+    }
+
+    atomic_store_explicit(&ctrl->seq, seq + 2, memory_order_release);
+}
+
+/*! \brief Take a consistent copy of the status snapshot, server thread only */
+static void ctrlSnapshot(struct control *ctrl, ctrl_status_t *st) {
+    struct timespec idle = {0, 100000}; // 100us
+    unsigned int s0, s1;
+
+    while (1) {
+        s0 = atomic_load_explicit(&ctrl->seq, memory_order_acquire);
+        if ((s0 & 1) == 0) {
+            memcpy(st, &ctrl->status, sizeof (ctrl_status_t));
+            atomic_thread_fence(memory_order_acquire);
+            s1 = atomic_load_explicit(&ctrl->seq, memory_order_relaxed);
+            if (s0 == s1)
+                return;
+        }
+        nanosleep(&idle, NULL);
+    }
+}
+
+/*! \brief Format the status snapshot as one line of JSON
+ *  \returns Length of the reply
+ */
+static int ctrlStatus(struct control *ctrl, char *reply, size_t size) {
+    ctrl_status_t st;
+    double llh[3];
+    size_t n;
+    int i;
+
+    ctrlSnapshot(ctrl, &st);
+    xyz2llh(st.xyz, llh);
+
+    n = (size_t) snprintf(reply, size, "{\"block\":%ld,\"week\":%d,\"sec\":%.1f,\"llh\":[%.7f,%.7f,%.2f],"
+            "\"xyz\":[%.3f,%.3f,%.3f],\"iono\":%s,\"tx_gain\":[",
+            st.block, st.g.week, st.g.sec, llh[0] * R2D, llh[1] * R2D, llh[2], st.xyz[0], st.xyz[1], st.xyz[2],
+            st.iono ? "true" : "false");
+    for (i = 0; plutotx.sink_fp == NULL && i < ntxdev && n < size; i++) {
+        n += (size_t) snprintf(reply + n, size - n, "%s%.1f", (i > 0) ? "," : "",
+                atomic_load_explicit(&txdev[i].gain_req, memory_order_relaxed));
+    }
+    if (n < size)
+        n += (size_t) snprintf(reply + n, size - n, "],\"chan\":[");
+    for (i = 0; i < st.nsat && n < size; i++) {
+        n += (size_t) snprintf(reply + n, size - n,
+                "%s{\"prn\":%d,\"az\":%.1f,\"el\":%.1f,\"range\":%.3f,\"doppler\":%.3f,\"gain\":%.2f}",
+                (i > 0) ? "," : "", st.chan[i].prn, st.chan[i].az, st.chan[i].el, st.chan[i].range,
+                st.chan[i].doppler, st.chan[i].gain_db);
+    }
+    if (n < size)
+        n += (size_t) snprintf(reply + n, size - n, "]}\n");
+
+    return ((n < size) ? (int) n : (int) size - 1);
+}
+
+/*! \brief Execute one control command line
+ *  \param ctrl Control server
+ *  \param line Command line, modified
+ *  \param[out] reply Reply line
+ *  \param[in] size Size of \a reply
+ *  \returns Length of the reply
+ */
+static int ctrlCommand(struct control *ctrl, char *line, char *reply, size_t size) {
+    ctrl_cmd_t cmd;
+    char word[16], arg[CTRL_LINE_LEN];
+    double llh[3];
+    int n;
+
+    memset(&cmd, 0, sizeof (cmd));
+    arg[0] = '\0';
+    n = sscanf(line, "%15s %255[^\n]", word, arg);
+    if (n < 1)
+        return (0);
+
+    if (strcmp(word, "status") == 0) {
+        return (ctrlStatus(ctrl, reply, size));
+    } else if (strcmp(word, "llh") == 0 || strcmp(word, "xyz") == 0) {
+        if (!ctrl->movable)
+            return (snprintf(reply, size, "ERROR position fixed\n"));
+        if (sscanf(arg, "%lf,%lf,%lf", &cmd.v[0], &cmd.v[1], &cmd.v[2]) != 3)
+            return (snprintf(reply, size, "ERROR invalid position\n"));
+        if (word[0] == 'l') {
+            llh[0] = cmd.v[0] / R2D;
+            llh[1] = cmd.v[1] / R2D;
+            llh[2] = cmd.v[2];
+            llh2xyz(llh, cmd.v);
+        }
+        cmd.type = CTRL_POSITION;
+    } else if (strcmp(word, "gain") == 0) {
+        cmd.arg = -1;
+        if (plutotx.sink_fp != NULL)
+            return (snprintf(reply, size, "ERROR no transmitter\n"));
+        if (sscanf(arg, "%lf %d", &cmd.v[0], &cmd.arg) < 1 || cmd.v[0] > 0.0 || cmd.v[0] < -80.0
+                || cmd.arg < -1 || cmd.arg >= ntxdev)
+            return (snprintf(reply, size, "ERROR invalid gain\n"));
+        cmd.type = CTRL_GAIN;
+    } else if (strcmp(word, "iono") == 0) {
+        if (strcmp(arg, "on") != 0 && strcmp(arg, "off") != 0)
+            return (snprintf(reply, size, "ERROR invalid iono\n"));
+        cmd.type = CTRL_IONO;
+        cmd.arg = (strcmp(arg, "on") == 0);
+    } else if (strcmp(word, "power") == 0) {
+        if (sscanf(arg, "%d %lf", &cmd.arg, &cmd.v[0]) != 2 || cmd.arg < 1 || cmd.arg > MAX_SAT
+                || fabs(cmd.v[0]) > MAX_POWER_OFFSET)
+            return (snprintf(reply, size, "ERROR invalid power\n"));
+        cmd.type = CTRL_POWER;
+    } else if (strcmp(word, "stop") == 0) {
+        cmd.type = CTRL_STOP;
+    } else {
+        return (snprintf(reply, size, "ERROR unknown command\n"));
+    }
+
+    if (ctrlPush(ctrl, &cmd) != 0)
+        return (snprintf(reply, size, "ERROR queue full\n"));
+
+    return (snprintf(reply, size, "OK\n"));
+}
+
+/*! \brief Read from a control client and answer all complete command lines
+ *  \returns 0 on success, -1 when the client is gone
+ */
+static int ctrlRead(struct control *ctrl, struct ctrl_client *cl) {
+    char reply[8192];
+    char *line, *eol;
+    ssize_t n;
+    int len;
+
+    n = recv(cl->fd, cl->line + cl->len, CTRL_LINE_LEN - 1 - cl->len, 0);
+    if (n <= 0)
+        return (-1);
+    cl->len += (size_t) n;
+    cl->line[cl->len] = '\0';
+
+    line = cl->line;
+    while ((eol = strchr(line, '\n')) != NULL) {
+        *eol = '\0';
+        if (eol > line && eol[-1] == '\r')
+            eol[-1] = '\0';
+        len = ctrlCommand(ctrl, line, reply, sizeof (reply));
+        if (len > 0 && send(cl->fd, reply, (size_t) len, MSG_NOSIGNAL) != len)
+            return (-1);
+        line = eol + 1;
+    }
+
+    cl->len -= (size_t) (line - cl->line);
+    memmove(cl->line, line, cl->len);
+    if (cl->len == CTRL_LINE_LEN - 1) {
+        cl->len = 0;
+        if (send(cl->fd, "ERROR line too long\n", 20, MSG_NOSIGNAL) != 20)
+            return (-1);
+    }
+
+    return (0);
+}
+
+/*! \brief Control server thread, serves the clients until ctrlClose() */
+static void *ctrlThread(void *arg) {
+    struct control *ctrl = (struct control *) arg;
+    struct pollfd pfd[CTRL_MAX_CLIENTS + 1];
+    int i, n, fd;
+
+    while (!atomic_load_explicit(&ctrl->exit, memory_order_acquire)) {
+        pfd[0].fd = ctrl->fd;
+        pfd[0].events = POLLIN;
+        for (i = 0; i < CTRL_MAX_CLIENTS; i++) {
+            pfd[i + 1].fd = ctrl->client[i].fd;
+            pfd[i + 1].events = POLLIN;
+        }
+
+        // Short timeout to notice the exit flag
+        n = poll(pfd, CTRL_MAX_CLIENTS + 1, 200);
+        if (n <= 0)
+            continue;
+
+        for (i = 0; i < CTRL_MAX_CLIENTS; i++) {
+            struct ctrl_client *cl = &ctrl->client[i];
+            if (cl->fd >= 0 && (pfd[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) != 0
+                    && ctrlRead(ctrl, cl) != 0) {
+                close(cl->fd);
+                cl->fd = -1;
+            }
+        }
+
+        if ((pfd[0].revents & POLLIN) != 0 && (fd = accept(ctrl->fd, NULL, NULL)) >= 0) {
+            for (i = 0; i < CTRL_MAX_CLIENTS && ctrl->client[i].fd >= 0; i++)
+                ;
+            if (i < CTRL_MAX_CLIENTS) {
+                ctrl->client[i].fd = fd;
+                ctrl->client[i].len = 0;
+            } else {
+                if (send(fd, "ERROR too many clients\n", 23, MSG_NOSIGNAL) != 23) {
+                    // Client is gone anyway
+                }
+                close(fd);
+            }
+        }
+    }
+
+    for (i = 0; i < CTRL_MAX_CLIENTS; i++) {
+        if (ctrl->client[i].fd >= 0)
+            close(ctrl->client[i].fd);
+        ctrl->client[i].fd = -1;
+    }
+
+    return NULL;
+}
+
+/*! \brief Open the control socket and start the server thread
+ *  \param ctrl Control server
+ *  \param[in] addr TCP port on localhost if numeric, Unix socket path otherwise
+ *  \returns 0 on success, -1 on error
+ */
+static int ctrlOpen(struct control *ctrl, const char *addr) {
+    struct sockaddr_un sun;
+    struct sockaddr_in sin;
+    struct stat st;
+    int i, one = 1;
+
+    for (i = 0; i < CTRL_MAX_CLIENTS; i++)
+        ctrl->client[i].fd = -1;
+    atomic_init(&ctrl->head, 0);
+    atomic_init(&ctrl->tail, 0);
+    atomic_init(&ctrl->seq, 0);
+    atomic_init(&ctrl->exit, false);
+    ctrl->status.block = -1;
+    ctrl->path[0] = '\0';
+
+    if (addr[0] != '\0' && strspn(addr, "0123456789") == strlen(addr)) {
+        // TCP on the loopback interface only
+        memset(&sin, 0, sizeof (sin));
+        sin.sin_family = AF_INET;
+        sin.sin_port = htons((uint16_t) atoi(addr));
+        sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ctrl->fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (ctrl->fd >= 0)
+            setsockopt(ctrl->fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one));
+        if (ctrl->fd < 0 || bind(ctrl->fd, (struct sockaddr *) &sin, sizeof (sin)) != 0)
+            goto ctrl_open_error;
+    } else {
+        if (strlen(addr) >= sizeof (sun.sun_path)) {
+            fprintf(stderr, "ERROR: Control socket path too long.\n");
+            return (-1);
+        }
+        memset(&sun, 0, sizeof (sun));
+        sun.sun_family = AF_UNIX;
+        strcpy(sun.sun_path, addr);
+        if (lstat(addr, &st) == 0) {
+            // Only a stale socket of a previous run is removed
+            if (!S_ISSOCK(st.st_mode)) {
+                fprintf(stderr, "ERROR: Control socket path %s exists and is not a socket.\n", addr);
+                return (-1);
+            }
+            ctrl->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (ctrl->fd >= 0 && connect(ctrl->fd, (struct sockaddr *) &sun, sizeof (sun)) == 0) {
+                fprintf(stderr, "ERROR: Control socket %s is in use by another server.\n", addr);
+                close(ctrl->fd);
+                ctrl->fd = -1;
+                return (-1);
+            }
+            if (ctrl->fd >= 0)
+                close(ctrl->fd);
+            unlink(addr);
+        }
+        ctrl->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (ctrl->fd < 0 || bind(ctrl->fd, (struct sockaddr *) &sun, sizeof (sun)) != 0)
+            goto ctrl_open_error;
+        strcpy(ctrl->path, addr);
+    }
+
+    if (listen(ctrl->fd, CTRL_MAX_CLIENTS) != 0
+            || pthread_create(&ctrl->thread, NULL, ctrlThread, ctrl) != 0)
+        goto ctrl_open_error;
+
+    fprintf(stderr, "Control server on %s.\n", addr);
+
+    return (0);
+
+ctrl_open_error:
+    fprintf(stderr, "ERROR: Failed to open control socket %s: %s\n", addr, strerror(errno));
+    if (ctrl->fd >= 0)
+        close(ctrl->fd);
+    if (ctrl->path[0] != '\0')
+        unlink(ctrl->path);
+    ctrl->fd = -1;
+
+    return (-1);
+}
+
+/*! \brief Stop the server thread and close the control socket */
+static void ctrlClose(struct control *ctrl) {
+    if (ctrl->fd < 0)
+        return;
+
+    atomic_store_explicit(&ctrl->exit, true, memory_order_release);
+    pthread_join(ctrl->thread, NULL);
+    close(ctrl->fd);
+    if (ctrl->path[0] != '\0')
+        unlink(ctrl->path);
+    ctrl->fd = -1;
+}
+/*! \brief Apply the queued control commands at the epoch boundary, main thread only, never blocks
+ *  \param ctrl Control server
+ *  \param sim Engine context, before gpssim_step() of the next block
+ */
+static void ctrlApply(struct control *ctrl, gpssim_t *sim) {
+    size_t tail = atomic_load_explicit(&ctrl->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ctrl->head, memory_order_acquire);
+    const ctrl_cmd_t *cmd;
+    int i;
+
+    for (; tail != head; tail++) {
+        cmd = &ctrl->cmd[tail & (CTRL_QUEUE_SIZE - 1)];
+        switch (cmd->type) {
+            case CTRL_POSITION:
+                gpssim_set_position(sim, 0, cmd->v);
+                break;
+            case CTRL_GAIN:
+                plutotx.gain_db = cmd->v[0];
+                for (i = 0; i < ntxdev; i++) {
+                    if (cmd->arg < 0 || cmd->arg == i)
+                        atomic_store_explicit(&txdev[i].gain_req, cmd->v[0], memory_order_relaxed);
+                }
+                break;
+            case CTRL_IONO:
+                gpssim_set_iono(sim, cmd->arg != 0);
+                break;
+            case CTRL_POWER:
+                // An offset replaces the absolute C/N0 target of the PRN
+                gpssim_set_power(sim, cmd->arg, cmd->v[0]);
+                break;
+            case CTRL_STOP:
+                plutotx.exit = true;
+                break;
+        }
+    }
+
+    atomic_store_explicit(&ctrl->tail, tail, memory_order_release);
+}
+
+static size_t fwrite_rinex(void *buffer, size_t size, size_t nmemb, void *stream) {
+    struct ftp_file *out = (struct ftp_file *) stream;
+    if (out && !out->stream) {
+        /* open file for writing */
+        out->stream = fopen(out->filename, "wb");
+        if (!out->stream)
+            return -1; /* failure, can't open file to write */
+    }
+    return fwrite(buffer, size, nmemb, out->stream);
+}
+
+int main(int argc, char *argv[]) {
+    int sv;
+    gpstime_t g0;
+
+    double llh[3];
+
+    int i, k;
+    int nchan = DEFAULT_CHAN;
+
+    gpstime_t grx;
+    double pos[3]; // Receiver position of the current block
+    const channel_t *chan;
+    const range_t *rho;
+    const double *gain;
+    gpssim_config_t cfg;
+    gpssim_t *sim = NULL; // Engine context, all receivers share its satellite state
+
+    int numd = 0;
+    // Allocate user motion array
+    double xyz[USER_MOTION_SIZE][3];
+
+    int staticLocationMode = true;
+
+    bool use_rinex3 = false;
+    bool use_ftp = false;
+    CURL *curl;
+    CURLcode res = CURLE_GOT_NOTHING;
+    struct ftp_file ftp = {
+        RINEX2_FILE_NAME,
+        NULL
+    };
+
+    const char* navfile = NULL;
+    const char* umfile = NULL;
+
+    int result;
+    double prn_offset[MAX_SAT]; // Power offset per PRN in dB
+    double prn_cn0[MAX_SAT]; // C/N0 target per PRN in dB-Hz, < 0 = modelled
+
+    datetime_t t0, tmin, tmax;
+    gpstime_t gmin, gmax;
+
+    struct timespec t_gen, t_now;
+
+    double duration = 300.0; // File sink duration in seconds
+    int iblock = 0, nblock;
+    FILE *golden_fp = NULL;
+    const char *truthfile = NULL;
+    const char *cachefile = NULL; // Scenario cache to render
+    const char *replayfile = NULL; // Scenario cache to replay
+    double tmpl_bound = 0.0; // Code template refresh bound in Hz, 0 = off
+    bool phasor = false;
+    int carr_bits = 9;
+    bool autoscale = false;
+    int nsat;
+    int out_shift = 0;
+    double noise_cn0 = -1.0; // Noise level in dB-Hz, < 0 = off
+    long long gen_fs = 0; // Generation rate in Hz, 0 = radio rate
+    struct rx_output *rx = NULL; // Receivers sharing the satellite state
+    int nrx = 1;
+    const char *rxfile = NULL; // Receiver list
+    const char *arrayfile = NULL; // Antenna array geometry
+    struct element_output el[MAX_ARRAY_ELEMENTS]; // Antenna array of the receiver
+    int e, nelem = 0;
+    int fir_taps = 0;
+    uint64_t noise_seed = 1;
+    short *iq_buff = NULL; // Samples of one block
+    short *out_buff;
+    int iq_bits = IQ_FMT_SC16; // File sink sample format
+    unsigned char *pack_buff = NULL; // Compact samples of one block
+    unsigned long sat_total = 0, sat_blocks = 0;
+    int nthreads = -1; // Parallel render threads, < 0 = serial
+    struct render_job job;
+    const char *ctrladdr = NULL; // Runtime control socket
+    struct control ctrl;
+    const char *echoes[MAX_ECHOES]; // Multipath echo lists, each adds at least one echo
+    int necho = 0;
+
+    bool verb;
+    bool timeoverwrite = false; // Overwirte the TOC and TOE in the RINEX file
+    bool iono = true;
+    const ionoutc_t *ionoutc;
+
+    ////////////////////////////////////////////////////////////
+    // Read options
+    ////////////////////////////////////////////////////////////
+
+    // Default options
+    g0.week = -1; // Invalid start time
+    verb = false;
+
+    // Default static location; Tokyo
+    llh[0] = 35.681298 / R2D;
+    llh[1] = 139.766247 / R2D;
+    llh[2] = 10.0;
+
+    plutotx.bw_hz = (TX_SAMPLE_FREQ * 2);
+    plutotx.fs_hz = TX_SAMPLE_FREQ;
+    plutotx.lo_hz = GHZ(1.575420); // 1.57542 GHz RF frequency
+    plutotx.rfport = "A";
+    plutotx.gain_db = -20.0;
+    plutotx.stats_interval = 0.0;
+    plutotx.stats_fp = NULL;
+    plutotx.sink_fp = NULL;
+    ctrl.fd = -1;
+
+    for (i = 0; i < MAX_SAT; i++) {
+        prn_offset[i] = 0.0;
+        prn_cn0[i] = -1.0;
+    }
+    rx = calloc(MAX_RECEIVERS, sizeof (struct rx_output));
+    if (rx == NULL) {
+        fprintf(stderr, "ERROR: Failed to allocate receivers.\n");
+        exit(1);
+    }
+
+    // signal handlers:
+    signal(SIGINT, handle_sig);
+    signal(SIGTERM, handle_sig);
+    signal(SIGQUIT, handle_sig);
+
+    /* On a multi-core CPU we run the main thread and reader thread on different cores.
+     * Try sticking the main thread to core 1
+     */
+    thread_to_core(1);
+
+    if (argc < 3) {
+        usage();
+        exit(1);
+    }
+
+    while ((result = getopt(argc, argv, "e:3:u:g:c:l:s:T:t:A:B:U:N:S:W:o:d:X:C:Q:L:n:r:p:k:I:F:R:Y:q:J:m:K:E:Z:PaMvfi?")) != -1) {
+        switch (result) {
+            case 'e':
+                navfile = optarg;
+                break;
+            case 'u':
+                umfile = optarg;
+                staticLocationMode = false;
+                break;
+            case '3':
+                use_rinex3 = true;
+                ftp.filename = RINEX3_FILE_NAME;
+                break;
+            case 'f':
+                use_ftp = true;
+                break;
+            case 'c':
+                // Static ECEF coordinates input mode
+                sscanf(optarg, "%lf,%lf,%lf", &xyz[0][0], &xyz[0][1], &xyz[0][2]);
+                break;
+            case 'l':
+                // Static geodetic coordinates input mode
+                // Added by scateu@gmail.com
+                sscanf(optarg, "%lf,%lf,%lf", &llh[0], &llh[1], &llh[2]);
+                llh[0] = llh[0] / R2D; // convert to RAD
+                llh[1] = llh[1] / R2D; // convert to RAD
+                llh2xyz(llh, xyz[0]); // Convert llh to xyz
+                break;
+            case 's':
+                plutotx.fs_hz = (long long) atoi(optarg);
+                if (plutotx.fs_hz < MHZ(1.0) || plutotx.fs_hz % 10 != 0) {
+                    fprintf(stderr, "ERROR: Invalid sampling frequency.\n");
+                    exit(1);
+                }
+                break;
+            case 'T':
+                timeoverwrite = true;
+                if (strncmp(optarg, "now", 3) == 0) {
+                    time_t timer;
+                    struct tm *gmt;
+
+                    time(&timer);
+                    gmt = gmtime(&timer);
+
+                    t0.y = gmt->tm_year + 1900;
+                    t0.m = gmt->tm_mon + 1;
+                    t0.d = gmt->tm_mday;
+                    t0.hh = gmt->tm_hour;
+                    t0.mm = gmt->tm_min;
+                    t0.sec = (double) gmt->tm_sec;
+
+                    date2gps(&t0, &g0);
+
+                }
+                break;
+            case 't':
+                sscanf(optarg, "%d/%d/%d,%d:%d:%lf", &t0.y, &t0.m, &t0.d, &t0.hh, &t0.mm, &t0.sec);
+                if (t0.y <= 1980 || t0.m < 1 || t0.m > 12 || t0.d < 1 || t0.d > 31 ||
+                        t0.hh < 0 || t0.hh > 23 || t0.mm < 0 || t0.mm > 59 || t0.sec < 0.0 || t0.sec >= 60.0) {
+                    fprintf(stderr, "ERROR: Invalid date and time.\n");
+                    exit(1);
+                }
+                t0.sec = floor(t0.sec);
+                date2gps(&t0, &g0);
+                break;
+            case 'i':
+                iono = false; // Disable ionospheric correction
+                break;
+            case 'v':
+                verb = true;
+                break;
+            case 'A':
+                plutotx.gain_db = atof(optarg);
+                if (plutotx.gain_db > 0.0) plutotx.gain_db = 0.0;
+                if (plutotx.gain_db < -80.0) plutotx.gain_db = -80.0;
+                break;
+            case 'B':
+                plutotx.bw_hz = MHZ(atof(optarg));
+                if (plutotx.bw_hz > MHZ(5.0)) plutotx.bw_hz = MHZ(5.0);
+                if (plutotx.bw_hz < MHZ(1.0)) plutotx.bw_hz = MHZ(1.0);
+                break;
+            case 'U':
+                if (txAddDevice(optarg, false) < 0)
+                    exit(1);
+                break;
+            case 'N':
+                if (txAddDevice(optarg, true) < 0)
+                    exit(1);
+                break;
+            case 'S':
+                plutotx.stats_interval = atof(optarg);
+                if (plutotx.stats_interval < 0.0) plutotx.stats_interval = 0.0;
+                break;
+            case 'o':
+                plutotx.sink_fp = fopen(optarg, "wb");
+                if (plutotx.sink_fp == NULL) {
+                    fprintf(stderr, "ERROR: Failed to open I/Q output file.\n");
+                    exit(1);
+                }
+                break;
+            case 'd':
+                duration = atof(optarg);
+                break;
+            case 'g':
+                golden_fp = fopen(optarg, "w");
+                if (golden_fp == NULL) {
+                    fprintf(stderr, "ERROR: Failed to open golden reference file.\n");
+                    exit(1);
+                }
+                break;
+            case 'X':
+                truthfile = optarg;
+                break;
+            case 'R':
+                cachefile = optarg;
+                break;
+            case 'Y':
+                replayfile = optarg;
+                break;
+            case 'Q':
+                tmpl_bound = atof(optarg);
+                if (tmpl_bound <= 0.0) {
+                    fprintf(stderr, "ERROR: Invalid code template refresh bound.\n");
+                    exit(1);
+                }
+                break;
+            case 'P':
+                phasor = true;
+                break;
+            case 'L':
+                carr_bits = atoi(optarg);
+                if (carr_bits < MIN_CARR_TABLE_BITS || carr_bits > MAX_CARR_TABLE_BITS) {
+                    fprintf(stderr, "ERROR: Invalid carrier table resolution.\n");
+                    exit(1);
+                }
+                break;
+            case 'a':
+                autoscale = true;
+                break;
+            case 'M':
+                out_shift = 4;
+                break;
+            case 'n':
+                noise_cn0 = atof(optarg);
+                if (noise_cn0 < MIN_NOISE_CN0 || noise_cn0 > MAX_NOISE_CN0) {
+                    fprintf(stderr, "ERROR: Invalid noise C/N0.\n");
+                    exit(1);
+                }
+                break;
+            case 'I':
+                gen_fs = (long long) atoi(optarg);
+                if (gen_fs < MHZ(1.0) || gen_fs % 10 != 0) {
+                    fprintf(stderr, "ERROR: Invalid generation rate.\n");
+                    exit(1);
+                }
+                break;
+            case 'F':
+                fir_taps = atoi(optarg);
+                if (fir_taps < MIN_FIR_TAPS || fir_taps > MAX_FIR_TAPS || fir_taps % 4 != 0) {
+                    fprintf(stderr, "ERROR: Invalid number of FIR taps.\n");
+                    exit(1);
+                }
+                break;
+            case 'r':
+                noise_seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'q':
+                iq_bits = atoi(optarg);
+                if (iq_bits != IQ_FMT_SC16 && iq_bits != IQ_FMT_SC8 && iq_bits != IQ_FMT_SC4) {
+                    fprintf(stderr, "ERROR: Invalid I/Q file format.\n");
+                    exit(1);
+                }
+                break;
+            case 'm':
+                rxfile = optarg;
+                break;
+            case 'K':
+                arrayfile = optarg;
+                break;
+            case 'E':
+                if (necho >= MAX_ECHOES) {
+                    fprintf(stderr, "ERROR: Invalid multipath echo.\n");
+                    exit(1);
+                }
+                echoes[necho++] = optarg;
+                break;
+            case 'Z':
+                ctrladdr = optarg;
+                break;
+            case 'J':
+                nthreads = atoi(optarg);
+                if (nthreads == 0)
+                    nthreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+                if (nthreads < 1) {
+                    fprintf(stderr, "ERROR: Invalid number of render threads.\n");
+                    exit(1);
+                }
+                break;
+            case 'p':
+                if (parsePrnLevels(optarg, prn_offset, -MAX_POWER_OFFSET, MAX_POWER_OFFSET) != 0) {
+                    fprintf(stderr, "ERROR: Invalid PRN power offset.\n");
+                    exit(1);
+                }
+                break;
+            case 'k':
+                if (parsePrnLevels(optarg, prn_cn0, MIN_NOISE_CN0, MAX_NOISE_CN0) != 0) {
+                    fprintf(stderr, "ERROR: Invalid PRN C/N0 target.\n");
+                    exit(1);
+                }
+                break;
+            case 'C':
+                nchan = atoi(optarg);
+                if (nchan < 1 || nchan > MAX_CHAN) {
+                    fprintf(stderr, "ERROR: Invalid number of channels.\n");
+                    exit(1);
+                }
+                break;
+            case 'W':
+                plutotx.stats_fp = fopen(optarg, "w");
+                if (plutotx.stats_fp == NULL) {
+                    fprintf(stderr, "ERROR: Failed to open TX statistics file.\n");
+                    exit(1);
+                }
+                if (plutotx.stats_interval <= 0.0)
+                    plutotx.stats_interval = 10.0;
+                break;
+            case ':':
+            case '?':
+                usage();
+                exit(1);
+            default:
+                break;
+        }
+    }
+
+    if (cachefile != NULL && (plutotx.sink_fp != NULL || replayfile != NULL)) {
+        fprintf(stderr, "ERROR: Scenario cache rendering excludes -o and -Y.\n");
+        exit(1);
+    }
+
+    if (rxfile != NULL && (plutotx.sink_fp != NULL || cachefile != NULL || replayfile != NULL || golden_fp != NULL
+            || umfile != NULL || ntxdev > 0)) {
+        fprintf(stderr, "ERROR: Receiver list excludes -o, -R, -Y, -g, -u, -U and -N.\n");
+        exit(1);
+    }
+
+    if (arrayfile != NULL && (plutotx.sink_fp != NULL || cachefile != NULL || replayfile != NULL || rxfile != NULL
+            || golden_fp != NULL || nthreads > 0 || ntxdev > 0 || phasor || tmpl_bound > 0.0 || necho > 0)) {
+        fprintf(stderr, "ERROR: Antenna array excludes -o, -R, -Y, -m, -g, -J, -U, -N, -P, -Q and -E.\n");
+        exit(1);
+    }
+
+    if (nthreads > 0) {
+        if (plutotx.sink_fp == NULL && cachefile == NULL && rxfile == NULL) {
+            fprintf(stderr, "ERROR: Parallel rendering needs -o, -R or -m.\n");
+            exit(1);
+        }
+        // Golden state, truth log and code templates follow the block order
+        if (golden_fp != NULL || truthfile != NULL || tmpl_bound > 0.0) {
+            fprintf(stderr, "ERROR: Parallel rendering excludes -g, -X and -Q.\n");
+            exit(1);
+        }
+    }
+
+    if (ctrladdr != NULL && (nthreads > 0 || replayfile != NULL)) {
+        fprintf(stderr, "ERROR: Runtime control excludes -J and -Y.\n");
+        exit(1);
+    }
+
+    if (iq_bits != IQ_FMT_SC16) {
+        if (plutotx.sink_fp == NULL && cachefile == NULL && rxfile == NULL && arrayfile == NULL) {
+            fprintf(stderr, "ERROR: Compact I/Q formats need -o, -R, -m or -K.\n");
+            exit(1);
+        }
+        // Compact formats quantize the 12-bit DAC range
+        autoscale = true;
+    }
+
+    // Single ADALM-Pluto from the default context
+    if (rxfile == NULL && ntxdev == 0)
+        txAddDevice("", false);
+
+    // Replay of a pre-rendered scenario needs no ephemeris
+    if (replayfile != NULL)
+        return (replayScenario(replayfile));
+
+    if ((navfile == NULL) && (use_ftp == false)) {
+        fprintf(stderr, "ERROR: GPS ephemeris file is not specified.\n");
+        exit(1);
+    }
+
+    // Generation rate and polyphase resampler to the radio rate
+    plutotx.block = (int) (plutotx.fs_hz / 10);
+    if (iq_bits == IQ_FMT_SC4 && (plutotx.block & 1) != 0) {
+        fprintf(stderr, "ERROR: sc4 needs a sampling frequency that is a multiple of 20 Hz.\n");
+        exit(1);
+    }
+    if (gen_fs == 0)
+        gen_fs = plutotx.fs_hz;
+    if (gen_fs > plutotx.fs_hz) {
+        fprintf(stderr, "ERROR: Generation rate above sampling frequency.\n");
+        exit(1);
+    }
+    if (gen_fs != plutotx.fs_hz) {
+        i = (int) gcdLL(plutotx.fs_hz, gen_fs);
+        if (plutotx.fs_hz / i > RESAMP_MAX_PHASES) {
+            fprintf(stderr, "ERROR: Resampling ratio %lld/%lld too fine, max. %d phases.\n",
+                    plutotx.fs_hz / i, gen_fs / i, RESAMP_MAX_PHASES);
+            exit(1);
+        }
+        // Constant group delay, a receiver sees it as clock offset
+        fprintf(stderr, "Generating at %lld Hz, resampling by %lld/%lld, delay %.2fus.\n", gen_fs,
+                plutotx.fs_hz / i, gen_fs / i, (plutotx.fs_hz / i * RESAMP_TAPS - 1) * 0.5e6 / ((double) plutotx.fs_hz));
+    }
+
+    // Pulse shaping to the analog bandwidth, the passband covers +/- bw / 2
+    if (fir_taps > 0 && plutotx.bw_hz >= plutotx.fs_hz) {
+        fprintf(stderr, "ERROR: FIR bandwidth -B must be below the sampling frequency.\n");
+        exit(1);
+    }
+
+    // A C/N0 target is relative to the noise stage level
+    for (sv = 0; sv < MAX_SAT && noise_cn0 < 0.0; sv++) {
+        if (prn_cn0[sv] >= 0.0) {
+            fprintf(stderr, "ERROR: C/N0 targets need the noise stage (-n).\n");
+            exit(1);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Receiver position
+    ////////////////////////////////////////////////////////////
+
+    if (rxfile != NULL) {
+        // One I/Q file per receiver
+        nrx = readReceivers(rxfile, rx);
+        if (nrx < 0)
+            exit(1);
+        for (k = 1; k < nrx; k++) {
+            if ((rx[k].fp == NULL) != (rx[0].fp == NULL)) {
+                fprintf(stderr, "ERROR: Receiver list mixes I/Q files and ADALM-Pluto devices.\n");
+                exit(1);
+            }
+        }
+        if (rx[0].fp == NULL && (nthreads > 0 || iq_bits != IQ_FMT_SC16)) {
+            fprintf(stderr, "ERROR: ADALM-Pluto receivers exclude -J and -q.\n");
+            exit(1);
+        }
+        plutotx.sink_fp = rx[0].fp;
+        fprintf(stderr, "Using %d receivers.\n", nrx);
+    } else if (!staticLocationMode) {
+        // Read user motion file
+        numd = readUserMotion(xyz, umfile);
+
+        if (numd == -1) {
+            fprintf(stderr, "ERROR: Failed to open user motion file.\n");
+            exit(1);
+        } else if (numd == 0) {
+            fprintf(stderr, "ERROR: Failed to read user motion data.\n");
+            exit(1);
+        }
+
+        fprintf(stderr, "Using user motion mode.\n");
+    } else {
+        // Static geodetic coordinates input mode: "-l"
+        fprintf(stderr, "Using static location mode.\n");
+    }
+
+    if (arrayfile != NULL) {
+        // One I/Q file per array element
+        nelem = readArray(arrayfile, el);
+        if (nelem < 0)
+            exit(1);
+        plutotx.sink_fp = el[0].fp;
+        fprintf(stderr, "Using %d antenna array elements.\n", nelem);
+    }
+
+    if (rxfile == NULL) {
+        rx[0].xyz = xyz;
+        rx[0].numd = staticLocationMode ? 0 : numd;
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Signal generation engine
+    ////////////////////////////////////////////////////////////
+
+    gpssim_config_default(&cfg);
+    cfg.fs_hz = plutotx.fs_hz;
+    cfg.gen_hz = gen_fs;
+    cfg.nchan = nchan;
+    cfg.fir_taps = fir_taps;
+    cfg.bw_hz = (double) plutotx.bw_hz;
+    cfg.noise_cn0 = noise_cn0;
+    cfg.noise_seed = noise_seed;
+    cfg.autoscale = autoscale;
+    cfg.iono = iono;
+    cfg.nrx = nrx;
+    cfg.nelem = nelem;
+    cfg.carr_bits = carr_bits;
+    cfg.phasor = phasor;
+    cfg.tmpl_bound = tmpl_bound;
+    cfg.msb = (out_shift > 0);
+
+    sim = gpssim_create(&cfg);
+    if (sim == NULL) {
+        fprintf(stderr, "ERROR: Failed to allocate signal pipeline.\n");
+        exit(1);
+    }
+
+    for (i = 0; i < necho; i++) {
+        if (gpssim_add_echoes(sim, echoes[i]) != 0) {
+            fprintf(stderr, "ERROR: Invalid multipath echo.\n");
+            exit(1);
+        }
+    }
+    for (sv = 0; sv < MAX_SAT; sv++) {
+        gpssim_set_power(sim, sv + 1, prn_offset[sv]);
+        if (prn_cn0[sv] >= 0.0 && gpssim_set_cn0(sim, sv + 1, prn_cn0[sv]) != 0) {
+            fprintf(stderr, "ERROR: C/N0 target of PRN %d too far above the noise level.\n", sv + 1);
+            exit(1);
+        }
+    }
+    for (k = 0; k < nrx; k++) {
+        if (rx[k].numd > 0)
+            gpssim_set_trajectory(sim, k, (const double (*)[3]) rx[k].xyz, rx[k].numd);
+        else
+            gpssim_set_position(sim, k, rx[k].xyz[0]);
+    }
+    for (e = 0; e < nelem; e++)
+        gpssim_set_element(sim, e, el[e].enu, el[e].gain_db);
+
+    /*
+    fprintf(stderr, "xyz = %11.1f, %11.1f, %11.1f\n", xyz[0][0], xyz[0][1], xyz[0][2]);
+    fprintf(stderr, "llh = %11.6f, %11.6f, %11.1f\n", llh[0]*R2D, llh[1]*R2D, llh[2]);
+     */
+    ////////////////////////////////////////////////////////////
+    // Read ephemeris
+    ////////////////////////////////////////////////////////////
+    if (use_ftp) {
+        time_t t = time(NULL);
+        struct tm *tm = gmtime(&t);
+        char* url = malloc(NAME_MAX);
+        const char *station = stations_v2[14].id_v2;
+        // We fetch data from previous hour because the actual hour is still in progress
+        tm->tm_hour -= 1;
+        if (tm->tm_hour < 0) {
+            tm->tm_hour = 23;
+        }
+
+        if (use_rinex3) {
+            station = stations_v3[0].id_v2;
+        }
+
+        // Compose FTP URL
+        snprintf(url, NAME_MAX, RINEX_FTP_URL RINEX_FTP_FILE, (use_rinex3) ? RINEX3_SUBFOLDER : RINEX2_SUBFOLDER,
+                tm->tm_yday + 1, tm->tm_hour, station, tm->tm_yday + 1, 'a' + tm->tm_hour, tm->tm_year - 100);
+
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+        curl = curl_easy_init();
+        if (curl) {
+            curl_easy_setopt(curl, CURLOPT_URL, url);
+            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, fwrite_rinex);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &ftp);
+            curl_easy_setopt(curl, CURLOPT_USE_SSL, CURLUSESSL_NONE);
+            if (verb) {
+                curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
+            } else {
+                curl_easy_setopt(curl, CURLOPT_VERBOSE, 0L);
+            }
+            curl_easy_setopt(curl, CURLOPT_USERPWD, "anonymous:anonymous");
+            res = curl_easy_perform(curl);
+            curl_easy_cleanup(curl);
+        }
+
+        if (ftp.stream)
+            fclose(ftp.stream);
+
+        free(url);
+        curl_global_cleanup();
+
+        if (res != CURLE_OK) {
+            fprintf(stderr, "Curl error: %d\n", res);
+            exit(1);
+        }
+    }
+
+    if (gpssim_load_ephemeris(sim, navfile, use_rinex3) <= 0) {
+        fprintf(stderr, "ERROR: No ephemeris available.\n");
+        exit(1);
+    }
+    ionoutc = gpssim_ionoutc(sim);
+
+    if ((verb == true)&&(ionoutc->vflg == true)) {
+        fprintf(stderr, "  %12.3e %12.3e %12.3e %12.3e\n",
+                ionoutc->alpha0, ionoutc->alpha1, ionoutc->alpha2, ionoutc->alpha3);
+        fprintf(stderr, "  %12.3e %12.3e %12.3e %12.3e\n",
+                ionoutc->beta0, ionoutc->beta1, ionoutc->beta2, ionoutc->beta3);
+        fprintf(stderr, "   %19.11e %19.11e  %9d %9d\n",
+                ionoutc->A0, ionoutc->A1, ionoutc->tot, ionoutc->wnt);
+        fprintf(stderr, "%6d\n", ionoutc->dtls);
+    }
+
+    if (gpssim_get_ephemeris_range(sim, &gmin.week, &gmin.sec, &gmax.week, &gmax.sec) != 0) {
+        fprintf(stderr, "ERROR: No ephemeris available.\n");
+        exit(1);
+    }
+    gps2date(&gmin, &tmin);
+    gps2date(&gmax, &tmax);
+
+    if (g0.week >= 0) // Scenario start time has been set.
+    {
+        if (timeoverwrite == true) {
+            // Overwrite the TOC and TOE to the scenario start time
+            gpssim_shift_ephemeris(sim, g0.week, g0.sec);
+        } else {
+            if (subGpsTime(g0, gmin) < 0.0 || subGpsTime(gmax, g0) < 0.0) {
+                fprintf(stderr, "ERROR: Invalid start time.\n");
+                fprintf(stderr, "tmin = %4d/%02d/%02d,%02d:%02d:%02.0f (%d:%.0f)\n",
+                        tmin.y, tmin.m, tmin.d, tmin.hh, tmin.mm, tmin.sec,
+                        gmin.week, gmin.sec);
+                fprintf(stderr, "tmax = %4d/%02d/%02d,%02d:%02d:%02.0f (%d:%.0f)\n",
+                        tmax.y, tmax.m, tmax.d, tmax.hh, tmax.mm, tmax.sec,
+                        gmax.week, gmax.sec);
+                exit(1);
+            }
+        }
+    } else {
+        g0 = gmin;
+        t0 = tmin;
+    }
+
+    fprintf(stderr, "RINEX date = %s\n", ionoutc->date);
+    fprintf(stderr, "Start time = %4d/%02d/%02d,%02d:%02d:%02.0f (%d:%.0f)\n",
+            t0.y, t0.m, t0.d, t0.hh, t0.mm, t0.sec, g0.week, g0.sec);
+
+    // Select the current set of ephemerides and allocate the visible satellites
+    if (gpssim_start(sim, g0.week, g0.sec) != 0) {
+        fprintf(stderr, "ERROR: No current set of ephemerides has been found.\n");
+        exit(1);
+    }
+
+    if (cachefile != NULL) {
+        plutotx.sink_fp = cacheOpen(cachefile, (double) plutotx.fs_hz, plutotx.block, iq_bits, iqShift(iq_bits, out_shift));
+        if (plutotx.sink_fp == NULL)
+            exit(1);
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Baseband signal buffer and output file
+    ////////////////////////////////////////////////////////////
+
+    // Allocate I/Q buffer, the TX thread provides the buffer when streaming to one Pluto
+    if (plutotx.sink_fp != NULL || ntxdev > 1)
+        iq_buff = calloc(plutotx.block, 4);
+    if (iq_bits != IQ_FMT_SC16)
+        pack_buff = malloc(iqBytes(iq_bits, plutotx.block));
+
+    if (((plutotx.sink_fp != NULL || ntxdev > 1) && iq_buff == NULL) || (iq_bits != IQ_FMT_SC16 && pack_buff == NULL)) {
+        fprintf(stderr, "ERROR: Faild to allocate 16-bit I/Q buffer.\n");
+        goto exit_main_thread;
+    }
+
+    if (truthfile != NULL && truthLogOpen(truthfile, (double) plutotx.fs_hz) != 0)
+        goto exit_main_thread;
+
+    ////////////////////////////////////////////////////////////
+    // Start ADALM-Pluto TX thread
+    ////////////////////////////////////////////////////////////
+    if (plutotx.sink_fp == NULL) {
+        txStart();
+    } else {
+        fprintf(stderr, "Writing %.1fs of I/Q samples to file.\n", duration);
+    }
+    nblock = (int) (duration * 10.0 + 0.5);
+
+    if (rxfile == NULL) {
+        rx[0].fp = plutotx.sink_fp;
+        rx[0].dev0 = 0;
+        rx[0].ndev = ntxdev;
+    }
+
+    // Visible satellites
+    for (k = 0; k < nrx; k++) {
+        gpssim_rx_state(sim, k, &chan, &rho, &gain);
+
+        if (nrx > 1)
+            fprintf(stderr, "Receiver %d\n", k + 1);
+        fprintf(stderr, "PRN   Az    El     Range     Iono\n");
+        for (i = 0; i < nchan; i++) {
+            if (chan[i].prn > 0)
+                fprintf(stderr, "%02d %6.1f %5.1f %11.1f %5.1f\n", chan[i].prn,
+                    chan[i].azel[0] * R2D, chan[i].azel[1] * R2D, chan[i].rho0.d,
+                    chan[i].rho0.iono_delay);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Receiver antenna gain pattern
+    ////////////////////////////////////////////////////////////
+
+
+    ////////////////////////////////////////////////////////////
+    // Generate baseband signals
+    ////////////////////////////////////////////////////////////
+
+    if (nthreads > 0) {
+        memset(&job, 0, sizeof (job));
+        job.sim = sim;
+        job.g0 = g0;
+        job.out = rx;
+        job.nrx = nrx;
+        job.block = plutotx.block;
+        job.iq_bits = iq_bits;
+        job.out_shift = out_shift;
+        job.warmup = (gen_fs != plutotx.fs_hz || fir_taps > 0);
+        job.nblock = nblock;
+        job.base = (cache.fp != NULL) ? CACHE_DATA_OFFSET : 0;
+
+        fprintf(stderr, "Rendering with %d threads.\n", nthreads);
+        clock_gettime(CLOCK_MONOTONIC, &t_gen);
+        // Workers keep their own copy of the context, each renders all receivers of its segments
+        for (k = 0; k < nrx; k++)
+            fflush(rx[k].fp);
+        result = renderParallel(&job, nthreads);
+        sat_total += atomic_load(&job.sat_total);
+        sat_blocks += atomic_load(&job.sat_blocks);
+        for (iblock = 0; result == 0 && iblock < nblock; iblock++) {
+            if (cacheAddBlock(incGpsTime(g0, 0.1 * (iblock + 1))) != 0) {
+                fprintf(stderr, "ERROR: Failed to allocate scenario cache index.\n");
+                break;
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t_now);
+        fprintf(stderr, "Rendered %.1fs of I/Q samples in %.1fs.\n", nblock / 10.0, timeDiffUs(&t_now, &t_gen) / 1.0e6);
+        goto exit_main_thread;
+    }
+
+    if (ctrladdr != NULL) {
+        // Position commands need a single static receiver
+        ctrl.movable = (rxfile == NULL && staticLocationMode);
+        if (ctrlOpen(&ctrl, ctrladdr) != 0)
+            goto exit_main_thread;
+    }
+
+    while (!plutotx.exit) {
+        clock_gettime(CLOCK_MONOTONIC, &t_gen);
+
+        // Runtime control commands take effect at the epoch boundary
+        if (ctrl.fd >= 0)
+            ctrlApply(&ctrl, sim);
+
+        // Satellite states and channels of this block, shared by all receivers
+        if (gpssim_step(sim) != 0) {
+            fprintf(stderr, "ERROR: Failed to allocate code templates.\n");
+            break;
+        }
+        gpssim_get_block(sim, &iblock, &grx.week, &grx.sec);
+
+        for (k = 0; k < nrx && !plutotx.exit; k++) {
+            // Channels and position of this block
+            gpssim_rx_state(sim, k, &chan, &rho, &gain);
+            gpssim_get_position(sim, k, pos);
+
+            if (golden_fp != NULL)
+                writeGoldenState(golden_fp, iblock, chan, nchan);
+
+            truthLogEpoch(chan, nchan, gain, rho, iblock, k, grx, pos);
+
+            if (k == 0)
+                ctrlPublish(&ctrl, iblock, chan, rho, gain, nchan, grx, pos, gpssim_ionoutc(sim)->enable);
+
+            if (gpssim_render(sim, k) != 0) {
+                fprintf(stderr, "ERROR: Failed to render block %d.\n", iblock);
+                plutotx.exit = true;
+                break;
+            }
+
+            if (nelem > 0) {
+                // Common scale keeps the element amplitudes relative to each other
+                nsat = 0;
+                for (e = 0; e < nelem && !plutotx.exit; e++) {
+                    nsat += gpssim_pack(sim, k, e, iq_buff);
+                    if (pack_buff != NULL)
+                        iqCompress(iq_buff, pack_buff, plutotx.block, iq_bits, iqShift(iq_bits, out_shift));
+                    if (fwrite((pack_buff != NULL) ? (void *) pack_buff : (void *) iq_buff, iqBytes(iq_bits, plutotx.block), 1,
+                            el[e].fp) != 1) {
+                        fprintf(stderr, "ERROR: Failed to write I/Q output file.\n");
+                        plutotx.exit = true;
+                    }
+                }
+            } else if (rx[k].fp != NULL) {
+                out_buff = iq_buff;
+                nsat = gpssim_pack(sim, k, 0, out_buff);
+                if (golden_fp != NULL)
+                    writeGoldenHash(golden_fp, iblock, out_buff, plutotx.block);
+                if (pack_buff != NULL)
+                    iqCompress(out_buff, pack_buff, plutotx.block, iq_bits, iqShift(iq_bits, out_shift));
+                if (fwrite((pack_buff != NULL) ? (void *) pack_buff : (void *) out_buff, iqBytes(iq_bits, plutotx.block), 1,
+                        rx[k].fp) != 1) {
+                    fprintf(stderr, "ERROR: Failed to write I/Q output file.\n");
+                    plutotx.exit = true;
+                } else if (cacheAddBlock(grx) != 0) {
+                    fprintf(stderr, "ERROR: Failed to allocate scenario cache index.\n");
+                    plutotx.exit = true;
+                }
+            } else if (rx[k].ndev > 1) {
+                // One generator feeds several devices, each gets a copy
+                out_buff = iq_buff;
+                nsat = gpssim_pack(sim, k, 0, out_buff);
+                if (golden_fp != NULL)
+                    writeGoldenHash(golden_fp, iblock, out_buff, plutotx.block);
+                clock_gettime(CLOCK_MONOTONIC, &t_now);
+                if (txFanOut(out_buff, rx[k].dev0, rx[k].ndev, timeDiffUs(&t_now, &t_gen), nsat) != 0)
+                    break;
+            } else {
+                // Wait for a free TX buffer and write the samples directly into it
+                if ((out_buff = txAcquire(&txdev[rx[k].dev0])) == NULL)
+                    break;
+                nsat = gpssim_pack(sim, k, 0, out_buff);
+                if (golden_fp != NULL)
+                    writeGoldenHash(golden_fp, iblock, out_buff, plutotx.block);
+                clock_gettime(CLOCK_MONOTONIC, &t_now);
+                txRelease(&txdev[rx[k].dev0], timeDiffUs(&t_now, &t_gen), nsat);
+            }
+
+            if (nsat > 0) {
+                sat_total += nsat;
+                sat_blocks++;
+                if (verb)
+                    fprintf(stderr, "Block %d: %d I/Q values saturated.\n", iblock, nsat);
+            }
+        }
+
+        // File sink stops after the requested duration, the engine updates
+        // navigation message and channel allocation with the next block
+        if (plutotx.sink_fp != NULL && iblock + 1 >= nblock)
+            break;
+    }
+
+exit_main_thread:
+    if (plutotx.sink_fp == NULL) {
+        txStop(); /* Wait on Pluto TX thread exit */
+    } else if (cache.fp != NULL) {
+        cacheClose();
+    } else {
+        fclose(plutotx.sink_fp);
+    }
+    for (k = 1; k < nrx; k++) {
+        if (rx[k].fp != NULL)
+            fclose(rx[k].fp);
+    }
+    for (e = 1; e < nelem; e++)
+        fclose(el[e].fp);
+
+    if (plutotx.stats_fp) {
+        fclose(plutotx.stats_fp);
+    }
+
+    if (golden_fp) {
+        fclose(golden_fp);
+    }
+
+    truthLogClose();
+    ctrlClose(&ctrl);
+
+    if (sat_blocks > 0)
+        fprintf(stderr, "Saturated %lu I/Q values in %lu blocks.\n", sat_total, sat_blocks);
+
+    // Free I/Q buffers
+    if (iq_buff) {
+        free(iq_buff);
+    }
+    free(pack_buff);
+    gpssim_destroy(sim);
+
+    for (k = 0; rxfile != NULL && k < nrx; k++)
+        free(rx[k].xyz);
+    free(rx);
+    return (0);
+}
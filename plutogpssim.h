@@ -11,6 +11,11 @@
 
 #define FLOAT_CARR_PHASE // For RKT simulation. Higher computational load, but smoother carrier phase.
 
+#define NOTUSED(V) ((void) V)
+#define MHZ(x) ((long long)(x*1000000.0 + .5))
+#define GHZ(x) ((long long)(x*1000000000.0 + .5))
+#define TX_SAMPLE_FREQ 3000000
+
 /*! \brief Maximum length of a line in a text file (RINEX, motion) */
 #define MAX_CHAR (100)
 
@@ -18,13 +23,25 @@
 #define MAX_SAT (32)
 
 /*! \brief Maximum number of channels we simulate */
-#define MAX_CHAN (12)
+#define MAX_CHAN (256)
+
+/*! \brief Default number of channels, one per satellite */
+#define DEFAULT_CHAN (MAX_SAT)
 
 /*! \brief Maximum number of user motion points */
 #ifndef USER_MOTION_SIZE
 #define USER_MOTION_SIZE (3000) // max duration at 10Hz
 #endif
 
+/*! \brief Maximum number of receivers in one run, see -m */
+#define MAX_RECEIVERS (64)
+
+/*! \brief Maximum number of ADALM-Pluto TX devices in one run, see -U */
+#define MAX_TX_DEVICES (8)
+
+/*! \brief Maximum number of antenna array elements, see -K, a multiple of four SIMD lanes */
+#define MAX_ARRAY_ELEMENTS (16)
+
 /*! \brief Number of subframes */
 #define N_SBF (5) // 5 subframes per frame
 
@@ -37,6 +54,63 @@
 /*! \brief C/A code sequence length */
 #define CA_SEQ_LEN (1023)
 
+/*! \brief Carrier sin/cos table phase resolution limits in bits */
+#define MIN_CARR_TABLE_BITS (9)
+#define MAX_CARR_TABLE_BITS (14)
+
+/*! \brief Pluto 12-bit DAC full scale */
+#define DAC_FULL_SCALE (2047)
+
+/*! \brief Output RMS level with auto-scaling, 12dB below DAC full scale */
+#define OUTPUT_RMS (DAC_FULL_SCALE / 3.981)
+
+/*! \brief Sub-sample code phase offsets of a code template */
+#define CODE_TMPL_PHASES (64)
+
+/*! \brief Fractional bits of the fixed-point channel gain */
+#define GAIN_FRAC_BITS (16)
+
+/*! \brief Accumulator level the signal of all channels may reach, the rest is headroom for noise and filters */
+#define MAX_SIGNAL_ACC (INT32_MAX / 2)
+
+/*! \brief Per-PRN signal power offset limit in dB */
+#define MAX_POWER_OFFSET (60.0)
+
+/*! \brief Maximum number of multipath echoes, see -E */
+#define MAX_ECHOES (64)
+
+/*! \brief Maximum excess delay of a multipath echo in meters, below one C/A code period */
+#define MAX_ECHO_DELAY (30000.0)
+
+/*! \brief Polyphase resampler taps per phase, even */
+#define RESAMP_TAPS (32)
+
+/*! \brief Max. interpolation factor of the polyphase resampler */
+#define RESAMP_MAX_PHASES (512)
+
+/*! \brief Resampler cutoff relative to the generation rate */
+#define RESAMP_CUTOFF (0.45)
+
+/*! \brief Kaiser window shape of the FIR designs, about 80dB stopband */
+#define FIR_KAISER_BETA (8.0)
+
+/*! \brief Input samples a FIR filter processes at once, sized for the L1 cache */
+#define FIR_CHUNK (2048)
+
+/*! \brief Pulse shaping FIR length limits, multiple of 4 */
+#define MIN_FIR_TAPS (8)
+#define MAX_FIR_TAPS (256)
+
+/*! \brief Interleaved generator streams of the noise stage */
+#define NOISE_LANES (4)
+
+/*! \brief Ziggurat layers of the normal distribution */
+#define ZIG_LAYERS (128)
+
+/*! \brief C/N0 limits of the noise stage in dB-Hz */
+#define MIN_NOISE_CN0 (0.0)
+#define MAX_NOISE_CN0 (100.0)
+
 #define SECONDS_IN_WEEK 604800.0
 #define SECONDS_IN_HALF_WEEK 302400.0
 #define SECONDS_IN_DAY 86400.0
@@ -137,6 +211,7 @@ typedef struct {
     double A0, A1;
     int dtls, tot, wnt;
     int dtlsf, dn, wnlsf;
+    char date[21]; /*!< PGM / RUN BY / DATE of the navigation file */
 } ionoutc_t;
 
 typedef struct {
@@ -148,10 +223,34 @@ typedef struct {
     double iono_delay;
 } range_t;
 
+/*! \brief Multipath echo of one satellite signal */
+typedef struct {
+    int prn;
+    double delay; /*!< Excess path delay in meters */
+    double gain; /*!< Amplitude relative to the direct path */
+    double doppler; /*!< Doppler offset to the direct path in Hz */
+    double phase; /*!< Phase offset in cycles */
+} echo_t;
+
+/*! \brief Satellite position, velocity and clock at one receiver time */
+typedef struct {
+    double pos[3];
+    double vel[3];
+    double clk[2];
+} svstate_t;
+
+/*! \brief Navigation message of one satellite, the same for every receiver */
+typedef struct {
+    gpstime_t g0; /*!< Start of the current frame */
+    unsigned long sbf[5][N_DWRD_SBF]; /*!< Subframes of the current ephemeris */
+    unsigned long dwrd[N_DWRD]; /*!< Data words of the current frame */
+    bool valid; /*!< Message has been generated */
+} navmsg_t;
+
 /*! \brief Structure representing a Channel */
 typedef struct {
     int prn; /*< PRN Number */
-    int ca[CA_SEQ_LEN]; /*< C/A Sequence */
+    const signed char *ca; /*< C/A Sequence +1/-1, shared table entry */
     double f_carr; /*< Carrier frequency */
     double f_code; /*< Code frequency */
 #ifdef FLOAT_CARR_PHASE
@@ -161,18 +260,175 @@ typedef struct {
     int carr_phasestep; /*< Carrier phasestep */
 #endif
     double code_phase; /*< Code phase */
+    double carr_ref; /*!< Carrier phase reference at allocation, carrier phase is (carr_ref - pseudorange) / lambda (meters) */
     gpstime_t g0; /*!< GPS time at start */
-    unsigned long sbf[5][N_DWRD_SBF]; /*!< current subframe */
-    unsigned long dwrd[N_DWRD]; /*!< Data words of sub-frame */
+    unsigned long dwrd[N_DWRD]; /*!< Data words of sub-frame, copy of the satellite navigation message */
     int iword; /*!< initial word */
     int ibit; /*!< initial bit */
     int icode; /*!< initial code */
     int dataBit; /*!< current data bit */
     int codeCA; /*!< current C/A code */
+    int32_t gain_q; /*!< Combined signal gain, GAIN_FRAC_BITS fixed-point, set once per epoch */
     double azel[2];
     range_t rho0;
+    signed char *tmpl; /*!< Code template, CODE_TMPL_PHASES rows of tmpl_len samples */
+    int tmpl_len; /*!< Samples per code template row */
+    int tmpl_prn; /*!< PRN the code template was rendered for */
+    double tmpl_f_code; /*!< Code frequency the code template was rendered with */
 } channel_t;
 
+/*! \brief Sub-bins per power of two in the timing histograms */
+#define TIMING_HIST_SUB (16)
+
+/*! \brief Number of timing histogram bins, covers 1us up to 2^24us (~16s) */
+#define TIMING_HIST_BINS (24 * TIMING_HIST_SUB)
+
+/*! \brief Log-linear histogram of a timing metric in microseconds */
+typedef struct {
+    unsigned long count; /*!< Number of samples in histogram */
+    double min; /*!< Smallest sample */
+    double max; /*!< Largest sample */
+    double sum; /*!< Sum of all samples, for average */
+    unsigned int bins[TIMING_HIST_BINS];
+} timing_hist_t;
+
+/*! \brief TX timing telemetry collected by the Pluto TX thread */
+typedef struct {
+    timing_hist_t gen; /*!< Block generation time */
+    timing_hist_t push; /*!< Latency of iio_buffer_push */
+    timing_hist_t period; /*!< Interval between two buffer pushes */
+    timing_hist_t slack; /*!< Estimated time of samples queued ahead of the DAC */
+    unsigned long underruns; /*!< Underruns in current report interval */
+    unsigned long underruns_total; /*!< Underruns since start */
+    unsigned long blocks_total; /*!< Blocks pushed since start */
+    unsigned long saturated; /*!< Saturated I/Q values in current report interval */
+    unsigned long saturated_total; /*!< Saturated I/Q values since start */
+    double pushed_us; /*!< Signal time pushed since queue reference time */
+    struct timespec t_ref; /*!< Queue reference time */
+    struct timespec t_push; /*!< Time of last buffer push */
+    struct timespec t_report; /*!< Time of last report */
+} tx_stats_t;
+
+/*! \brief Runtime control command, see -Z */
+typedef enum {
+    CTRL_POSITION, /*!< Move the receiver to v[0..2] ECEF */
+    CTRL_GAIN, /*!< TX hardware gain v[0] in dB of device arg, -1 = all */
+    CTRL_IONO, /*!< Ionospheric delay on (arg = 1) or off */
+    CTRL_POWER, /*!< Power offset v[0] in dB of PRN arg */
+    CTRL_STOP /*!< Stop the simulation */
+} ctrl_type_t;
+
+/*! \brief Runtime control command queued for the next epoch */
+typedef struct {
+    ctrl_type_t type;
+    int arg;
+    double v[3];
+} ctrl_cmd_t;
+
+/*! \brief Channel state in a runtime status snapshot */
+typedef struct {
+    int prn;
+    double az, el; /*!< Azimuth and elevation in degree */
+    double range; /*!< Pseudorange in meters */
+    double doppler; /*!< Carrier Doppler in Hz */
+    double gain_db; /*!< Signal gain in dB */
+} ctrl_chan_t;
+
+/*! \brief Runtime status snapshot, published by the main thread once per epoch */
+typedef struct {
+    long block; /*!< Block counter since start */
+    gpstime_t g; /*!< Receiver time */
+    double xyz[3]; /*!< Receiver position */
+    bool iono; /*!< Ionospheric delay enabled */
+    int nsat; /*!< Allocated channels */
+    ctrl_chan_t chan[MAX_SAT];
+} ctrl_status_t;
+
+/*! \brief Truth log file and epoch record identifier "PGST" */
+#define TRUTH_MAGIC (0x54534750u)
+
+/*! \brief Truth log format version */
+#define TRUTH_VERSION (2)
+
+/*! \brief Truth log file header */
+typedef struct {
+    uint32_t magic; /*!< TRUTH_MAGIC */
+    uint32_t version; /*!< TRUTH_VERSION */
+    double interval; /*!< Epoch interval (seconds) */
+    double fs; /*!< Sample rate (Hz) */
+} truth_header_t;
+
+/*! \brief Truth log epoch record, followed by nchan channel records */
+typedef struct {
+    uint32_t magic; /*!< TRUTH_MAGIC, resynchronizes a damaged log */
+    uint32_t nchan; /*!< Number of channel records following */
+    uint32_t epoch; /*!< Epoch counter since start, shared by all receivers */
+    uint32_t dropped; /*!< Epoch records dropped by the log writer so far */
+    uint32_t rx; /*!< Receiver index, see -m */
+    uint32_t pad;
+    gpstime_t g; /*!< Receiver time at the end of the block */
+    double xyz[3]; /*!< Receiver position ECEF (meters) */
+} truth_epoch_t;
+
+/*! \brief Truth log state of one channel at the epoch time */
+typedef struct {
+    int32_t prn;
+    int32_t pad;
+    double range; /*!< Pseudorange (meters) */
+    double rate; /*!< Range rate (meters/second) */
+    double iono_delay; /*!< Ionospheric delay (meters) */
+    double azel[2]; /*!< Azimuth and elevation (radians) */
+    double f_carr; /*!< Carrier frequency (Hz) */
+    double f_code; /*!< Code frequency (Hz) */
+    double code_phase; /*!< Code phase (chips) */
+    double carr_phase; /*!< Carrier phase (cycles) */
+    double gain; /*!< Signal gain */
+} truth_chan_t;
+
+/*! \brief I/Q file formats, bits per I and Q value
+ *
+ * Compact formats hold the 12-bit DAC range with rounding, sc4 packs I into the
+ * high and Q into the low nibble of one byte.
+ */
+#define IQ_FMT_SC16 (16)
+#define IQ_FMT_SC8 (8)
+#define IQ_FMT_SC4 (4)
+
+/*! \brief Scenario cache file identifier "PGSC" */
+#define CACHE_MAGIC (0x43534750u)
+
+/*! \brief Scenario cache format version */
+#define CACHE_VERSION (2)
+
+/*! \brief File offset of the first I/Q block, page aligned for mmap */
+#define CACHE_DATA_OFFSET (4096)
+
+/*! \brief Blocks the replay asks the kernel to read ahead */
+#define CACHE_READAHEAD (8)
+
+/*! \brief Bytes of the scenario cache the replay maps at a time */
+#define CACHE_WINDOW (64 << 20)
+
+/*! \brief Scenario cache file header, I/Q blocks follow at CACHE_DATA_OFFSET */
+typedef struct {
+    uint32_t magic; /*!< CACHE_MAGIC */
+    uint32_t version; /*!< CACHE_VERSION */
+    uint32_t format; /*!< Sample format, bits per I/Q value IQ_FMT_SC16, IQ_FMT_SC8 or IQ_FMT_SC4 */
+    uint32_t block; /*!< I/Q samples per 0.1s block */
+    uint32_t shift; /*!< Left shift that expands compact samples to 16 bit */
+    uint32_t pad;
+    uint64_t nblocks; /*!< Number of I/Q blocks */
+    uint64_t index_offset; /*!< File offset of the time index, one entry per block */
+    double fs; /*!< Sample rate (Hz) */
+    gpstime_t start; /*!< Receiver time of the first block */
+} cache_header_t;
+
+/*! \brief Scenario cache time index entry */
+typedef struct {
+    gpstime_t g; /*!< Receiver time of block */
+    uint64_t offset; /*!< File offset of block */
+} cache_index_t;
+
 /* Structure represending a single GPS monitoring station. */
 typedef struct {
     const char *id_v2;
@@ -180,108 +436,4 @@ typedef struct {
     const char *name;
 } stations_t;
 
-/**
- * Stations providing Rinex v3 format.
- * 4-characters station ID
- * 9-characters station ID
- * Station name
- * Including Ionosphere data in Rinex file
- */
-const stations_t stations_v3[] = {
-    {"func", "FUNC00PRT", "Funchal"},
-    {"flrs", "FLRS00PRT", "Santa Cruz das Flore"},
-    {"pdel", "PDEL00PRT", "PONTA DELGADA"}
-};
-
-/**
- * Stations providing Rinex v2 format.
- * 4-characters station ID
- * 9-characters station ID
- * Station name
- * Including Ionosphere data in Rinex file
- */
-const stations_t stations_v2[] = {
-    {"abmf", "ABMF00GLP", "Aeroport du Raizet"},
-    {"aggo", "AGGO00ARG", "AGGO"},
-    {"ajac", "AJAC00FRA", "Ajaccio"},
-    {"ankr", "ANKR00TUR", "Ankara"},
-    {"areg", "AREG00PER", "Arequipa"},
-    {"ascg", "ASCG00SHN", "Ascension"},
-    {"bogi", "BOGI00POL", "Borowa Gora"},
-    {"bor1", "BOR100POL", "Borowiec"},
-    {"brst", "BRST00FRA", "Brest"},
-    {"chpg", "CHPG00BRA", "Cachoeira Paulista"},
-    {"cibg", "CIBG00IDN", "Cibinong"},
-    {"cpvg", "CPVG00CPV", "CAP-VERT"},
-    {"djig", "DJIG00DJI", "Djibouti"},
-    {"dlf1", "DLF100NLD", "Delft"},
-    {"ffmj", "FFMJ00DEU", "Frankfurt/Main"},
-    {"ftna", "FTNA00WLF", "Futuna"},
-    {"gamb", "GAMB00PYF", "Rikitea"},
-    {"gamg", "GAMG00KOR", "Geochang"},
-    {"glps", "GLPS00ECU", "Galapagos Permanent Station"},
-    {"glsv", "GLSV00UKR", "Kiev/Golosiiv"},
-    {"gmsd", "GMSD00JPN", "GUTS Masda"},
-    {"gop6", "GOP600CZE", "Pecny, Ondrejov"},
-    {"gop7", "GOP700CZE", "Pecny, Ondrejov"},
-    {"gope", "GOPE00CZE", "Pecny, Ondrejov"},
-    {"grac", "GRAC00FRA", "Grasse"},
-    {"gras", "GRAS00FRA", "Observatoire de Calern - OCA"},
-    {"holb", "HOLB00CAN", "Holberg"},
-    {"hueg", "HUEG00DEU", "Huegelheim"},
-    {"ieng", "IENG00ITA", "Torino"},
-    {"ista", "ISTA00TUR", "Istanbul"},
-    {"izmi", "IZMI00TUR", "Izmir"},
-    {"jfng", "JFNG00CHN", "Juifeng"},
-    {"joz2", "JOZ200POL", "Jozefoslaw"},
-    {"joze", "JOZE00POL", "Jozefoslaw"},
-    {"kerg", "KERG00ATF", "Kerguelen Islands"},
-    {"kitg", "KITG00UZB", "Kitab"},
-    {"koug", "KOUG00GUF", "Kourou"},
-    {"krgg", "KRGG00ATF", "Kerguelen Islands"},
-    {"krs1", "KRS100TUR", "Kars"},
-    {"lama", "LAMA00POL", "Lamkowo"},
-    {"leij", "LEIJ00DEU", "Leipzig"},
-    {"lmmf", "LMMF00MTQ", "Aeroport Aime CESAIRE-LE LAMENTIN"},
-    {"lroc", "LROC00FRA", "La Rochelle"},
-    {"mad2", "MAD200ESP", "Madrid Deep Space Tracking Station"},
-    {"madr", "MADR00ESP", "Madrid Deep Space Tracking Station"},
-    {"mayg", "MAYG00MYT", "Dzaoudzi"},
-    {"mers", "MERS00TUR", "Mersin"},
-    {"mikl", "MIKL00UKR", "Mykolaiv"},
-    {"morp", "MORP00GBR", "Morpeth"},
-    {"nklg", "NKLG00GAB", "N'KOLTANG"},
-    {"nyal", "NYAL00NOR", "Ny-Alesund"},
-    {"nya1", "NYA100NOR", "Ny-Alesund"},
-    {"ohi2", "OHI200ATA", "O'Higgins"},
-    {"orid", "ORID00MKD", "Ohrid"},
-    {"owmg", "OWMG00NZL", "Chatham Island"},
-    {"polv", "POLV00UKR", "Poltava"},
-    {"ptbb", "PTBB00DEU", "Braunschweig"},
-    {"ptgg", "PTGG00PHL", "Manilla"},
-    {"rabt", "RABT00MAR", "Rabat, EMI"},
-    {"reun", "REUN00REU", "La Reunion - Observatoire Volcanologique"},
-    {"rgdg", "RGDG00ARG", "Rio Grande"},
-    {"riga", "RIGA00LVA", "RIGA permanent GPS"},
-    {"seyg", "SEYG00SYC", "Mahe"},
-    {"sofi", "SOFI00BGR", "Sofia"},
-    {"stj3", "STJ300CAN", "STJ3 CACS-GSD"},
-    {"sulp", "SULP00UKR", "Lviv Polytechnic"},
-    {"svtl", "SVTL00RUS", "Svetloe"},
-    {"tana", "TANA00ETH", "ILA, Bahir Dar University"},
-    {"thtg", "THTG00PYF", "Papeete Tahiti"},
-    {"thti", "THTI00PYF", "Tahiti"},
-    {"tit2", "TIT200DEU", "Titz / Jackerath"},
-    {"tlse", "TLSE00FRA", "Toulouse"},
-    {"tro1", "TRO100NOR", "Tromsoe"},
-    {"warn", "WARN00DEU", "Warnemuende"},
-    {"whit", "WHIT00CAN", "WHIT CACS-GSD"},
-    {"wroc", "WROC00POL", "Wroclaw"},
-    {"wtza", "WTZA00DEU", "Wettzell"},
-    {"yel2", "YEL200CAN", "Yellow Knife"},
-    {"zeck", "ZECK00RUS", "Zelenchukskaya"},
-    {"zim2", "ZIM200CHE", "Zimmerwald"},
-    {"zimm", "ZIMM00CHE", "Zimmerwald L+T 88"},
-};
-
 #endif
@@ -0,0 +1,221 @@
+/**
+ * pluto-gps-truth converts the binary per-epoch truth log written by
+ * pluto-gps-sim -X into CSV or RINEX 2.11 observation files.
+ *
+ * This file is part of the pluto-gps-sim project at
+ * https://github.com/mictronics/pluto-gps-sim.git
+ *
+ * Copyright © 2019 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <stdarg.h>
+#include "gpssim_int.h"
+
+/*! \brief Maximum number of channel records accepted in one epoch */
+#define TRUTH_MAX_NCHAN (1024)
+
+static void truthUsage(void) {
+    fprintf(stderr, "Usage: pluto-gps-truth [options]\n"
+            "Options:\n"
+            "  -f <file name>   Truth log file written by pluto-gps-sim -X (required)\n"
+            "  -o <file name>   Output file (default stdout)\n"
+            "  -r               Write RINEX 2.11 observation file instead of CSV\n"
+            "  -n <index>       Receiver of a -m receiver list written with -r (default 0)\n"
+            "  -m <name>        RINEX marker name (default PLUTO)\n");
+
+    return;
+}
+
+/*! \brief Read next epoch of the truth log
+ *  \param[in] fp Truth log file
+ *  \param[out] ep Epoch record
+ *  \param[out] tc Channel records, TRUTH_MAX_NCHAN entries
+ *  \returns 1 on success, 0 at end of file, -1 on damaged log
+ */
+static int readTruthEpoch(FILE *fp, truth_epoch_t *ep, truth_chan_t *tc) {
+    if (fread(ep, sizeof (truth_epoch_t), 1, fp) != 1)
+        return (0);
+
+    if (ep->magic != TRUTH_MAGIC || ep->nchan > TRUTH_MAX_NCHAN)
+        return (-1);
+
+    if (fread(tc, sizeof (truth_chan_t), ep->nchan, fp) != ep->nchan)
+        return (-1);
+
+    return (1);
+}
+
+/*! \brief Write one epoch as CSV lines, one per channel */
+static void writeCsvEpoch(FILE *fp, const truth_epoch_t *ep, const truth_chan_t *tc) {
+    uint32_t i;
+
+    for (i = 0; i < ep->nchan; i++) {
+        fprintf(fp, "%u,%u,%d,%.3f,%.3f,%.3f,%.3f,%d,%.4f,%.4f,%.4f,%.3f,%.3f,%.6f,%.6f,%.9f,%.9f,%.3f\n",
+                ep->epoch, ep->rx, ep->g.week, ep->g.sec, ep->xyz[0], ep->xyz[1], ep->xyz[2],
+                tc[i].prn, tc[i].range, tc[i].rate, tc[i].iono_delay,
+                tc[i].azel[0] * R2D, tc[i].azel[1] * R2D,
+                tc[i].f_carr, tc[i].f_code, tc[i].code_phase, tc[i].carr_phase, tc[i].gain);
+    }
+}
+
+/*! \brief Write one RINEX header line with label in column 61 */
+static void rinexHeaderLine(FILE *fp, const char *label, const char *fmt, ...) {
+    char str[61];
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(str, sizeof (str), fmt, ap);
+    va_end(ap);
+    fprintf(fp, "%-60s%-20s\n", str, label);
+}
+
+/*! \brief Write RINEX 2.11 observation header from first epoch */
+static void writeRinexHeader(FILE *fp, const truth_header_t *hdr, const truth_epoch_t *ep, const char *marker) {
+    datetime_t t;
+
+    gps2date(&ep->g, &t);
+
+    rinexHeaderLine(fp, "RINEX VERSION / TYPE", "     2.11           OBSERVATION DATA    G (GPS)");
+    rinexHeaderLine(fp, "PGM / RUN BY / DATE", "%-20s%-20s%-20s", "pluto-gps-truth", "", "");
+    rinexHeaderLine(fp, "MARKER NAME", "%s", marker);
+    rinexHeaderLine(fp, "OBSERVER / AGENCY", "%-20s%-40s", "", "");
+    rinexHeaderLine(fp, "REC # / TYPE / VERS", "%-20s%-20s%-20s", "", "pluto-gps-sim", "");
+    rinexHeaderLine(fp, "ANT # / TYPE", "%-20s%-20s", "", "");
+    rinexHeaderLine(fp, "APPROX POSITION XYZ", "%14.4f%14.4f%14.4f", ep->xyz[0], ep->xyz[1], ep->xyz[2]);
+    rinexHeaderLine(fp, "ANTENNA: DELTA H/E/N", "%14.4f%14.4f%14.4f", 0.0, 0.0, 0.0);
+    rinexHeaderLine(fp, "WAVELENGTH FACT L1/2", "%6d%6d", 1, 0);
+    rinexHeaderLine(fp, "# / TYPES OF OBSERV", "%6d%6s%6s%6s", 3, "C1", "L1", "D1");
+    rinexHeaderLine(fp, "INTERVAL", "%10.3f", hdr->interval);
+    rinexHeaderLine(fp, "TIME OF FIRST OBS", "%6d%6d%6d%6d%6d%13.7f     GPS",
+            t.y, t.m, t.d, t.hh, t.mm, t.sec);
+    rinexHeaderLine(fp, "END OF HEADER", "");
+}
+
+/*! \brief Write one epoch as RINEX 2.11 observation record
+ *
+ * The simulator applies the ionospheric delay to code and carrier alike,
+ * so the carrier phase observable follows the pseudorange. The integer
+ * ambiguity is zero.
+ */
+static void writeRinexEpoch(FILE *fp, const truth_epoch_t *ep, const truth_chan_t *tc) {
+    datetime_t t;
+    uint32_t i;
+
+    gps2date(&ep->g, &t);
+
+    fprintf(fp, " %02d %2d %2d %2d %2d%11.7f  0%3u", t.y % 100, t.m, t.d, t.hh, t.mm, t.sec, ep->nchan);
+    for (i = 0; i < ep->nchan; i++) {
+        if (i > 0 && (i % 12) == 0)
+            fprintf(fp, "\n%32s", "");
+        fprintf(fp, "G%02d", tc[i].prn);
+    }
+    fprintf(fp, "\n");
+
+    for (i = 0; i < ep->nchan; i++) {
+        fprintf(fp, "%14.3f  %14.3f  %14.3f\n", tc[i].range, tc[i].range / LAMBDA_L1, tc[i].f_carr);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const char *infile = NULL;
+    const char *outfile = NULL;
+    const char *marker = "PLUTO";
+    bool rinex = false;
+    uint32_t rx = 0;
+    FILE *fin, *fout = stdout;
+    truth_header_t hdr;
+    truth_epoch_t ep;
+    truth_chan_t *tc;
+    long nepoch = 0;
+    int result;
+
+    while ((result = getopt(argc, argv, "f:o:m:n:rh")) != -1) {
+        switch (result) {
+            case 'f':
+                infile = optarg;
+                break;
+            case 'o':
+                outfile = optarg;
+                break;
+            case 'm':
+                marker = optarg;
+                break;
+            case 'r':
+                rinex = true;
+                break;
+            case 'n':
+                rx = (uint32_t) atoi(optarg);
+                break;
+            default:
+                truthUsage();
+                exit(1);
+        }
+    }
+
+    if (infile == NULL) {
+        truthUsage();
+        exit(1);
+    }
+
+    fin = fopen(infile, "rb");
+    if (fin == NULL) {
+        fprintf(stderr, "ERROR: Failed to open truth log file.\n");
+        exit(1);
+    }
+
+    if (fread(&hdr, sizeof (hdr), 1, fin) != 1 || hdr.magic != TRUTH_MAGIC || hdr.version != TRUTH_VERSION) {
+        fprintf(stderr, "ERROR: Invalid truth log file.\n");
+        exit(1);
+    }
+
+    if (outfile != NULL) {
+        fout = fopen(outfile, "w");
+        if (fout == NULL) {
+            fprintf(stderr, "ERROR: Failed to open output file.\n");
+            exit(1);
+        }
+    }
+
+    tc = malloc(TRUTH_MAX_NCHAN * sizeof (truth_chan_t));
+    if (tc == NULL) {
+        fprintf(stderr, "ERROR: Failed to allocate channel records.\n");
+        exit(1);
+    }
+
+    memset(&ep, 0, sizeof (ep));
+    if (!rinex)
+        fprintf(fout, "epoch,rx,week,sec,x,y,z,prn,range,rate,iono_delay,az,el,f_carr,f_code,code_phase,carr_phase,gain\n");
+
+    while ((result = readTruthEpoch(fin, &ep, tc)) > 0) {
+        if (rinex) {
+            // One observation file describes one receiver
+            if (ep.rx != rx)
+                continue;
+            if (nepoch == 0)
+                writeRinexHeader(fout, &hdr, &ep, marker);
+            writeRinexEpoch(fout, &ep, tc);
+        } else {
+            writeCsvEpoch(fout, &ep, tc);
+        }
+        nepoch++;
+    }
+
+    if (result < 0)
+        fprintf(stderr, "ERROR: Truth log damaged after %ld epochs.\n", nepoch);
+    if (ep.dropped > 0)
+        fprintf(stderr, "Truth log reports %u dropped epochs.\n", ep.dropped);
+    fprintf(stderr, "Converted %ld epochs.\n", nepoch);
+
+    free(tc);
+    fclose(fin);
+    if (fout != stdout)
+        fclose(fout);
+
+    return ((result < 0) ? 1 : 0);
+}
@@ -0,0 +1,744 @@
+/**
+ * pluto-gps-verify acquires and tracks GPS signals in an I/Q file written by
+ * pluto-gps-sim and compares the result against the simulator channel state.
+ *
+ * This file is part of the pluto-gps-sim project at
+ * https://github.com/mictronics/pluto-gps-sim.git
+ *
+ * Copyright © 2019 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <complex.h>
+#include "gpssim_int.h"
+
+#define METERS_PER_CHIP (SPEED_OF_LIGHT / CODE_FREQ)
+
+/*! \brief Verifier parameters */
+typedef struct {
+    long long fs_hz; /*!< Sample rate */
+    int block; /*!< Samples per simulator block */
+    double interval; /*!< Time between two check windows in seconds */
+    int track_ms; /*!< Tracking time per check window */
+    int acq_ms; /*!< Non-coherent acquisition integrations */
+    double max_doppler; /*!< Doppler search range +/- Hz */
+    double doppler_step; /*!< Doppler search bin width Hz */
+    double threshold; /*!< Acquisition peak to second peak ratio */
+    double delay; /*!< Known output delay in seconds, e.g. of the resampler */
+    int bits; /*!< I/Q file format, see IQ_FMT_SC16 */
+} verify_cfg_t;
+
+/*! \brief Mixed radix FFT plan */
+typedef struct {
+    int n; /*!< Transform length */
+    int nfact; /*!< Number of radix factors */
+    int fact[32]; /*!< Radix factors of n */
+    float complex *tw; /*!< Twiddle factors exp(-2*pi*i*k/n) */
+    float complex *scratch; /*!< Butterfly work space */
+} fft_plan_t;
+
+/*! \brief Truth of one channel at the start of a simulator block */
+typedef struct {
+    int block;
+    int prn;
+    double code_phase;
+    double f_carr;
+} truth_t;
+
+/*! \brief Truth table read from pluto-gps-sim -g state file */
+typedef struct {
+    truth_t *v;
+    long n;
+} truth_table_t;
+
+/*! \brief Result of acquisition and tracking of one PRN */
+typedef struct {
+    bool acquired;
+    double ratio; /*!< Acquisition peak to second peak ratio */
+    double code_phase; /*!< Code phase in chips at end of tracking */
+    double doppler; /*!< Doppler in Hz at end of tracking */
+    double cn0; /*!< C/N0 estimate in dB-Hz */
+} track_result_t;
+
+/*! \brief Complex multiply without the C99 Inf/NaN recovery library call */
+static inline float complex cmulf(float complex a, float complex b) {
+    return CMPLXF(crealf(a) * crealf(b) - cimagf(a) * cimagf(b), crealf(a) * cimagf(b) + cimagf(a) * crealf(b));
+}
+
+/*! \brief Unit phasor exp(i*2*pi*cycles) */
+static inline float complex phasor(double cycles) {
+    return CMPLXF((float) cos(2.0 * PI * cycles), (float) sin(2.0 * PI * cycles));
+}
+
+static void verifyUsage(void) {
+    fprintf(stderr, "Usage: pluto-gps-verify [options]\n"
+            "Options:\n"
+            "  -f <file name>   I/Q file written by pluto-gps-sim -o (required)\n"
+            "  -g <file name>   Golden state file from pluto-gps-sim -g, used as truth\n"
+            "  -s <frequency>   Sampling frequency [Hz] (default: %d)\n"
+            "  -b <samples>     Samples per simulator block (default: sampling frequency / 10)\n"
+            "  -i <interval>    Seconds between check windows (default 10.0)\n"
+            "  -L <ms>          Tracking time per window [ms] (default 200)\n"
+            "  -n <ms>          Non-coherent acquisition integrations [ms] (default 4)\n"
+            "  -D <doppler>     Doppler search range +/- [Hz] (default 5000)\n"
+            "  -t <ratio>       Acquisition peak to second peak threshold (default 1.8)\n"
+            "  -O <delay>       Output delay to remove from the truth [us], see pluto-gps-sim -I\n"
+            "  -q <bits>        I/Q file format written with pluto-gps-sim -q: 16, 8 or 4 (default 16)\n",
+            TX_SAMPLE_FREQ);
+
+    return;
+}
+
+/*! \brief Create FFT plan for arbitrary length, fast for lengths with small factors
+ *  \param[out] p FFT plan
+ *  \param[in] n Transform length
+ *  \returns 0 on success, -1 on error
+ */
+static int fftInit(fft_plan_t *p, int n) {
+    int k, r, m = n, maxr = 2;
+
+    memset(p, 0, sizeof (fft_plan_t));
+    p->n = n;
+
+    // Radix 4 first, it has the cheapest butterfly
+    while (m % 4 == 0 && p->nfact < 32) {
+        p->fact[p->nfact++] = 4;
+        m /= 4;
+        maxr = 4;
+    }
+    for (r = 2; m > 1 && p->nfact < 32; r++) {
+        while (m % r == 0 && p->nfact < 32) {
+            p->fact[p->nfact++] = r;
+            m /= r;
+            if (r > maxr)
+                maxr = r;
+        }
+    }
+
+    p->tw = malloc(sizeof (float complex) * n);
+    p->scratch = malloc(sizeof (float complex) * maxr * 2);
+    if (m > 1 || p->tw == NULL || p->scratch == NULL)
+        return (-1);
+
+    for (k = 0; k < n; k++)
+        p->tw[k] = phasor(-(double) k / n);
+
+    return (0);
+}
+
+static void fftFree(fft_plan_t *p) {
+    free(p->tw);
+    free(p->scratch);
+}
+
+/*! \brief Radix 2 butterflies of one FFT stage, tw is indexed in steps of ts */
+static void fftRadix2(float complex *out, int m, const float complex *tw, int ts) {
+    int u;
+
+    for (u = 0; u < m; u++) {
+        const float complex y0 = out[u];
+        const float complex y1 = cmulf(out[u + m], tw[u * ts]);
+        out[u] = y0 + y1;
+        out[u + m] = y0 - y1;
+    }
+}
+
+static void fftRadix3(float complex *out, int m, const float complex *tw, int ts) {
+    int u;
+
+    for (u = 0; u < m; u++) {
+        const float complex y0 = out[u];
+        const float complex y1 = cmulf(out[u + m], tw[u * ts]);
+        const float complex y2 = cmulf(out[u + 2 * m], tw[2 * u * ts]);
+        const float complex t1 = y1 + y2;
+        const float complex t2 = y0 - 0.5f * t1;
+        const float complex t3 = 0.866025404f * (y1 - y2);
+        out[u] = y0 + t1;
+        out[u + m] = CMPLXF(crealf(t2) + cimagf(t3), cimagf(t2) - crealf(t3));
+        out[u + 2 * m] = CMPLXF(crealf(t2) - cimagf(t3), cimagf(t2) + crealf(t3));
+    }
+}
+
+static void fftRadix4(float complex *out, int m, const float complex *tw, int ts) {
+    int u;
+
+    for (u = 0; u < m; u++) {
+        const float complex y0 = out[u];
+        const float complex y1 = cmulf(out[u + m], tw[u * ts]);
+        const float complex y2 = cmulf(out[u + 2 * m], tw[2 * u * ts]);
+        const float complex y3 = cmulf(out[u + 3 * m], tw[3 * u * ts]);
+        const float complex a0 = y0 + y2, a1 = y0 - y2;
+        const float complex a2 = y1 + y3;
+        const float complex a3 = CMPLXF(cimagf(y1) - cimagf(y3), crealf(y3) - crealf(y1)); // * -i
+        out[u] = a0 + a2;
+        out[u + m] = a1 + a3;
+        out[u + 2 * m] = a0 - a2;
+        out[u + 3 * m] = a1 - a3;
+    }
+}
+
+static void fftRadix5(float complex *out, int m, const float complex *tw, int ts) {
+    const float c1 = 0.309016994f, c2 = -0.809016994f;
+    const float s1 = 0.951056516f, s2 = 0.587785252f;
+    int u;
+
+    for (u = 0; u < m; u++) {
+        const float complex y0 = out[u];
+        const float complex y1 = cmulf(out[u + m], tw[u * ts]);
+        const float complex y2 = cmulf(out[u + 2 * m], tw[2 * u * ts]);
+        const float complex y3 = cmulf(out[u + 3 * m], tw[3 * u * ts]);
+        const float complex y4 = cmulf(out[u + 4 * m], tw[4 * u * ts]);
+        const float complex a1 = y1 + y4, a2 = y2 + y3;
+        const float complex b1 = y1 - y4, b2 = y2 - y3;
+        const float complex r1 = y0 + c1 * a1 + c2 * a2, r2 = y0 + c2 * a1 + c1 * a2;
+        const float complex i1 = s1 * b1 + s2 * b2, i2 = s2 * b1 - s1 * b2;
+        out[u] = y0 + a1 + a2;
+        out[u + m] = CMPLXF(crealf(r1) + cimagf(i1), cimagf(r1) - crealf(i1));
+        out[u + 4 * m] = CMPLXF(crealf(r1) - cimagf(i1), cimagf(r1) + crealf(i1));
+        out[u + 2 * m] = CMPLXF(crealf(r2) + cimagf(i2), cimagf(r2) - crealf(i2));
+        out[u + 3 * m] = CMPLXF(crealf(r2) - cimagf(i2), cimagf(r2) + crealf(i2));
+    }
+}
+
+/*! \brief Generic radix butterflies for uncommon prime factors */
+static void fftRadixN(const fft_plan_t *p, float complex *out, int r, int m, int ts) {
+    float complex *y = p->scratch;
+    float complex *w = p->scratch + r;
+    int u, k, q, idx;
+
+    // Roots of unity of this radix
+    for (k = 0; k < r; k++)
+        w[k] = p->tw[k * m * ts];
+
+    for (u = 0; u < m; u++) {
+        y[0] = out[u];
+        for (k = 1; k < r; k++)
+            y[k] = cmulf(out[u + k * m], p->tw[k * u * ts]);
+
+        for (q = 0; q < r; q++) {
+            float complex acc = y[0];
+            for (k = 1, idx = 0; k < r; k++) {
+                idx += q;
+                if (idx >= r)
+                    idx -= r;
+                acc += cmulf(y[k], w[idx]);
+            }
+            out[u + q * m] = acc;
+        }
+    }
+}
+
+/*! \brief Recursive decimation in time stage of the mixed radix FFT */
+static void fftStage(const fft_plan_t *p, float complex *out, const float complex *in, int stride, const int *fact, int n) {
+    const int r = fact[0];
+    const int m = n / r;
+    int k;
+
+    if (m == 1) {
+        for (k = 0; k < r; k++)
+            out[k] = in[k * stride];
+    } else {
+        for (k = 0; k < r; k++)
+            fftStage(p, out + k * m, in + k * stride, stride * r, fact + 1, m);
+    }
+
+    // Twiddle index k * u * stride stays below n
+    switch (r) {
+        case 2:
+            fftRadix2(out, m, p->tw, stride);
+            break;
+        case 3:
+            fftRadix3(out, m, p->tw, stride);
+            break;
+        case 4:
+            fftRadix4(out, m, p->tw, stride);
+            break;
+        case 5:
+            fftRadix5(out, m, p->tw, stride);
+            break;
+        default:
+            fftRadixN(p, out, r, m, stride);
+            break;
+    }
+}
+
+/*! \brief Forward FFT, \a out must not alias \a in */
+static void fft(const fft_plan_t *p, float complex *out, const float complex *in) {
+    fftStage(p, out, in, 1, p->fact, p->n);
+}
+
+/*! \brief Read truth table from golden state file
+ *  \returns Number of entries, -1 on error
+ */
+static long readTruth(truth_table_t *tt, const char *fname) {
+    FILE *fp;
+    char str[256];
+    long size = 0;
+    truth_t t;
+    int iword, ibit, icode, dataBit;
+    double carr;
+
+    tt->v = NULL;
+    tt->n = 0;
+
+    if (NULL == (fp = fopen(fname, "r")))
+        return (-1);
+
+    while (fgets(str, sizeof (str), fp) != NULL) {
+        if (str[0] != 'C')
+            continue;
+        if (sscanf(str + 1, "%d %d %lf %lf %lf %d %d %d %d", &t.block, &t.prn, &t.code_phase,
+                &carr, &t.f_carr, &iword, &ibit, &icode, &dataBit) != 9)
+            continue;
+
+        if (tt->n >= size) {
+            truth_t *v;
+            size = (size == 0) ? 4096 : size * 2;
+            v = realloc(tt->v, sizeof (truth_t) * size);
+            if (v == NULL) {
+                fclose(fp);
+                return (-1);
+            }
+            tt->v = v;
+        }
+        tt->v[tt->n++] = t;
+    }
+
+    fclose(fp);
+
+    return (tt->n);
+}
+
+/*! \brief Find truth of a PRN in a given simulator block, entries are sorted by block
+ *  \returns Pointer to entry, NULL if PRN is not simulated in that block
+ */
+static const truth_t *findTruth(const truth_table_t *tt, int block, int prn) {
+    long lo = 0, hi = tt->n, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (tt->v[mid].block < block)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    for (; lo < tt->n && tt->v[lo].block == block; lo++) {
+        if (tt->v[lo].prn == prn)
+            return (&tt->v[lo]);
+    }
+
+    return (NULL);
+}
+
+/*! \brief Parallel code phase acquisition of all PRNs in one window
+ *  \param[in] cfg Verifier parameters
+ *  \param[in] plan FFT plan for one code period
+ *  \param[in] code_fft Conjugate FFT of the sampled C/A code per PRN
+ *  \param[in] x Input samples, at least cfg->acq_ms code periods
+ *  \param[out] res Acquisition result per PRN (index PRN-1)
+ */
+static void acquire(const verify_cfg_t *cfg, const fft_plan_t *plan, float complex * const *code_fft,
+        const float complex *x, track_result_t *res) {
+    const int n = plan->n;
+    const int chip_samples = (int) ceil((double) n / CA_SEQ_LEN);
+    float complex *wipe = malloc(sizeof (float complex) * n);
+    float complex *wiped = malloc(sizeof (float complex) * n);
+    float complex *X = malloc(sizeof (float complex) * n);
+    float complex *Y = malloc(sizeof (float complex) * n);
+    float complex *y = malloc(sizeof (float complex) * n);
+    float *acc = malloc(sizeof (float) * n * MAX_SAT);
+    float best[MAX_SAT];
+    double f;
+    int sv, k, i, ms;
+
+    for (sv = 0; sv < MAX_SAT; sv++) {
+        best[sv] = 0.0f;
+        res[sv].acquired = false;
+        res[sv].ratio = 0.0;
+    }
+
+    for (f = -cfg->max_doppler; f <= cfg->max_doppler + 1e-6; f += cfg->doppler_step) {
+        memset(acc, 0, sizeof (float) * n * MAX_SAT);
+
+        for (k = 0; k < n; k++)
+            wipe[k] = phasor(-f * k / cfg->fs_hz);
+
+        for (ms = 0; ms < cfg->acq_ms; ms++) {
+            // Carrier wipe-off, phase offset between code periods is irrelevant non-coherently
+            for (k = 0; k < n; k++)
+                wiped[k] = cmulf(x[ms * n + k], wipe[k]);
+            fft(plan, X, wiped);
+
+            for (sv = 0; sv < MAX_SAT; sv++) {
+                // Circular correlation, inverse FFT through conjugation
+                for (k = 0; k < n; k++)
+                    Y[k] = conjf(cmulf(X[k], code_fft[sv][k]));
+                fft(plan, y, Y);
+                for (k = 0; k < n; k++)
+                    acc[sv * n + k] += crealf(y[k]) * crealf(y[k]) + cimagf(y[k]) * cimagf(y[k]);
+            }
+        }
+
+        for (sv = 0; sv < MAX_SAT; sv++) {
+            const float *a = acc + sv * n;
+            float peak = 0.0f, second = 0.0f;
+            int ipeak = 0;
+
+            for (k = 0; k < n; k++) {
+                if (a[k] > peak) {
+                    peak = a[k];
+                    ipeak = k;
+                }
+            }
+
+            if (peak <= best[sv])
+                continue;
+
+            // Second peak outside of one chip around the main peak
+            for (k = 0; k < n; k++) {
+                i = abs(k - ipeak);
+                if (i > n / 2)
+                    i = n - i;
+                if (i > chip_samples && a[k] > second)
+                    second = a[k];
+            }
+
+            best[sv] = peak;
+            res[sv].ratio = (second > 0.0f) ? sqrt(peak / second) : 1.0e3;
+            // Peak at sample d means code chip 0 arrives d samples after window start
+            res[sv].code_phase = fmod((double) (n - ipeak) * CA_SEQ_LEN / n, CA_SEQ_LEN);
+            res[sv].doppler = f;
+        }
+    }
+
+    for (sv = 0; sv < MAX_SAT; sv++)
+        res[sv].acquired = (res[sv].ratio >= cfg->threshold);
+
+    free(wipe);
+    free(wiped);
+    free(X);
+    free(Y);
+    free(y);
+    free(acc);
+
+    return;
+}
+
+/*! \brief Track one acquired PRN with FLL assisted PLL and DLL
+ *  \param[in] cfg Verifier parameters
+ *  \param[in] code C/A code as +/-1, padded with one chip on both sides
+ *  \param[in] x Input samples, cfg->track_ms code periods
+ *  \param res Acquisition result in, tracking result out
+ */
+static void track(const verify_cfg_t *cfg, const float *code, const float complex *x, track_result_t *res) {
+    const int n = (int) (cfg->fs_hz / 1000);
+    const double T = 0.001;
+    const int fll_ms = cfg->track_ms * 2 / 5;
+    const double zeta = 0.707;
+    const double wn = 20.0 / 0.53; // PLL noise bandwidth 20 Hz
+    double p = res->code_phase; // Code phase in chips
+    double f_int = res->doppler;
+    double f_nco = f_int;
+    double carr = 0.0; // Carrier phase in cycles
+    double m2 = 0.0, m4 = 0.0, f_sum = 0.0;
+    int nstat = 0;
+    float complex prev = 0.0f;
+    int ms, k;
+
+    for (ms = 0; ms < cfg->track_ms; ms++) {
+        const float complex *xs = x + (long) ms * n;
+        const double dcode = (CODE_FREQ + f_nco * CARR_TO_CODE) / cfg->fs_hz;
+        const float complex rot = phasor(-f_nco / cfg->fs_hz);
+        float complex lo = phasor(-carr);
+        float complex E = 0.0f, P = 0.0f, L = 0.0f;
+        double dll, pll, fll, pp;
+
+        for (k = 0; k < n; k++) {
+            const float complex s = cmulf(xs[k], lo);
+            const int ie = (int) (p + 0.5);
+
+            E += s * code[ie + 1];
+            P += s * code[(int) p + 1];
+            L += s * code[ie];
+
+            lo = cmulf(lo, rot);
+            p += dcode;
+            if (p >= CA_SEQ_LEN)
+                p -= CA_SEQ_LEN;
+        }
+
+        carr += f_nco * T;
+        carr -= floor(carr);
+
+        // Normalized early minus late envelope, chips
+        dll = 0.5 * (cabsf(E) - cabsf(L)) / (cabsf(E) + cabsf(L) + 1e-9f);
+        p += ((ms < fll_ms) ? 0.04 : 0.008) * dll;
+        if (p >= CA_SEQ_LEN)
+            p -= CA_SEQ_LEN;
+        else if (p < 0.0)
+            p += CA_SEQ_LEN;
+
+        if (ms < fll_ms) {
+            // Decision directed cross/dot frequency discriminator, Hz
+            if (ms > 0) {
+                double dot = crealf(prev) * crealf(P) + cimagf(prev) * cimagf(P);
+                double cross = crealf(prev) * cimagf(P) - cimagf(prev) * crealf(P);
+                fll = (dot != 0.0) ? atan(cross / dot) / (2.0 * PI * T) : 0.0;
+                f_int += 0.1 * fll;
+            }
+            f_nco = f_int;
+        } else {
+            // Costas discriminator, cycles
+            pll = (crealf(P) != 0.0f) ? atan(cimagf(P) / crealf(P)) / (2.0 * PI) : 0.0;
+            f_int += wn * wn * T * pll;
+            f_nco = f_int + 2.0 * zeta * wn * pll;
+        }
+        prev = P;
+
+        // Statistics over the last half of tracking
+        if (ms >= cfg->track_ms / 2) {
+            pp = crealf(P) * crealf(P) + cimagf(P) * cimagf(P);
+            m2 += pp;
+            m4 += pp * pp;
+            f_sum += f_int;
+            nstat++;
+        }
+    }
+
+    res->code_phase = p;
+    res->doppler = (nstat > 0) ? f_sum / nstat : f_int;
+    res->cn0 = 0.0;
+    if (nstat > 0) {
+        // Moments based C/N0 estimator
+        double pd, pn;
+        m2 /= nstat;
+        m4 /= nstat;
+        pd = 2.0 * m2 * m2 - m4;
+        pd = (pd > 0.0) ? sqrt(pd) : 0.0;
+        pn = m2 - pd;
+        res->cn0 = (pn > 0.0) ? 10.0 * log10(pd / pn / T) : 99.9;
+    }
+
+    return;
+}
+
+int main(int argc, char *argv[]) {
+    verify_cfg_t cfg;
+    fft_plan_t plan;
+    truth_table_t truth = {NULL, 0};
+    track_result_t res[MAX_SAT];
+    float complex *code_fft[MAX_SAT];
+    float code_ext[MAX_SAT][CA_SEQ_LEN + 2];
+    const char *iqfile = NULL;
+    const char *truthfile = NULL;
+    FILE *fp;
+    short *raw;
+    unsigned char *packed;
+    float complex *x;
+    int ca[CA_SEQ_LEN];
+    int result, sv, k, n, nwin_samples;
+    long window = 0;
+    long nacq = 0, nmiss = 0, nfalse = 0;
+    double sum_code = 0.0, sum_dop = 0.0;
+
+    cfg.fs_hz = TX_SAMPLE_FREQ;
+    cfg.block = 0;
+    cfg.interval = 10.0;
+    cfg.track_ms = 200;
+    cfg.acq_ms = 4;
+    cfg.max_doppler = 5000.0;
+    cfg.doppler_step = 250.0;
+    cfg.threshold = 1.8;
+    cfg.delay = 0.0;
+    cfg.bits = IQ_FMT_SC16;
+
+    while ((result = getopt(argc, argv, "f:g:s:b:i:L:n:D:t:O:q:h")) != -1) {
+        switch (result) {
+            case 'f':
+                iqfile = optarg;
+                break;
+            case 'g':
+                truthfile = optarg;
+                break;
+            case 's':
+                cfg.fs_hz = (long long) atoi(optarg);
+                break;
+            case 'b':
+                cfg.block = atoi(optarg);
+                break;
+            case 'i':
+                cfg.interval = atof(optarg);
+                break;
+            case 'L':
+                cfg.track_ms = atoi(optarg);
+                break;
+            case 'n':
+                cfg.acq_ms = atoi(optarg);
+                break;
+            case 'D':
+                cfg.max_doppler = atof(optarg);
+                break;
+            case 't':
+                cfg.threshold = atof(optarg);
+                break;
+            case 'O':
+                cfg.delay = atof(optarg) * 1.0e-6;
+                break;
+            case 'q':
+                cfg.bits = atoi(optarg);
+                break;
+            default:
+                verifyUsage();
+                exit(1);
+        }
+    }
+
+    if (cfg.block == 0)
+        cfg.block = (int) (cfg.fs_hz / 10);
+
+    if (iqfile == NULL || cfg.fs_hz % 1000 != 0 || cfg.fs_hz < MHZ(1.0) || cfg.block <= 0
+            || cfg.track_ms < 10 || cfg.acq_ms < 1 || cfg.interval <= 0.0
+            || (cfg.bits != IQ_FMT_SC16 && cfg.bits != IQ_FMT_SC8 && cfg.bits != IQ_FMT_SC4)) {
+        verifyUsage();
+        exit(1);
+    }
+
+    if (truthfile != NULL && readTruth(&truth, truthfile) < 0) {
+        fprintf(stderr, "ERROR: Failed to read truth file.\n");
+        exit(1);
+    }
+
+    // One code period per FFT
+    n = (int) (cfg.fs_hz / 1000);
+    if (fftInit(&plan, n) != 0) {
+        fprintf(stderr, "ERROR: Failed to create FFT plan.\n");
+        exit(1);
+    }
+
+    for (sv = 0; sv < MAX_SAT; sv++) {
+        float complex *c = malloc(sizeof (float complex) * n);
+        code_fft[sv] = malloc(sizeof (float complex) * n);
+        if (c == NULL || code_fft[sv] == NULL) {
+            fprintf(stderr, "ERROR: Failed to allocate code replica.\n");
+            exit(1);
+        }
+
+        codegen(ca, sv + 1);
+        for (k = 0; k < CA_SEQ_LEN + 2; k++)
+            code_ext[sv][k] = (float) (ca[(k + CA_SEQ_LEN - 1) % CA_SEQ_LEN] * 2 - 1);
+        for (k = 0; k < n; k++)
+            c[k] = (float) (ca[(int) ((double) k * CA_SEQ_LEN / n)] * 2 - 1);
+
+        fft(&plan, code_fft[sv], c);
+        for (k = 0; k < n; k++)
+            code_fft[sv][k] = conjf(code_fft[sv][k]);
+        free(c);
+    }
+
+    nwin_samples = n * ((cfg.acq_ms > cfg.track_ms) ? cfg.acq_ms : cfg.track_ms);
+    raw = malloc(sizeof (short) * 2 * nwin_samples);
+    packed = malloc(iqBytes(cfg.bits, nwin_samples));
+    x = malloc(sizeof (float complex) * nwin_samples);
+    if (raw == NULL || packed == NULL || x == NULL) {
+        fprintf(stderr, "ERROR: Failed to allocate sample buffer.\n");
+        exit(1);
+    }
+
+    if (NULL == (fp = fopen(iqfile, "rb"))) {
+        fprintf(stderr, "ERROR: Failed to open I/Q file.\n");
+        exit(1);
+    }
+
+    printf("time,prn,acq_ratio,cn0_dbhz,code_chips,code_truth,code_err_m,doppler_hz,doppler_truth,doppler_err_hz\n");
+
+    while (1) {
+        // sc4 holds two samples per byte
+        long long start = (long long) (window * cfg.interval * cfg.fs_hz) & ((cfg.bits == IQ_FMT_SC4) ? ~1LL : ~0LL);
+        long long end_sample = start + (long long) cfg.track_ms * n;
+        int end_block = (int) (end_sample / cfg.block);
+        double end_offset = (double) (end_sample - (long long) end_block * cfg.block);
+
+        if (fseeko(fp, (off_t) iqBytes(cfg.bits, 1) * start, SEEK_SET) != 0)
+            break;
+        if (cfg.bits == IQ_FMT_SC16) {
+            if (fread(raw, 2 * sizeof (short), nwin_samples, fp) != (size_t) nwin_samples)
+                break;
+        } else {
+            // Compact samples expand to the 12-bit range, the level does not matter here
+            if (fread(packed, iqBytes(cfg.bits, nwin_samples), 1, fp) != 1)
+                break;
+            iqExpand(packed, raw, nwin_samples, cfg.bits, iqShift(cfg.bits, 0));
+        }
+
+        for (k = 0; k < nwin_samples; k++)
+            x[k] = CMPLXF((float) raw[2 * k], (float) raw[2 * k + 1]);
+
+        acquire(&cfg, &plan, code_fft, x, res);
+
+        for (sv = 0; sv < MAX_SAT; sv++) {
+            const truth_t *t = (truth.n > 0) ? findTruth(&truth, end_block, sv + 1) : NULL;
+            double code_truth = 0.0, dop_truth = 0.0, code_err = 0.0;
+
+            if (!res[sv].acquired) {
+                if (t != NULL) {
+                    printf("%.3f,%d,%.2f,,,,,,,\n", (double) start / cfg.fs_hz, sv + 1, res[sv].ratio);
+                    nmiss++;
+                }
+                continue;
+            }
+
+            track(&cfg, code_ext[sv], x, &res[sv]);
+            nacq++;
+
+            if (t != NULL) {
+                // Propagate truth from block start to the end of tracking
+                code_truth = t->code_phase + (CODE_FREQ + t->f_carr * CARR_TO_CODE) * (end_offset / cfg.fs_hz - cfg.delay);
+                code_truth = fmod(code_truth, CA_SEQ_LEN);
+                dop_truth = t->f_carr;
+                code_err = res[sv].code_phase - code_truth;
+                if (code_err > CA_SEQ_LEN / 2.0)
+                    code_err -= CA_SEQ_LEN;
+                else if (code_err < -CA_SEQ_LEN / 2.0)
+                    code_err += CA_SEQ_LEN;
+                sum_code += code_err * code_err;
+                sum_dop += (res[sv].doppler - dop_truth) * (res[sv].doppler - dop_truth);
+            } else if (truth.n > 0) {
+                nfalse++;
+            }
+
+            printf("%.3f,%d,%.2f,%.1f,%.4f,%.4f,%.2f,%.2f,%.2f,%.2f\n", (double) start / cfg.fs_hz, sv + 1,
+                    res[sv].ratio, res[sv].cn0, res[sv].code_phase, code_truth,
+                    code_err * METERS_PER_CHIP, res[sv].doppler, dop_truth,
+                    (t != NULL) ? res[sv].doppler - dop_truth : 0.0);
+        }
+        fflush(stdout);
+
+        window++;
+    }
+
+    fprintf(stderr, "Windows %ld, tracked %ld", window, nacq);
+    if (truth.n > 0) {
+        long ntrue = nacq - nfalse;
+        fprintf(stderr, ", missed %ld, false %ld, RMS code error %.2fm, RMS Doppler error %.2fHz",
+                nmiss, nfalse, (ntrue > 0) ? sqrt(sum_code / ntrue) * METERS_PER_CHIP : 0.0,
+                (ntrue > 0) ? sqrt(sum_dop / ntrue) : 0.0);
+    }
+    fprintf(stderr, "\n");
+
+    fclose(fp);
+    free(raw);
+    free(packed);
+    free(x);
+    free(truth.v);
+    for (sv = 0; sv < MAX_SAT; sv++)
+        free(code_fft[sv]);
+    fftFree(&plan);
+
+    return ((nmiss == 0 && nfalse == 0) ? 0 : 1);
+}